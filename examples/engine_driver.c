@@ -0,0 +1,215 @@
+/* Drives the engine library through engine_api.h alone, the way a trainer
+ * written in another language would, and checks what it can see from the
+ * outside: stepping games one at a time and as a batch gives the same
+ * observations, a reset with the same seed replays the same games, every
+ * board looks like a board and bad arguments are refused. Prints game steps
+ * per second and exits non-zero on the first problem.
+ *
+ * Build the FallingBlockEngine project, then against the library it made:
+ *
+ *   cc -std=c99 -Iinclude examples/engine_driver.c -L<library dir> -lFallingBlockEngine -o engine_driver */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "engine_api.h"
+
+#define GAME_COUNT 64
+#define CHECK_STEPS 5000
+#define TIMED_STEPS 20000
+#define SEED 12345
+
+/* every buffer for GAME_COUNT games */
+typedef struct Observations
+{
+    uint8_t planes[GAME_COUNT * FB_PLANES_SIZE];
+    int32_t pieces[GAME_COUNT * FB_PIECE_FIELDS];
+    int32_t scores[GAME_COUNT * FB_SCORE_FIELDS];
+    int32_t rewards[GAME_COUNT];
+    uint8_t dones[GAME_COUNT];
+} Observations;
+
+static Observations g_batch;
+static Observations g_single;
+static Observations g_replay;
+
+static int Fail(const char* what)
+{
+    fprintf(stderr, "FAILED: %s\n", what);
+    return 1;
+}
+
+static fb_buffers Buffers(Observations* obs)
+{
+    fb_buffers buffers;
+    buffers.planes = obs->planes;
+    buffers.pieces = obs->pieces;
+    buffers.scores = obs->scores;
+    buffers.rewards = obs->rewards;
+    buffers.dones = obs->dones;
+    return buffers;
+}
+
+static uint32_t NextRandom(uint64_t* state)
+{
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t)(*state >> 33);
+}
+
+/* mostly sideways moves and rotations so pieces travel before they land */
+static void PickActions(uint64_t* state, uint8_t* actions)
+{
+    int game;
+
+    for (game = 0; game < GAME_COUNT; game++)
+    {
+        uint32_t roll = NextRandom(state) % 32;
+        actions[game] = roll < 28 ? (uint8_t)(roll % 4) : FB_ACTION_HARD_DROP;
+    }
+}
+
+/* 0 and 1 only, no full row left on the board and at most one piece falling */
+static int BoardsLookRight(const Observations* obs)
+{
+    int game;
+
+    for (game = 0; game < GAME_COUNT; game++)
+    {
+        const uint8_t* landed = obs->planes + game * FB_PLANES_SIZE + FB_PLANE_LANDED * FB_BOARD_HEIGHT * FB_BOARD_WIDTH;
+        const uint8_t* falling = obs->planes + game * FB_PLANES_SIZE + FB_PLANE_FALLING * FB_BOARD_HEIGHT * FB_BOARD_WIDTH;
+        int falling_cells = 0;
+        int y;
+
+        for (y = 0; y < FB_BOARD_HEIGHT; y++)
+        {
+            int filled = 0;
+            int x;
+
+            for (x = 0; x < FB_BOARD_WIDTH; x++)
+            {
+                uint8_t cell = landed[y * FB_BOARD_WIDTH + x];
+                uint8_t piece = falling[y * FB_BOARD_WIDTH + x];
+
+                if (cell > 1 || piece > 1 || (cell && piece))
+                {
+                    return 0;
+                }
+
+                filled += cell;
+                falling_cells += piece;
+            }
+
+            if (filled == FB_BOARD_WIDTH)
+            {
+                return 0;
+            }
+        }
+
+        if (falling_cells > 4 || obs->pieces[game * FB_PIECE_FIELDS + FB_PIECE_TYPE] >= 7)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int main(void)
+{
+    fb_env* batch;
+    fb_env* single;
+    fb_buffers batch_buffers = Buffers(&g_batch);
+    fb_buffers single_buffers = Buffers(&g_single);
+    uint8_t actions[GAME_COUNT];
+    uint64_t random_state = SEED;
+    long lines = 0;
+    long episodes = 0;
+    int step;
+    int game;
+    clock_t start;
+    double seconds;
+
+    if (fb_api_version() != FB_API_VERSION)
+    {
+        return Fail("library and header versions differ");
+    }
+
+    batch = fb_create(GAME_COUNT, SEED, FB_RANDOMIZER_BAG7);
+    single = fb_create(GAME_COUNT, SEED, FB_RANDOMIZER_BAG7);
+
+    if (batch == NULL || single == NULL || fb_game_count(batch) != GAME_COUNT)
+    {
+        return Fail("fb_create");
+    }
+
+    if (fb_create(0, SEED, FB_RANDOMIZER_UNIFORM) != NULL || fb_create(1, SEED, 2) != NULL ||
+        fb_step(batch, GAME_COUNT, FB_ACTION_NONE, NULL) != FB_ERROR_ARGUMENT ||
+        fb_step(batch, 0, FB_ACTION_COUNT, NULL) != FB_ERROR_ARGUMENT ||
+        fb_step_batch(NULL, actions, NULL) != FB_ERROR_ARGUMENT || fb_reset(NULL, SEED, NULL) != FB_ERROR_ARGUMENT)
+    {
+        return Fail("bad arguments were accepted");
+    }
+
+    fb_reset(batch, SEED, &batch_buffers);
+    fb_reset(single, SEED, &single_buffers);
+    memcpy(&g_replay, &g_batch, sizeof(Observations));
+
+    for (step = 0; step < CHECK_STEPS; step++)
+    {
+        PickActions(&random_state, actions);
+
+        if (fb_step_batch(batch, actions, &batch_buffers) != FB_OK)
+        {
+            return Fail("fb_step_batch");
+        }
+
+        for (game = 0; game < GAME_COUNT; game++)
+        {
+            fb_step(single, (uint32_t)game, actions[game], &single_buffers);
+            lines += g_batch.rewards[game];
+            episodes += g_batch.dones[game];
+        }
+
+        if (memcmp(&g_batch, &g_single, sizeof(Observations)) != 0)
+        {
+            return Fail("a game stepped alone differs from the same game stepped in the batch");
+        }
+
+        if (!BoardsLookRight(&g_batch))
+        {
+            return Fail("a board is malformed");
+        }
+    }
+
+    if (lines == 0 || episodes == 0)
+    {
+        return Fail("no line was cleared or no game ended, the check saw too little");
+    }
+
+    /* the same seed again has to deal the same first pieces */
+    fb_reset(batch, SEED, &batch_buffers);
+
+    if (memcmp(&g_batch, &g_replay, sizeof(Observations)) != 0)
+    {
+        return Fail("a reset with the same seed started different games");
+    }
+
+    printf("checked %d steps of %d games: %ld lines, %ld episodes, first game seed %llu\n", CHECK_STEPS, GAME_COUNT,
+        lines, episodes, (unsigned long long)fb_game_seed(batch, 0));
+
+    start = clock();
+
+    for (step = 0; step < TIMED_STEPS; step++)
+    {
+        PickActions(&random_state, actions);
+        fb_step_batch(batch, actions, &batch_buffers);
+    }
+
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("%.0f game steps per second with every observation written\n",
+        seconds > 0 ? (double)TIMED_STEPS * GAME_COUNT / seconds : 0);
+
+    fb_destroy(batch);
+    fb_destroy(single);
+    return 0;
+}
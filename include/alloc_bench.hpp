@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Plays bot games headless through the RecordedGame InGameState runs, every
+// input recorded into a replay archive, a keyframe every REPLAY_KEYFRAME_PIECES
+// pieces and an autosave every AUTOSAVE_TICKS, and counts the heap allocations
+// each tick makes on the game thread, the tick that finishes a game included.
+// Starting a game and deleting it may allocate, ticks in between must not. The
+// bot presses keys like a player, one a tick, and picking its moves is not
+// counted. Ticks run speed times faster than in the game so the writer threads
+// see a disk about as far behind as it would be. Allocations are counted by
+// alloc_bench.cpp's own global operator new, in every build.
+
+struct AllocBenchOptions
+{
+    uint32_t ticks = 100000;    // over all games together
+    double speed = 500;         // times faster than TICKS_PER_SECOND
+    uint64_t seed = 0;          // 0 picks a fresh one
+};
+
+struct AllocBenchReport
+{
+    uint32_t ticks = 0;
+    double seconds = 0;
+    size_t games = 0;           // finished, the last one is cut off at options.ticks
+    size_t lines = 0;
+    size_t keyframes = 0;
+    size_t autosaves = 0;
+    size_t allocations = 0;
+    size_t allocating_ticks = 0;
+    size_t max_tick_allocations = 0;
+    uint32_t first_allocating_tick = 0;     // of the game it happened in, 0 if none did
+};
+
+// global operator new calls so far on the calling thread
+size_t AllocationCount();
+bool RunAllocBench(const AllocBenchOptions& options, AllocBenchReport& out_report);
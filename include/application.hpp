@@ -1,12 +1,30 @@
 #include <SDL.h>
 #include <SDL_mixer.h>
 #include <iostream>
+#include <array>
 #include "game_state.hpp"
+#include "latency_probe.hpp"
+
+static const int MAX_TICKS_PER_FRAME = 8;
+static const size_t MAX_PENDING_EVENTS = 256;
+static const Uint64 PROBE_INTERVAL_MS = 100;
+static const double TICK_DURATION_SEC = 1.0 / TICKS_PER_SECOND;
+
+struct LaunchOptions
+{
+    bool measure_latency = false;   // --latency [samples]
+    size_t latency_samples = 200;
+    NetSocket* versus_socket = NULL; // --host or --join, connected before the window opens
+    GameSettings versus_settings;
+    int versus_player = 0;
+    bool spectate = false;          // --spectate [port]
+    uint16_t spectate_port = SPECTATOR_DEFAULT_PORT;
+};
 
 class Application
 {
 public:
-    Application();
+    Application(const LaunchOptions& options);
     ~Application();
 
 private:
@@ -16,14 +34,25 @@ private:
     SDL_Renderer* m_renderer = NULL;
     GameState* m_active_state = NULL;
     GameState* m_saved_state = NULL;
-    Uint64 m_last_frame_ticks = 0;
+    Uint64 m_counter_frequency = 1;
+    Uint64 m_last_frame_counter = 0;
+    Uint64 m_tick_accumulator = 0;
     bool m_should_quit = false;
     std::vector<Mix_Music*> m_music;
     size_t m_music_index = 0;
+    std::array<SDL_Event, MAX_PENDING_EVENTS> m_pending_events;
+    size_t m_pending_event_count = 0;
+    LatencyProbe* m_latency_probe = NULL;
+    SpectatorFeed* m_spectator_feed = NULL;
+    Uint64 m_next_probe_counter = 0;
 
 private:
     void MainLoop();
     void ChangeState(STATE new_state);
     void DeleteState(GameState*& state);
     bool HandleEvent(const SDL_Event& event);
+    void PollEvents();
+    STATE DispatchEvents(double tick_end_ms);
+    void InjectProbeEvent();
+    bool IsProbeEvent(const SDL_Event& event);
 };
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Appends byte chunks to a file from a background thread so the caller
+// never waits on disk I/O. Write() only takes a lock long enough to queue
+// the chunk; the destructor drains the queue and closes the file.
+//
+// Chunks the thread has written are kept as spares instead of freed.
+// A caller that hands a chunk over with Write() and takes its next one back
+// with TakeBuffer() passes the same few buffers back and forth, and once
+// Reserve() has set them aside that allocates nothing unless the disk falls
+// more than the reserved count behind.
+//
+// Chunks written with a non-zero tag go to the ChunkHandler given to Open()
+// instead of straight to the file, on the same thread and in the same order,
+// and only what the handler leaves in out_bytes is written. The replay archive
+// uses this to gather a replay's chunks and write them as one packed block.
+//
+// WriteAt() puts a chunk at an offset instead, over whatever was there, for
+// files opened without append. The save file keeps a few fixed slots that way.
+
+class ChunkHandler
+{
+public:
+    virtual ~ChunkHandler() = default;
+    virtual void HandleChunk(const std::vector<uint8_t>& chunk, uint8_t tag, std::vector<uint8_t>& out_bytes) = 0;
+};
+
+class AsyncFileWriter
+{
+public:
+    AsyncFileWriter() = default;
+    AsyncFileWriter(const std::string& path, bool append = false);
+    ~AsyncFileWriter();
+    bool Open(const std::string& path, bool append = false, ChunkHandler* handler = NULL);
+    bool IsOpen() const;
+    void Reserve(size_t count, size_t capacity);
+    void Write(std::vector<uint8_t>&& chunk, uint8_t tag = 0);
+    void WriteAt(uint64_t offset, std::vector<uint8_t>&& chunk);
+    void TakeBuffer(std::vector<uint8_t>& out_buffer, size_t capacity);
+
+private:
+    struct Chunk
+    {
+        std::vector<uint8_t> bytes;
+        uint8_t tag = 0;
+        int64_t offset = -1;    // WriteAt's, -1 to carry on from the last write
+    };
+
+    void Run();
+
+private:
+    FILE* m_file = NULL;
+    ChunkHandler* m_handler = NULL;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::vector<Chunk> m_queue;                     // oldest first
+    std::vector<Chunk> m_writing;                   // the thread's batch, swapped with m_queue
+    std::vector<std::vector<uint8_t>> m_spare;      // written, empty and ready for TakeBuffer
+    std::vector<uint8_t> m_handled;                 // the handler's output, only touched by the thread
+    size_t m_spare_size = 0;                        // largest capacity given to Reserve, smaller chunks are not kept
+    bool m_stopping = false;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "board_evaluator.hpp"
+
+// Steps a BatchEnvironment with random actions, and a simple bot in half the
+// games so lines get cleared, and checks every game after every step against
+// a GameCore given the same seed and the same calls, with both the plain and
+// the AVX2 kernels, on one thread and on a pool. Then times steps per second on
+// one thread with each kernel and on 1, 2, 4... up to max_threads threads
+// with the best one.
+
+struct BatchBenchOptions
+{
+    size_t games = 4096;
+    size_t steps = 2000;            // timed steps of every game
+    size_t check_games = 256;
+    size_t check_steps = 3000;
+    size_t max_threads = 1;
+    uint64_t seed = 0;              // 0 picks a fresh one
+};
+
+struct BatchScaling
+{
+    size_t threads = 0;
+    double seconds = 0;
+    double game_steps_per_second = 0;
+    double speedup = 0;             // over one thread
+};
+
+struct BatchBenchReport
+{
+    size_t checked_game_steps = 0;                          // for each kernel and thread count
+    size_t checked_threads = 0;                             // the pool's, besides one thread
+    size_t checked_episodes = 0;                            // games that topped out and started over
+    size_t checked_lines = 0;
+    size_t mismatches = 0;                                  // game steps that differed from GameCore
+    EVALUATOR_KERNEL best_kernel = KERNEL_SCALAR;
+    std::array<double, KERNEL_LENGTH> game_steps_per_second = {};  // one thread, 0 for kernels not run
+    size_t episodes = 0;                                    // finished while timing
+    size_t lines = 0;
+    std::vector<BatchScaling> scaling;
+};
+
+bool RunBatchBench(const BatchBenchOptions& options, BatchBenchReport& out_report);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "board.hpp"
+#include "board_evaluator.hpp"
+#include "game_core.hpp"
+#include "piece.hpp"
+#include "randomizer.hpp"
+#include "rotation.hpp"
+#include "work_stealing_pool.hpp"
+
+// Many independent games stepped together, one action per game per step,
+// for training bots. Each step does to one game what StepGameCore does to a
+// GameCore, see game_core.hpp. A game that tops out is reported done and
+// starts over with the next seed in the same step.
+//
+// Everything is stored game by game per field, so row y of every board sits
+// together and an AVX2 register holds the same row or the same piece field
+// of 8 or 16 games. Collision checks gather the rows under 8 pieces at once
+// and full rows are found 16 games at a time. Rotations, locking pieces and
+// moving rows down after a clear are rare enough to stay one game at a time.
+
+class BatchEnvironment
+{
+public:
+    BatchEnvironment(size_t game_count, uint64_t seed = 0, size_t thread_count = 1,
+        RANDOMIZER_TYPE randomizer = RANDOMIZER_UNIFORM, const RotationSystem* rotation_system = &DEFAULT_ROTATION_SYSTEM);
+    BatchEnvironment(const BatchEnvironment&) = delete;
+    BatchEnvironment& operator=(const BatchEnvironment&) = delete;
+    void Reset();
+    void Step(const uint8_t* actions);
+    size_t GameCount() const;
+    RowMask Row(size_t game, int y) const;
+
+private:
+    void ResetGame(size_t game);
+    void SpawnPiece(size_t game);
+    void SetShape(size_t game);
+    void StepGames(const uint8_t* actions, size_t begin, size_t end);
+    void RotateGame(size_t game);
+    void LockGame(size_t game);
+    void ClearRows(size_t game);
+    bool CollidesGame(size_t game, const PieceRotation& rotation, const Coordinate& origin) const;
+    uint32_t FitsBlock(size_t first, const int8_t* dx, int dy) const;
+    void FindFullRows(size_t begin, size_t end);
+
+public:
+    // AVX2 or plain code, anything else in the enum runs the plain code
+    EVALUATOR_KERNEL m_kernel;
+
+    // after each Step, per game
+    std::vector<int32_t> m_rewards;         // lines cleared this step
+    std::vector<uint8_t> m_dones;           // topped out this step and started over
+
+    // the game in progress, per game
+    std::vector<uint64_t> m_seeds;
+    std::vector<uint32_t> m_episodes;       // games finished so far
+    std::vector<uint32_t> m_lines;
+    std::vector<uint32_t> m_pieces;
+    std::vector<uint8_t> m_piece_types;
+    std::vector<uint8_t> m_piece_rotations;
+    std::vector<int32_t> m_piece_x;
+    std::vector<int32_t> m_piece_y;
+
+private:
+    size_t m_game_count;
+    size_t m_stride;                        // games rounded up to a whole number of registers
+    uint64_t m_seed;
+    RANDOMIZER_TYPE m_randomizer_type;
+    const RotationSystem* m_rotation_system;
+    std::unique_ptr<WorkStealingPool> m_pool;   // NULL for one thread
+
+    // m_rows[y * m_stride + game], with a register's worth of padding past the last row for gathers
+    std::vector<RowMask> m_rows;
+    std::vector<PieceRandomizer> m_randomizers;
+
+    // the falling piece's rotation as the collision check wants it, updated when it rotates or spawns
+    std::vector<int32_t> m_shape_min_x;
+    std::vector<int32_t> m_shape_max_x;
+    std::vector<int32_t> m_shape_min_y;
+    std::vector<int32_t> m_shape_height;
+    std::array<std::vector<int32_t>, SQUARES_PER_PIECE> m_shape_masks;
+
+    // per step scratch
+    std::vector<int8_t> m_moves;            // -1, 0 or 1 columns
+    std::vector<uint8_t> m_locked;
+    std::vector<uint8_t> m_topped_out;
+    std::vector<uint8_t> m_full;            // a row is full somewhere on the board
+};
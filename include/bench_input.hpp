@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include "game_core.hpp"
+#include "utility.hpp"
+
+// Random key presses for the simulated players of the network benches, see
+// rollback_bench.cpp and server_bench.cpp, and the real time tick they run at.
+
+static const std::chrono::nanoseconds BENCH_TICK(1000000000 / TICKS_PER_SECOND);
+
+// keys the bots press, speed changes are left out so games last
+static const GAME_INPUT BOT_INPUTS[] =
+{
+    INPUT_ROTATE,
+    INPUT_LEFT_PRESS,
+    INPUT_LEFT_RELEASE,
+    INPUT_RIGHT_PRESS,
+    INPUT_RIGHT_RELEASE,
+    INPUT_DOWN_PRESS,
+    INPUT_DOWN_RELEASE,
+    INPUT_HARD_DROP
+};
+
+static const uint64_t BOT_INPUT_ONE_IN = 12;    // chance of a key each tick
+
+/*The key a bot presses this tick, false on the ticks it presses none*/
+inline bool RandomBotInput(Rng& rng, GAME_INPUT& out_input)
+{
+    if (rng.Range(1, BOT_INPUT_ONE_IN) != 1)
+    {
+        return false;
+    }
+
+    out_input = BOT_INPUTS[rng.Range(0, std::size(BOT_INPUTS) - 1)];
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "piece.hpp"
+#include "rotation.hpp"
+
+//game board size
+static const int COORD_LIMIT_X = 9;
+static const int COORD_LIMIT_Y = 22;
+
+static const RowMask FULL_ROW_MASK = (RowMask)((1 << COORD_LIMIT_X) - 1);
+
+class Board
+{
+public:
+    Board();
+    bool InBounds(const Coordinate& coord) const;
+    bool IsOccupied(const Coordinate& coord) const;
+    bool Collides(const PieceRotation& rotation, const Coordinate& origin) const;
+    void Place(const Square& sq);
+    int ClearCompletedRows(uint32_t* out_cleared_rows = NULL);
+    bool AddGarbage(int rows, int hole_x, BLOCK_COLOR color);
+    int DropDistance(const PieceRotation& rotation, const Coordinate& origin) const;
+
+private:
+    void UpdateColumnTops();
+
+public:
+    std::array<RowMask, COORD_LIMIT_Y> m_rows;
+    std::array<int8_t, COORD_LIMIT_X> m_column_tops; // highest filled row per column, COORD_LIMIT_Y when empty
+    std::array<std::array<BLOCK_COLOR, COORD_LIMIT_X>, COORD_LIMIT_Y> m_colors;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Times Board::Collides and Board::ClearCompletedRows against the scans they
+// replaced, which kept every landed square in one list: a collision test
+// compared each cell of the piece with every square and a clear rebuilt the
+// list without the full rows. Boards are near full, the worst case for the
+// scans, with every row below the top two filled but for one hole and a few
+// rows completed for the clear. Every rotation of every piece is tested at
+// every origin on and around the board, and both sides have to give the same
+// answers before anything is timed.
+
+struct BoardBenchOptions
+{
+    size_t boards = 64;
+    size_t repeats = 50;            // timed passes over every board
+    uint64_t seed = 0;              // 0 picks a fresh one
+};
+
+struct BoardBenchReport
+{
+    size_t collision_checks = 0;    // per pass, each way
+    size_t collisions = 0;          // checks that collided, per pass
+    size_t rows_cleared = 0;        // per pass
+    size_t mismatches = 0;          // checks or clears where the two ways differed
+    double collides_ns = 0;         // per check
+    double scan_collides_ns = 0;
+    double clear_ns = 0;            // per board, copying the board included
+    double scan_clear_ns = 0;
+};
+
+bool RunBoardBench(const BoardBenchOptions& options, BoardBenchReport& out_report);
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "board.hpp"
+
+// Board features bots score candidate boards with. Every feature is a sum
+// over rows of a popcount of a few mask operations on that row, the row
+// above it and the OR of every row above it, so nothing walks cells. One
+// board goes through plain bit tricks, a BoardBatch holds up to
+// EVALUATOR_BATCH_SIZE boards row by row so a vector register holds the same
+// row of 8 (SSE) or 16 (AVX2) boards and they are all done at once.
+
+struct BoardFeatures
+{
+    int32_t aggregate_height;       // sum of column heights
+    int32_t max_height;
+    int32_t holes;                  // empty cells with a filled cell somewhere above
+    int32_t bumpiness;              // sum of height differences between neighbouring columns
+    int32_t row_transitions;        // filled to empty changes along rows, walls count as filled
+    int32_t column_transitions;     // the same down columns, the floor counts as filled
+    int32_t wells;                  // empty cells walled in on both sides, n deep counts 1 + 2 + ... + n
+
+    bool operator==(const BoardFeatures& other) const = default;
+};
+
+// one per bot personality, a board scores the weighted sum of its features and higher is better
+struct EvaluatorWeights
+{
+    float aggregate_height;
+    float max_height;
+    float holes;
+    float bumpiness;
+    float row_transitions;
+    float column_transitions;
+    float wells;
+};
+
+// keeps the stack low and flat, close to the well known hand tuned weights
+static const EvaluatorWeights EVALUATOR_BALANCED = { -0.51f, -0.1f, -3.6f, -0.18f, -0.32f, -0.93f, -0.34f };
+// afraid of height, gives up tidiness to stay low
+static const EvaluatorWeights EVALUATOR_CAUTIOUS = { -1.2f, -0.8f, -2.5f, -0.1f, -0.2f, -0.5f, -0.2f };
+// stacks high with one open well, waiting for a line piece to clear four at once
+static const EvaluatorWeights EVALUATOR_GREEDY = { -0.2f, -0.05f, -4.0f, -0.3f, -0.4f, -1.0f, 0.05f };
+
+enum EVALUATOR_KERNEL
+{
+    KERNEL_SCALAR,
+    KERNEL_SSE,     // SSSE3, 8 boards at once
+    KERNEL_AVX2,    // 16 boards at once
+    KERNEL_LENGTH
+};
+
+static const size_t EVALUATOR_BATCH_SIZE = 16;
+
+// rows[y][i] is row y of board i, zero padded past count
+struct BoardBatch
+{
+    size_t count = 0;
+    alignas(32) std::array<std::array<RowMask, EVALUATOR_BATCH_SIZE>, COORD_LIMIT_Y> rows = {};
+
+    void Clear();
+    bool Add(const std::array<RowMask, COORD_LIMIT_Y>& board_rows);
+};
+
+EVALUATOR_KERNEL BestEvaluatorKernel();
+const char* EvaluatorKernelName(EVALUATOR_KERNEL kernel);
+void EvaluateBoard(const std::array<RowMask, COORD_LIMIT_Y>& rows, BoardFeatures& out_features);
+void EvaluateBatch(const BoardBatch& batch, EVALUATOR_KERNEL kernel, std::array<BoardFeatures, EVALUATOR_BATCH_SIZE>& out_features);
+float ScoreFeatures(const BoardFeatures& features, const EvaluatorWeights& weights);
+void ScoreBatch(const BoardBatch& batch, EVALUATOR_KERNEL kernel, const EvaluatorWeights& weights,
+    std::array<float, EVALUATOR_BATCH_SIZE>& out_scores);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What main() can run instead of the game, one src/command_*.cpp each. main()
+// finds them by flag in its command line table, they print what they found
+// and return the process exit code, non-zero if anything failed to match.
+
+struct AllocBenchOptions;
+struct BatchBenchOptions;
+struct BoardBenchOptions;
+struct EvaluatorBenchOptions;
+struct PlacementBenchOptions;
+struct RollbackBenchOptions;
+struct SearchBenchOptions;
+struct ServerBenchOptions;
+
+// replay files and archives, see command_replay.cpp
+int RunReplays(const std::vector<std::string>& paths, int seek_seconds);
+int VerifyAll(const std::vector<std::string>& paths, size_t thread_count);
+int RebuildIndexes(const std::vector<std::string>& archives, size_t thread_count);
+int QueryIndex(const std::string& index_path, int top_count, int longer_than_minutes);
+
+int RunServer(uint16_t port, size_t thread_count);
+int WatchGame(const std::string& address);
+
+int MeasureRollback(const RollbackBenchOptions& options);
+int MeasureServer(const ServerBenchOptions& options);
+int MeasurePlacements(const PlacementBenchOptions& options);
+int MeasureEvaluator(const EvaluatorBenchOptions& options);
+int MeasureSearch(const SearchBenchOptions& options);
+int MeasureBatch(const BatchBenchOptions& options);
+int MeasureBoard(const BoardBenchOptions& options);
+int MeasureAllocations(const AllocBenchOptions& options);
@@ -0,0 +1,122 @@
+#ifndef ENGINE_API_H
+#define ENGINE_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Plain C interface to the game rules, built as its own shared library with
+ * no SDL, for trainers and test rigs in other languages. An fb_env holds
+ * game_count games of GameCore and each step runs StepGameCore from
+ * game_core.hpp: the action (a move checked with CanMove, a rotation or a
+ * hard drop), then unless it was a hard drop one row down, or a hard drop
+ * where the piece can go no further. A game that tops out is
+ * reported done and starts over with its next seed in the same step.
+ *
+ * Observations go straight into buffers the caller owns, laid out game after
+ * game so each one is a single contiguous array a trainer can wrap as a
+ * tensor. Once created an fb_env allocates nothing while it is reset or
+ * stepped. Calls on one fb_env must not overlap, separate fb_envs can be
+ * used from separate threads.
+ *
+ * Only fixed width types cross the interface and nothing is ever passed by
+ * value but scalars, so FB_API_VERSION only changes when a call or a buffer
+ * layout does. */
+
+#if defined(_WIN32)
+#ifdef ENGINE_API_EXPORTS
+#define FB_API __declspec(dllexport)
+#else
+#define FB_API __declspec(dllimport)
+#endif
+#else
+#define FB_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FB_API_VERSION 1
+
+#define FB_BOARD_WIDTH 9
+#define FB_BOARD_HEIGHT 22
+
+/* planes of FB_BOARD_HEIGHT rows of FB_BOARD_WIDTH bytes, row 0 at the top,
+ * 1 where the cell is filled and 0 where it is not */
+#define FB_PLANE_LANDED 0           /* blocks already on the board */
+#define FB_PLANE_FALLING 1          /* the falling piece */
+#define FB_PLANE_COUNT 2
+#define FB_PLANES_SIZE (FB_PLANE_COUNT * FB_BOARD_HEIGHT * FB_BOARD_WIDTH)
+
+/* int32 fields per game in fb_buffers.pieces */
+#define FB_PIECE_TYPE 0             /* 0 to 6: square, line, L right, L left, T, Z right, Z left */
+#define FB_PIECE_ROTATION 1
+#define FB_PIECE_X 2                /* origin of the rotation, may lie off the board */
+#define FB_PIECE_Y 3
+#define FB_PIECE_FIELDS 4
+
+/* int32 fields per game in fb_buffers.scores */
+#define FB_SCORE_LINES 0            /* lines cleared this episode, the score the game shows */
+#define FB_SCORE_PIECES 1           /* pieces locked this episode */
+#define FB_SCORE_EPISODES 2         /* episodes finished so far */
+#define FB_SCORE_FIELDS 3
+
+/* actions, one uint8 per game */
+#define FB_ACTION_NONE 0
+#define FB_ACTION_LEFT 1
+#define FB_ACTION_RIGHT 2
+#define FB_ACTION_ROTATE 3
+#define FB_ACTION_HARD_DROP 4
+#define FB_ACTION_COUNT 5
+
+#define FB_RANDOMIZER_UNIFORM 0     /* every piece independently uniform */
+#define FB_RANDOMIZER_BAG7 1        /* shuffled bag of all seven pieces */
+
+/* returned by every call that can fail */
+#define FB_OK 0
+#define FB_ERROR_ARGUMENT -1        /* NULL env, game out of range or unknown action */
+
+typedef struct fb_env fb_env;
+
+/* Where reset and step write observations. Each array holds game_count
+ * entries of the size given, entry g for game g, and any of them can be NULL
+ * to skip it. fb_step only writes entry g of each. */
+typedef struct fb_buffers
+{
+    uint8_t* planes;                /* FB_PLANES_SIZE bytes per game */
+    int32_t* pieces;                /* FB_PIECE_FIELDS per game */
+    int32_t* scores;                /* FB_SCORE_FIELDS per game */
+    int32_t* rewards;               /* lines cleared by the last step, 0 after a reset */
+    uint8_t* dones;                 /* 1 if the last step topped out and started over */
+} fb_buffers;
+
+/* FB_API_VERSION of the library loaded, for callers to check against the header they were built with */
+FB_API uint32_t fb_api_version(void);
+
+/* game_count games (at least 1) already reset from seed, 0 picks a fresh
+ * seed. NULL for a bad argument or if memory ran out */
+FB_API fb_env* fb_create(uint32_t game_count, uint64_t seed, int32_t randomizer);
+
+FB_API void fb_destroy(fb_env* env);
+
+FB_API uint32_t fb_game_count(const fb_env* env);
+
+/* Starts every game over, each from a seed derived from seed and its index
+ * the way BatchEnvironment derives them, 0 picks a fresh seed. Episode
+ * counts go back to 0. out may be NULL */
+FB_API int32_t fb_reset(fb_env* env, uint64_t seed, const fb_buffers* out);
+
+/* the seed of the episode game is playing, a GameSettings seed that replays it */
+FB_API uint64_t fb_game_seed(const fb_env* env, uint32_t game);
+
+/* one step of one game, out may be NULL */
+FB_API int32_t fb_step(fb_env* env, uint32_t game, uint8_t action, const fb_buffers* out);
+
+/* one step of every game, actions[g] for game g, out may be NULL */
+FB_API int32_t fb_step_batch(fb_env* env, const uint8_t* actions, const fb_buffers* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
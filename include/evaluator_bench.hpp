@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "board_evaluator.hpp"
+
+// Collects the candidate boards a bot weighs while playing with the
+// balanced weights, checks every evaluator kernel this CPU has against a
+// cell by cell count of the same features and times each of them.
+
+struct EvaluatorBenchOptions
+{
+    size_t games = 20;
+    size_t pieces_per_game = 500;
+    size_t repeats = 20;        // passes over the boards when timing
+    uint64_t seed = 0;          // 0 picks a fresh one
+};
+
+struct EvaluatorBenchReport
+{
+    size_t games = 0;
+    size_t pieces = 0;
+    size_t lines = 0;
+    size_t boards = 0;
+    EVALUATOR_KERNEL best_kernel = KERNEL_SCALAR;
+    double single_ns_per_board = 0;                         // EvaluateBoard
+    std::array<double, KERNEL_LENGTH> batch_ns_per_board = {}; // EvaluateBatch, 0 when the CPU lacks it
+    double reference_ns_per_board = 0;                      // cell by cell
+    size_t mismatches = 0;                                  // boards any kernel disagreed on
+    uint64_t checksum = 0;                                  // every feature of every timed board, cell by cell
+    size_t checksum_mismatches = 0;                         // timed passes that summed to something else
+};
+
+bool RunEvaluatorBench(const EvaluatorBenchOptions& options, EvaluatorBenchReport& out_report);
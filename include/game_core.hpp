@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include "board.hpp"
+#include "piece.hpp"
+#include "rotation.hpp"
+#include "randomizer.hpp"
+
+// game rules with no SDL dependency. InGameState translates SDL events into
+// GAME_INPUTs and turns the GameEvents back into sounds and labels.
+
+enum GAME_INPUT
+{
+    INPUT_ROTATE,
+    INPUT_LEFT_PRESS,
+    INPUT_LEFT_RELEASE,
+    INPUT_RIGHT_PRESS,
+    INPUT_RIGHT_RELEASE,
+    INPUT_DOWN_PRESS,
+    INPUT_DOWN_RELEASE,
+    INPUT_SPEED_UP,
+    INPUT_SPEED_DOWN,
+    INPUT_HARD_DROP,
+    INPUT_LENGTH
+};
+
+// one step of a game driven by a bot, see StepGameCore
+enum BATCH_ACTION : uint8_t
+{
+    ACTION_NONE,
+    ACTION_LEFT,
+    ACTION_RIGHT,
+    ACTION_ROTATE,
+    ACTION_HARD_DROP,
+    ACTION_LENGTH
+};
+
+enum GAME_EVENT_TYPE
+{
+    EVENT_PIECE_LOCKED,
+    EVENT_LINES_CLEARED,
+    EVENT_TOP_OUT
+};
+
+struct GameEvent
+{
+    GAME_EVENT_TYPE type;
+    int value;      // rows removed for EVENT_LINES_CLEARED
+    uint32_t rows;  // EVENT_LINES_CLEARED sets bit y for each row y removed, counted before the clear
+};
+
+// simulation rate, every timer in GameCore counts these
+static const int TICKS_PER_SECOND = 60;
+
+// slowest fall a snapshot may hold, a minute per row
+static const int MAX_FALL_TICKS = 60 * TICKS_PER_SECOND;
+
+// rows added by AddGarbage, there is no texture of its own
+static const BLOCK_COLOR GARBAGE_COLOR = BLOCK_RED;
+
+struct GameSettings
+{
+    uint64_t seed = 0; // 0 picks a fresh seed from RandomSeed()
+    RANDOMIZER_TYPE randomizer = RANDOMIZER_UNIFORM;
+    const RotationSystem* rotation_system = &DEFAULT_ROTATION_SYSTEM;
+};
+
+// Everything GameCore needs to resume a game, as fixed width fields with no
+// implicit padding so the bytes can be written to disk as they are. Replay
+// keyframes and save files both store it this way.
+struct GameSnapshot
+{
+    uint64_t seed;
+    std::array<uint64_t, 4> rng_state;
+    uint64_t lines_cleared;
+    uint64_t pieces_placed;
+    uint32_t tick;
+    int32_t ticks_since_down_move;
+    int32_t fall_ticks;
+    int32_t ticks_since_LR_move;
+    std::array<RowMask, COORD_LIMIT_Y> rows;
+    std::array<int8_t, COORD_LIMIT_X> column_tops;
+    std::array<std::array<BLOCK_COLOR, COORD_LIMIT_X>, COORD_LIMIT_Y> colors;
+    std::array<uint8_t, PIECE_TYPE::LENGTH> bag;
+    uint8_t bag_index;
+    uint8_t randomizer;
+    uint8_t piece_type;
+    uint8_t piece_rotation;
+    int8_t piece_x;
+    int8_t piece_y;
+    uint8_t LR_key_state;
+    uint8_t down_key_state;
+    uint8_t game_running;
+    uint8_t reserved[5];
+};
+
+static_assert(sizeof(GameSnapshot) == 344, "GameSnapshot layout changed, bump REPLAY_VERSION");
+static_assert(std::is_trivially_copyable_v<GameSnapshot>, "GameSnapshot is written and read as raw bytes");
+
+class GameCore
+{
+public:
+    GameCore(const GameSettings& settings = GameSettings());
+    void Reset(const GameSettings& settings);
+    void ApplyInput(GAME_INPUT input);
+    void Step();
+    bool PollEvent(GameEvent& out_event);
+    bool CanMove(const Coordinate& movement, const Piece& piece) const;
+    int DropDistance(const Piece& piece) const;
+    uint64_t Checksum() const;
+    void SaveSnapshot(GameSnapshot& out_snapshot) const;
+    bool LoadSnapshot(const GameSnapshot& snapshot);
+    void AddGarbage(int rows, int hole_x);
+
+public:
+    enum SpeedChange
+    {
+        UP,
+        DOWN,
+    };
+
+    enum LR_Key_State
+    {
+        KEY_NONE,
+        KEY_LEFT,
+        KEY_RIGHT
+    };
+
+private:
+    bool Move(const Coordinate& movement);
+    void Rotate();
+    bool PlacePiece();
+    void LockPiece();
+    void HardDrop();
+    bool NewPiece();
+    void ChangeSpeed(SpeedChange dir);
+    void CheckCompletedRow();
+    void PushEvent(GAME_EVENT_TYPE type, int value, uint32_t rows = 0);
+
+private:
+    static const size_t MAX_PENDING_EVENTS = 8;
+    static const int START_FALL_TICKS = 24;     // 0.4 sec
+
+    std::array<GameEvent, MAX_PENDING_EVENTS> m_events;
+    size_t m_event_count = 0;
+    size_t m_event_read = 0;
+
+public:
+    const RotationSystem* m_rotation_system;
+    uint64_t m_seed;
+    PieceRandomizer m_randomizer;
+    const Coordinate m_coord_limits {COORD_LIMIT_X, COORD_LIMIT_Y};
+    Board m_board;
+    Piece m_falling_piece;
+    bool m_game_running = true;
+    uint32_t m_tick = 0;
+    int m_ticks_since_down_move = 0;
+    int m_fall_ticks = START_FALL_TICKS;
+    int m_fall_ticks_step = 3;      // 0.05 sec
+    int m_fall_ticks_minimum = 6;   // 0.1 sec
+    int m_hold_key_move_ticks = 6;  // 0.1 sec
+    size_t m_lines_cleared = 0;
+    size_t m_pieces_placed = 0;
+    LR_Key_State m_LR_key_state = KEY_NONE;
+    int m_ticks_since_LR_move = 0;
+    bool m_down_key_state = false;
+};
+
+bool SnapshotValid(const GameSnapshot& snapshot, const RotationSystem& rotation_system);
+void StepGameCore(GameCore& core, uint8_t action);
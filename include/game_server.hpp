@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "game_core.hpp"
+#include "net_socket.hpp"
+#include "versus.hpp"
+#include "work_stealing_pool.hpp"
+
+// Hosts many headless games in one process. Clients connect over TCP and
+// each connection can open any number of sessions, every session being a
+// GameCore played the way InGameState plays one. Sessions live in one array
+// allocated up front; each tick the array is cut into batches of
+// SERVER_BATCH_SIZE sessions that the pool steps in parallel, while socket
+// reads and writes stay on the thread calling Tick. Nothing on that thread
+// waits on a socket: replies the kernel cannot take yet wait in a per
+// connection queue for the next tick.
+//
+// Stream, after an "FBGS" u16 version header from the server:
+//   open     u8 tag, u32 request, u64 seed          client, seed 0 picks one
+//   input    u8 tag, u32 session, u8 GAME_INPUT      client, applied on the next tick
+//   close    u8 tag, u32 session                     client
+//   opened   u8 tag, u32 request, u32 session        server, SERVER_NO_SESSION when full
+//   event    u8 tag, u32 session, u32 tick, u8 GAME_EVENT_TYPE, u8 value   server
+
+static const uint16_t SERVER_DEFAULT_PORT = 7432;
+static const char SERVER_MAGIC[4] = {'F', 'B', 'G', 'S'};
+static const uint16_t SERVER_PROTOCOL_VERSION = 1;
+static const size_t SERVER_HEADER_SIZE = sizeof(SERVER_MAGIC) + 2;
+static const size_t SERVER_MAX_SESSIONS = 8192;
+static const size_t SERVER_BATCH_SIZE = 256;
+static const uint32_t SERVER_NO_SESSION = UINT32_MAX;
+
+// a client with more unread bytes than this queued for it, or more unhandled bytes sent to the
+// server, is disconnected rather than allowed to hold up or bloat the tick
+static const size_t SERVER_SEND_LIMIT = SEND_QUEUE_LIMIT;
+static const size_t SERVER_RECEIVE_LIMIT = 64 * 1024;
+
+enum SERVER_MESSAGE : uint8_t
+{
+    SERVER_OPEN,
+    SERVER_INPUT,
+    SERVER_CLOSE,
+    SERVER_OPENED,
+    SERVER_EVENT
+};
+
+static const size_t SERVER_OPEN_SIZE = 1 + 4 + 8;
+static const size_t SERVER_INPUT_SIZE = 1 + 4 + 1;
+static const size_t SERVER_CLOSE_SIZE = 1 + 4;
+static const size_t SERVER_OPENED_SIZE = 1 + 4 + 4;
+static const size_t SERVER_EVENT_SIZE = 1 + 4 + 4 + 1 + 1;
+
+struct ServerSession
+{
+    GameCore core;
+    TickInputs inputs;                      // received since the last tick
+    uint8_t event_count = 0;
+    std::array<GameEvent, 8> events;        // from the last tick, sent by Tick
+    uint32_t connection = 0;
+    bool active = false;
+};
+
+// how long each part of one Tick took
+struct ServerTickTiming
+{
+    double receive_ms = 0;
+    double step_ms = 0;         // wall time of the batches
+    double step_cpu_ms = 0;     // all batches added up, what the pool threads spent
+    double send_ms = 0;
+    double total_ms = 0;
+};
+
+class GameServer
+{
+public:
+    GameServer(size_t max_sessions, size_t thread_count);
+    GameServer(const GameServer&) = delete;
+    GameServer& operator=(const GameServer&) = delete;
+    bool Listen(uint16_t port);
+    uint16_t Port() const;
+    void Tick(ServerTickTiming& out_timing);
+    size_t SessionCount() const;
+    size_t ThreadCount() const;
+    size_t MemoryUsage() const;
+
+private:
+    struct Connection
+    {
+        NetSocket socket;
+        std::vector<uint8_t> receive_buffer;
+        std::vector<uint8_t> send_buffer;      // this tick's messages
+        SendQueue send_queue {SERVER_SEND_LIMIT};   // earlier ticks' messages the socket has not taken yet
+    };
+
+    void AcceptConnections();
+    void ReceiveMessages();
+    bool HandleMessages(uint32_t connection_index);
+    uint32_t OpenSession(uint32_t connection_index, uint64_t seed);
+    void CloseSession(uint32_t session_index);
+    void CloseConnection(uint32_t connection_index);
+    void StepBatch(size_t first, size_t last);
+    void SendEvents();
+
+private:
+    NetSocket m_listener;
+    std::vector<ServerSession> m_sessions;      // never resized, sessions stay where they are
+    std::vector<uint32_t> m_free_sessions;      // lowest index on top so active sessions stay packed
+    size_t m_session_end = 0;                   // one past the highest active session
+    size_t m_session_count = 0;
+    std::vector<Connection> m_connections;
+    WorkStealingPool m_pool;
+    std::atomic<uint64_t> m_step_nanoseconds {0};
+};
@@ -7,6 +7,10 @@
 #include <unordered_map>
 #include "texture.hpp"
 #include "piece.hpp"
+#include "game_core.hpp"
+#include "recorded_game.hpp"
+#include "rollback.hpp"
+#include "spectator.hpp"
 #include "debug.hpp"
 
 static const char* FONT_PATH = "font/Righteous-Regular.ttf";
@@ -21,10 +25,24 @@ enum STATE
     STATE_QUIT
 };
 
+typedef std::array<SDL_Texture*, BLOCK_COLOR_LENGTH> BlockTextures;
+
+// shared by every state that draws a board, see game_state_ingame.cpp
+void LoadBlockTextures(SDL_Renderer* renderer, std::unordered_map<std::string, SDL_Texture*>& texture_data,
+    BlockTextures& out_textures);
+void RenderBoard(SDL_Renderer* renderer, const GameCore& core, const BlockTextures& textures, int cube_size,
+    int offset_x, int offset_y);
+bool TranslateKey(const SDL_Event& event, GAME_INPUT& out_input);
+
 class GameState
 {
 public:
     GameState() = default;
+    // lets MainLoop drop event types before they are queued
+    virtual bool WantsEvent(Uint32 event_type)
+    {
+        return true;
+    }
     virtual STATE HandleEvent(const SDL_Event& event)
     {
         DEBUG_PRINT("ERR GameState::HandleEvent called");
@@ -35,7 +53,8 @@ public:
         DEBUG_PRINT("ERR GameState::Step called");
         return STATE_QUIT;
     }
-    virtual void Render()
+    // interpolation is how far (0..1) the clock is between the last tick and the next
+    virtual void Render(double interpolation)
     {
         DEBUG_PRINT("ERR GameState::Render called");
         exit(1);
@@ -48,6 +67,8 @@ public:
     TTF_Font* m_font = NULL;
     std::unordered_map<std::string, SDL_Texture*> m_texture_data;
     std::unordered_map<std::string, Label> m_labels;
+    SpectatorFeed* m_spectator = NULL;     // --spectate, owned by Application
+    bool m_allocation_free_frames = false; // debug builds warn when Step+Render allocates
 };
 
 
@@ -55,9 +76,10 @@ class TitleState : public GameState
 {
 public:
     TitleState(SDL_Window* window, SDL_Renderer* renderer);
+    bool WantsEvent(Uint32 event_type);
     STATE HandleEvent(const SDL_Event& event);
     STATE Step(double delta_time_sec);
-    void Render();
+    void Render(double interpolation);
     ~TitleState();
 
 private:
@@ -68,58 +90,30 @@ private:
 class InGameState : public GameState
 {
 public:
-    InGameState(SDL_Window* window, SDL_Renderer* renderer);
+    // resume continues a saved game instead of starting a new one
+    InGameState(SDL_Window* window, SDL_Renderer* renderer, const GameSnapshot* resume = NULL);
     ~InGameState();
+    bool WantsEvent(Uint32 event_type);
     STATE HandleEvent(const SDL_Event& event);
     STATE Step(double delta_time_sec);
-    void Render();
-
-private:
-    enum SpeedChange
-    {
-        UP,
-        DOWN,
-    };
-    
-    enum LR_Key_State
-    {
-        KEY_NONE,
-        KEY_LEFT,
-        KEY_RIGHT
-    };
+    void Render(double interpolation);
+    void SaveGame();
+    void DiscardSave();
 
 private:
-    bool Move(const Coordinate& movement);
-    bool Move(const Coordinate& movement, const Piece& piece);
-    bool CanMove(const Coordinate& movement, const Piece& piece);
-    void Rotate();
-    bool PlacePiece();
-    bool NewPiece();
-    void ChangeSpeed(SpeedChange dir);
-    void CheckCompletedRow();
+    void HandleCoreEvent(const GameEvent& event);
+    void UpdateScore();
 
 private:
-    //game board size
-    static const int COORD_LIMIT_X = 9;
-    static const int COORD_LIMIT_Y = 22;
-
-    const Coordinate m_coord_limits {COORD_LIMIT_X, COORD_LIMIT_Y};
-    std::vector<Square> m_placed_squares;
-    Piece m_falling_piece;
+    RecordedGame m_game;
+    Piece m_previous_piece; // falling piece before the last tick, for interpolation
+    uint32_t m_cleared_rows = 0;        // rows cleared this tick, for the spectator feed
+    bool m_spectator_resync = true;     // spectators cannot follow from the last tick they saw
+    BlockTextures m_block_textures;
     SDL_Rect m_game_view;
     std::array<SDL_Rect, 3> m_game_border;
     int m_cube_size = 0;
-    bool m_game_running = true;
-    double m_time_since_down_move = 0;
-    double m_fall_speed = 0.4;
-    double m_fall_speed_step = 0.05;
-    double m_fall_speed_minimum = 0.1;
-    double m_hold_key_move_speed = 0.1;
-    size_t m_lines_cleared = 0;
     Label m_score;
-    LR_Key_State m_LR_key_state = KEY_NONE;
-    double m_time_since_LR_move = 0;
-    bool m_down_key_state = false;
     std::unordered_map<std::string, Mix_Chunk*> m_sound_effects;
 };
 
@@ -127,8 +121,46 @@ private:
 class PausedState : public GameState
 {
 public:
-    PausedState(SDL_Window* window, SDL_Renderer* renderer){};
-    STATE HandleEvent(const SDL_Event& event){return STATE_UNCHANGED;};
-    STATE Step(double delta_time_sec){return STATE_UNCHANGED;};
-    void Render(){};
+    // game keeps rendering underneath, it is owned by Application not by this state
+    PausedState(SDL_Window* window, SDL_Renderer* renderer, InGameState* game);
+    bool WantsEvent(Uint32 event_type);
+    STATE HandleEvent(const SDL_Event& event);
+    STATE Step(double delta_time_sec);
+    void Render(double interpolation);
+    ~PausedState();
+
+private:
+    STATE Choose(const std::string& name);
+
+private:
+    InGameState* m_game = NULL;
+};
+
+
+// Two player versus against another process, see rollback.hpp. The local
+// board is on the left. Esc leaves the match.
+class VersusState : public GameState
+{
+public:
+    VersusState(SDL_Window* window, SDL_Renderer* renderer, NetSocket&& socket, const GameSettings& settings,
+        int local_player);
+    ~VersusState();
+    bool WantsEvent(Uint32 event_type);
+    STATE HandleEvent(const SDL_Event& event);
+    STATE Step(double delta_time_sec);
+    void Render(double interpolation);
+
+private:
+    void ShowResult(const char* text);
+
+private:
+    NetSocket m_socket;
+    SendQueue m_send_queue {VERSUS_SEND_LIMIT};    // the game thread never waits on the peer
+    RollbackSession m_session;
+    std::vector<uint8_t> m_packet;
+    BlockTextures m_block_textures;
+    std::array<SDL_Rect, VERSUS_PLAYERS> m_views;  // local player first
+    int m_cube_size = 0;
+    bool m_finished = false;
+    std::unordered_map<std::string, Mix_Chunk*> m_sound_effects;
 };
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <ostream>
+
+// Timestamps one synthetic key press at a time through the frame pipeline.
+// Counters come from SDL_GetPerformanceCounter, the probe itself has no SDL dependency.
+
+enum LATENCY_STAGE
+{
+    LATENCY_INJECTED,           // SDL_PushEvent
+    LATENCY_RECEIVED,           // drained from the SDL queue
+    LATENCY_APPLIED,            // handed to the state before its tick
+    LATENCY_RENDER_SUBMITTED,   // state finished drawing the frame showing it
+    LATENCY_PRESENTED,          // SDL_RenderPresent returned
+    LATENCY_STAGE_LENGTH
+};
+
+class LatencyProbe
+{
+public:
+    LatencyProbe(size_t sample_target, uint64_t counter_frequency);
+    bool InFlight() const;
+    bool Done() const;
+    void Begin(uint64_t counter);
+    void Mark(LATENCY_STAGE stage, uint64_t counter);
+    void PrintReport(std::ostream& out) const;
+
+private:
+    typedef std::array<uint64_t, LATENCY_STAGE_LENGTH> Sample;
+
+    size_t m_sample_target;
+    uint64_t m_counter_frequency;
+    std::vector<Sample> m_samples;
+    Sample m_current = {};
+    int m_next_stage = LATENCY_STAGE_LENGTH; // LATENCY_STAGE_LENGTH means nothing in flight
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "board.hpp"
+#include "board_evaluator.hpp"
+#include "move_generator.hpp"
+#include "piece.hpp"
+#include "randomizer.hpp"
+#include "rotation.hpp"
+#include "work_stealing_pool.hpp"
+
+// Picks where to put the falling piece by looking several pieces ahead. A
+// board is worth the best of its placements while the next piece is known
+// and the mean over every piece the randomizer could deal once it is not,
+// and boards out of depth are scored with BoardEvaluator weights. Each
+// placement of the falling piece is searched as its own task on a
+// WorkStealingPool. Boards already valued are shared between tasks, depths
+// and moves through a TranspositionTable keyed by a hash kept up to date one
+// row at a time as pieces are placed. Depth goes up a piece at a time until
+// the time budget runs out and the deepest search that finished decides.
+
+static const size_t MAX_SEARCH_DEPTH = 6;
+
+// bit t set for each PIECE_TYPE t
+static const uint8_t ALL_PIECES_MASK = (uint8_t)((1 << PIECE_TYPE::LENGTH) - 1);
+
+// worse than any board the evaluator can score, for a piece that cannot spawn
+static const float TOP_OUT_VALUE = -1.0e6f;
+
+// what the bot knows about the pieces after the falling one
+struct PieceOutlook
+{
+    std::array<PIECE_TYPE, MAX_SEARCH_DEPTH> known;
+    size_t known_count = 0;
+    RANDOMIZER_TYPE randomizer = RANDOMIZER_UNIFORM;
+    uint8_t bag = ALL_PIECES_MASK;  // pieces left in the bag once the known ones are dealt, RANDOMIZER_BAG7 only
+};
+
+struct SearchOptions
+{
+    size_t max_depth = 3;                           // pieces, the falling one included
+    double budget_ms = 0;                           // 0 always searches to max_depth
+    EvaluatorWeights weights = EVALUATOR_BALANCED;
+};
+
+struct SearchResult
+{
+    Placement placement;
+    float value = 0;
+    size_t depth = 0;           // of the deepest search that finished
+    size_t nodes = 0;           // boards valued, every depth counted
+    size_t table_hits = 0;
+    double seconds = 0;
+};
+
+// Fixed size table from a position key to its value, read and written by
+// every worker with no lock. Each slot keeps the key XORed with the data
+// beside the data itself, so a slot torn by two writers no longer matches
+// either key and reads as a miss. A store always replaces what was there.
+class TranspositionTable
+{
+public:
+    TranspositionTable(size_t size_log2);
+    bool Probe(uint64_t key, float& out_value) const;
+    void Store(uint64_t key, float value);
+    void Clear();
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> check {0};
+        std::atomic<uint64_t> data {0};
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask;
+};
+
+class LookaheadSearch
+{
+public:
+    LookaheadSearch(size_t thread_count, const RotationSystem* rotation_system = &DEFAULT_ROTATION_SYSTEM);
+    bool Search(const Board& board, const Piece& falling_piece, const PieceOutlook& outlook,
+        const SearchOptions& options, SearchResult& out_result);
+    void ClearTable();
+    size_t ThreadCount() const;
+
+private:
+    // what one task needs to search a subtree, handed out so no two tasks share one
+    struct Scratch
+    {
+        Scratch(const RotationSystem* rotation_system);
+
+        MoveGenerator generator;
+        std::array<PlacementList, MAX_SEARCH_DEPTH> lists;
+        BoardBatch batch;
+        size_t nodes = 0;
+        size_t table_hits = 0;
+    };
+
+    float Value(Scratch& scratch, const Board& board, uint64_t hash, size_t ply, size_t remaining, uint8_t bag);
+    float BestPlacement(Scratch& scratch, const Board& board, uint64_t hash, PIECE_TYPE type, size_t ply,
+        size_t remaining, uint8_t bag);
+    uint64_t PositionKey(uint64_t hash, size_t ply, size_t remaining, uint8_t bag) const;
+    bool OutOfTime();
+    Scratch* TakeScratch();
+    void ReturnScratch(Scratch* scratch);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    const RotationSystem* m_rotation_system;
+    WorkStealingPool m_pool;
+    TranspositionTable m_table;
+    EVALUATOR_KERNEL m_kernel;
+
+    std::mutex m_scratch_mutex;
+    std::vector<std::unique_ptr<Scratch>> m_scratch;    // every one made
+    std::vector<Scratch*> m_free_scratch;
+    size_t m_nodes = 0;                                 // counted by scratch handed back
+    size_t m_table_hits = 0;
+
+    // the search in progress
+    PieceOutlook m_outlook;
+    EvaluatorWeights m_weights;
+    bool m_has_deadline = false;
+    Clock::time_point m_deadline;
+    std::atomic<bool> m_stop {false};
+    std::vector<Board> m_children;
+    std::vector<uint64_t> m_child_hashes;
+    std::vector<float> m_child_values;
+};
+
+PieceOutlook PeekOutlook(const PieceRandomizer& randomizer, size_t preview);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only view of a whole file mapped into memory. The size is fixed when
+// the file is opened, bytes appended afterwards are not visible.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+    bool Open(const std::string& path);
+    void Close();
+    const uint8_t* Data() const;
+    size_t Size() const;
+
+private:
+    const uint8_t* m_data = NULL;
+    size_t m_size = 0;
+#ifdef _WINDOWS
+    void* m_file = NULL;    // HANDLE, kept as void* so windows.h stays out of the header
+    void* m_mapping = NULL;
+#else
+    int m_fd = -1;
+#endif
+};
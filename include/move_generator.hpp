@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "board.hpp"
+#include "piece.hpp"
+#include "rotation.hpp"
+
+// Lists every place the falling piece can come to rest, for bots and
+// analysis. Moves are left, right, down one row and rotating with the same
+// clamping and kicks as GameCore::Rotate, so tucks under overhangs and spins
+// into holes are found along with plain drops. Collisions are tested against
+// one RowMask per rotation and row giving every column the piece fits in, and
+// reachability is a flood fill over those masks a whole row at a time. Most
+// resting places are a few rotations and shifts then a straight drop, the
+// rest are found by walking the flood's steps back to the start.
+
+enum PLACEMENT_MOVE : uint8_t
+{
+    MOVE_LEFT,
+    MOVE_RIGHT,
+    MOVE_DOWN,      // one row, like holding down for a moment
+    MOVE_ROTATE
+};
+
+static const size_t MAX_PLACEMENT_PATH = 60;
+static const size_t MAX_PIECE_STATES = MAX_ROTATIONS * COORD_LIMIT_Y * COORD_LIMIT_X;
+
+// a resting position and the moves from the starting piece to it, a hard drop after them locks it there.
+// the path is rotations then shifts when a straight drop gets there, otherwise the way the flood fill
+// first got there with any moves down at the end left to the hard drop
+struct Placement
+{
+    int8_t x;
+    int8_t y;
+    uint8_t rotation;
+    uint8_t path_length;
+    std::array<uint8_t, MAX_PLACEMENT_PATH> path;   // PLACEMENT_MOVEs
+};
+
+static_assert(sizeof(Placement) == 64, "Placement is meant to fill one cache line");
+
+struct PlacementList
+{
+    size_t count = 0;
+    std::array<Placement, MAX_PIECE_STATES> placements;
+};
+
+class MoveGenerator
+{
+public:
+    MoveGenerator(const RotationSystem* rotation_system = &DEFAULT_ROTATION_SYSTEM);
+    size_t Generate(const Board& board, const Piece& piece, PlacementList& out_placements);
+
+private:
+    // one batch of columns reached on a row from one earlier step, kept for finding the way back
+    struct FloodStep
+    {
+        RowMask seeds;      // columns first reached, before spreading sideways
+        RowMask added;      // columns new to the flood once spread
+        uint16_t parent;
+        uint16_t next;      // next step that added columns on the same row
+        uint8_t rotation;
+        uint8_t y;
+        int8_t kick;        // index of the kick a rotation took, or STEP_DOWN or STEP_START
+    };
+
+    // the origins Piece::Rotate's clamp allows in the rotation after this one
+    struct RotateBounds
+    {
+        int next;
+        int lowest;
+        int highest;
+        int top;
+        int bottom;
+    };
+
+    void BuildFitMasks(const Board& board);
+    void Flood(int rotation, int x, int y);
+    void AddStep(int rotation, int y, RowMask columns, uint16_t parent, int8_t kick);
+    void FindDrops(int rotation, int x, int y);
+    bool TracePath(int rotation, int x, int y, Placement& out_placement) const;
+    bool Rotate(int& rotation, int& x, int& y) const;
+    bool Fits(int rotation, int x, int y) const;
+
+private:
+    typedef std::array<std::array<RowMask, COORD_LIMIT_Y>, MAX_ROTATIONS> RowMasks;
+
+    const RotationSystem* m_rotation_system;
+    PIECE_TYPE m_type = SQUARE;
+    int m_num_rotations = 1;
+
+    // m_fits[r][y] has bit x set when rotation r fits with its origin at (x, y)
+    std::array<std::array<RowMask, COORD_LIMIT_Y + 1>, MAX_ROTATIONS> m_fits;
+    std::array<RotateBounds, MAX_ROTATIONS> m_rotate_bounds;
+
+    // every step adds at least one position or is dropped, and makes at most one more per kick and one down
+    RowMasks m_reachable;
+    std::array<FloodStep, 1 + MAX_PIECE_STATES * (MAX_KICKS + 1)> m_steps;
+    size_t m_step_count = 0;
+    std::array<std::array<uint16_t, COORD_LIMIT_Y>, MAX_ROTATIONS> m_first_step;
+
+    // what rotating at the start, shifting and dropping straight reaches
+    RowMasks m_dropped;
+    std::array<uint8_t, MAX_ROTATIONS> m_drop_rotations;
+    std::array<int8_t, MAX_ROTATIONS> m_drop_x;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// TCP socket for play on one machine or a LAN. Connected sockets are non
+// blocking and have Nagle's algorithm off, so a few bytes sent every tick go
+// out right away instead of being held back to fill a segment.
+class NetSocket
+{
+public:
+    NetSocket() = default;
+    NetSocket(const NetSocket&) = delete;
+    NetSocket& operator=(const NetSocket&) = delete;
+    NetSocket(NetSocket&& other);
+    NetSocket& operator=(NetSocket&& other);
+    ~NetSocket();
+    bool Listen(uint16_t port);
+    bool Accept(NetSocket& out_socket, bool wait = true);
+    bool Connect(const std::string& host, uint16_t port);
+    bool Send(const uint8_t* data, size_t size);
+    int SendSome(const uint8_t* data, size_t size);
+    int Receive(uint8_t* buffer, size_t size);
+    uint16_t LocalPort() const;
+    bool IsOpen() const;
+    void Close();
+
+private:
+    bool Configure();
+
+private:
+#ifdef _WINDOWS
+    uintptr_t m_socket = ~(uintptr_t)0;    // SOCKET, kept as an integer so winsock2.h stays out of the header
+#else
+    int m_socket = -1;
+#endif
+};
+
+// bytes a SendQueue holds before it gives up on the peer
+static const size_t SEND_QUEUE_LIMIT = 256 * 1024;
+
+// Bytes waiting to go out on one non blocking socket, for peers that must not
+// be waited on. Whatever the kernel does not take now stays queued for the
+// next Flush, and a peer that lets more than the limit pile up has stopped
+// reading and is disconnected.
+class SendQueue
+{
+public:
+    SendQueue(size_t limit = SEND_QUEUE_LIMIT);
+    bool Send(NetSocket& socket, const uint8_t* data, size_t size);
+    bool Flush(NetSocket& socket);
+    size_t Pending() const;
+    size_t Capacity() const;
+    void Clear();
+
+private:
+    std::vector<uint8_t> m_bytes;
+    size_t m_sent = 0;          // bytes at the front of m_bytes already taken by the kernel
+    size_t m_limit;
+};
+
+void SplitAddress(const std::string& address, uint16_t default_port, std::string& out_host, uint16_t& out_port);
@@ -1,6 +1,8 @@
-#include <vector>
+#pragma once
+
 #include <array>
-#include <string>
+#include <cstddef>
+#include <cstdint>
 
 struct Coordinate
 {
@@ -29,20 +31,35 @@ struct Coordinate
     }
 };
 
-static const Coordinate MOVEMENT_NULL = {0,0};
-static const Coordinate MOVEMENT_UP = {0,-1};
-static const Coordinate MOVEMENT_DOWN = {0,1};
-static const Coordinate MOVEMENT_LEFT = {-1,0};
-static const Coordinate MOVEMENT_RIGHT = {1,0};
+static constexpr Coordinate MOVEMENT_NULL = {0,0};
+static constexpr Coordinate MOVEMENT_UP = {0,-1};
+static constexpr Coordinate MOVEMENT_DOWN = {0,1};
+static constexpr Coordinate MOVEMENT_LEFT = {-1,0};
+static constexpr Coordinate MOVEMENT_RIGHT = {1,0};
+
+enum BLOCK_COLOR : uint8_t
+{
+    BLOCK_YELLOW,
+    BLOCK_CYAN,
+    BLOCK_ORANGE,
+    BLOCK_BLUE,
+    BLOCK_PURPLE,
+    BLOCK_GREEN,
+    BLOCK_RED,
+    BLOCK_COLOR_LENGTH
+};
 
 struct Square
 {
     Coordinate coord;
-    std::string color;
+    BLOCK_COLOR color;
 };
 
 const size_t SQUARES_PER_PIECE = 4;
 
+// one bit per column, bit 0 is the leftmost column
+typedef uint16_t RowMask;
+
 enum PIECE_TYPE
 {
     SQUARE,
@@ -55,18 +72,36 @@ enum PIECE_TYPE
     LENGTH
 };
 
+static constexpr BLOCK_COLOR PIECE_COLORS[PIECE_TYPE::LENGTH] =
+{
+    BLOCK_YELLOW,   // SQUARE
+    BLOCK_CYAN,     // LINE
+    BLOCK_ORANGE,   // L_RIGHT
+    BLOCK_BLUE,     // L_LEFT
+    BLOCK_PURPLE,   // T
+    BLOCK_GREEN,    // Z_RIGHT
+    BLOCK_RED       // Z_LEFT
+};
+
+struct RotationSystem;
+
 class Piece
 {
 public:
     Piece() = default;
-    Piece(PIECE_TYPE t, int game_width);
+    Piece(PIECE_TYPE t, int game_width, const RotationSystem& rotation_system);
+    Piece(PIECE_TYPE t, size_t rotation_index, const Coordinate& origin, const RotationSystem& rotation_system);
     void Move(const Coordinate& movement);
-    void Rotate(const Coordinate& coord_limits);
-    std::vector<Square> GetSquares();
-    
+    void Rotate(const Coordinate& coord_limits, const RotationSystem& rotation_system);
+    std::array<Square, SQUARES_PER_PIECE> GetSquares() const;
+
+private:
+    void UpdateCoords(const RotationSystem& rotation_system);
+
 public:
     PIECE_TYPE m_type;
     size_t m_rotation_index = 0;
-    std::string m_color;
+    Coordinate m_origin = {0,0};
+    BLOCK_COLOR m_color = BLOCK_YELLOW;
     std::array<Coordinate, SQUARES_PER_PIECE> m_coords;
 };
\ No newline at end of file
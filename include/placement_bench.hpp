@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Times MoveGenerator over the boards of games played by a bot that drops
+// each piece on a random resting place, and checks it against GameCore. For
+// every piece a plain search through GameCore::CanMove and INPUT_ROTATE must
+// find the same resting places, and every path must get there when played
+// on a copy of the game.
+
+struct PlacementBenchOptions
+{
+    size_t games = 100;
+    size_t pieces_per_game = 200;   // games that top out earlier end there
+    size_t repeats = 20;            // Generate calls per board, the time is their mean
+    uint64_t seed = 0;              // 0 picks a fresh one
+};
+
+struct PlacementBenchReport
+{
+    size_t pieces = 0;
+    size_t placements = 0;
+    double ns_per_piece = 0;
+    double ns_p50 = 0;
+    double ns_p99 = 0;
+    size_t tucks = 0;               // placements a straight drop does not reach
+    size_t wrong_pieces = 0;        // the resting places differed from GameCore's
+    size_t wrong_paths = 0;         // the path did not end on its placement
+};
+
+bool RunPlacementBench(const PlacementBenchOptions& options, PlacementBenchReport& out_report);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "piece.hpp"
+#include "utility.hpp"
+
+enum RANDOMIZER_TYPE : uint8_t
+{
+    RANDOMIZER_UNIFORM,   // every piece independently uniform
+    RANDOMIZER_BAG7       // shuffled bag of all seven pieces, refilled when empty
+};
+
+class PieceRandomizer
+{
+public:
+    PieceRandomizer() = default;
+    PieceRandomizer(RANDOMIZER_TYPE type, uint64_t seed);
+    PIECE_TYPE Next();
+
+private:
+    void RefillBag();
+
+public:
+    RANDOMIZER_TYPE m_type = RANDOMIZER_UNIFORM;
+    Rng m_rng;
+    std::array<PIECE_TYPE, PIECE_TYPE::LENGTH> m_bag = {};
+    size_t m_bag_index = PIECE_TYPE::LENGTH;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include "game_core.hpp"
+#include "replay.hpp"
+#include "replay_archive.hpp"
+#include "save_game.hpp"
+
+// One single player game and everything written while it runs: every input
+// into the replay archive, a keyframe every REPLAY_KEYFRAME_PIECES pieces and
+// an autosave every AUTOSAVE_TICKS. InGameState adds rendering and sound on
+// top, the allocation bench drives it headless, so both run the same ticks.
+// Events from GameCore are left queued for the owner to poll after Step.
+class RecordedGame
+{
+public:
+    // resume continues a saved game instead of starting a new one
+    RecordedGame(const std::string& archive_path, const std::string& save_path,
+        const GameSettings& settings = GameSettings(), const GameSnapshot* resume = NULL);
+    RecordedGame(const RecordedGame&) = delete;
+    RecordedGame& operator=(const RecordedGame&) = delete;
+    ~RecordedGame();
+    void ApplyInput(GAME_INPUT input);
+    void Step();
+    void SaveGame();
+    void DiscardSave();
+
+public:
+    GameCore m_core;
+
+private:
+    std::string m_save_path;
+    ReplayArchiveWriter* m_replay_archive = NULL;
+    ReplayWriter* m_replay = NULL;
+    SaveGameWriter* m_save = NULL;
+    uint32_t m_next_autosave_tick = 0;
+    bool m_keep_save = true;   // false once the game is over or abandoned
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "async_file_writer.hpp"
+#include "game_core.hpp"
+#include "replay_index.hpp"
+
+// Replay stream layout, all integers little endian:
+//   header   "FBGR" u16 version, u64 seed, u8 randomizer, u8 width, u8 height, u16 tick rate
+//   records  varint tick delta, u8 GAME_INPUT
+//   keyframe varint tick delta, u8 REPLAY_KEYFRAME, GameSnapshot bytes
+//   end      varint tick delta, u8 REPLAY_END, varint lines cleared, varint pieces placed
+//   index    varint count, then count times u32 tick, u64 offset of the keyframe tag byte
+//   footer   u64 offset of the index, "FBGI"
+// Tick deltas are against the previous record, starting from tick 0. Version 1
+// streams have no keyframes, index or footer.
+
+static const char REPLAY_MAGIC[4] = {'F', 'B', 'G', 'R'};
+static const char REPLAY_INDEX_MAGIC[4] = {'F', 'B', 'G', 'I'};
+static const uint16_t REPLAY_VERSION = 2;
+static const uint8_t REPLAY_KEYFRAME = 0xFE;
+static const uint8_t REPLAY_END = 0xFF;
+static const size_t REPLAY_FLUSH_SIZE = 4096;
+// a buffer under REPLAY_FLUSH_SIZE always has room for one more record, a keyframe the largest
+static const size_t REPLAY_BUFFER_SIZE = REPLAY_FLUSH_SIZE + 16 + sizeof(GameSnapshot);
+static const size_t REPLAY_FLUSH_BUFFERS = 2;     // spares the file writer keeps for ReplayWriter to swap in
+static const size_t REPLAY_KEYFRAME_PIECES = 50;
+static const size_t REPLAY_INDEX_RESERVE = 1024;  // keyframes indexed before m_index grows, 51200 pieces
+static const size_t REPLAY_FOOTER_SIZE = 8 + sizeof(REPLAY_INDEX_MAGIC);
+
+struct ReplayHeader
+{
+    uint16_t version = REPLAY_VERSION;
+    uint64_t seed = 0;
+    RANDOMIZER_TYPE randomizer = RANDOMIZER_UNIFORM;
+    uint8_t board_width = COORD_LIMIT_X;
+    uint8_t board_height = COORD_LIMIT_Y;
+    uint16_t tick_rate = TICKS_PER_SECOND;
+};
+
+struct ReplayRecord
+{
+    uint32_t tick;  // absolute tick the input was applied before
+    uint8_t input;  // GAME_INPUT, REPLAY_KEYFRAME or REPLAY_END
+};
+
+struct ReplayIndexEntry
+{
+    uint32_t tick;
+    uint64_t offset;
+};
+
+// outcome of re-simulating a replay, see SimulateReplay
+struct ReplayResult
+{
+    uint32_t ticks = 0;
+    size_t lines_cleared = 0;
+    size_t pieces_placed = 0;
+    int fall_ticks = 0;             // final fall speed
+    bool resumed = false;           // started from a keyframe, not from the seed
+    bool corrupt = false;           // the keyframe it starts from failed GameCore::LoadSnapshot, nothing was simulated
+    uint64_t checksum = 0;
+    bool has_end = false;           // the recorded END record was present
+    size_t recorded_lines = 0;      // lines claimed by the END record
+    size_t recorded_pieces = 0;
+};
+
+class ReplayArchiveWriter;
+
+void PutU16(std::vector<uint8_t>& out, uint16_t value);
+void PutU32(std::vector<uint8_t>& out, uint32_t value);
+void PutU64(std::vector<uint8_t>& out, uint64_t value);
+uint16_t GetU16(const uint8_t* bytes);
+uint32_t GetU32(const uint8_t* bytes);
+uint64_t GetU64(const uint8_t* bytes);
+void PutVarint(std::vector<uint8_t>& out, uint64_t value);
+bool GetVarint(const uint8_t*& cursor, const uint8_t* end, uint64_t& out_value);
+
+class ReplayWriter
+{
+public:
+    ReplayWriter(const std::string& path, const ReplayHeader& header);
+    ReplayWriter(ReplayArchiveWriter& archive, const ReplayHeader& header);
+    ReplayWriter(const ReplayWriter&) = delete;
+    ReplayWriter& operator=(const ReplayWriter&) = delete;
+    ~ReplayWriter();
+    void RecordInput(uint32_t tick, GAME_INPUT input);
+    void Update(const GameCore& core);
+    void WriteKeyframe(const GameCore& core);
+    void Finish(const GameCore& core);
+
+private:
+    void WriteHeader(const ReplayHeader& header);
+    void Flush();
+
+private:
+    AsyncFileWriter* m_file = NULL;
+    ReplayArchiveWriter* m_archive = NULL;  // set when the stream goes into the archive as one block
+    std::vector<uint8_t> m_buffer;
+    std::vector<ReplayIndexEntry> m_index;
+    uint64_t m_bytes_flushed = 0;
+    uint32_t m_last_tick = 0;
+    size_t m_next_keyframe_pieces = REPLAY_KEYFRAME_PIECES;
+    ReplayMetadata m_metadata = {};         // handed to the archive with the finished stream
+    bool m_finished = false;
+};
+
+class ReplayReader
+{
+public:
+    bool Open(const std::string& path);
+    bool Load(std::vector<uint8_t>&& bytes);
+    bool NextRecord(ReplayRecord& out_record);
+    bool Seek(uint32_t tick, GameCore& core);
+    GameSettings Settings() const;
+
+private:
+    void LoadIndex();
+
+public:
+    ReplayHeader m_header;
+    bool m_has_end = false;
+    bool m_starts_with_keyframe = false;
+    size_t m_end_lines = 0;
+    size_t m_end_pieces = 0;
+    GameSnapshot m_keyframe;    // payload of the last REPLAY_KEYFRAME record read
+    std::vector<ReplayIndexEntry> m_index;
+
+private:
+    std::vector<uint8_t> m_bytes;
+    size_t m_header_size = 0;
+    size_t m_records_end = 0;
+    size_t m_position = 0;
+    uint32_t m_last_tick = 0;
+};
+
+bool SimulateReplay(ReplayReader& reader, ReplayResult& out_result);
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "async_file_writer.hpp"
+#include "replay.hpp"
+#include "replay_index.hpp"
+
+// Append-only container holding many replay streams, all integers little endian:
+//   header "FBGA" u16 version
+//   blocks "FBGB" u8 codec, u32 raw size, u32 packed size, u32 CRC-32 of the raw bytes, packed bytes
+// Every block is one complete replay stream. Tick deltas in the stream are already
+// delta coded, the block codec adds an adaptive binary range coder on top. Blocks
+// are only ever appended, so a writer never rewrites what is already on disk and a
+// torn block at the end only loses that one game. Each append also adds a record
+// to the metadata index beside the archive, see replay_index.hpp.
+
+constexpr char REPLAY_DIRECTORY[] = "replays";
+constexpr char REPLAY_ARCHIVE_PATH[] = "replays/replays.fba";
+
+static const char REPLAY_ARCHIVE_MAGIC[4] = {'F', 'B', 'G', 'A'};
+static const char REPLAY_BLOCK_MAGIC[4] = {'F', 'B', 'G', 'B'};
+static const uint16_t REPLAY_ARCHIVE_VERSION = 1;
+static const size_t REPLAY_ARCHIVE_HEADER_SIZE = sizeof(REPLAY_ARCHIVE_MAGIC) + 2;
+static const size_t REPLAY_BLOCK_HEADER_SIZE = sizeof(REPLAY_BLOCK_MAGIC) + 1 + 4 + 4 + 4;
+static const uint32_t REPLAY_BLOCK_MAX_SIZE = 64 * 1024 * 1024; // larger sizes are treated as corruption
+
+enum REPLAY_CODEC : uint8_t
+{
+    CODEC_STORED,       // raw bytes, used when coding would not make the block smaller
+    CODEC_RANGE         // order-0 adaptive binary range coder
+};
+
+// one block as read from disk, still packed
+struct ReplayBlock
+{
+    uint64_t offset = 0;
+    uint8_t codec = CODEC_STORED;
+    uint32_t raw_size = 0;
+    uint32_t crc = 0;
+    std::vector<uint8_t> packed;
+};
+
+bool IsReplayArchive(const std::string& path);
+bool DecodeReplayBlock(const ReplayBlock& block, ReplayReader& out_replay);
+uint32_t Crc32(const uint8_t* bytes, size_t size);
+void PackBytes(const std::vector<uint8_t>& raw, std::vector<uint8_t>& out_packed);
+bool UnpackBytes(const uint8_t* packed, size_t packed_size, size_t raw_size, std::vector<uint8_t>& out_raw);
+
+// A replay arrives in chunks while it is recorded and is only compressed and
+// written as a block once EndReplay() says it is complete. The chunks go
+// through the archive file's own AsyncFileWriter as tagged chunks, so they are
+// gathered and packed on its thread and go back and forth with TakeBuffer()
+// like any other, a game being recorded allocates nothing. A replay dropped or
+// never ended is not written at all. A file that exists but is not an archive
+// is left alone and nothing is written.
+class ReplayArchiveWriter : private ChunkHandler
+{
+public:
+    ReplayArchiveWriter(const std::string& path);
+    void Reserve(size_t count, size_t capacity);
+    void Write(std::vector<uint8_t>&& chunk);
+    void TakeBuffer(std::vector<uint8_t>& out_buffer, size_t capacity);
+    void EndReplay(const ReplayMetadata& metadata);
+    void DropReplay();
+
+private:
+    void HandleChunk(const std::vector<uint8_t>& chunk, uint8_t tag, std::vector<uint8_t>& out_bytes) override;
+    void Append(const ReplayMetadata& metadata, std::vector<uint8_t>& out_block);
+
+private:
+    // only touched by m_file's thread, declared first so they outlive it
+    ReplayIndexWriter m_index;
+    uint64_t m_size = 0;            // archive bytes on disk or queued, the offset of the next block
+    std::vector<uint8_t> m_stream;  // the replay so far
+    std::vector<uint8_t> m_packed;
+
+    AsyncFileWriter m_file;
+};
+
+// Decodes one game at a time, memory use is bounded by the largest single block
+class ReplayArchiveReader
+{
+public:
+    ReplayArchiveReader() = default;
+    ReplayArchiveReader(const ReplayArchiveReader&) = delete;
+    ReplayArchiveReader& operator=(const ReplayArchiveReader&) = delete;
+    ~ReplayArchiveReader();
+    bool Open(const std::string& path);
+    bool Next(ReplayReader& out_replay);
+    bool NextBlock(ReplayBlock& out_block);
+
+private:
+    bool FindBlockMagic();
+
+public:
+    uint64_t m_block_offset = 0;    // file offset of the block last read
+    size_t m_corrupt_blocks = 0;
+
+private:
+    FILE* m_file = NULL;
+    uint64_t m_offset = 0;
+    ReplayBlock m_block;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "async_file_writer.hpp"
+#include "mapped_file.hpp"
+
+// Metadata index kept beside a replay archive, one fixed size record per game:
+//   header  "FBGX" u16 version, u16 record size
+//   records ReplayMetadata, in the order the games were appended
+// Records are read straight out of the mapped file, so like GameSnapshot they
+// have fixed width fields, no implicit padding and assume a little endian host.
+// The index only mirrors the archive and can always be rebuilt from it.
+
+static const char REPLAY_INDEX_FILE_MAGIC[4] = {'F', 'B', 'G', 'X'};
+static const uint16_t REPLAY_INDEX_FILE_VERSION = 1;
+static const size_t REPLAY_INDEX_FILE_HEADER_SIZE = sizeof(REPLAY_INDEX_FILE_MAGIC) + 2 + 2;
+
+// ReplayMetadata::flags
+static const uint8_t REPLAY_META_VERIFIED = 0x01;   // re-simulation matched the recorded END
+
+struct ReplayMetadata
+{
+    uint64_t seed;
+    uint64_t archive_offset;    // of the game's block in the archive
+    uint32_t lines_cleared;
+    uint32_t pieces_placed;
+    uint32_t ticks;             // game length
+    uint16_t fall_ticks;        // final fall speed, ticks per row
+    uint8_t randomizer;
+    uint8_t flags;
+};
+
+static_assert(sizeof(ReplayMetadata) == 32, "ReplayMetadata layout changed, bump REPLAY_INDEX_FILE_VERSION");
+
+std::string ReplayIndexPath(const std::string& archive_path);
+
+class ReplayIndexWriter
+{
+public:
+    ReplayIndexWriter() = default;
+    ReplayIndexWriter(const std::string& path);
+    bool Open(const std::string& path);
+    void Append(const ReplayMetadata& metadata);
+
+private:
+    AsyncFileWriter m_file;
+    std::vector<uint8_t> m_buffer;  // one record, traded with m_file's spares so appends allocate nothing
+};
+
+class ReplayIndexView
+{
+public:
+    bool Open(const std::string& path);
+    size_t Count() const;
+    const ReplayMetadata* Records() const;
+
+private:
+    MappedFile m_file;
+    size_t m_count = 0;
+};
+
+bool RebuildReplayIndex(const std::string& archive_path, size_t thread_count);
+void TopByLines(const ReplayIndexView& index, size_t count, std::vector<const ReplayMetadata*>& out_records);
+void LongerThan(const ReplayIndexView& index, uint32_t ticks, std::vector<const ReplayMetadata*>& out_records);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Re-simulates submitted replays on every core and checks each one against
+// the lines and pieces its END record claims. GameCore is the same code
+// InGameState runs, so a pass means the live game would have reached the
+// same result from the same inputs.
+
+struct VerifyResult
+{
+    std::string name;           // replay file, or archive@block offset
+    bool passed = false;
+    const char* reason = "";    // why it failed
+    size_t lines_cleared = 0;
+    size_t claimed_lines = 0;
+    size_t pieces_placed = 0;
+    size_t claimed_pieces = 0;
+    uint32_t ticks = 0;
+    uint64_t checksum = 0;
+    double milliseconds = 0;    // time spent re-simulating this game
+};
+
+struct VerifyReport
+{
+    std::vector<VerifyResult> results;  // in the order the games were found
+    size_t failures = 0;
+    size_t thread_count = 0;
+    size_t steals = 0;
+    double seconds = 0;
+};
+
+void VerifyReplays(const std::vector<std::string>& paths, size_t thread_count, VerifyReport& out_report);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "net_socket.hpp"
+#include "versus.hpp"
+
+// Rollback netcode for two player versus. Each side runs the whole
+// VersusCore, applying its own inputs at once and predicting that the other
+// player pressed nothing new (held keys stay held inside GameCore). When the
+// real remote inputs for a predicted tick turn out to differ, the state saved
+// at the start of that tick is restored and every tick since is simulated
+// again within the same frame.
+//
+// Stream, one packet per tick from each side over TCP:
+//   hello   "FBGV" u16 version, u64 seed, u8 randomizer     host to client, once
+//   inputs  u8 count, u32 tick, count GAME_INPUTs           every tick, in order
+
+static const uint16_t VERSUS_DEFAULT_PORT = 7430;
+static const char VERSUS_MAGIC[4] = {'F', 'B', 'G', 'V'};
+static const uint16_t VERSUS_PROTOCOL_VERSION = 1;
+static const size_t VERSUS_HELLO_SIZE = sizeof(VERSUS_MAGIC) + 2 + 8 + 1;
+static const size_t VERSUS_INPUT_HEADER_SIZE = 1 + 4;
+static const int VERSUS_CONNECT_TIMEOUT_MS = 5000;
+static const size_t VERSUS_SEND_LIMIT = 16 * 1024;     // queued bytes before a peer that stopped reading is dropped
+
+// how many ticks a side may run past the last remote input it has, it waits after that
+static const uint32_t ROLLBACK_WINDOW = 16;
+
+class RollbackSession
+{
+public:
+    // local_player 0 is the host, 1 the client
+    RollbackSession(const GameSettings& settings, int local_player);
+    void AddLocalInput(GAME_INPUT input);
+    bool Receive(const uint8_t* data, size_t size);
+    bool AdvanceFrame(std::vector<uint8_t>& out_packet, VersusTickEvents& out_events);
+    void Rollback();
+    bool IsConfirmed() const;
+    uint32_t Tick() const;
+
+private:
+    void SimulateTick(VersusTickEvents& out_events);
+
+public:
+    VersusCore m_core;              // latest state, predicted past m_remote_ticks
+    int m_local_player;
+    uint32_t m_remote_ticks = 0;    // remote inputs are known for every tick before this
+
+    size_t m_rollbacks = 0;
+    size_t m_resimulated_ticks = 0;
+    uint32_t m_max_rollback_ticks = 0;
+    size_t m_stalled_frames = 0;    // frames spent waiting because the remote fell a window behind
+    double m_rollback_seconds = 0;
+
+private:
+    static const uint32_t NO_ROLLBACK = UINT32_MAX;
+
+    uint32_t m_rollback_tick = NO_ROLLBACK;    // earliest tick that was mispredicted
+    TickInputs m_pending_local;                 // applied on the next tick
+    std::array<VersusSnapshot, ROLLBACK_WINDOW> m_snapshots;           // state at the start of each recent tick
+    std::array<TickInputs, ROLLBACK_WINDOW> m_local_inputs;
+    std::array<TickInputs, ROLLBACK_WINDOW * 2> m_remote_inputs;       // the remote side can be a window ahead
+    std::vector<uint8_t> m_receive_buffer;
+};
+
+bool HostVersus(uint16_t port, const GameSettings& settings, NetSocket& out_socket, GameSettings& out_settings);
+bool JoinVersus(const std::string& host, uint16_t port, NetSocket& out_socket, GameSettings& out_settings);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Plays a versus match between two bots in one process, each with its own
+// RollbackSession, over a real loopback connection. Every packet is held
+// back by a fixed delay plus random jitter before it reaches the socket, so
+// the sessions mispredict and roll back the way they would on a bad network.
+
+struct RollbackBenchOptions
+{
+    double seconds = 10;
+    int delay_ms = 40;      // one way
+    int jitter_ms = 20;     // extra delay per packet, uniform from 0 to this
+    uint64_t seed = 0;      // 0 picks a fresh one
+};
+
+struct RollbackBenchReport
+{
+    uint32_t ticks = 0;
+    double seconds = 0;
+    uint32_t match_over_tick = 0;       // 0 while both bots were still playing at the end
+    size_t rollbacks = 0;               // both sides together
+    size_t resimulated_ticks = 0;
+    uint32_t max_rollback_ticks = 0;
+    size_t stalled_frames = 0;
+    double rollback_seconds = 0;        // spent restoring and re-simulating
+    double frame_ms_p50 = 0;            // AdvanceFrame, including any rollback
+    double frame_ms_p99 = 0;
+    double frame_ms_max = 0;
+    std::array<uint64_t, 2> checksums = {};
+    bool in_sync = false;               // both sides ended on the same state
+};
+
+bool RunRollbackBench(const RollbackBenchOptions& options, RollbackBenchReport& out_report);
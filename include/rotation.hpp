@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include "piece.hpp"
+
+// Precomputed cell offsets, bounding boxes and row masks for every piece
+// and rotation, plus the list of kicks tried when a rotation collides.
+// GameCore holds a pointer to the active RotationSystem so alternate
+// systems can be swapped in without changing Piece.
+
+static const size_t MAX_ROTATIONS = 4;
+static const size_t MAX_KICKS = 8;
+
+typedef std::array<Coordinate, SQUARES_PER_PIECE> PieceCells;
+
+struct PieceRotation
+{
+    PieceCells cells;   // offsets from the piece origin
+    Coordinate min;     // bounding box of cells, inclusive
+    Coordinate max;
+    std::array<RowMask, SQUARES_PER_PIECE> row_masks; // row_masks[r] covers row min.y + r, bit 0 is column min.x
+    std::array<int, SQUARES_PER_PIECE> column_bottoms; // lowest cell offset in column min.x + c
+};
+
+struct RotationSystem
+{
+    std::array<size_t, PIECE_TYPE::LENGTH> num_rotations;
+    std::array<std::array<PieceRotation, MAX_ROTATIONS>, PIECE_TYPE::LENGTH> rotations;
+    std::array<Coordinate, MAX_KICKS> kicks;
+    size_t num_kicks;
+
+    constexpr const PieceRotation& Get(PIECE_TYPE type, size_t rotation_index) const
+    {
+        return rotations[type][rotation_index];
+    }
+
+    constexpr size_t Next(PIECE_TYPE type, size_t rotation_index) const
+    {
+        return (rotation_index + 1) % num_rotations[type];
+    }
+};
+
+constexpr PieceRotation MakePieceRotation(const PieceCells& cells)
+{
+    PieceRotation rotation = {};
+    rotation.cells = cells;
+    rotation.min = cells[0];
+    rotation.max = cells[0];
+
+    for (const Coordinate& c : cells)
+    {
+        rotation.min.x = c.x < rotation.min.x ? c.x : rotation.min.x;
+        rotation.min.y = c.y < rotation.min.y ? c.y : rotation.min.y;
+        rotation.max.x = c.x > rotation.max.x ? c.x : rotation.max.x;
+        rotation.max.y = c.y > rotation.max.y ? c.y : rotation.max.y;
+    }
+
+    rotation.column_bottoms.fill(rotation.min.y - 1);
+
+    for (const Coordinate& c : cells)
+    {
+        rotation.row_masks[c.y - rotation.min.y] |= (RowMask)(1 << (c.x - rotation.min.x));
+
+        int& bottom = rotation.column_bottoms[c.x - rotation.min.x];
+        bottom = c.y > bottom ? c.y : bottom;
+    }
+
+    return rotation;
+}
+
+struct RotationTable
+{
+    PIECE_TYPE type;
+    size_t num_rotations;
+    std::array<PieceCells, MAX_ROTATIONS> cells;
+};
+
+constexpr RotationSystem MakeRotationSystem(
+    const std::array<RotationTable, PIECE_TYPE::LENGTH>& tables,
+    const std::array<Coordinate, MAX_KICKS>& kicks,
+    size_t num_kicks)
+{
+    RotationSystem system = {};
+
+    for (const RotationTable& table : tables)
+    {
+        system.num_rotations[table.type] = table.num_rotations;
+
+        for (size_t i = 0; i < table.num_rotations; i++)
+        {
+            system.rotations[table.type][i] = MakePieceRotation(table.cells[i]);
+        }
+    }
+
+    system.kicks = kicks;
+    system.num_kicks = num_kicks;
+    return system;
+}
+
+inline constexpr RotationSystem DEFAULT_ROTATION_SYSTEM = MakeRotationSystem(
+{{
+    {SQUARE, 1, {{
+        {{ {0,0}, {1,0}, {0,1}, {1,1} }}
+    }}},
+    {LINE, 2, {{
+        {{ {-1,0}, {0,0}, {1,0}, {2,0} }},
+        {{ {0,-1}, {0,0}, {0,1}, {0,2} }}
+    }}},
+    {L_RIGHT, 4, {{
+        {{ {0,0}, {1,0}, {2,0}, {0,1} }},
+        {{ {0,0}, {0,1}, {0,2}, {-1,0} }},
+        {{ {0,0}, {-1,0}, {-2,0}, {0,-1} }},
+        {{ {0,0}, {0,-1}, {0,-2}, {1,0} }}
+    }}},
+    {L_LEFT, 4, {{
+        {{ {0,0}, {-1,0}, {-2,0}, {0,1} }},
+        {{ {0,0}, {0,-1}, {0,-2}, {-1,0} }},
+        {{ {0,0}, {1,0}, {2,0}, {0,-1} }},
+        {{ {0,0}, {0,1}, {0,2}, {1,0} }}
+    }}},
+    {T, 4, {{
+        {{ {-1,0}, {0,0}, {1,0}, {0,1} }},
+        {{ {0,-1}, {0,0}, {0,1}, {-1,0} }},
+        {{ {1,0}, {0,0}, {-1,0}, {0,-1} }},
+        {{ {0,1}, {0,0}, {0,-1}, {1,0} }}
+    }}},
+    {Z_RIGHT, 2, {{
+        {{ {-1,0}, {0,0}, {0,1}, {1,1} }},
+        {{ {0,-1}, {0,0}, {-1,0}, {-1,1} }}
+    }}},
+    {Z_LEFT, 2, {{
+        {{ {-1,1}, {0,1}, {0,0}, {1,0} }},
+        {{ {-1,-1}, {-1,0}, {0,0}, {0,1} }}
+    }}}
+}},
+{{ MOVEMENT_NULL, MOVEMENT_LEFT, MOVEMENT_RIGHT, MOVEMENT_UP }},
+4);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "async_file_writer.hpp"
+#include "game_core.hpp"
+
+// A save file is SAVE_SLOTS SaveRecords, each one a GameSnapshot behind a small
+// header. Records take the slots in turn, each written with a single write over
+// the oldest, and the intact one with the highest sequence wins, so a crash
+// mid-write only loses that last autosave and the file never grows past the
+// slots. Every game starts the file over, a resumed one by writing the
+// snapshot it resumed from. Loading maps the file and copies one record out,
+// nothing is parsed field by field.
+
+constexpr char SAVE_DIRECTORY[] = "saves";
+constexpr char SAVE_PATH[] = "saves/game.fbs";
+static const char SAVE_MAGIC[4] = {'F', 'B', 'G', 'S'};
+static const uint16_t SAVE_VERSION = 1;
+static const uint32_t AUTOSAVE_TICKS = 10 * TICKS_PER_SECOND;
+static const uint32_t SAVE_SLOTS = 2;
+
+struct SaveRecord
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t snapshot_size;
+    uint32_t crc;       // CRC-32 of snapshot
+    uint32_t sequence;  // records written before this one since the file was started
+    GameSnapshot snapshot;
+};
+
+static_assert(std::is_trivially_copyable_v<SaveRecord>, "SaveRecord is written and read as raw bytes");
+static_assert(sizeof(SaveRecord) == 16 + sizeof(GameSnapshot), "SaveRecord layout changed, bump SAVE_VERSION");
+
+class SaveGameWriter
+{
+public:
+    SaveGameWriter(const std::string& path);
+    void Write(const GameSnapshot& snapshot);
+
+private:
+    AsyncFileWriter m_file;
+    std::vector<uint8_t> m_buffer;  // one record, traded with m_file's spares so autosaves allocate nothing
+    uint32_t m_sequence = 0;
+};
+
+bool LoadSaveGame(const std::string& path, GameSnapshot& out_snapshot);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Plays the same games with a bot that only weighs the falling piece and
+// with LookaheadSearch under a time budget per move, then searches boards
+// from those games to a fixed depth on 1, 2, 4... up to max_threads workers
+// to see how nodes per second scale. Every thread count has to pick the
+// same placements as one thread, the table and the pool only change how
+// fast they are found.
+
+struct SearchBenchOptions
+{
+    size_t games = 4;
+    size_t pieces_per_game = 200;   // games that top out earlier end there
+    size_t preview = 1;             // next pieces the bot is shown
+    double budget_ms = 10;          // per move while playing
+    size_t depth = 3;               // of the searches timed for scaling
+    size_t positions = 20;          // boards searched for each thread count
+    size_t max_threads = 1;
+    uint64_t seed = 0;              // 0 picks a fresh one
+};
+
+struct SearchBotResult
+{
+    size_t pieces = 0;
+    size_t lines = 0;
+    size_t top_outs = 0;
+    double mean_height = 0;         // of the highest column after each move, lower leaves more room
+};
+
+struct SearchScaling
+{
+    size_t threads = 0;
+    size_t nodes = 0;
+    size_t table_hits = 0;
+    double seconds = 0;
+    double nodes_per_second = 0;
+    double speedup = 0;             // over one thread
+    size_t differing_moves = 0;     // placements one thread did not pick
+};
+
+struct SearchBenchReport
+{
+    size_t games = 0;
+    SearchBotResult greedy;
+    SearchBotResult lookahead;
+    double mean_depth = 0;          // finished by the lookahead bot within the budget
+    double move_ms_p50 = 0;
+    double move_ms_p99 = 0;
+    size_t positions = 0;
+    std::vector<SearchScaling> scaling;
+};
+
+bool RunSearchBench(const SearchBenchOptions& options, SearchBenchReport& out_report);
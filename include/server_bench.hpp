@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Load generator for GameServer. One thread plays every simulated client,
+// pressing random keys over loopback connections and starting a new game
+// whenever one tops out, while the calling thread runs the server at
+// TICKS_PER_SECOND and times every tick.
+
+struct ServerBenchOptions
+{
+    size_t clients = 1000;
+    double seconds = 10;
+    size_t thread_count = 1;    // server pool threads
+};
+
+struct ServerBenchReport
+{
+    size_t sessions = 0;
+    size_t thread_count = 0;
+    uint32_t ticks = 0;
+    double seconds = 0;
+    double tick_ms_p50 = 0;         // GameServer::Tick, receiving, stepping and sending
+    double tick_ms_p99 = 0;
+    double tick_ms_p999 = 0;
+    double tick_ms_max = 0;
+    double step_ms_p50 = 0;         // the batches alone
+    double step_ms_p99 = 0;
+    double cpu_ms_per_tick = 0;     // mean over every thread that worked on a tick
+    double sessions_per_core = 0;   // sessions one core could keep at TICKS_PER_SECOND
+    size_t late_ticks = 0;          // ticks that took longer than a tick
+    size_t session_bytes = 0;       // sizeof(ServerSession)
+    size_t bytes_per_session = 0;   // everything the server holds, divided by sessions
+    size_t inputs_sent = 0;
+    size_t events_received = 0;
+    size_t games_over = 0;
+};
+
+bool RunServerBench(const ServerBenchOptions& options, ServerBenchReport& out_report);
@@ -0,0 +1,20 @@
+#pragma once
+
+// Lets one source file hold plain code next to SSE and AVX2 kernels that
+// are only called once the CPU is known to have them. GCC and Clang need
+// each kernel marked with the instruction set it uses; MSVC takes any
+// intrinsic anywhere, so the marks are empty there and the CPU check alone
+// keeps a kernel from running where it would fault.
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SIMD_TARGET_SSE
+#define SIMD_TARGET_AVX2
+#else
+#define SIMD_TARGET_SSE __attribute__((target("ssse3")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
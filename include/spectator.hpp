@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "game_core.hpp"
+#include "net_socket.hpp"
+
+// Live game stream for spectators. The game thread hands a GameSnapshot per
+// tick to SpectatorFeed through a lock free ring, a background thread turns
+// it into the changes since the last tick and sends them to every connected
+// spectator, so encoding and sending never add to the frame time.
+//
+// Stream, after an "FBGW" u16 version header:
+//   keyframe  u8 tag, u8 flags, raw GameSnapshot       new game, resync, join and every SPECTATOR_KEYFRAME_TICKS
+//   tick      u8 tag, varint ticks since the last one  only before a tick that changed something
+//   clear     u8 tag, varint row mask                   rows removed this tick, counted before the clear
+//   row       u8 tag, u8 y, u16 mask, 4 bit colors      one per occupied cell, two to a byte
+//   piece     u8 tag, u8 type << 4 | rotation, i8 x, i8 y
+//   end       u8 tag, varint lines cleared              the game is over
+// Rows are compared after the clear is applied, so a line clear costs one
+// record instead of rewriting every row above it. Join and periodic
+// keyframes come after that tick's changes, so a spectator already in sync
+// can check the state it built up against them.
+
+static const uint16_t SPECTATOR_DEFAULT_PORT = 7431;
+static const char SPECTATOR_MAGIC[4] = {'F', 'B', 'G', 'W'};
+static const uint16_t SPECTATOR_PROTOCOL_VERSION = 1;
+static const size_t SPECTATOR_HEADER_SIZE = sizeof(SPECTATOR_MAGIC) + 2;
+static const uint32_t SPECTATOR_KEYFRAME_TICKS = 5 * TICKS_PER_SECOND;
+static const size_t SPECTATOR_RING_SIZE = 256;   // ticks the feed thread may fall behind before frames are dropped
+
+enum SPECTATOR_RECORD : uint8_t
+{
+    SPECTATOR_KEYFRAME,
+    SPECTATOR_TICK,
+    SPECTATOR_CLEAR,
+    SPECTATOR_ROW,
+    SPECTATOR_PIECE,
+    SPECTATOR_END
+};
+
+// keyframe flags
+static const uint8_t SPECTATOR_KEYFRAME_CONTINUES = 1;  // same game, a spectator in sync already holds this state
+
+struct SpectatorFrame
+{
+    GameSnapshot snapshot;
+    uint32_t cleared_rows;  // EVENT_LINES_CLEARED rows of this tick
+    bool resync;            // the changes cannot be told from the last frame, send a keyframe
+};
+
+// Keeps the state every spectator holds and writes what has to change to
+// bring it to the next frame
+class SpectatorEncoder
+{
+public:
+    void Encode(const SpectatorFrame& frame, std::vector<uint8_t>& out);
+    void ForceKeyframe();
+
+private:
+    void WriteKeyframe(const GameSnapshot& snapshot, uint8_t flags, std::vector<uint8_t>& out);
+    void WriteTick(uint32_t tick, std::vector<uint8_t>& out);
+
+public:
+    size_t m_keyframes = 0;
+
+private:
+    GameSnapshot m_state = {};
+    bool m_has_state = false;
+    bool m_force_keyframe = false;
+    uint32_t m_keyframe_tick = 0;
+};
+
+// Applies a stream to its own copy of the game, see --watch
+class SpectatorDecoder
+{
+public:
+    bool Receive(const uint8_t* data, size_t size);
+
+private:
+    int ParseRecord(const uint8_t* data, size_t size);
+    void ApplyKeyframe(const GameSnapshot& keyframe, uint8_t flags);
+
+public:
+    GameSnapshot m_state = {};
+    bool m_synced = false;          // false until the first keyframe
+    size_t m_ticks = 0;             // ticks that changed something
+    size_t m_keyframes = 0;
+    size_t m_mismatches = 0;        // continuing keyframes that disagreed with the decoded state
+    size_t m_bad_keyframes = 0;     // failed SnapshotValid, dropped until the next keyframe
+    size_t m_games_finished = 0;
+
+private:
+    bool m_header_read = false;
+    std::vector<uint8_t> m_receive_buffer;
+};
+
+// a connected spectator and the part of the stream its socket has not taken yet
+struct Spectator
+{
+    NetSocket socket;
+    SendQueue queue;
+};
+
+class SpectatorFeed
+{
+public:
+    SpectatorFeed() = default;
+    SpectatorFeed(const SpectatorFeed&) = delete;
+    SpectatorFeed& operator=(const SpectatorFeed&) = delete;
+    ~SpectatorFeed();
+    bool Start(uint16_t port);
+    void Publish(const GameCore& core, uint32_t cleared_rows, bool resync);
+
+private:
+    void Run();
+    void AcceptSpectators();
+    void Broadcast(const std::vector<uint8_t>& data);
+    void FlushSpectators();
+
+public:
+    std::atomic<size_t> m_dropped_frames {0};
+
+private:
+    NetSocket m_listener;
+    std::vector<Spectator> m_spectators;   // feed thread only
+    SpectatorEncoder m_encoder;
+    std::vector<uint8_t> m_chunk;
+    std::array<SpectatorFrame, SPECTATOR_RING_SIZE> m_ring;
+    std::atomic<size_t> m_write_index {0};  // only the game thread moves it
+    std::atomic<size_t> m_read_index {0};   // only the feed thread moves it
+    std::atomic<bool> m_resync {false};     // a frame was dropped
+    std::atomic<bool> m_running {false};
+    std::thread m_thread;
+};
@@ -1,4 +1,24 @@
-#include <SDL.h>
+#pragma once
 
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// xoshiro256** generator. Small enough to keep one per game and copy into
+// snapshots; the same seed always produces the same sequence.
+class Rng
+{
+public:
+    Rng(uint64_t seed = 0);
+    void Seed(uint64_t seed);
+    uint64_t Next();
+    uint64_t Range(uint64_t min, uint64_t max);
+
+public:
+    std::array<uint64_t, 4> m_state;
+};
+
+uint64_t RandomSeed();
 uint64_t Random();
-uint64_t Random(uint64_t min, uint64_t max);
\ No newline at end of file
+uint64_t Random(uint64_t min, uint64_t max);
+double Percentile(std::vector<double>& values, double fraction);
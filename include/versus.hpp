@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include "game_core.hpp"
+#include "utility.hpp"
+
+// Two games played side by side on the same piece sequence, clearing lines
+// sends garbage rows to the other player. The same inputs on the same ticks
+// always give the same result, which is what lets the rollback netcode
+// re-simulate a few ticks instead of waiting on the network.
+
+static const size_t VERSUS_PLAYERS = 2;
+static const size_t MAX_INPUTS_PER_TICK = 8;
+static const uint8_t MAX_PENDING_GARBAGE = 20;
+
+// GAME_INPUTs one player applied on one tick, in order
+struct TickInputs
+{
+    uint8_t count = 0;
+    std::array<uint8_t, MAX_INPUTS_PER_TICK> inputs;
+};
+
+typedef std::array<TickInputs, VERSUS_PLAYERS> VersusInputs;
+
+// what happened to each player on the last tick, for sounds and labels
+struct VersusTickEvents
+{
+    std::array<uint8_t, VERSUS_PLAYERS> pieces_locked;
+    std::array<uint8_t, VERSUS_PLAYERS> lines_cleared;
+};
+
+// The whole versus state. Rollback saves one every tick and restores one on
+// every misprediction, so like GameSnapshot it stays a flat copy.
+struct VersusSnapshot
+{
+    std::array<GameSnapshot, VERSUS_PLAYERS> players;
+    std::array<uint64_t, 4> garbage_rng_state;
+    uint32_t tick;
+    std::array<uint8_t, VERSUS_PLAYERS> pending_garbage;
+    uint8_t reserved[2];
+};
+
+static_assert(std::is_trivially_copyable_v<VersusSnapshot>, "VersusSnapshot is restored with a plain copy");
+
+class VersusCore
+{
+public:
+    // seed 0 picks one fresh seed shared by both players
+    VersusCore(const GameSettings& settings);
+    void Step(const VersusInputs& inputs, VersusTickEvents& out_events);
+    void SaveSnapshot(VersusSnapshot& out_snapshot) const;
+    void LoadSnapshot(const VersusSnapshot& snapshot);
+    bool IsOver() const;
+    int Winner() const;
+    uint64_t Checksum() const;
+
+private:
+    VersusCore(const GameSettings& settings, uint64_t seed);
+
+public:
+    std::array<GameCore, VERSUS_PLAYERS> m_players;
+    Rng m_garbage_rng;                          // picks the hole column of each garbage row
+    uint32_t m_tick = 0;                        // keeps counting after a player tops out
+    std::array<uint8_t, VERSUS_PLAYERS> m_pending_garbage = {};  // rows waiting for the player's next lock
+};
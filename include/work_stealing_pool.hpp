@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque. A worker pops its
+// newest task first and, when its deque runs dry, steals the oldest task of
+// another worker. Tasks submitted from inside a task stay on the submitting
+// worker's deque; tasks submitted from outside are dealt out round robin.
+class WorkStealingPool
+{
+public:
+    WorkStealingPool(size_t thread_count);
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    ~WorkStealingPool();
+    void Submit(std::function<void()> task);
+    void Wait(size_t max_pending = 0);
+    size_t ThreadCount() const;
+    size_t StealCount() const;
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void Run(size_t index);
+    bool TakeTask(size_t index, std::function<void()>& out_task);
+
+private:
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    std::mutex m_idle_mutex;
+    std::condition_variable m_wake;     // workers, a task was queued or the pool is stopping
+    std::condition_variable m_done;     // Wait, a task finished
+    std::atomic<size_t> m_queued {0};   // submitted and not yet taken by a worker
+    std::atomic<size_t> m_pending {0};  // submitted and not yet finished
+    std::atomic<size_t> m_wait_limit {0};
+    std::atomic<size_t> m_steals {0};
+    std::atomic<size_t> m_next_worker {0};
+    bool m_stopping = false;
+};
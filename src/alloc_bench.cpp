@@ -0,0 +1,255 @@
+#include "alloc_bench.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include "board_evaluator.hpp"
+#include "debug.hpp"
+#include "move_generator.hpp"
+#include "recorded_game.hpp"
+#include "utility.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint32_t BOT_GIVE_UP_TICKS = 60;   // a piece not where it was meant to go by then is dropped anyway
+
+// every global operator new is counted, in every build, so the bench never runs blind. Counted per
+// thread, the file writers' threads allocate as they please off the game thread
+static thread_local size_t g_allocation_count = 0;
+
+void* operator new(size_t size)
+{
+    g_allocation_count++;
+
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+
+    if (ptr == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+size_t AllocationCount()
+{
+    return g_allocation_count;
+}
+
+/*A straight drop's path is rotations then shifts, the only places the bot steers to*/
+static bool IsStraightDrop(const Placement& placement)
+{
+    for (size_t i = 0; i < placement.path_length; i++)
+    {
+        if (placement.path[i] == MOVE_DOWN || (placement.path[i] == MOVE_ROTATE && i > 0 && placement.path[i - 1] != MOVE_ROTATE))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*Picks the best scoring straight drop for each new piece and presses one key a tick to get it there*/
+class BenchBot
+{
+public:
+    BenchBot() : m_lists(1) {}
+
+    void NewGame()
+    {
+        m_target_pieces = SIZE_MAX;
+        m_LR_key_state = GameCore::KEY_NONE;
+    }
+
+    bool NextInput(const GameCore& core, GAME_INPUT& out_input)
+    {
+        if (core.m_pieces_placed != m_target_pieces)
+        {
+            PickTarget(core);
+        }
+
+        const Piece& piece = core.m_falling_piece;
+        bool give_up = core.m_tick - m_target_tick > BOT_GIVE_UP_TICKS;
+
+        if (!give_up && piece.m_rotation_index != m_target.rotation)
+        {
+            out_input = INPUT_ROTATE;
+            return true;
+        }
+
+        GameCore::LR_Key_State wanted = GameCore::KEY_NONE;
+
+        if (!give_up && piece.m_origin.x != m_target.x)
+        {
+            wanted = piece.m_origin.x < m_target.x ? GameCore::KEY_RIGHT : GameCore::KEY_LEFT;
+        }
+
+        if (wanted != m_LR_key_state)
+        {
+            if (wanted == GameCore::KEY_NONE)
+            {
+                out_input = m_LR_key_state == GameCore::KEY_LEFT ? INPUT_LEFT_RELEASE : INPUT_RIGHT_RELEASE;
+            }
+            else
+            {
+                out_input = wanted == GameCore::KEY_LEFT ? INPUT_LEFT_PRESS : INPUT_RIGHT_PRESS;
+            }
+
+            m_LR_key_state = wanted;
+            return true;
+        }
+
+        if (wanted == GameCore::KEY_NONE)
+        {
+            out_input = INPUT_HARD_DROP;
+            return true;
+        }
+
+        return false;
+    }
+
+private:
+    void PickTarget(const GameCore& core)
+    {
+        PlacementList& list = m_lists[0];
+        float best_score = 0;
+        bool found = false;
+
+        m_target_pieces = core.m_pieces_placed;
+        m_target_tick = core.m_tick;
+        m_target.rotation = (uint8_t)core.m_falling_piece.m_rotation_index;
+        m_target.x = (int8_t)core.m_falling_piece.m_origin.x;
+
+        m_generator.Generate(core.m_board, core.m_falling_piece, list);
+
+        for (size_t i = 0; i < list.count; i++)
+        {
+            const Placement& placement = list.placements[i];
+
+            if (!IsStraightDrop(placement))
+            {
+                continue;
+            }
+
+            Board board = core.m_board;
+            Piece piece(core.m_falling_piece.m_type, placement.rotation, {placement.x, placement.y}, *core.m_rotation_system);
+
+            for (const Square& square : piece.GetSquares())
+            {
+                board.Place(square);
+            }
+
+            board.ClearCompletedRows();
+
+            BoardFeatures features;
+            EvaluateBoard(board.m_rows, features);
+            float score = ScoreFeatures(features, EVALUATOR_BALANCED);
+
+            if (!found || score > best_score)
+            {
+                m_target = placement;
+                best_score = score;
+                found = true;
+            }
+        }
+    }
+
+private:
+    MoveGenerator m_generator;
+    std::vector<PlacementList> m_lists;     // too big for the stack
+    Placement m_target = {};
+    size_t m_target_pieces = SIZE_MAX;      // m_pieces_placed when m_target was picked
+    uint32_t m_target_tick = 0;
+    GameCore::LR_Key_State m_LR_key_state = GameCore::KEY_NONE;
+};
+
+bool RunAllocBench(const AllocBenchOptions& options, AllocBenchReport& out_report)
+{
+    out_report = AllocBenchReport();
+
+    std::error_code error;
+    std::filesystem::path directory = std::filesystem::temp_directory_path(error) / "fbg-alloc-bench";
+    std::filesystem::create_directories(directory, error);
+
+    if (error)
+    {
+        ERROR_PRINT("ERROR: could not create " << directory.string());
+        return false;
+    }
+
+    Rng rng(options.seed != 0 ? options.seed : RandomSeed());
+    BenchBot bot;
+    std::chrono::nanoseconds tick_duration((int64_t)(1e9 / (TICKS_PER_SECOND * std::max(options.speed, 1.0))));
+    Clock::time_point start = Clock::now();
+
+    while (out_report.ticks < options.ticks)
+    {
+        GameSettings settings;
+        settings.seed = rng.Next() | 1;
+
+        // starting a game allocates, as the state change into one does in the game
+        RecordedGame* game = new RecordedGame((directory / "replays.fba").string(), (directory / "game.fbs").string(), settings);
+        bot.NewGame();
+
+        bool running = true;
+
+        while (running && out_report.ticks < options.ticks)
+        {
+            std::this_thread::sleep_until(start + tick_duration * out_report.ticks);
+
+            GAME_INPUT input;
+            bool pressed = bot.NextInput(game->m_core, input);
+
+            size_t allocations_before = AllocationCount();
+
+            if (pressed)
+            {
+                game->ApplyInput(input);
+            }
+
+            game->Step();
+
+            GameEvent event;
+
+            while (game->m_core.PollEvent(event))
+            {
+            }
+
+            running = game->m_core.m_game_running;
+
+            size_t tick_allocations = AllocationCount() - allocations_before;
+            out_report.ticks++;
+
+            if (tick_allocations > 0)
+            {
+                if (out_report.allocating_ticks == 0)
+                {
+                    out_report.first_allocating_tick = game->m_core.m_tick;
+                }
+
+                out_report.allocations += tick_allocations;
+                out_report.allocating_ticks++;
+                out_report.max_tick_allocations = std::max(out_report.max_tick_allocations, tick_allocations);
+            }
+        }
+
+        out_report.games += running ? 0 : 1;
+        out_report.lines += game->m_core.m_lines_cleared;
+        out_report.keyframes += game->m_core.m_pieces_placed / REPLAY_KEYFRAME_PIECES;
+        out_report.autosaves += game->m_core.m_tick / AUTOSAVE_TICKS + 1;
+        delete game;
+    }
+
+    out_report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::filesystem::remove_all(directory, error);
+    return true;
+}
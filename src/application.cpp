@@ -1,12 +1,14 @@
 #include "application.hpp"
 #include <SDL_image.h>
 #include <SDL_ttf.h>
+#include <cmath>
 #include <iostream>
+#include "alloc_bench.hpp"
 #include "audio.hpp"
 #include "utility.hpp"
 #include "debug.hpp"
 
-Application::Application()
+Application::Application(const LaunchOptions& options)
 {
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
     {
@@ -56,9 +58,34 @@ Application::Application()
         Mix_FadeInMusic(m_music[m_music_index], 0, 500);
     }
 
-    ChangeState(STATE_TITLE);
+    if (options.spectate)
+    {
+        m_spectator_feed = new SpectatorFeed();
+
+        if (!m_spectator_feed->Start(options.spectate_port))
+        {
+            delete m_spectator_feed;
+            m_spectator_feed = NULL;
+        }
+    }
 
-    m_last_frame_ticks = SDL_GetTicks64();
+    m_counter_frequency = SDL_GetPerformanceFrequency();
+    m_last_frame_counter = SDL_GetPerformanceCounter();
+
+    if (options.measure_latency)
+    {
+        m_latency_probe = new LatencyProbe(options.latency_samples, m_counter_frequency);
+        ChangeState(STATE_NEW_GAME);
+    }
+    else if (options.versus_socket != NULL)
+    {
+        m_active_state = new VersusState(m_window, m_renderer, std::move(*options.versus_socket),
+            options.versus_settings, options.versus_player);
+    }
+    else
+    {
+        ChangeState(STATE_TITLE);
+    }
 
     MainLoop();
 }
@@ -66,31 +93,62 @@ Application::Application()
 void Application::MainLoop()
 {
     STATE new_state;
-    SDL_Event event;
 
     while (!m_should_quit)
     {
         new_state = STATE_UNCHANGED;
 
-        bool event_returned = (bool)SDL_PollEvent(&event);
+        if (m_latency_probe != NULL)
+        {
+            InjectProbeEvent();
+        }
+
+        PollEvents();
+
+        if (m_should_quit)
+        {
+            break;
+        }
+
+        Uint64 counter = SDL_GetPerformanceCounter();
+        Uint64 now_ms = SDL_GetTicks64();
+
+        // accumulate in units of 1/(frequency * TICKS_PER_SECOND) sec so a tick is exactly m_counter_frequency
+        m_tick_accumulator += (counter - m_last_frame_counter) * TICKS_PER_SECOND;
+        m_last_frame_counter = counter;
+
+        // SDL time the next tick starts at, used to line event timestamps up with ticks
+        double tick_end_ms = now_ms - (double)m_tick_accumulator * 1000 / ((double)m_counter_frequency * TICKS_PER_SECOND);
 
-        if (event_returned)
+#ifdef DEBUG_ENABLE
+        size_t allocations_before = AllocationCount();
+#endif
+
+        int ticks_run = 0;
+
+        while (m_tick_accumulator >= m_counter_frequency && new_state == STATE_UNCHANGED)
         {
-            if (HandleEvent(event))
+            if (ticks_run >= MAX_TICKS_PER_FRAME)
             {
-                continue;
+                // fell too far behind, drop the backlog instead of spiraling
+                DEBUG_PRINT("WARN: dropping " << m_tick_accumulator / m_counter_frequency << " ticks");
+                m_tick_accumulator %= m_counter_frequency;
+                break;
             }
 
-            new_state = m_active_state->HandleEvent(event);
-            ChangeState(new_state);
-            continue;
-        }
+            tick_end_ms += TICK_DURATION_SEC * 1000;
 
-        double delta_time_sec = (double)(SDL_GetTicks64() - m_last_frame_ticks) / 1000;
+            new_state = DispatchEvents(tick_end_ms);
 
-        m_last_frame_ticks = SDL_GetTicks64();
+            if (new_state != STATE_UNCHANGED)
+            {
+                break;
+            }
 
-        new_state = m_active_state->Step(delta_time_sec);
+            new_state = m_active_state->Step(TICK_DURATION_SEC);
+            m_tick_accumulator -= m_counter_frequency;
+            ticks_run++;
+        }
 
         if (new_state != STATE_UNCHANGED)
         {
@@ -98,9 +156,30 @@ void Application::MainLoop()
             continue;
         }
 
-        m_active_state->Render();
+        m_active_state->Render((double)m_tick_accumulator / m_counter_frequency);
+
+        if (m_latency_probe != NULL)
+        {
+            m_latency_probe->Mark(LATENCY_RENDER_SUBMITTED, SDL_GetPerformanceCounter());
+        }
+
+        SDL_RenderPresent(m_renderer);
         //SDL_Delay(10);
 
+        if (m_latency_probe != NULL)
+        {
+            m_latency_probe->Mark(LATENCY_PRESENTED, SDL_GetPerformanceCounter());
+        }
+
+#ifdef DEBUG_ENABLE
+        size_t frame_allocations = AllocationCount() - allocations_before;
+
+        if (m_active_state->m_allocation_free_frames && frame_allocations > 0)
+        {
+            DEBUG_PRINT("WARN: frame made " << frame_allocations << " heap allocations");
+        }
+#endif
+
         if (m_music.size() > 0 && !Mix_PlayingMusic())
         {
             m_music_index = (m_music_index + 1) % m_music.size();
@@ -109,12 +188,145 @@ void Application::MainLoop()
     }
 }
 
+/*Drains the whole SDL queue. Application level events are handled right away, the rest are
+filtered by what the active state wants, coalesced and queued until the tick they happened in*/
+void Application::PollEvents()
+{
+    SDL_Event event;
+
+    while (SDL_PollEvent(&event))
+    {
+        if (HandleEvent(event))
+        {
+            continue;
+        }
+
+        if (m_latency_probe != NULL && IsProbeEvent(event))
+        {
+            m_latency_probe->Mark(LATENCY_RECEIVED, SDL_GetPerformanceCounter());
+        }
+
+        if (!m_active_state->WantsEvent(event.type))
+        {
+            continue;
+        }
+
+        if (event.type == SDL_KEYDOWN && event.key.repeat)
+        {
+            continue;
+        }
+
+        // only the latest position matters, as long as nothing else happened in between
+        if (event.type == SDL_MOUSEMOTION && m_pending_event_count > 0 &&
+            m_pending_events[m_pending_event_count - 1].type == SDL_MOUSEMOTION)
+        {
+            m_pending_events[m_pending_event_count - 1] = event;
+            continue;
+        }
+
+        if (m_pending_event_count >= m_pending_events.size())
+        {
+            DEBUG_PRINT("WARN: pending event buffer full, dropping event type " << event.type);
+            continue;
+        }
+
+        m_pending_events[m_pending_event_count] = event;
+        m_pending_event_count++;
+    }
+}
+
+/*Hands the active state every queued event that happened before tick_end_ms*/
+STATE Application::DispatchEvents(double tick_end_ms)
+{
+    STATE new_state = STATE_UNCHANGED;
+    size_t dispatched = 0;
+
+    // event timestamps are SDL_GetTicks cut to 32 bits and wrap after about 49 days, so the
+    // comparison is done in 32 bits too and only the difference's sign matters
+    Uint32 tick_end = (Uint32)(Sint64)std::floor(tick_end_ms);
+
+    while (dispatched < m_pending_event_count && new_state == STATE_UNCHANGED)
+    {
+        const SDL_Event& event = m_pending_events[dispatched];
+
+        if ((Sint32)(event.common.timestamp - tick_end) > 0)
+        {
+            break;
+        }
+
+        if (m_latency_probe != NULL && IsProbeEvent(event))
+        {
+            m_latency_probe->Mark(LATENCY_APPLIED, SDL_GetPerformanceCounter());
+        }
+
+        new_state = m_active_state->HandleEvent(event);
+        dispatched++;
+    }
+
+    if (new_state != STATE_UNCHANGED)
+    {
+        return new_state;
+    }
+
+    for (size_t i = dispatched; i < m_pending_event_count; i++)
+    {
+        m_pending_events[i - dispatched] = m_pending_events[i];
+    }
+
+    m_pending_event_count -= dispatched;
+    return new_state;
+}
+
+/*Latency mode: press and release rotate every PROBE_INTERVAL_MS, one press in flight at a time*/
+void Application::InjectProbeEvent()
+{
+    if (m_latency_probe->Done())
+    {
+        m_latency_probe->PrintReport(std::cout);
+        m_should_quit = true;
+        return;
+    }
+
+    Uint64 counter = SDL_GetPerformanceCounter();
+
+    if (m_latency_probe->InFlight() || counter < m_next_probe_counter)
+    {
+        return;
+    }
+
+    SDL_Event event = {};
+    event.type = SDL_KEYDOWN;
+    event.key.state = SDL_PRESSED;
+    event.key.keysym.sym = SDLK_UP;
+
+    m_latency_probe->Begin(counter);
+    SDL_PushEvent(&event);
+
+    event.type = SDL_KEYUP;
+    event.key.state = SDL_RELEASED;
+    SDL_PushEvent(&event);
+
+    m_next_probe_counter = counter + m_counter_frequency * PROBE_INTERVAL_MS / 1000;
+}
+
+bool Application::IsProbeEvent(const SDL_Event& event)
+{
+    return event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_UP;
+}
+
 void Application::ChangeState(STATE new_state)
 {
+    if (new_state != STATE_UNCHANGED)
+    {
+        // anything still queued was meant for the state being replaced
+        m_pending_event_count = 0;
+    }
+
     switch (new_state)
     {
     case STATE_TITLE:
         DeleteState(m_active_state);
+        DeleteState(m_saved_state);
         m_active_state = new TitleState(m_window, m_renderer);
         break;
 
@@ -125,10 +337,21 @@ void Application::ChangeState(STATE new_state)
         break;
 
     case STATE_PAUSED:
+    {
+        // the paused game keeps rendering underneath, anything else asking to pause is ignored
+        InGameState* game = dynamic_cast<InGameState*>(m_active_state);
+
+        if (game == NULL)
+        {
+            ERROR_PRINT("ERROR: only a game in progress can be paused");
+            break;
+        }
+
         DeleteState(m_saved_state);
         m_saved_state = m_active_state;
-        m_active_state = new PausedState(m_window, m_renderer);
+        m_active_state = new PausedState(m_window, m_renderer, game);
         break;
+    }
 
     case STATE_RESUME_GAME:
         DeleteState(m_active_state);
@@ -139,13 +362,28 @@ void Application::ChangeState(STATE new_state)
         }
         else
         {
-            m_active_state = new InGameState(m_window, m_renderer);
+            // Continue on the title screen, picks up the save left by the last session
+            GameSnapshot snapshot;
+
+            if (LoadSaveGame(SAVE_PATH, snapshot))
+            {
+                m_active_state = new InGameState(m_window, m_renderer, &snapshot);
+            }
+            else
+            {
+                m_active_state = new InGameState(m_window, m_renderer);
+            }
         }
         break;
 
     case STATE_QUIT:
         m_should_quit = true;
     }
+
+    if (m_active_state != NULL)
+    {
+        m_active_state->m_spectator = m_spectator_feed;
+    }
 }
 
 void Application::DeleteState(GameState*& state)
@@ -181,6 +419,17 @@ Application::~Application()
 {
     DeleteState(m_active_state);
     DeleteState(m_saved_state);
+
+    if (m_latency_probe != NULL)
+    {
+        delete m_latency_probe;
+    }
+
+    if (m_spectator_feed != NULL)
+    {
+        delete m_spectator_feed;
+    }
+
     SDL_DestroyRenderer(m_renderer);
     SDL_DestroyWindow(m_window);
     SDL_Quit();
@@ -0,0 +1,186 @@
+#include "async_file_writer.hpp"
+#include <algorithm>
+#include "debug.hpp"
+
+AsyncFileWriter::AsyncFileWriter(const std::string& path, bool append)
+{
+    Open(path, append);
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    if (m_file != NULL)
+    {
+        fclose(m_file);
+    }
+}
+
+/*handler, if any, has to outlive the writer*/
+bool AsyncFileWriter::Open(const std::string& path, bool append, ChunkHandler* handler)
+{
+    if (m_file != NULL)
+    {
+        return false;
+    }
+
+    m_file = fopen(path.c_str(), append ? "ab" : "wb");
+
+    if (m_file == NULL)
+    {
+        ERROR_PRINT("ERROR: could not open " << path << " for writing");
+        return false;
+    }
+
+    m_handler = handler;
+    m_thread = std::thread(&AsyncFileWriter::Run, this);
+    return true;
+}
+
+bool AsyncFileWriter::IsOpen() const
+{
+    return m_file != NULL;
+}
+
+/*Sets count empty buffers of capacity bytes aside for TakeBuffer and makes room to queue that many*/
+void AsyncFileWriter::Reserve(size_t count, size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // room for every buffer to be queued or spare at once
+    size_t total = count + m_spare.size() + m_queue.size() + 1;
+    m_spare_size = std::max(m_spare_size, capacity);
+    m_queue.reserve(total);
+    m_spare.reserve(total);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        m_spare.emplace_back();
+        m_spare.back().reserve(capacity);
+    }
+}
+
+/*An untagged chunk is written as is, a tagged one goes to the handler and may be empty*/
+void AsyncFileWriter::Write(std::vector<uint8_t>&& chunk, uint8_t tag)
+{
+    if (m_file == NULL || (chunk.empty() && tag == 0))
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.emplace_back();
+        m_queue.back().bytes = std::move(chunk);
+        m_queue.back().tag = tag;
+    }
+    m_wake.notify_one();
+}
+
+/*Writes chunk at offset in a file not opened for append, later Writes carry on after it*/
+void AsyncFileWriter::WriteAt(uint64_t offset, std::vector<uint8_t>&& chunk)
+{
+    if (m_file == NULL || chunk.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.emplace_back();
+        m_queue.back().bytes = std::move(chunk);
+        m_queue.back().offset = (int64_t)offset;
+    }
+    m_wake.notify_one();
+}
+
+/*Leaves out_buffer empty with room for capacity bytes, taking a spare the thread is done
+with if out_buffer has less. Only allocates when every spare is still waiting on the disk*/
+void AsyncFileWriter::TakeBuffer(std::vector<uint8_t>& out_buffer, size_t capacity)
+{
+    out_buffer.clear();
+
+    if (out_buffer.capacity() >= capacity)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_spare.empty())
+        {
+            out_buffer.swap(m_spare.back());
+            m_spare.pop_back();
+        }
+    }
+
+    out_buffer.reserve(capacity);
+}
+
+void AsyncFileWriter::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        m_wake.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+
+        if (m_queue.empty() && m_stopping)
+        {
+            break;
+        }
+
+        // the queue gets the batch's old storage, topped up here on this thread rather than in Write
+        m_writing.swap(m_queue);
+        m_queue.reserve(m_writing.capacity());
+
+        lock.unlock();
+
+        for (Chunk& chunk : m_writing)
+        {
+            const std::vector<uint8_t>* bytes = &chunk.bytes;
+
+            if (chunk.tag != 0 && m_handler != NULL)
+            {
+                m_handled.clear();
+                m_handler->HandleChunk(chunk.bytes, chunk.tag, m_handled);
+                bytes = &m_handled;
+            }
+
+            if (chunk.offset >= 0 && fseek(m_file, (long)chunk.offset, SEEK_SET) != 0)
+            {
+                ERROR_PRINT("ERROR: could not seek while saving file");
+            }
+
+            if (fwrite(bytes->data(), 1, bytes->size(), m_file) != bytes->size())
+            {
+                ERROR_PRINT("ERROR: short write while saving file");
+            }
+            chunk.bytes.clear();
+        }
+        fflush(m_file);
+
+        lock.lock();
+
+        // kept only up to what Reserve made room for, past that and below its size they are freed
+        for (Chunk& chunk : m_writing)
+        {
+            if (chunk.bytes.capacity() >= m_spare_size && m_spare.size() < m_spare.capacity())
+            {
+                m_spare.push_back(std::move(chunk.bytes));
+            }
+        }
+        m_writing.clear();
+    }
+}
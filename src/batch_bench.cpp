@@ -0,0 +1,273 @@
+#include "batch_bench.hpp"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include "batch_environment.hpp"
+#include "debug.hpp"
+#include "game_core.hpp"
+#include "utility.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+// picked from uniformly, so pieces move about and still lock often enough for games to end
+static const BATCH_ACTION BENCH_ACTIONS[] =
+{
+    ACTION_NONE, ACTION_NONE,
+    ACTION_LEFT, ACTION_LEFT,
+    ACTION_RIGHT, ACTION_RIGHT,
+    ACTION_ROTATE, ACTION_ROTATE,
+    ACTION_HARD_DROP
+};
+
+// steps of actions made up front and played round and round while timing
+static const size_t BENCH_ACTION_STEPS = 64;
+
+// threads the check runs on besides one, or max_threads if that is more
+static const size_t CHECK_POOL_THREADS = 4;
+
+static void RandomActions(Rng& rng, std::vector<uint8_t>& out_actions)
+{
+    for (uint8_t& action : out_actions)
+    {
+        action = BENCH_ACTIONS[rng.Range(0, std::size(BENCH_ACTIONS) - 1)];
+    }
+}
+
+// where the bot steers a piece, chosen when it spawns
+struct DropTarget
+{
+    size_t pieces_placed = (size_t)-1;
+    size_t rotation = 0;
+    int x = 0;
+};
+
+/*Random play hardly ever clears a line, so half the checked games are played by a bot that
+rotates and shifts each piece over the straight drop scoring best with the balanced weights*/
+static uint8_t BotAction(const GameCore& core, DropTarget& target)
+{
+    const Piece& piece = core.m_falling_piece;
+
+    if (target.pieces_placed != core.m_pieces_placed)
+    {
+        target.pieces_placed = core.m_pieces_placed;
+        float best_score = 0;
+        bool found = false;
+
+        for (size_t rotation = 0; rotation < core.m_rotation_system->num_rotations[piece.m_type]; rotation++)
+        {
+            for (int x = 0; x < COORD_LIMIT_X; x++)
+            {
+                Piece drop(piece.m_type, rotation, {x, piece.m_origin.y}, *core.m_rotation_system);
+
+                if (!core.CanMove(MOVEMENT_NULL, drop))
+                {
+                    continue;
+                }
+
+                drop.Move({0, core.DropDistance(drop)});
+                Board board = core.m_board;
+
+                for (const Square& square : drop.GetSquares())
+                {
+                    board.Place(square);
+                }
+
+                board.ClearCompletedRows();
+                BoardFeatures features;
+                EvaluateBoard(board.m_rows, features);
+                float score = ScoreFeatures(features, EVALUATOR_BALANCED);
+
+                if (!found || score > best_score)
+                {
+                    found = true;
+                    best_score = score;
+                    target.rotation = rotation;
+                    target.x = x;
+                }
+            }
+        }
+    }
+
+    if (piece.m_rotation_index != target.rotation)
+    {
+        return ACTION_ROTATE;
+    }
+
+    if (piece.m_origin.x != target.x)
+    {
+        return piece.m_origin.x < target.x ? ACTION_RIGHT : ACTION_LEFT;
+    }
+
+    return ACTION_HARD_DROP;
+}
+
+static bool SameGame(const BatchEnvironment& env, size_t game, const GameCore& core)
+{
+    for (int y = 0; y < COORD_LIMIT_Y; y++)
+    {
+        if (env.Row(game, y) != core.m_board.m_rows[y])
+        {
+            return false;
+        }
+    }
+
+    const Piece& piece = core.m_falling_piece;
+
+    return env.m_piece_types[game] == piece.m_type && env.m_piece_rotations[game] == piece.m_rotation_index &&
+        env.m_piece_x[game] == piece.m_origin.x && env.m_piece_y[game] == piece.m_origin.y &&
+        env.m_lines[game] == core.m_lines_cleared && env.m_pieces[game] == core.m_pieces_placed;
+}
+
+/*Plays the same actions through the environment and through one GameCore per game*/
+static void CheckKernel(const BatchBenchOptions& options, uint64_t seed, EVALUATOR_KERNEL kernel, size_t thread_count,
+    BatchBenchReport& out_report)
+{
+    BatchEnvironment env(options.check_games, seed, thread_count);
+    env.m_kernel = kernel;
+
+    // GameCore cannot be assigned, a game that ends is replaced
+    std::vector<std::unique_ptr<GameCore>> cores;
+    GameSettings settings;
+
+    for (size_t game = 0; game < env.GameCount(); game++)
+    {
+        settings.seed = env.m_seeds[game];
+        cores.push_back(std::make_unique<GameCore>(settings));
+    }
+
+    Rng rng(seed);
+    std::vector<uint8_t> actions(env.GameCount());
+    std::vector<DropTarget> targets(env.GameCount());
+    GameEvent event;
+
+    for (size_t step = 0; step < options.check_steps; step++)
+    {
+        RandomActions(rng, actions);
+
+        for (size_t game = 0; game < env.GameCount(); game += 2)
+        {
+            actions[game] = BotAction(*cores[game], targets[game]);
+        }
+
+        env.Step(actions.data());
+
+        for (size_t game = 0; game < env.GameCount(); game++)
+        {
+            GameCore& core = *cores[game];
+            size_t lines = core.m_lines_cleared;
+            StepGameCore(core, actions[game]);
+
+            while (core.PollEvent(event))
+            {
+            }
+
+            bool same = env.m_rewards[game] == (int32_t)(core.m_lines_cleared - lines) &&
+                env.m_dones[game] == (core.m_game_running ? 0 : 1);
+
+            out_report.checked_lines += (size_t)env.m_rewards[game];
+
+            if (!core.m_game_running)
+            {
+                settings.seed = env.m_seeds[game];
+                cores[game] = std::make_unique<GameCore>(settings);
+                out_report.checked_episodes++;
+            }
+
+            out_report.mismatches += same && SameGame(env, game, *cores[game]) ? 0 : 1;
+        }
+    }
+
+    out_report.checked_game_steps = env.GameCount() * options.check_steps;
+}
+
+/*Seconds for steps steps of every game*/
+static double TimeSteps(BatchEnvironment& env, const std::vector<std::vector<uint8_t>>& actions, size_t steps)
+{
+    Clock::time_point start = Clock::now();
+
+    for (size_t step = 0; step < steps; step++)
+    {
+        env.Step(actions[step % actions.size()].data());
+    }
+
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+bool RunBatchBench(const BatchBenchOptions& options, BatchBenchReport& out_report)
+{
+    if (options.games == 0 || options.steps == 0)
+    {
+        ERROR_PRINT("ERROR: batch bench needs at least one game and one step");
+        return false;
+    }
+
+    uint64_t seed = options.seed != 0 ? options.seed : RandomSeed();
+    out_report.best_kernel = BestEvaluatorKernel() == KERNEL_AVX2 ? KERNEL_AVX2 : KERNEL_SCALAR;
+
+    // the pool splits the games into chunks stepped on other threads, checked as well as one thread
+    out_report.checked_threads = std::max(options.max_threads, CHECK_POOL_THREADS);
+
+    for (EVALUATOR_KERNEL kernel : { KERNEL_SCALAR, KERNEL_AVX2 })
+    {
+        for (size_t threads : { (size_t)1, out_report.checked_threads })
+        {
+            if (kernel <= out_report.best_kernel)
+            {
+                out_report.checked_episodes = 0;
+                out_report.checked_lines = 0;
+                CheckKernel(options, seed, kernel, threads, out_report);
+            }
+        }
+    }
+
+    Rng rng(seed);
+    std::vector<std::vector<uint8_t>> actions(BENCH_ACTION_STEPS, std::vector<uint8_t>(options.games));
+
+    for (std::vector<uint8_t>& step_actions : actions)
+    {
+        RandomActions(rng, step_actions);
+    }
+
+    double game_steps = (double)options.games * options.steps;
+
+    for (EVALUATOR_KERNEL kernel : { KERNEL_SCALAR, KERNEL_AVX2 })
+    {
+        if (kernel <= out_report.best_kernel)
+        {
+            BatchEnvironment env(options.games, seed);
+            env.m_kernel = kernel;
+            out_report.game_steps_per_second[kernel] = game_steps / TimeSteps(env, actions, options.steps);
+        }
+    }
+
+    size_t max_threads = std::max(options.max_threads, (size_t)1);
+
+    for (size_t threads = 1; ; threads = std::min(threads * 2, max_threads))
+    {
+        BatchEnvironment env(options.games, seed, threads);
+        BatchScaling scaling;
+        scaling.threads = threads;
+        scaling.seconds = TimeSteps(env, actions, options.steps);
+        scaling.game_steps_per_second = game_steps / scaling.seconds;
+
+        const BatchScaling* one = out_report.scaling.empty() ? &scaling : &out_report.scaling[0];
+        scaling.speedup = scaling.game_steps_per_second / one->game_steps_per_second;
+        out_report.scaling.push_back(scaling);
+
+        if (threads == max_threads)
+        {
+            out_report.episodes = 0;
+            out_report.lines = 0;
+
+            for (size_t game = 0; game < env.GameCount(); game++)
+            {
+                out_report.episodes += env.m_episodes[game];
+                out_report.lines += env.m_lines[game];
+            }
+
+            break;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,455 @@
+#include "batch_environment.hpp"
+#include <algorithm>
+#include "game_core.hpp"
+#include "simd_target.hpp"
+#include "utility.hpp"
+
+// games in one 256 bit register of int32 piece fields, and of RowMask rows
+static const size_t BLOCK_GAMES = 8;
+static const size_t ROW_BLOCK_GAMES = 16;
+
+// games stepped by one task, whole row blocks and wide enough that tasks seldom write the same cache line
+static const size_t MIN_CHUNK_GAMES = 64;
+
+BatchEnvironment::BatchEnvironment(size_t game_count, uint64_t seed, size_t thread_count, RANDOMIZER_TYPE randomizer,
+    const RotationSystem* rotation_system)
+{
+    m_kernel = BestEvaluatorKernel();
+    m_game_count = game_count;
+    m_stride = std::max((game_count + ROW_BLOCK_GAMES - 1) / ROW_BLOCK_GAMES, (size_t)1) * ROW_BLOCK_GAMES;
+    m_seed = seed != 0 ? seed : RandomSeed();
+    m_randomizer_type = randomizer;
+    m_rotation_system = rotation_system;
+
+    if (thread_count > 1)
+    {
+        m_pool = std::make_unique<WorkStealingPool>(thread_count);
+    }
+
+    m_rows.assign(COORD_LIMIT_Y * m_stride + ROW_BLOCK_GAMES, 0);
+    m_randomizers.resize(m_stride);
+
+    // padding games are never stepped, but the kernels read them and need them zero
+    m_rewards.assign(m_stride, 0);
+    m_dones.assign(m_stride, 0);
+    m_seeds.assign(m_stride, 0);
+    m_episodes.assign(m_stride, 0);
+    m_lines.assign(m_stride, 0);
+    m_pieces.assign(m_stride, 0);
+    m_piece_types.assign(m_stride, 0);
+    m_piece_rotations.assign(m_stride, 0);
+    m_piece_x.assign(m_stride, 0);
+    m_piece_y.assign(m_stride, 0);
+    m_shape_min_x.assign(m_stride, 0);
+    m_shape_max_x.assign(m_stride, 0);
+    m_shape_min_y.assign(m_stride, 0);
+    m_shape_height.assign(m_stride, 0);
+
+    for (std::vector<int32_t>& masks : m_shape_masks)
+    {
+        masks.assign(m_stride, 0);
+    }
+
+    m_moves.assign(m_stride, 0);
+    m_locked.assign(m_stride, 0);
+    m_topped_out.assign(m_stride, 0);
+    m_full.assign(m_stride, 0);
+
+    Reset();
+}
+
+/*Starts every game over from its first seed*/
+void BatchEnvironment::Reset()
+{
+    for (size_t game = 0; game < m_game_count; game++)
+    {
+        m_episodes[game] = 0;
+        m_rewards[game] = 0;
+        m_dones[game] = 0;
+        ResetGame(game);
+    }
+}
+
+/*Runs one step of every game, actions[game] being a BATCH_ACTION. With more than one thread the
+games are split into chunks stepped as separate tasks*/
+void BatchEnvironment::Step(const uint8_t* actions)
+{
+    if (m_pool == NULL)
+    {
+        StepGames(actions, 0, m_game_count);
+        return;
+    }
+
+    // a few chunks per thread so stealing can even out games that lock more pieces
+    size_t chunk = (m_game_count + m_pool->ThreadCount() * 4 - 1) / (m_pool->ThreadCount() * 4);
+    chunk = std::max((chunk + MIN_CHUNK_GAMES - 1) / MIN_CHUNK_GAMES, (size_t)1) * MIN_CHUNK_GAMES;
+
+    for (size_t begin = 0; begin < m_game_count; begin += chunk)
+    {
+        size_t end = std::min(begin + chunk, m_game_count);
+        m_pool->Submit([this, actions, begin, end] { StepGames(actions, begin, end); });
+    }
+
+    m_pool->Wait();
+}
+
+size_t BatchEnvironment::GameCount() const
+{
+    return m_game_count;
+}
+
+RowMask BatchEnvironment::Row(size_t game, int y) const
+{
+    return m_rows[y * m_stride + game];
+}
+
+/*A new game with the seed GameCore would be given for this game's next episode*/
+void BatchEnvironment::ResetGame(size_t game)
+{
+    Rng rng(m_seed ^ ((uint64_t)game << 32 | m_episodes[game]));
+    m_seeds[game] = rng.Next() | 1;
+    m_randomizers[game] = PieceRandomizer(m_randomizer_type, m_seeds[game]);
+    m_lines[game] = 0;
+    m_pieces[game] = 0;
+
+    for (int y = 0; y < COORD_LIMIT_Y; y++)
+    {
+        m_rows[y * m_stride + game] = 0;
+    }
+
+    SpawnPiece(game);
+}
+
+/*GameCore::NewPiece*/
+void BatchEnvironment::SpawnPiece(size_t game)
+{
+    Piece piece(m_randomizers[game].Next(), COORD_LIMIT_X, *m_rotation_system);
+    m_piece_types[game] = (uint8_t)piece.m_type;
+    m_piece_rotations[game] = (uint8_t)piece.m_rotation_index;
+    m_piece_x[game] = piece.m_origin.x;
+    m_piece_y[game] = piece.m_origin.y;
+    SetShape(game);
+}
+
+void BatchEnvironment::SetShape(size_t game)
+{
+    const PieceRotation& rotation = m_rotation_system->Get((PIECE_TYPE)m_piece_types[game], m_piece_rotations[game]);
+    m_shape_min_x[game] = rotation.min.x;
+    m_shape_max_x[game] = rotation.max.x;
+    m_shape_min_y[game] = rotation.min.y;
+    m_shape_height[game] = rotation.max.y - rotation.min.y + 1;
+
+    for (size_t r = 0; r < SQUARES_PER_PIECE; r++)
+    {
+        m_shape_masks[r][game] = rotation.row_masks[r];
+    }
+}
+
+/*Steps the games in [begin, end), begin being a whole number of row blocks in*/
+void BatchEnvironment::StepGames(const uint8_t* actions, size_t begin, size_t end)
+{
+    bool any_moves = false;
+
+    for (size_t game = begin; game < end; game++)
+    {
+        m_rewards[game] = 0;
+        m_dones[game] = 0;
+        m_locked[game] = 0;
+        m_topped_out[game] = 0;
+        m_moves[game] = actions[game] == ACTION_LEFT ? -1 : (actions[game] == ACTION_RIGHT ? 1 : 0);
+        any_moves = any_moves || m_moves[game] != 0;
+
+        if (actions[game] == ACTION_ROTATE)
+        {
+            RotateGame(game);
+        }
+    }
+
+    for (size_t first = begin; first < end && any_moves; first += BLOCK_GAMES)
+    {
+        uint32_t fits = FitsBlock(first, m_moves.data(), 0);
+
+        for (size_t i = 0; i < BLOCK_GAMES && first + i < end; i++)
+        {
+            m_piece_x[first + i] += (fits >> i) & 1 ? m_moves[first + i] : 0;
+        }
+    }
+
+    // everything falls a row or locks where it is, hard drops keep falling until they lock
+    bool any_locked = false;
+
+    for (size_t first = begin; first < end; first += BLOCK_GAMES)
+    {
+        uint32_t falling = 0;
+        uint32_t dropping = 0;
+
+        for (size_t i = 0; i < BLOCK_GAMES && first + i < end; i++)
+        {
+            falling |= 1u << i;
+            dropping |= actions[first + i] == ACTION_HARD_DROP ? 1u << i : 0;
+        }
+
+        while (falling != 0)
+        {
+            uint32_t fits = FitsBlock(first, NULL, 1);
+            uint32_t moved = falling & fits;
+
+            for (size_t i = 0; i < BLOCK_GAMES && first + i < end; i++)
+            {
+                m_piece_y[first + i] += (moved >> i) & 1;
+                m_locked[first + i] |= ((falling & ~fits) >> i) & 1;
+            }
+
+            any_locked = any_locked || (falling & ~fits) != 0;
+            falling = moved & dropping;
+        }
+    }
+
+    if (!any_locked)
+    {
+        return;
+    }
+
+    for (size_t game = begin; game < end; game++)
+    {
+        if (m_locked[game])
+        {
+            LockGame(game);
+        }
+    }
+
+    FindFullRows(begin, end);
+
+    for (size_t game = begin; game < end; game++)
+    {
+        if (m_locked[game] && m_full[game])
+        {
+            ClearRows(game);
+        }
+
+        if (m_topped_out[game])
+        {
+            m_dones[game] = 1;
+            m_episodes[game]++;
+            ResetGame(game);
+        }
+    }
+}
+
+/*GameCore::Rotate: the next rotation clamped inside the board, then the first kick that fits*/
+void BatchEnvironment::RotateGame(size_t game)
+{
+    Piece piece((PIECE_TYPE)m_piece_types[game], m_piece_rotations[game], {m_piece_x[game], m_piece_y[game]}, *m_rotation_system);
+    piece.Rotate({COORD_LIMIT_X, COORD_LIMIT_Y}, *m_rotation_system);
+    const PieceRotation& rotation = m_rotation_system->Get(piece.m_type, piece.m_rotation_index);
+
+    for (size_t i = 0; i < m_rotation_system->num_kicks; i++)
+    {
+        Coordinate origin = piece.m_origin;
+        origin += m_rotation_system->kicks[i];
+
+        if (!CollidesGame(game, rotation, origin))
+        {
+            m_piece_rotations[game] = (uint8_t)piece.m_rotation_index;
+            m_piece_x[game] = origin.x;
+            m_piece_y[game] = origin.y;
+            SetShape(game);
+            return;
+        }
+    }
+}
+
+/*GameCore::PlacePiece: the new piece comes out, and tops the game out if it does not fit, before
+full rows are cleared*/
+void BatchEnvironment::LockGame(size_t game)
+{
+    const PieceRotation& rotation = m_rotation_system->Get((PIECE_TYPE)m_piece_types[game], m_piece_rotations[game]);
+
+    for (const Coordinate& cell : rotation.cells)
+    {
+        m_rows[(m_piece_y[game] + cell.y) * m_stride + game] |= (RowMask)(1 << (m_piece_x[game] + cell.x));
+    }
+
+    m_pieces[game]++;
+    SpawnPiece(game);
+
+    if (CollidesGame(game, m_rotation_system->Get((PIECE_TYPE)m_piece_types[game], m_piece_rotations[game]),
+        {m_piece_x[game], m_piece_y[game]}))
+    {
+        m_topped_out[game] = 1;
+    }
+}
+
+/*Board::ClearCompletedRows down one game's column of rows*/
+void BatchEnvironment::ClearRows(size_t game)
+{
+    int write_row = COORD_LIMIT_Y - 1;
+
+    for (int read_row = COORD_LIMIT_Y - 1; read_row >= 0; read_row--)
+    {
+        RowMask row = m_rows[read_row * m_stride + game];
+
+        if (row == FULL_ROW_MASK)
+        {
+            continue;
+        }
+
+        m_rows[write_row * m_stride + game] = row;
+        write_row--;
+    }
+
+    int rows_cleared = write_row + 1;
+
+    for (int row = write_row; row >= 0; row--)
+    {
+        m_rows[row * m_stride + game] = 0;
+    }
+
+    m_lines[game] += (uint32_t)rows_cleared;
+    m_rewards[game] = rows_cleared;
+}
+
+/*Board::Collides against one game's rows*/
+bool BatchEnvironment::CollidesGame(size_t game, const PieceRotation& rotation, const Coordinate& origin) const
+{
+    int left = origin.x + rotation.min.x;
+    int top = origin.y + rotation.min.y;
+
+    if (left < 0 || origin.x + rotation.max.x >= COORD_LIMIT_X ||
+        top < 0 || origin.y + rotation.max.y >= COORD_LIMIT_Y)
+    {
+        return true;
+    }
+
+    int height = rotation.max.y - rotation.min.y + 1;
+
+    for (int row = 0; row < height; row++)
+    {
+        if ((m_rows[(top + row) * m_stride + game] & (rotation.row_masks[row] << left)) != 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#ifdef SIMD_X86
+
+/*Bit i set when the falling piece of game first + i fits moved dx[game] columns and dy rows. The
+rows under each piece are gathered straight out of the shared row arrays, a 32 bit load at a
+RowMask's offset with the high half masked off*/
+SIMD_TARGET_AVX2 static uint32_t FitsAvx2(const RowMask* rows, size_t stride, size_t first, const int8_t* dx, int dy,
+    const int32_t* piece_x, const int32_t* piece_y, const int32_t* min_x, const int32_t* max_x, const int32_t* min_y,
+    const int32_t* height, const std::array<std::vector<int32_t>, SQUARES_PER_PIECE>& masks)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i row_bits = _mm256_set1_epi32(0xFFFF);
+
+    __m256i x = _mm256_loadu_si256((const __m256i*)(piece_x + first));
+
+    if (dx != NULL)
+    {
+        x = _mm256_add_epi32(x, _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(dx + first))));
+    }
+
+    __m256i y = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(piece_y + first)), _mm256_set1_epi32(dy));
+    __m256i left = _mm256_add_epi32(x, _mm256_loadu_si256((const __m256i*)(min_x + first)));
+    __m256i right = _mm256_add_epi32(x, _mm256_loadu_si256((const __m256i*)(max_x + first)));
+    __m256i top = _mm256_add_epi32(y, _mm256_loadu_si256((const __m256i*)(min_y + first)));
+    __m256i bottom = _mm256_sub_epi32(_mm256_add_epi32(top, _mm256_loadu_si256((const __m256i*)(height + first))), one);
+
+    __m256i blocked = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpgt_epi32(zero, left), _mm256_cmpgt_epi32(right, _mm256_set1_epi32(COORD_LIMIT_X - 1))),
+        _mm256_or_si256(_mm256_cmpgt_epi32(zero, top), _mm256_cmpgt_epi32(bottom, _mm256_set1_epi32(COORD_LIMIT_Y - 1))));
+
+    // out of bounds games are already blocked, clamping only keeps their loads inside the rows
+    __m256i shift = _mm256_max_epi32(left, zero);
+    __m256i games = _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)first));
+    __m256i hits = zero;
+
+    for (size_t r = 0; r < SQUARES_PER_PIECE; r++)
+    {
+        __m256i row = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(top, _mm256_set1_epi32((int)r)), zero),
+            _mm256_set1_epi32(COORD_LIMIT_Y - 1));
+        __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(row, _mm256_set1_epi32((int)stride)), games);
+        __m256i board = _mm256_and_si256(_mm256_i32gather_epi32((const int*)rows, index, 2), row_bits);
+        __m256i piece = _mm256_sllv_epi32(_mm256_loadu_si256((const __m256i*)(masks[r].data() + first)), shift);
+        hits = _mm256_or_si256(hits, _mm256_and_si256(board, piece));
+    }
+
+    blocked = _mm256_or_si256(blocked, _mm256_xor_si256(_mm256_cmpeq_epi32(hits, zero), _mm256_set1_epi32(-1)));
+    return ~(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(blocked)) & 0xFF;
+}
+
+/*Sets full[game] for every game in [begin, end) with a full row, 16 games a register*/
+SIMD_TARGET_AVX2 static void FindFullRowsAvx2(const RowMask* rows, size_t stride, size_t begin, size_t end, uint8_t* full)
+{
+    const __m256i full_row = _mm256_set1_epi16((short)FULL_ROW_MASK);
+
+    for (size_t first = begin; first < end; first += ROW_BLOCK_GAMES)
+    {
+        __m256i any = _mm256_setzero_si256();
+
+        for (int y = 0; y < COORD_LIMIT_Y; y++)
+        {
+            any = _mm256_or_si256(any, _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(rows + y * stride + first)), full_row));
+        }
+
+        uint32_t lanes = (uint32_t)_mm256_movemask_epi8(any);
+
+        for (size_t i = 0; i < ROW_BLOCK_GAMES; i++)
+        {
+            full[first + i] = (uint8_t)((lanes >> (2 * i)) & 1);
+        }
+    }
+}
+
+#endif
+
+/*Bit i set when the falling piece of game first + i fits moved dx[game] columns (none for NULL)
+and dy rows*/
+uint32_t BatchEnvironment::FitsBlock(size_t first, const int8_t* dx, int dy) const
+{
+#ifdef SIMD_X86
+    if (m_kernel == KERNEL_AVX2 && BestEvaluatorKernel() == KERNEL_AVX2)
+    {
+        return FitsAvx2(m_rows.data(), m_stride, first, dx, dy, m_piece_x.data(), m_piece_y.data(), m_shape_min_x.data(),
+            m_shape_max_x.data(), m_shape_min_y.data(), m_shape_height.data(), m_shape_masks);
+    }
+#endif
+
+    uint32_t fits = 0;
+
+    for (size_t i = 0; i < BLOCK_GAMES; i++)
+    {
+        size_t game = first + i;
+        const PieceRotation& rotation = m_rotation_system->Get((PIECE_TYPE)m_piece_types[game], m_piece_rotations[game]);
+        Coordinate origin = {m_piece_x[game] + (dx != NULL ? dx[game] : 0), m_piece_y[game] + dy};
+        fits |= CollidesGame(game, rotation, origin) ? 0 : 1u << i;
+    }
+
+    return fits;
+}
+
+void BatchEnvironment::FindFullRows(size_t begin, size_t end)
+{
+#ifdef SIMD_X86
+    if (m_kernel == KERNEL_AVX2 && BestEvaluatorKernel() == KERNEL_AVX2)
+    {
+        FindFullRowsAvx2(m_rows.data(), m_stride, begin, end, m_full.data());
+        return;
+    }
+#endif
+
+    for (size_t game = begin; game < end; game++)
+    {
+        m_full[game] = 0;
+
+        for (int y = 0; y < COORD_LIMIT_Y; y++)
+        {
+            m_full[game] |= m_rows[y * m_stride + game] == FULL_ROW_MASK;
+        }
+    }
+}
@@ -0,0 +1,192 @@
+#include "board.hpp"
+#include <algorithm>
+
+Board::Board()
+{
+    m_rows.fill(0);
+    m_column_tops.fill(COORD_LIMIT_Y);
+
+    for (auto& row : m_colors)
+    {
+        row.fill(BLOCK_YELLOW);
+    }
+}
+
+bool Board::InBounds(const Coordinate& coord) const
+{
+    return coord.x >= 0 && coord.x < COORD_LIMIT_X &&
+        coord.y >= 0 && coord.y < COORD_LIMIT_Y;
+}
+
+bool Board::IsOccupied(const Coordinate& coord) const
+{
+    return (m_rows[coord.y] & (1 << coord.x)) != 0;
+}
+
+/*Tests the piece's precomputed row masks against the board, one AND per occupied row*/
+bool Board::Collides(const PieceRotation& rotation, const Coordinate& origin) const
+{
+    int left = origin.x + rotation.min.x;
+    int top = origin.y + rotation.min.y;
+
+    if (left < 0 || origin.x + rotation.max.x >= COORD_LIMIT_X ||
+        top < 0 || origin.y + rotation.max.y >= COORD_LIMIT_Y)
+    {
+        return true;
+    }
+
+    int height = rotation.max.y - rotation.min.y + 1;
+
+    for (int row = 0; row < height; row++)
+    {
+        if ((m_rows[top + row] & (rotation.row_masks[row] << left)) != 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Board::Place(const Square& sq)
+{
+    m_rows[sq.coord.y] |= (RowMask)(1 << sq.coord.x);
+    m_colors[sq.coord.y][sq.coord.x] = sq.color;
+
+    if (sq.coord.y < m_column_tops[sq.coord.x])
+    {
+        m_column_tops[sq.coord.x] = (int8_t)sq.coord.y;
+    }
+}
+
+/*Removes every full row, shifts the rows above it down and returns the number of rows removed.
+out_cleared_rows gets bit y set for each row y that was removed*/
+int Board::ClearCompletedRows(uint32_t* out_cleared_rows)
+{
+    int write_row = COORD_LIMIT_Y - 1;
+    uint32_t cleared_rows = 0;
+
+    for (int read_row = COORD_LIMIT_Y - 1; read_row >= 0; read_row--)
+    {
+        if (m_rows[read_row] == FULL_ROW_MASK)
+        {
+            cleared_rows |= 1u << read_row;
+            continue;
+        }
+
+        if (write_row != read_row)
+        {
+            m_rows[write_row] = m_rows[read_row];
+            m_colors[write_row] = m_colors[read_row];
+        }
+        write_row--;
+    }
+
+    int rows_cleared = write_row + 1;
+
+    for (int row = write_row; row >= 0; row--)
+    {
+        m_rows[row] = 0;
+    }
+
+    if (rows_cleared > 0)
+    {
+        UpdateColumnTops();
+    }
+
+    if (out_cleared_rows != NULL)
+    {
+        *out_cleared_rows = cleared_rows;
+    }
+
+    return rows_cleared;
+}
+
+/*Pushes the stack up and fills the bottom rows except for one column, false if blocks were
+pushed off the top*/
+bool Board::AddGarbage(int rows, int hole_x, BLOCK_COLOR color)
+{
+    bool overflow = false;
+
+    for (int row = 0; row < rows && row < COORD_LIMIT_Y; row++)
+    {
+        overflow = overflow || m_rows[row] != 0;
+    }
+
+    for (int row = 0; row + rows < COORD_LIMIT_Y; row++)
+    {
+        m_rows[row] = m_rows[row + rows];
+        m_colors[row] = m_colors[row + rows];
+    }
+
+    RowMask garbage = FULL_ROW_MASK & (RowMask)~(1 << hole_x);
+
+    for (int row = std::max(COORD_LIMIT_Y - rows, 0); row < COORD_LIMIT_Y; row++)
+    {
+        m_rows[row] = garbage;
+        m_colors[row].fill(color);
+    }
+
+    UpdateColumnTops();
+    return !overflow;
+}
+
+void Board::UpdateColumnTops()
+{
+    m_column_tops.fill(COORD_LIMIT_Y);
+    RowMask seen = 0;
+
+    for (int row = 0; row < COORD_LIMIT_Y && seen != FULL_ROW_MASK; row++)
+    {
+        RowMask new_columns = m_rows[row] & ~seen;
+        seen |= m_rows[row];
+
+        for (int x = 0; new_columns != 0; x++, new_columns >>= 1)
+        {
+            if (new_columns & 1)
+            {
+                m_column_tops[x] = (int8_t)row;
+            }
+        }
+    }
+}
+
+/*How many rows the piece can fall from origin. Uses the column tops when every column of the
+piece is above the stack, otherwise the piece is tucked under an overhang and is stepped down*/
+int Board::DropDistance(const PieceRotation& rotation, const Coordinate& origin) const
+{
+    int left = origin.x + rotation.min.x;
+    int width = rotation.max.x - rotation.min.x + 1;
+    int distance = COORD_LIMIT_Y;
+
+    for (int c = 0; c < width; c++)
+    {
+        int column_distance = m_column_tops[left + c] - (origin.y + rotation.column_bottoms[c]) - 1;
+
+        if (column_distance < 0)
+        {
+            distance = -1;
+            break;
+        }
+
+        distance = column_distance < distance ? column_distance : distance;
+    }
+
+    if (distance >= 0)
+    {
+        return distance;
+    }
+
+    Coordinate below = origin;
+    distance = 0;
+
+    while (true)
+    {
+        below += MOVEMENT_DOWN;
+
+        if (Collides(rotation, below))
+        {
+            return distance;
+        }
+        distance++;
+    }
+}
@@ -0,0 +1,247 @@
+#include "board_bench.hpp"
+#include <array>
+#include <chrono>
+#include <vector>
+#include "board.hpp"
+#include "utility.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static const int BENCH_EMPTY_ROWS = 2;              // left empty at the top, where pieces spawn
+static const uint64_t BENCH_FULL_ROW_ONE_IN = 6;    // chance of a row with no hole
+static const int BENCH_ORIGIN_MARGIN = 2;           // origins are tried this far past every edge
+
+// one board kept both ways
+struct BenchBoard
+{
+    Board board;
+    std::vector<Square> squares;
+};
+
+struct CollisionQuery
+{
+    const PieceRotation* rotation;
+    Coordinate origin;
+};
+
+/*InGameState::CanMove before Board, every cell of the piece against every landed square*/
+static bool ScanCollides(const std::vector<Square>& squares, const PieceRotation& rotation, const Coordinate& origin)
+{
+    for (const Coordinate& cell : rotation.cells)
+    {
+        Coordinate coord = origin;
+        coord += cell;
+
+        if (coord.x < 0 || coord.x >= COORD_LIMIT_X || coord.y < 0 || coord.y >= COORD_LIMIT_Y)
+        {
+            return true;
+        }
+
+        for (const Square& placed : squares)
+        {
+            if (coord == placed.coord)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/*InGameState::CheckCompletedRow before Board, counts the squares in each row then keeps the ones
+in rows that are not full and moves them down past every full row below*/
+static int ScanClearCompletedRows(std::vector<Square>& squares)
+{
+    std::array<int, COORD_LIMIT_Y> row_counts = {0};
+
+    for (const Square& sq : squares)
+    {
+        row_counts[sq.coord.y]++;
+    }
+
+    std::vector<Square> remaining_squares;
+
+    for (const Square& sq : squares)
+    {
+        if (row_counts[sq.coord.y] < COORD_LIMIT_X)
+        {
+            remaining_squares.push_back(sq);
+        }
+    }
+
+    int rows_lowered = 0;
+
+    for (int i = (int)row_counts.size() - 1; i >= 0; i--)
+    {
+        if (row_counts[i] >= COORD_LIMIT_X)
+        {
+            for (Square& sq : remaining_squares)
+            {
+                if (sq.coord.y < i + rows_lowered)
+                {
+                    sq.coord += MOVEMENT_DOWN;
+                }
+            }
+            rows_lowered++;
+        }
+    }
+
+    squares = remaining_squares;
+    return rows_lowered;
+}
+
+/*Every row below the empty ones filled but for one random hole, some with none*/
+static void MakeBoard(Rng& rng, BenchBoard& out_board)
+{
+    for (int y = BENCH_EMPTY_ROWS; y < COORD_LIMIT_Y; y++)
+    {
+        int hole = rng.Range(0, BENCH_FULL_ROW_ONE_IN - 1) == 0 ? -1 : (int)rng.Range(0, COORD_LIMIT_X - 1);
+
+        for (int x = 0; x < COORD_LIMIT_X; x++)
+        {
+            if (x != hole)
+            {
+                Square sq = {{x, y}, (BLOCK_COLOR)rng.Range(0, BLOCK_COLOR_LENGTH - 1)};
+                out_board.board.Place(sq);
+                out_board.squares.push_back(sq);
+            }
+        }
+    }
+}
+
+/*Whether board holds exactly the squares, colors included*/
+static bool SameBoard(const Board& board, const std::vector<Square>& squares)
+{
+    Board expected;
+
+    for (const Square& sq : squares)
+    {
+        expected.Place(sq);
+
+        if (board.m_colors[sq.coord.y][sq.coord.x] != sq.color)
+        {
+            return false;
+        }
+    }
+
+    return board.m_rows == expected.m_rows && board.m_column_tops == expected.m_column_tops;
+}
+
+static double NanosecondsEach(Clock::time_point start, size_t count)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (double)count;
+}
+
+bool RunBoardBench(const BoardBenchOptions& options, BoardBenchReport& out_report)
+{
+    out_report = BoardBenchReport();
+
+    Rng rng(options.seed != 0 ? options.seed : RandomSeed());
+    std::vector<BenchBoard> boards(options.boards);
+
+    for (BenchBoard& board : boards)
+    {
+        MakeBoard(rng, board);
+    }
+
+    std::vector<CollisionQuery> queries;
+
+    for (int type = 0; type < PIECE_TYPE::LENGTH; type++)
+    {
+        for (size_t r = 0; r < DEFAULT_ROTATION_SYSTEM.num_rotations[type]; r++)
+        {
+            for (int y = -BENCH_ORIGIN_MARGIN; y < COORD_LIMIT_Y + BENCH_ORIGIN_MARGIN; y++)
+            {
+                for (int x = -BENCH_ORIGIN_MARGIN; x < COORD_LIMIT_X + BENCH_ORIGIN_MARGIN; x++)
+                {
+                    queries.push_back({&DEFAULT_ROTATION_SYSTEM.rotations[type][r], {x, y}});
+                }
+            }
+        }
+    }
+
+    out_report.collision_checks = boards.size() * queries.size();
+
+    for (const BenchBoard& board : boards)
+    {
+        for (const CollisionQuery& query : queries)
+        {
+            bool collides = board.board.Collides(*query.rotation, query.origin);
+            out_report.collisions += collides ? 1 : 0;
+            out_report.mismatches += collides != ScanCollides(board.squares, *query.rotation, query.origin) ? 1 : 0;
+        }
+
+        Board cleared = board.board;
+        std::vector<Square> squares = board.squares;
+        int rows = cleared.ClearCompletedRows();
+        out_report.rows_cleared += (size_t)rows;
+        out_report.mismatches += rows != ScanClearCompletedRows(squares) || !SameBoard(cleared, squares) ? 1 : 0;
+    }
+
+    // the totals go into the report so the timed loops cannot be left out
+    size_t collisions = 0;
+    size_t scan_collisions = 0;
+    size_t rows_cleared = 0;
+    size_t scan_rows_cleared = 0;
+
+    Clock::time_point start = Clock::now();
+
+    for (size_t repeat = 0; repeat < options.repeats; repeat++)
+    {
+        for (const BenchBoard& board : boards)
+        {
+            for (const CollisionQuery& query : queries)
+            {
+                collisions += board.board.Collides(*query.rotation, query.origin) ? 1 : 0;
+            }
+        }
+    }
+
+    out_report.collides_ns = NanosecondsEach(start, options.repeats * out_report.collision_checks);
+    start = Clock::now();
+
+    for (size_t repeat = 0; repeat < options.repeats; repeat++)
+    {
+        for (const BenchBoard& board : boards)
+        {
+            for (const CollisionQuery& query : queries)
+            {
+                scan_collisions += ScanCollides(board.squares, *query.rotation, query.origin) ? 1 : 0;
+            }
+        }
+    }
+
+    out_report.scan_collides_ns = NanosecondsEach(start, options.repeats * out_report.collision_checks);
+    start = Clock::now();
+
+    for (size_t repeat = 0; repeat < options.repeats; repeat++)
+    {
+        for (const BenchBoard& board : boards)
+        {
+            Board cleared = board.board;
+            rows_cleared += (size_t)cleared.ClearCompletedRows();
+        }
+    }
+
+    out_report.clear_ns = NanosecondsEach(start, options.repeats * boards.size());
+    start = Clock::now();
+
+    for (size_t repeat = 0; repeat < options.repeats; repeat++)
+    {
+        for (const BenchBoard& board : boards)
+        {
+            std::vector<Square> squares = board.squares;
+            scan_rows_cleared += (size_t)ScanClearCompletedRows(squares);
+        }
+    }
+
+    out_report.scan_clear_ns = NanosecondsEach(start, options.repeats * boards.size());
+
+    if (collisions != scan_collisions || rows_cleared != scan_rows_cleared ||
+        collisions != options.repeats * out_report.collisions || rows_cleared != options.repeats * out_report.rows_cleared)
+    {
+        out_report.mismatches++;
+    }
+
+    return true;
+}
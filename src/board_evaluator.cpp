@@ -0,0 +1,414 @@
+#include "board_evaluator.hpp"
+#include "simd_target.hpp"
+
+// enough to count a well the whole board deep
+static const int WELL_DEPTH_BITS = 5;
+
+static const RowMask RIGHT_WALL = (RowMask)(1 << COORD_LIMIT_X);
+static const RowMask LAST_COLUMN = (RowMask)(1 << (COORD_LIMIT_X - 1));
+
+// std::popcount is a library call unless the compiler may assume the instruction, a row and its
+// wall bit are small enough to look up
+static constexpr std::array<uint8_t, RIGHT_WALL * 2> MakeBitCounts()
+{
+    std::array<uint8_t, RIGHT_WALL * 2> counts = {};
+
+    for (size_t i = 1; i < counts.size(); i++)
+    {
+        counts[i] = (uint8_t)(counts[i / 2] + (i & 1));
+    }
+
+    return counts;
+}
+
+static constexpr std::array<uint8_t, RIGHT_WALL * 2> BIT_COUNTS = MakeBitCounts();
+
+static int CountBits(RowMask mask)
+{
+    return BIT_COUNTS[mask];
+}
+
+static EVALUATOR_KERNEL DetectKernel()
+{
+#if !defined(SIMD_X86)
+    return KERNEL_SCALAR;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    bool ssse3 = (info[2] & (1 << 9)) != 0;
+    bool saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+
+    if (max_leaf >= 7 && saves_ymm)
+    {
+        __cpuidex(info, 7, 0);
+
+        if (info[1] & (1 << 5))
+        {
+            return KERNEL_AVX2;
+        }
+    }
+
+    return ssse3 ? KERNEL_SSE : KERNEL_SCALAR;
+#else
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return KERNEL_AVX2;
+    }
+
+    return __builtin_cpu_supports("ssse3") ? KERNEL_SSE : KERNEL_SCALAR;
+#endif
+}
+
+/*The fastest kernel this CPU runs, checked once*/
+EVALUATOR_KERNEL BestEvaluatorKernel()
+{
+    static const EVALUATOR_KERNEL best = DetectKernel();
+    return best;
+}
+
+const char* EvaluatorKernelName(EVALUATOR_KERNEL kernel)
+{
+    switch (kernel)
+    {
+    case KERNEL_SCALAR:
+        return "scalar";
+    case KERNEL_SSE:
+        return "sse";
+    case KERNEL_AVX2:
+        return "avx2";
+    default:
+        return "unknown";
+    }
+}
+
+void BoardBatch::Clear()
+{
+    count = 0;
+
+    for (auto& row : rows)
+    {
+        row.fill(0);
+    }
+}
+
+/*Copies a board into the next free slot, false when the batch is full*/
+bool BoardBatch::Add(const std::array<RowMask, COORD_LIMIT_Y>& board_rows)
+{
+    if (count == EVALUATOR_BATCH_SIZE)
+    {
+        return false;
+    }
+
+    for (int y = 0; y < COORD_LIMIT_Y; y++)
+    {
+        rows[y][count] = board_rows[y];
+    }
+
+    count++;
+    return true;
+}
+
+/*Going down a row at a time, covered is the OR of every row so far: a column is as high as the
+rows it is covered in, and two columns differ in height by the rows only one is covered in. Well
+depths are kept as a counter per column, one mask per bit*/
+void EvaluateBoard(const std::array<RowMask, COORD_LIMIT_Y>& rows, BoardFeatures& out_features)
+{
+    BoardFeatures features = {};
+    RowMask covered = 0;
+    RowMask previous = 0;
+    std::array<RowMask, WELL_DEPTH_BITS> depth = {};
+
+    for (RowMask row : rows)
+    {
+        features.holes += CountBits((RowMask)(covered & ~row));
+        covered |= row;
+
+        features.aggregate_height += CountBits(covered);
+        features.max_height += covered != 0;
+        features.bumpiness += CountBits((RowMask)((covered ^ (covered >> 1)) & (FULL_ROW_MASK >> 1)));
+        features.row_transitions += CountBits((RowMask)(((row << 1) | 1) ^ (row | RIGHT_WALL)));
+        features.column_transitions += CountBits((RowMask)(row ^ previous));
+
+        RowMask well = (RowMask)(~row & ((row << 1) | 1) & ((row >> 1) | LAST_COLUMN) & FULL_ROW_MASK);
+        RowMask carry = well;
+
+        for (int bit = 0; bit < WELL_DEPTH_BITS; bit++)
+        {
+            RowMask next_carry = depth[bit] & carry;
+            depth[bit] = (RowMask)((depth[bit] ^ carry) & well);
+            carry = next_carry;
+            features.wells += CountBits(depth[bit]) << bit;
+        }
+
+        previous = row;
+    }
+
+    features.column_transitions += CountBits((RowMask)(previous ^ FULL_ROW_MASK));
+    out_features = features;
+}
+
+#ifdef SIMD_X86
+
+/*Popcount of every byte, looked up a nibble at a time*/
+SIMD_TARGET_SSE static inline __m128i CountBytes(__m128i x, __m128i table, __m128i nibble)
+{
+    __m128i low = _mm_shuffle_epi8(table, _mm_and_si128(x, nibble));
+    __m128i high = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(x, 4), nibble));
+    return _mm_add_epi8(low, high);
+}
+
+SIMD_TARGET_SSE static inline __m128i SumBytePairs(__m128i counts)
+{
+    return _mm_add_epi16(_mm_and_si128(counts, _mm_set1_epi16(0xFF)), _mm_srli_epi16(counts, 8));
+}
+
+/*EvaluateBoard for 8 boards, one per 16 bit lane. Counts are summed per byte while going down,
+at most 8 a row for 22 rows, and only added up per board at the end*/
+SIMD_TARGET_SSE static void EvaluateSse(const BoardBatch& batch, size_t first, BoardFeatures* out_features)
+{
+    const __m128i table = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i full = _mm_set1_epi16(FULL_ROW_MASK);
+    const __m128i right_wall = _mm_set1_epi16(RIGHT_WALL);
+    const __m128i last_column = _mm_set1_epi16(LAST_COLUMN);
+    const __m128i bump_columns = _mm_set1_epi16(FULL_ROW_MASK >> 1);
+
+    __m128i covered = _mm_setzero_si128();
+    __m128i previous = _mm_setzero_si128();
+    __m128i empty_rows = _mm_setzero_si128();
+    __m128i holes = _mm_setzero_si128();
+    __m128i height = _mm_setzero_si128();
+    __m128i bumpiness = _mm_setzero_si128();
+    __m128i row_transitions = _mm_setzero_si128();
+    __m128i column_transitions = _mm_setzero_si128();
+    __m128i depth[WELL_DEPTH_BITS];
+    __m128i wells[WELL_DEPTH_BITS];
+
+    for (int bit = 0; bit < WELL_DEPTH_BITS; bit++)
+    {
+        depth[bit] = _mm_setzero_si128();
+        wells[bit] = _mm_setzero_si128();
+    }
+
+    for (int y = 0; y < COORD_LIMIT_Y; y++)
+    {
+        __m128i row = _mm_load_si128((const __m128i*)&batch.rows[y][first]);
+
+        holes = _mm_add_epi8(holes, CountBytes(_mm_andnot_si128(row, covered), table, nibble));
+        covered = _mm_or_si128(covered, row);
+
+        empty_rows = _mm_sub_epi16(empty_rows, _mm_cmpeq_epi16(covered, _mm_setzero_si128()));
+        height = _mm_add_epi8(height, CountBytes(covered, table, nibble));
+
+        __m128i steps = _mm_and_si128(_mm_xor_si128(covered, _mm_srli_epi16(covered, 1)), bump_columns);
+        bumpiness = _mm_add_epi8(bumpiness, CountBytes(steps, table, nibble));
+
+        __m128i left = _mm_or_si128(_mm_slli_epi16(row, 1), one);
+        __m128i edges = _mm_xor_si128(left, _mm_or_si128(row, right_wall));
+        row_transitions = _mm_add_epi8(row_transitions, CountBytes(edges, table, nibble));
+        column_transitions = _mm_add_epi8(column_transitions, CountBytes(_mm_xor_si128(row, previous), table, nibble));
+
+        __m128i right = _mm_or_si128(_mm_srli_epi16(row, 1), last_column);
+        __m128i well = _mm_andnot_si128(row, _mm_and_si128(_mm_and_si128(left, right), full));
+        __m128i carry = well;
+
+        for (int bit = 0; bit < WELL_DEPTH_BITS; bit++)
+        {
+            __m128i next_carry = _mm_and_si128(depth[bit], carry);
+            depth[bit] = _mm_and_si128(_mm_xor_si128(depth[bit], carry), well);
+            carry = next_carry;
+            wells[bit] = _mm_add_epi8(wells[bit], CountBytes(depth[bit], table, nibble));
+        }
+
+        previous = row;
+    }
+
+    column_transitions = _mm_add_epi8(column_transitions, CountBytes(_mm_xor_si128(previous, full), table, nibble));
+
+    __m128i well_sum = _mm_setzero_si128();
+
+    for (int bit = 0; bit < WELL_DEPTH_BITS; bit++)
+    {
+        well_sum = _mm_add_epi16(well_sum, _mm_slli_epi16(SumBytePairs(wells[bit]), bit));
+    }
+
+    alignas(16) std::array<std::array<uint16_t, 8>, 7> lanes;
+    _mm_store_si128((__m128i*)lanes[0].data(), SumBytePairs(height));
+    _mm_store_si128((__m128i*)lanes[1].data(), _mm_sub_epi16(_mm_set1_epi16(COORD_LIMIT_Y), empty_rows));
+    _mm_store_si128((__m128i*)lanes[2].data(), SumBytePairs(holes));
+    _mm_store_si128((__m128i*)lanes[3].data(), SumBytePairs(bumpiness));
+    _mm_store_si128((__m128i*)lanes[4].data(), SumBytePairs(row_transitions));
+    _mm_store_si128((__m128i*)lanes[5].data(), SumBytePairs(column_transitions));
+    _mm_store_si128((__m128i*)lanes[6].data(), well_sum);
+
+    for (size_t i = 0; i < 8 && first + i < batch.count; i++)
+    {
+        out_features[i] = { lanes[0][i], lanes[1][i], lanes[2][i], lanes[3][i], lanes[4][i], lanes[5][i], lanes[6][i] };
+    }
+}
+
+SIMD_TARGET_AVX2 static inline __m256i CountBytes(__m256i x, __m256i table, __m256i nibble)
+{
+    __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(x, nibble));
+    __m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble));
+    return _mm256_add_epi8(low, high);
+}
+
+SIMD_TARGET_AVX2 static inline __m256i SumBytePairs(__m256i counts)
+{
+    return _mm256_add_epi16(_mm256_and_si256(counts, _mm256_set1_epi16(0xFF)), _mm256_srli_epi16(counts, 8));
+}
+
+/*EvaluateSse on 16 boards at once*/
+SIMD_TARGET_AVX2 static void EvaluateAvx2(const BoardBatch& batch, BoardFeatures* out_features)
+{
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i full = _mm256_set1_epi16(FULL_ROW_MASK);
+    const __m256i right_wall = _mm256_set1_epi16(RIGHT_WALL);
+    const __m256i last_column = _mm256_set1_epi16(LAST_COLUMN);
+    const __m256i bump_columns = _mm256_set1_epi16(FULL_ROW_MASK >> 1);
+
+    __m256i covered = _mm256_setzero_si256();
+    __m256i previous = _mm256_setzero_si256();
+    __m256i empty_rows = _mm256_setzero_si256();
+    __m256i holes = _mm256_setzero_si256();
+    __m256i height = _mm256_setzero_si256();
+    __m256i bumpiness = _mm256_setzero_si256();
+    __m256i row_transitions = _mm256_setzero_si256();
+    __m256i column_transitions = _mm256_setzero_si256();
+    __m256i depth[WELL_DEPTH_BITS];
+    __m256i wells[WELL_DEPTH_BITS];
+
+    for (int bit = 0; bit < WELL_DEPTH_BITS; bit++)
+    {
+        depth[bit] = _mm256_setzero_si256();
+        wells[bit] = _mm256_setzero_si256();
+    }
+
+    for (int y = 0; y < COORD_LIMIT_Y; y++)
+    {
+        __m256i row = _mm256_load_si256((const __m256i*)batch.rows[y].data());
+
+        holes = _mm256_add_epi8(holes, CountBytes(_mm256_andnot_si256(row, covered), table, nibble));
+        covered = _mm256_or_si256(covered, row);
+
+        empty_rows = _mm256_sub_epi16(empty_rows, _mm256_cmpeq_epi16(covered, _mm256_setzero_si256()));
+        height = _mm256_add_epi8(height, CountBytes(covered, table, nibble));
+
+        __m256i steps = _mm256_and_si256(_mm256_xor_si256(covered, _mm256_srli_epi16(covered, 1)), bump_columns);
+        bumpiness = _mm256_add_epi8(bumpiness, CountBytes(steps, table, nibble));
+
+        __m256i left = _mm256_or_si256(_mm256_slli_epi16(row, 1), one);
+        __m256i edges = _mm256_xor_si256(left, _mm256_or_si256(row, right_wall));
+        row_transitions = _mm256_add_epi8(row_transitions, CountBytes(edges, table, nibble));
+        column_transitions = _mm256_add_epi8(column_transitions, CountBytes(_mm256_xor_si256(row, previous), table, nibble));
+
+        __m256i right = _mm256_or_si256(_mm256_srli_epi16(row, 1), last_column);
+        __m256i well = _mm256_andnot_si256(row, _mm256_and_si256(_mm256_and_si256(left, right), full));
+        __m256i carry = well;
+
+        for (int bit = 0; bit < WELL_DEPTH_BITS; bit++)
+        {
+            __m256i next_carry = _mm256_and_si256(depth[bit], carry);
+            depth[bit] = _mm256_and_si256(_mm256_xor_si256(depth[bit], carry), well);
+            carry = next_carry;
+            wells[bit] = _mm256_add_epi8(wells[bit], CountBytes(depth[bit], table, nibble));
+        }
+
+        previous = row;
+    }
+
+    column_transitions = _mm256_add_epi8(column_transitions, CountBytes(_mm256_xor_si256(previous, full), table, nibble));
+
+    __m256i well_sum = _mm256_setzero_si256();
+
+    for (int bit = 0; bit < WELL_DEPTH_BITS; bit++)
+    {
+        well_sum = _mm256_add_epi16(well_sum, _mm256_slli_epi16(SumBytePairs(wells[bit]), bit));
+    }
+
+    alignas(32) std::array<std::array<uint16_t, 16>, 7> lanes;
+    _mm256_store_si256((__m256i*)lanes[0].data(), SumBytePairs(height));
+    _mm256_store_si256((__m256i*)lanes[1].data(), _mm256_sub_epi16(_mm256_set1_epi16(COORD_LIMIT_Y), empty_rows));
+    _mm256_store_si256((__m256i*)lanes[2].data(), SumBytePairs(holes));
+    _mm256_store_si256((__m256i*)lanes[3].data(), SumBytePairs(bumpiness));
+    _mm256_store_si256((__m256i*)lanes[4].data(), SumBytePairs(row_transitions));
+    _mm256_store_si256((__m256i*)lanes[5].data(), SumBytePairs(column_transitions));
+    _mm256_store_si256((__m256i*)lanes[6].data(), well_sum);
+
+    for (size_t i = 0; i < batch.count; i++)
+    {
+        out_features[i] = { lanes[0][i], lanes[1][i], lanes[2][i], lanes[3][i], lanes[4][i], lanes[5][i], lanes[6][i] };
+    }
+}
+
+#endif
+
+/*Features of every board in the batch. A kernel this CPU does not have falls back to the best one
+it does*/
+void EvaluateBatch(const BoardBatch& batch, EVALUATOR_KERNEL kernel, std::array<BoardFeatures, EVALUATOR_BATCH_SIZE>& out_features)
+{
+    kernel = kernel > BestEvaluatorKernel() ? BestEvaluatorKernel() : kernel;
+
+#ifdef SIMD_X86
+    if (kernel == KERNEL_AVX2)
+    {
+        EvaluateAvx2(batch, out_features.data());
+        return;
+    }
+
+    if (kernel == KERNEL_SSE)
+    {
+        for (size_t first = 0; first < batch.count; first += 8)
+        {
+            EvaluateSse(batch, first, out_features.data() + first);
+        }
+
+        return;
+    }
+#endif
+
+    std::array<RowMask, COORD_LIMIT_Y> rows;
+
+    for (size_t i = 0; i < batch.count; i++)
+    {
+        for (int y = 0; y < COORD_LIMIT_Y; y++)
+        {
+            rows[y] = batch.rows[y][i];
+        }
+
+        EvaluateBoard(rows, out_features[i]);
+    }
+}
+
+float ScoreFeatures(const BoardFeatures& features, const EvaluatorWeights& weights)
+{
+    return weights.aggregate_height * features.aggregate_height +
+        weights.max_height * features.max_height +
+        weights.holes * features.holes +
+        weights.bumpiness * features.bumpiness +
+        weights.row_transitions * features.row_transitions +
+        weights.column_transitions * features.column_transitions +
+        weights.wells * features.wells;
+}
+
+void ScoreBatch(const BoardBatch& batch, EVALUATOR_KERNEL kernel, const EvaluatorWeights& weights,
+    std::array<float, EVALUATOR_BATCH_SIZE>& out_scores)
+{
+    std::array<BoardFeatures, EVALUATOR_BATCH_SIZE> features;
+    EvaluateBatch(batch, kernel, features);
+
+    for (size_t i = 0; i < batch.count; i++)
+    {
+        out_scores[i] = ScoreFeatures(features[i], weights);
+    }
+}
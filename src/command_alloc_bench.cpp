@@ -0,0 +1,24 @@
+#include "commands.hpp"
+#include <format>
+#include <iostream>
+#include "alloc_bench.hpp"
+
+/*Plays bot games headless with replays and autosaves on and counts heap allocations per tick,
+non-zero if any tick allocated*/
+int MeasureAllocations(const AllocBenchOptions& options)
+{
+    AllocBenchReport report;
+
+    if (!RunAllocBench(options, report))
+    {
+        return 1;
+    }
+
+    std::cout << std::format("{} ticks in {:.1f} s over {} finished games, {} lines, {} keyframes, {} autosaves",
+        report.ticks, report.seconds, report.games, report.lines, report.keyframes, report.autosaves) << std::endl;
+    std::cout << std::format("{} allocations in {} ticks, at most {} in one{}",
+        report.allocations, report.allocating_ticks, report.max_tick_allocations,
+        report.allocating_ticks == 0 ? "" : std::format(", first at tick {} ALLOCATED", report.first_allocating_tick)) << std::endl;
+
+    return report.allocating_ticks == 0 ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#include "commands.hpp"
+#include <format>
+#include <iostream>
+#include "batch_bench.hpp"
+
+/*Checks the batch environment against GameCore and prints steps per second for each kernel and
+thread count, non-zero if any game ever differed*/
+int MeasureBatch(const BatchBenchOptions& options)
+{
+    BatchBenchReport report;
+
+    if (!RunBatchBench(options, report))
+    {
+        return 1;
+    }
+
+    std::cout << std::format("{} game steps checked against GameCore per kernel on 1 and {} threads, {} games over, {} lines, {} differed{}",
+        report.checked_game_steps, report.checked_threads, report.checked_episodes, report.checked_lines, report.mismatches,
+        report.mismatches == 0 ? "" : " MISMATCH") << std::endl;
+
+    for (int kernel = 0; kernel < KERNEL_LENGTH; kernel++)
+    {
+        if (report.game_steps_per_second[kernel] > 0)
+        {
+            std::cout << std::format("{} games, 1 thread, {}: {:.0f} game steps/s",
+                options.games, EvaluatorKernelName((EVALUATOR_KERNEL)kernel), report.game_steps_per_second[kernel]) << std::endl;
+        }
+    }
+
+    for (const BatchScaling& scaling : report.scaling)
+    {
+        std::cout << std::format("{} threads: {:.0f} game steps/s, {:.2f}x",
+            scaling.threads, scaling.game_steps_per_second, scaling.speedup) << std::endl;
+    }
+
+    return report.mismatches == 0 ? 0 : 1;
+}
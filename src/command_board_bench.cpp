@@ -0,0 +1,26 @@
+#include "commands.hpp"
+#include <format>
+#include <iostream>
+#include "board_bench.hpp"
+
+/*Times the row bitmask board against the square list scans it replaced on near-full boards,
+non-zero if the two ever disagreed*/
+int MeasureBoard(const BoardBenchOptions& options)
+{
+    BoardBenchReport report;
+
+    if (!RunBoardBench(options, report))
+    {
+        return 1;
+    }
+
+    std::cout << std::format("{} boards, {} collision checks ({} collide) and {} rows cleared a pass, {} differed{}",
+        options.boards, report.collision_checks, report.collisions, report.rows_cleared, report.mismatches,
+        report.mismatches == 0 ? "" : " MISMATCH") << std::endl;
+    std::cout << std::format("Collides: {:.1f} ns, square scan {:.1f} ns, {:.1f}x",
+        report.collides_ns, report.scan_collides_ns, report.scan_collides_ns / report.collides_ns) << std::endl;
+    std::cout << std::format("ClearCompletedRows: {:.1f} ns a board, square scan {:.1f} ns, {:.1f}x",
+        report.clear_ns, report.scan_clear_ns, report.scan_clear_ns / report.clear_ns) << std::endl;
+
+    return report.mismatches == 0 ? 0 : 1;
+}
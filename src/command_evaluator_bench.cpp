@@ -0,0 +1,34 @@
+#include "commands.hpp"
+#include <format>
+#include <iostream>
+#include "evaluator_bench.hpp"
+
+/*Times every board evaluator kernel this CPU has on the boards a bot weighed and prints whether
+they all agreed with a cell by cell count, non-zero if any did not*/
+int MeasureEvaluator(const EvaluatorBenchOptions& options)
+{
+    EvaluatorBenchReport report;
+
+    if (!RunEvaluatorBench(options, report))
+    {
+        return 1;
+    }
+
+    std::cout << std::format("{} games, {} pieces, {:.1f} lines per game, {} boards",
+        report.games, report.pieces, (double)report.lines / report.games, report.boards) << std::endl;
+    std::cout << std::format("cell by cell {:.1f} ns per board, single board {:.1f} ns",
+        report.reference_ns_per_board, report.single_ns_per_board) << std::endl;
+
+    for (int kernel = 0; kernel <= report.best_kernel; kernel++)
+    {
+        std::cout << std::format("batch {} {:.1f} ns per board", EvaluatorKernelName((EVALUATOR_KERNEL)kernel),
+            report.batch_ns_per_board[kernel]) << std::endl;
+    }
+
+    std::cout << std::format("{} boards with different features{}",
+        report.mismatches, report.mismatches == 0 ? "" : " MISMATCH") << std::endl;
+    std::cout << std::format("feature checksum {:016x}, {} timed passes disagreed{}", report.checksum,
+        report.checksum_mismatches, report.checksum_mismatches == 0 ? "" : " MISMATCH") << std::endl;
+
+    return report.mismatches == 0 && report.checksum_mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+#include "commands.hpp"
+#include <format>
+#include <iostream>
+#include "placement_bench.hpp"
+
+/*Times the move generator on bot games and prints whether it agreed with GameCore, non-zero if
+it ever did not*/
+int MeasurePlacements(const PlacementBenchOptions& options)
+{
+    PlacementBenchReport report;
+
+    if (!RunPlacementBench(options, report))
+    {
+        return 1;
+    }
+
+    bool correct = report.wrong_pieces == 0 && report.wrong_paths == 0;
+
+    std::cout << std::format("{} pieces, {} placements ({:.1f} per piece, {} tucks and spins)",
+        report.pieces, report.placements, (double)report.placements / report.pieces, report.tucks) << std::endl;
+    std::cout << std::format("{:.0f} ns per piece, p50 {:.0f} ns, p99 {:.0f} ns",
+        report.ns_per_piece, report.ns_p50, report.ns_p99) << std::endl;
+    std::cout << std::format("{} pieces with different resting places, {} wrong paths{}",
+        report.wrong_pieces, report.wrong_paths, correct ? "" : " MISMATCH") << std::endl;
+
+    return correct ? 0 : 1;
+}
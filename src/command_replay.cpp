@@ -0,0 +1,174 @@
+#include "commands.hpp"
+#include <chrono>
+#include <format>
+#include <iostream>
+#include "replay.hpp"
+#include "replay_archive.hpp"
+#include "replay_index.hpp"
+#include "replay_verifier.hpp"
+
+/*Re-simulates one replay and prints the result, false if it did not match what was recorded*/
+static bool CheckReplay(const std::string& name, ReplayReader& reader, int seek_seconds, uint64_t& total_ticks)
+{
+    ReplayResult result;
+
+    bool complete = SimulateReplay(reader, result);
+    bool matches = complete && result.lines_cleared == result.recorded_lines &&
+        result.pieces_placed == result.recorded_pieces;
+
+    std::cout << std::format("{}: lines {} pieces {} ticks {} checksum {:016x}{}{}",
+        name, result.lines_cleared, result.pieces_placed, result.ticks, result.checksum,
+        result.resumed ? " RESUMED" : "",
+        result.corrupt ? " CORRUPT" : (!complete ? " TRUNCATED" : (matches ? "" : " MISMATCH"))) << std::endl;
+
+    if (seek_seconds >= 0)
+    {
+        uint32_t seek_tick = (uint32_t)seek_seconds * TICKS_PER_SECOND;
+        GameCore core(reader.Settings());
+
+        auto seek_start = std::chrono::steady_clock::now();
+        bool seeked = reader.Seek(seek_tick, core);
+        double seek_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - seek_start).count();
+
+        if (!seeked)
+        {
+            std::cout << std::format("  at tick {}: could not seek", seek_tick) << std::endl;
+            return false;
+        }
+
+        std::cout << std::format("  at tick {}: lines {} pieces {} checksum {:016x} ({:.3f} ms)",
+            core.m_tick, core.m_lines_cleared, core.m_pieces_placed, core.Checksum(), seek_ms) << std::endl;
+    }
+
+    total_ticks += result.ticks;
+    return matches;
+}
+
+/*Re-simulates each replay, or every game in each replay archive, without touching SDL and
+prints the result, non-zero if any failed to match*/
+int RunReplays(const std::vector<std::string>& paths, int seek_seconds)
+{
+    int failures = 0;
+    size_t replay_count = 0;
+    uint64_t total_ticks = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (const std::string& path : paths)
+    {
+        ReplayReader reader;
+
+        if (IsReplayArchive(path))
+        {
+            ReplayArchiveReader archive;
+
+            if (!archive.Open(path))
+            {
+                failures++;
+                continue;
+            }
+
+            while (archive.Next(reader))
+            {
+                std::string name = std::format("{}@{}", path, archive.m_block_offset);
+                failures += CheckReplay(name, reader, seek_seconds, total_ticks) ? 0 : 1;
+                replay_count++;
+            }
+
+            failures += (int)archive.m_corrupt_blocks;
+            continue;
+        }
+
+        if (!reader.Open(path))
+        {
+            failures++;
+            continue;
+        }
+
+        failures += CheckReplay(path, reader, seek_seconds, total_ticks) ? 0 : 1;
+        replay_count++;
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double game_seconds = (double)total_ticks / TICKS_PER_SECOND;
+
+    std::cout << std::format("{} replays, {:.1f} game seconds in {:.3f} s ({:.0f}x real time)",
+        replay_count, game_seconds, elapsed, elapsed > 0 ? game_seconds / elapsed : 0.0) << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
+
+/*Re-simulates every game on thread_count workers and prints a pass/fail line per game*/
+int VerifyAll(const std::vector<std::string>& paths, size_t thread_count)
+{
+    VerifyReport report;
+    VerifyReplays(paths, thread_count, report);
+
+    for (const VerifyResult& result : report.results)
+    {
+        std::cout << std::format("{} {}: lines {}/{} pieces {}/{} ticks {} checksum {:016x} {:.3f} ms{}{}",
+            result.passed ? "PASS" : "FAIL", result.name, result.lines_cleared, result.claimed_lines,
+            result.pieces_placed, result.claimed_pieces, result.ticks, result.checksum, result.milliseconds,
+            result.passed ? "" : " ", result.reason) << std::endl;
+    }
+
+    std::cout << std::format("{} games, {} failed in {:.3f} s on {} threads ({:.0f} games/s, {} steals)",
+        report.results.size(), report.failures, report.seconds, report.thread_count,
+        report.seconds > 0 ? report.results.size() / report.seconds : 0.0, report.steals) << std::endl;
+
+    return report.failures == 0 ? 0 : 1;
+}
+
+/*Rebuilds the metadata index of each archive, each one spread over thread_count workers*/
+int RebuildIndexes(const std::vector<std::string>& archives, size_t thread_count)
+{
+    int failures = 0;
+
+    for (const std::string& archive : archives)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bool rebuilt = RebuildReplayIndex(archive, thread_count);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << std::format("{}: {} in {:.3f} s on {} threads", ReplayIndexPath(archive),
+            rebuilt ? "rebuilt" : "FAILED", elapsed, thread_count) << std::endl;
+
+        failures += rebuilt ? 0 : 1;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
+
+/*Answers --top or --longer-than straight from the mapped index*/
+int QueryIndex(const std::string& index_path, int top_count, int longer_than_minutes)
+{
+    ReplayIndexView index;
+
+    if (!index.Open(index_path))
+    {
+        return 1;
+    }
+
+    std::vector<const ReplayMetadata*> records;
+
+    if (top_count > 0)
+    {
+        TopByLines(index, (size_t)top_count, records);
+    }
+    else
+    {
+        LongerThan(index, (uint32_t)longer_than_minutes * 60 * TICKS_PER_SECOND, records);
+    }
+
+    for (const ReplayMetadata* record : records)
+    {
+        uint32_t seconds = record->ticks / TICKS_PER_SECOND;
+
+        std::cout << std::format("@{} seed {:016x} lines {} pieces {} time {}:{:02} fall ticks {}{}",
+            record->archive_offset, record->seed, record->lines_cleared, record->pieces_placed,
+            seconds / 60, seconds % 60, record->fall_ticks,
+            (record->flags & REPLAY_META_VERIFIED) ? " verified" : "") << std::endl;
+    }
+
+    std::cout << std::format("{} of {} games", records.size(), index.Count()) << std::endl;
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include "commands.hpp"
+#include <format>
+#include <iostream>
+#include "rollback_bench.hpp"
+
+/*Plays a bot match over loopback with injected latency and prints how much rolling back it took,
+non-zero if the two sides did not end on the same state*/
+int MeasureRollback(const RollbackBenchOptions& options)
+{
+    RollbackBenchReport report;
+
+    if (!RunRollbackBench(options, report))
+    {
+        return 1;
+    }
+
+    double ticks_per_second = report.rollback_seconds > 0 ? report.resimulated_ticks / report.rollback_seconds : 0.0;
+
+    std::cout << std::format("{} ticks in {:.1f} s, delay {} ms, jitter {} ms{}",
+        report.ticks, report.seconds, options.delay_ms, options.jitter_ms,
+        report.match_over_tick > 0 ? std::format(", match over at tick {}", report.match_over_tick) : "") << std::endl;
+    std::cout << std::format("rollbacks {} ({:.1f}/s), re-simulated ticks {} ({:.1f}/s), deepest {} ticks, stalled frames {}",
+        report.rollbacks, report.rollbacks / report.seconds, report.resimulated_ticks,
+        report.resimulated_ticks / report.seconds, report.max_rollback_ticks, report.stalled_frames) << std::endl;
+    std::cout << std::format("frame time p50 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms, re-simulation runs at {:.0f} ticks/s",
+        report.frame_ms_p50, report.frame_ms_p99, report.frame_ms_max, ticks_per_second) << std::endl;
+    std::cout << std::format("checksums {:016x} {:016x} {}", report.checksums[0], report.checksums[1],
+        report.in_sync ? "in sync" : "DESYNC") << std::endl;
+
+    return report.in_sync ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#include "commands.hpp"
+#include <format>
+#include <iostream>
+#include <utility>
+#include "search_bench.hpp"
+
+/*Plays the greedy and the lookahead bot on the same games, then prints nodes per second for each
+thread count, non-zero if more threads ever picked a different placement*/
+int MeasureSearch(const SearchBenchOptions& options)
+{
+    SearchBenchReport report;
+
+    if (!RunSearchBench(options, report))
+    {
+        return 1;
+    }
+
+    for (const auto& [name, bot] : { std::pair{"greedy", report.greedy}, std::pair{"lookahead", report.lookahead} })
+    {
+        std::cout << std::format("{}: {} games, {} pieces, {} lines, {} topped out, mean stack height {:.2f}",
+            name, report.games, bot.pieces, bot.lines, bot.top_outs, bot.mean_height) << std::endl;
+    }
+
+    std::cout << std::format("lookahead with {:.1f} ms a move: mean depth {:.2f}, p50 {:.2f} ms, p99 {:.2f} ms",
+        options.budget_ms, report.mean_depth, report.move_ms_p50, report.move_ms_p99) << std::endl;
+
+    size_t differing = 0;
+
+    for (const SearchScaling& scaling : report.scaling)
+    {
+        std::cout << std::format("{} threads: {} positions {} deep, {} nodes, {} table hits, {:.0f} nodes/s, {:.2f}x{}",
+            scaling.threads, report.positions, options.depth, scaling.nodes, scaling.table_hits,
+            scaling.nodes_per_second, scaling.speedup, scaling.differing_moves == 0 ? "" : " DIFFERENT MOVES") << std::endl;
+        differing += scaling.differing_moves;
+    }
+
+    return differing == 0 ? 0 : 1;
+}
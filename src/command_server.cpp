@@ -0,0 +1,49 @@
+#include "commands.hpp"
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "game_server.hpp"
+#include "utility.hpp"
+
+/*Hosts headless games for clients on port until the process is killed, printing the load once
+a second*/
+int RunServer(uint16_t port, size_t thread_count)
+{
+    GameServer server(SERVER_MAX_SESSIONS, thread_count);
+
+    if (!server.Listen(port))
+    {
+        return 1;
+    }
+
+    std::cout << std::format("serving up to {} games on port {} with {} threads",
+        SERVER_MAX_SESSIONS, server.Port(), server.ThreadCount()) << std::endl;
+
+    const std::chrono::nanoseconds tick_duration(1000000000 / TICKS_PER_SECOND);
+    std::vector<double> tick_ms;
+    tick_ms.reserve(TICKS_PER_SECOND);
+
+    ServerTickTiming timing;
+    auto next_tick = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+        server.Tick(timing);
+        tick_ms.push_back(timing.total_ms);
+
+        if (tick_ms.size() == TICKS_PER_SECOND)
+        {
+            double max_ms = *std::max_element(tick_ms.begin(), tick_ms.end());
+
+            std::cout << std::format("{} sessions, tick p50 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms",
+                server.SessionCount(), Percentile(tick_ms, 0.50), Percentile(tick_ms, 0.99), max_ms) << std::endl;
+            tick_ms.clear();
+        }
+
+        next_tick += tick_duration;
+        std::this_thread::sleep_until(next_tick);
+    }
+}
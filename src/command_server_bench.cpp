@@ -0,0 +1,29 @@
+#include "commands.hpp"
+#include <format>
+#include <iostream>
+#include "game_core.hpp"
+#include "server_bench.hpp"
+
+/*Runs the server against simulated clients and prints how much load it took*/
+int MeasureServer(const ServerBenchOptions& options)
+{
+    ServerBenchReport report;
+
+    if (!RunServerBench(options, report))
+    {
+        return 1;
+    }
+
+    std::cout << std::format("{} sessions on {} threads, {} ticks in {:.1f} s, {} inputs, {} events, {} games over",
+        report.sessions, report.thread_count, report.ticks, report.seconds, report.inputs_sent,
+        report.events_received, report.games_over) << std::endl;
+    std::cout << std::format("tick p50 {:.3f} ms, p99 {:.3f} ms, p99.9 {:.3f} ms, max {:.3f} ms, {} late; stepping p50 {:.3f} ms, p99 {:.3f} ms",
+        report.tick_ms_p50, report.tick_ms_p99, report.tick_ms_p999, report.tick_ms_max, report.late_ticks,
+        report.step_ms_p50, report.step_ms_p99) << std::endl;
+    std::cout << std::format("{:.3f} ms of cpu per tick, {:.0f} sessions per core at {} ticks/s",
+        report.cpu_ms_per_tick, report.sessions_per_core, TICKS_PER_SECOND) << std::endl;
+    std::cout << std::format("{} bytes per session ({} in the session array)",
+        report.bytes_per_session, report.session_bytes) << std::endl;
+
+    return 0;
+}
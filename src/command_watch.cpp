@@ -0,0 +1,72 @@
+#include "commands.hpp"
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <thread>
+#include "net_socket.hpp"
+#include "spectator.hpp"
+
+/*Follows a game streamed with --spectate without drawing it and prints what arrives each second,
+non-zero if the decoded board ever disagreed with a keyframe*/
+int WatchGame(const std::string& address)
+{
+    std::string host;
+    uint16_t port;
+    SplitAddress(address, SPECTATOR_DEFAULT_PORT, host, port);
+
+    NetSocket socket;
+
+    if (!socket.Connect(host, port))
+    {
+        return 1;
+    }
+
+    SpectatorDecoder decoder;
+    uint8_t buffer[4096];
+    size_t total_bytes = 0;
+    size_t second_bytes = 0;
+    size_t second_ticks = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto next_report = start + std::chrono::seconds(1);
+
+    while (true)
+    {
+        int bytes = socket.Receive(buffer, sizeof(buffer));
+
+        if (bytes < 0)
+        {
+            break;
+        }
+
+        if (bytes == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        else if (!decoder.Receive(buffer, (size_t)bytes))
+        {
+            break;
+        }
+
+        total_bytes += (size_t)bytes;
+
+        if (std::chrono::steady_clock::now() >= next_report)
+        {
+            std::cout << std::format("tick {} lines {} pieces {}: {} bytes/s, {} changed ticks/s, {} keyframes, {} mismatches, {} corrupt keyframes",
+                decoder.m_state.tick, decoder.m_state.lines_cleared, decoder.m_state.pieces_placed,
+                total_bytes - second_bytes, decoder.m_ticks - second_ticks, decoder.m_keyframes,
+                decoder.m_mismatches, decoder.m_bad_keyframes) << std::endl;
+
+            second_bytes = total_bytes;
+            second_ticks = decoder.m_ticks;
+            next_report += std::chrono::seconds(1);
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::format("stream closed after {:.1f} s: {} bytes ({:.0f} bytes/s), {} keyframes, {} games over, {} mismatches, {} corrupt keyframes",
+        elapsed, total_bytes, elapsed > 0 ? total_bytes / elapsed : 0.0, decoder.m_keyframes,
+        decoder.m_games_finished, decoder.m_mismatches, decoder.m_bad_keyframes) << std::endl;
+
+    return decoder.m_mismatches == 0 && decoder.m_bad_keyframes == 0 ? 0 : 1;
+}
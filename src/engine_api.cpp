@@ -0,0 +1,239 @@
+#include "engine_api.h"
+#include <cstring>
+#include <new>
+#include <optional>
+#include <vector>
+#include "game_core.hpp"
+#include "utility.hpp"
+
+static const size_t PLANE_SIZE = FB_BOARD_HEIGHT * FB_BOARD_WIDTH;
+
+static_assert(FB_BOARD_WIDTH == COORD_LIMIT_X && FB_BOARD_HEIGHT == COORD_LIMIT_Y, "engine_api.h board size is out of date");
+static_assert(FB_ACTION_NONE == ACTION_NONE && FB_ACTION_LEFT == ACTION_LEFT && FB_ACTION_RIGHT == ACTION_RIGHT &&
+    FB_ACTION_ROTATE == ACTION_ROTATE && FB_ACTION_HARD_DROP == ACTION_HARD_DROP && FB_ACTION_COUNT == ACTION_LENGTH,
+    "engine_api.h actions must match BATCH_ACTION");
+static_assert(FB_RANDOMIZER_UNIFORM == RANDOMIZER_UNIFORM && FB_RANDOMIZER_BAG7 == RANDOMIZER_BAG7,
+    "engine_api.h randomizers must match RANDOMIZER_TYPE");
+
+struct fb_env
+{
+    uint64_t seed;
+    RANDOMIZER_TYPE randomizer;
+
+    // optional so a game starts over in place, a new GameCore would be an allocation per top out
+    std::vector<std::optional<GameCore>> cores;
+    std::vector<uint32_t> episodes;
+};
+
+/*A new game with the seed BatchEnvironment would give this game's next episode*/
+static void ResetGame(fb_env& env, size_t game)
+{
+    Rng rng(env.seed ^ ((uint64_t)game << 32 | env.episodes[game]));
+
+    GameSettings settings;
+    settings.seed = rng.Next() | 1;
+    settings.randomizer = env.randomizer;
+    env.cores[game].emplace(settings);
+}
+
+/*Writes game's entry in every buffer the caller gave*/
+static void WriteObservation(const fb_env& env, size_t game, int32_t reward, bool done, const fb_buffers* out)
+{
+    if (out == NULL)
+    {
+        return;
+    }
+
+    const GameCore& core = *env.cores[game];
+    const Piece& piece = core.m_falling_piece;
+
+    if (out->planes != NULL)
+    {
+        uint8_t* landed = out->planes + game * FB_PLANES_SIZE + FB_PLANE_LANDED * PLANE_SIZE;
+        uint8_t* falling = out->planes + game * FB_PLANES_SIZE + FB_PLANE_FALLING * PLANE_SIZE;
+
+        for (int y = 0; y < FB_BOARD_HEIGHT; y++)
+        {
+            RowMask row = core.m_board.m_rows[y];
+
+            for (int x = 0; x < FB_BOARD_WIDTH; x++)
+            {
+                landed[y * FB_BOARD_WIDTH + x] = (uint8_t)((row >> x) & 1);
+            }
+        }
+
+        std::memset(falling, 0, PLANE_SIZE);
+
+        // a piece that just spawned can stick out over the top
+        for (const Square& square : piece.GetSquares())
+        {
+            if (core.m_board.InBounds(square.coord))
+            {
+                falling[square.coord.y * FB_BOARD_WIDTH + square.coord.x] = 1;
+            }
+        }
+    }
+
+    if (out->pieces != NULL)
+    {
+        int32_t* fields = out->pieces + game * FB_PIECE_FIELDS;
+        fields[FB_PIECE_TYPE] = (int32_t)piece.m_type;
+        fields[FB_PIECE_ROTATION] = (int32_t)piece.m_rotation_index;
+        fields[FB_PIECE_X] = piece.m_origin.x;
+        fields[FB_PIECE_Y] = piece.m_origin.y;
+    }
+
+    if (out->scores != NULL)
+    {
+        int32_t* fields = out->scores + game * FB_SCORE_FIELDS;
+        fields[FB_SCORE_LINES] = (int32_t)core.m_lines_cleared;
+        fields[FB_SCORE_PIECES] = (int32_t)core.m_pieces_placed;
+        fields[FB_SCORE_EPISODES] = (int32_t)env.episodes[game];
+    }
+
+    if (out->rewards != NULL)
+    {
+        out->rewards[game] = reward;
+    }
+
+    if (out->dones != NULL)
+    {
+        out->dones[game] = done ? 1 : 0;
+    }
+}
+
+/*Steps one game through GameCore and starts it over if it topped out*/
+static void StepGame(fb_env& env, size_t game, uint8_t action, const fb_buffers* out)
+{
+    GameCore& core = *env.cores[game];
+    size_t lines = core.m_lines_cleared;
+    GameEvent event;
+
+    StepGameCore(core, action);
+
+    // nothing here listens, but GameCore only holds so many
+    while (core.PollEvent(event))
+    {
+    }
+
+    int32_t reward = (int32_t)(core.m_lines_cleared - lines);
+    bool done = !core.m_game_running;
+
+    if (done)
+    {
+        env.episodes[game]++;
+        ResetGame(env, game);
+    }
+
+    WriteObservation(env, game, reward, done, out);
+}
+
+uint32_t fb_api_version(void)
+{
+    return FB_API_VERSION;
+}
+
+fb_env* fb_create(uint32_t game_count, uint64_t seed, int32_t randomizer)
+{
+    if (game_count == 0 || (randomizer != FB_RANDOMIZER_UNIFORM && randomizer != FB_RANDOMIZER_BAG7))
+    {
+        return NULL;
+    }
+
+    fb_env* env = new (std::nothrow) fb_env;
+
+    if (env == NULL)
+    {
+        return NULL;
+    }
+
+    // the only allocations an fb_env makes, and no exception may reach a C caller
+    try
+    {
+        env->cores.resize(game_count);
+        env->episodes.resize(game_count);
+    }
+    catch (const std::bad_alloc&)
+    {
+        delete env;
+        return NULL;
+    }
+
+    env->randomizer = (RANDOMIZER_TYPE)randomizer;
+    fb_reset(env, seed, NULL);
+    return env;
+}
+
+void fb_destroy(fb_env* env)
+{
+    delete env;
+}
+
+uint32_t fb_game_count(const fb_env* env)
+{
+    return env != NULL ? (uint32_t)env->cores.size() : 0;
+}
+
+int32_t fb_reset(fb_env* env, uint64_t seed, const fb_buffers* out)
+{
+    if (env == NULL)
+    {
+        return FB_ERROR_ARGUMENT;
+    }
+
+    env->seed = seed != 0 ? seed : RandomSeed();
+
+    for (size_t game = 0; game < env->cores.size(); game++)
+    {
+        env->episodes[game] = 0;
+        ResetGame(*env, game);
+        WriteObservation(*env, game, 0, false, out);
+    }
+
+    return FB_OK;
+}
+
+uint64_t fb_game_seed(const fb_env* env, uint32_t game)
+{
+    if (env == NULL || game >= env->cores.size())
+    {
+        return 0;
+    }
+
+    return env->cores[game]->m_seed;
+}
+
+int32_t fb_step(fb_env* env, uint32_t game, uint8_t action, const fb_buffers* out)
+{
+    if (env == NULL || game >= env->cores.size() || action >= FB_ACTION_COUNT)
+    {
+        return FB_ERROR_ARGUMENT;
+    }
+
+    StepGame(*env, game, action, out);
+    return FB_OK;
+}
+
+int32_t fb_step_batch(fb_env* env, const uint8_t* actions, const fb_buffers* out)
+{
+    if (env == NULL || actions == NULL)
+    {
+        return FB_ERROR_ARGUMENT;
+    }
+
+    // checked up front so a bad action leaves every game as it was
+    for (size_t game = 0; game < env->cores.size(); game++)
+    {
+        if (actions[game] >= FB_ACTION_COUNT)
+        {
+            return FB_ERROR_ARGUMENT;
+        }
+    }
+
+    for (size_t game = 0; game < env->cores.size(); game++)
+    {
+        StepGame(*env, game, actions[game], out);
+    }
+
+    return FB_OK;
+}
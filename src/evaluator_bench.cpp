@@ -0,0 +1,271 @@
+#include "evaluator_bench.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include "debug.hpp"
+#include "game_core.hpp"
+#include "move_generator.hpp"
+#include "utility.hpp"
+
+typedef std::chrono::steady_clock Clock;
+typedef std::array<RowMask, COORD_LIMIT_Y> BoardRows;
+
+static bool Filled(const BoardRows& rows, int x, int y)
+{
+    if (x < 0 || x >= COORD_LIMIT_X || y >= COORD_LIMIT_Y)
+    {
+        return true;
+    }
+
+    return y >= 0 && ((rows[y] >> x) & 1) != 0;
+}
+
+/*The features counted the obvious way, one cell at a time, for checking the kernels against*/
+static void CountFeatures(const BoardRows& rows, BoardFeatures& out_features)
+{
+    BoardFeatures features = {};
+    std::array<int, COORD_LIMIT_X> heights = {};
+
+    for (int x = 0; x < COORD_LIMIT_X; x++)
+    {
+        int top = 0;
+
+        while (top < COORD_LIMIT_Y && !Filled(rows, x, top))
+        {
+            top++;
+        }
+
+        heights[x] = COORD_LIMIT_Y - top;
+        features.aggregate_height += heights[x];
+        features.max_height = std::max(features.max_height, heights[x]);
+
+        int well_depth = 0;
+
+        for (int y = 0; y < COORD_LIMIT_Y; y++)
+        {
+            bool filled = Filled(rows, x, y);
+            features.holes += y > top && !filled;
+            features.column_transitions += filled != Filled(rows, x, y - 1);
+
+            if (!filled && Filled(rows, x - 1, y) && Filled(rows, x + 1, y))
+            {
+                well_depth++;
+                features.wells += well_depth;
+            }
+            else
+            {
+                well_depth = 0;
+            }
+        }
+
+        // the floor
+        features.column_transitions += !Filled(rows, x, COORD_LIMIT_Y - 1);
+
+        if (x > 0)
+        {
+            features.bumpiness += std::abs(heights[x] - heights[x - 1]);
+        }
+    }
+
+    for (int y = 0; y < COORD_LIMIT_Y; y++)
+    {
+        for (int x = 0; x <= COORD_LIMIT_X; x++)
+        {
+            features.row_transitions += Filled(rows, x - 1, y) != Filled(rows, x, y);
+        }
+    }
+
+    out_features = features;
+}
+
+/*The board after dropping the piece on the placement and clearing lines*/
+static Board PlaceOnCopy(const Board& board, const Piece& falling_piece, const Placement& placement,
+    const RotationSystem& rotation_system, int& out_lines)
+{
+    Board result = board;
+    Piece piece(falling_piece.m_type, placement.rotation, {placement.x, placement.y}, rotation_system);
+
+    for (const Square& square : piece.GetSquares())
+    {
+        result.Place(square);
+    }
+
+    out_lines = result.ClearCompletedRows();
+    return result;
+}
+
+/*Plays games that always take the best scoring placement, keeping every board it weighed*/
+static void CollectBoards(const EvaluatorBenchOptions& options, EvaluatorBenchReport& out_report, std::vector<BoardRows>& out_boards)
+{
+    Rng rng(options.seed != 0 ? options.seed : RandomSeed());
+    MoveGenerator generator;
+    std::vector<PlacementList> lists(1);   // too big for the stack
+    PlacementList& list = lists[0];
+
+    for (size_t game = 0; game < options.games; game++)
+    {
+        GameSettings settings;
+        settings.seed = rng.Next() | 1;
+        GameCore core(settings);
+        GameEvent event;
+
+        while (core.m_game_running && core.m_pieces_placed < options.pieces_per_game &&
+            generator.Generate(core.m_board, core.m_falling_piece, list) > 0)
+        {
+            size_t best = 0;
+            float best_score = 0;
+
+            for (size_t i = 0; i < list.count; i++)
+            {
+                int lines;
+                Board board = PlaceOnCopy(core.m_board, core.m_falling_piece, list.placements[i], *core.m_rotation_system, lines);
+                out_boards.push_back(board.m_rows);
+
+                BoardFeatures features;
+                EvaluateBoard(board.m_rows, features);
+                float score = ScoreFeatures(features, EVALUATOR_BALANCED);
+
+                if (i == 0 || score > best_score)
+                {
+                    best = i;
+                    best_score = score;
+                }
+            }
+
+            const Placement& pick = list.placements[best];
+            core.m_falling_piece = Piece(core.m_falling_piece.m_type, pick.rotation, {pick.x, pick.y}, *core.m_rotation_system);
+            core.ApplyInput(INPUT_HARD_DROP);
+
+            while (core.PollEvent(event))
+            {
+                out_report.lines += event.type == EVENT_LINES_CLEARED ? (size_t)event.value : 0;
+            }
+        }
+
+        out_report.games++;
+        out_report.pieces += core.m_pieces_placed;
+    }
+}
+
+static double NanosecondsPerBoard(Clock::time_point start, size_t boards)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / boards;
+}
+
+/*Adds up every feature, cheap enough to leave in the timed loops and it keeps their results in use*/
+static uint64_t SumFeatures(const BoardFeatures& features)
+{
+    return (uint64_t)(int64_t)(features.aggregate_height + features.max_height + features.holes + features.bumpiness +
+        features.row_transitions + features.column_transitions + features.wells);
+}
+
+bool RunEvaluatorBench(const EvaluatorBenchOptions& options, EvaluatorBenchReport& out_report)
+{
+    std::vector<BoardRows> boards;
+    CollectBoards(options, out_report, boards);
+
+    if (boards.empty())
+    {
+        ERROR_PRINT("ERROR: evaluator bench collected no boards");
+        return false;
+    }
+
+    out_report.boards = boards.size();
+    out_report.best_kernel = BestEvaluatorKernel();
+
+    std::vector<BoardBatch> batches((boards.size() + EVALUATOR_BATCH_SIZE - 1) / EVALUATOR_BATCH_SIZE);
+
+    for (size_t i = 0; i < boards.size(); i++)
+    {
+        batches[i / EVALUATOR_BATCH_SIZE].Add(boards[i]);
+    }
+
+    // check
+    std::vector<BoardFeatures> expected(boards.size());
+    std::vector<bool> wrong(boards.size(), false);
+    BoardFeatures features;
+
+    for (size_t i = 0; i < boards.size(); i++)
+    {
+        CountFeatures(boards[i], expected[i]);
+        EvaluateBoard(boards[i], features);
+        wrong[i] = !(features == expected[i]);
+    }
+
+    std::array<BoardFeatures, EVALUATOR_BATCH_SIZE> batch_features;
+
+    for (int kernel = 0; kernel <= out_report.best_kernel; kernel++)
+    {
+        for (size_t b = 0; b < batches.size(); b++)
+        {
+            EvaluateBatch(batches[b], (EVALUATOR_KERNEL)kernel, batch_features);
+
+            for (size_t i = 0; i < batches[b].count; i++)
+            {
+                size_t index = b * EVALUATOR_BATCH_SIZE + i;
+                wrong[index] = wrong[index] || !(batch_features[i] == expected[index]);
+            }
+        }
+    }
+
+    out_report.mismatches = (size_t)std::count(wrong.begin(), wrong.end(), true);
+
+    // time, summing the features of every board so nothing is optimised away. Every pass goes over
+    // the same boards, so any pass whose sum differs from the cell by cell one got something wrong
+    size_t repeats = std::max(options.repeats, (size_t)1);
+    size_t total = boards.size() * repeats;
+    uint64_t checksum = 0;
+
+    Clock::time_point start = Clock::now();
+
+    for (size_t r = 0; r < repeats; r++)
+    {
+        for (const BoardRows& rows : boards)
+        {
+            CountFeatures(rows, features);
+            checksum += SumFeatures(features);
+        }
+    }
+
+    out_report.reference_ns_per_board = NanosecondsPerBoard(start, total);
+    out_report.checksum = checksum;
+    checksum = 0;
+    start = Clock::now();
+
+    for (size_t r = 0; r < repeats; r++)
+    {
+        for (const BoardRows& rows : boards)
+        {
+            EvaluateBoard(rows, features);
+            checksum += SumFeatures(features);
+        }
+    }
+
+    out_report.single_ns_per_board = NanosecondsPerBoard(start, total);
+    out_report.checksum_mismatches += checksum != out_report.checksum;
+
+    for (int kernel = 0; kernel <= out_report.best_kernel; kernel++)
+    {
+        checksum = 0;
+        start = Clock::now();
+
+        for (size_t r = 0; r < repeats; r++)
+        {
+            for (const BoardBatch& batch : batches)
+            {
+                EvaluateBatch(batch, (EVALUATOR_KERNEL)kernel, batch_features);
+
+                for (size_t i = 0; i < batch.count; i++)
+                {
+                    checksum += SumFeatures(batch_features[i]);
+                }
+            }
+        }
+
+        out_report.batch_ns_per_board[kernel] = NanosecondsPerBoard(start, total);
+        out_report.checksum_mismatches += checksum != out_report.checksum;
+    }
+
+    return true;
+}
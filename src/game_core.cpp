@@ -0,0 +1,536 @@
+#include "game_core.hpp"
+#include "debug.hpp"
+#include "utility.hpp"
+
+GameCore::GameCore(const GameSettings& settings)
+{
+    Reset(settings);
+}
+
+/*Starts over in place with the game a GameCore constructed from settings would play*/
+void GameCore::Reset(const GameSettings& settings)
+{
+    m_rotation_system = settings.rotation_system;
+    m_seed = (settings.seed != 0) ? settings.seed : RandomSeed();
+    m_randomizer = PieceRandomizer(settings.randomizer, m_seed);
+    m_board = Board();
+    m_game_running = true;
+    m_tick = 0;
+    m_ticks_since_down_move = 0;
+    m_fall_ticks = START_FALL_TICKS;
+    m_lines_cleared = 0;
+    m_pieces_placed = 0;
+    m_LR_key_state = KEY_NONE;
+    m_ticks_since_LR_move = 0;
+    m_down_key_state = false;
+    m_event_count = 0;
+    m_event_read = 0;
+
+    NewPiece();
+}
+
+void GameCore::ApplyInput(GAME_INPUT input)
+{
+    if (!m_game_running)
+    {
+        return;
+    }
+
+    switch (input)
+    {
+    case INPUT_ROTATE:
+        Rotate();
+        break;
+
+    case INPUT_LEFT_PRESS:
+        m_LR_key_state = KEY_LEFT;
+        break;
+
+    case INPUT_LEFT_RELEASE:
+        if (m_LR_key_state == KEY_LEFT)
+            m_LR_key_state = KEY_NONE;
+        break;
+
+    case INPUT_RIGHT_PRESS:
+        m_LR_key_state = KEY_RIGHT;
+        break;
+
+    case INPUT_RIGHT_RELEASE:
+        if (m_LR_key_state == KEY_RIGHT)
+            m_LR_key_state = KEY_NONE;
+        break;
+
+    case INPUT_DOWN_PRESS:
+        m_down_key_state = true;
+        break;
+
+    case INPUT_DOWN_RELEASE:
+        m_down_key_state = false;
+        break;
+
+    case INPUT_SPEED_UP:
+        ChangeSpeed(SpeedChange::UP);
+        break;
+
+    case INPUT_SPEED_DOWN:
+        ChangeSpeed(SpeedChange::DOWN);
+        break;
+
+    case INPUT_HARD_DROP:
+        HardDrop();
+        break;
+
+    case INPUT_LENGTH:
+        break;
+    }
+}
+
+/*Advances the simulation by exactly one tick*/
+void GameCore::Step()
+{
+    if (!m_game_running)
+    {
+        return;
+    }
+
+    m_tick++;
+    m_ticks_since_down_move++;
+    m_ticks_since_LR_move++;
+
+    if (m_LR_key_state != KEY_NONE && m_ticks_since_LR_move > m_hold_key_move_ticks)
+    {
+        m_ticks_since_LR_move = 0;
+
+        switch (m_LR_key_state)
+        {
+        case KEY_LEFT:
+            Move(MOVEMENT_LEFT);
+            break;
+        case KEY_RIGHT:
+            Move(MOVEMENT_RIGHT);
+            break;
+        case KEY_NONE:
+            break;
+        }
+    }
+
+    bool should_auto_fall = (m_ticks_since_down_move > m_fall_ticks);
+    bool should_hold_down_fall = (m_down_key_state && m_ticks_since_down_move > m_hold_key_move_ticks);
+
+    if (should_auto_fall || should_hold_down_fall)
+    {
+        bool moved_down = Move(MOVEMENT_DOWN);
+
+        if (moved_down)
+        {
+            DEBUG_PRINT("DEBUG: move down ticks since move: " << m_ticks_since_down_move);
+            m_ticks_since_down_move = 0;
+        }
+        else if (m_ticks_since_down_move > m_fall_ticks * 3 / 2)
+        {
+            DEBUG_PRINT("DEBUG: place piece ticks since move: " << m_ticks_since_down_move);
+            LockPiece();
+        }
+    }
+}
+
+void GameCore::LockPiece()
+{
+    m_ticks_since_down_move = 0;
+
+    if (!PlacePiece())
+    {
+        m_game_running = false;
+        PushEvent(EVENT_TOP_OUT, 0);
+    }
+
+    size_t previous_lines = m_lines_cleared;
+    CheckCompletedRow();
+
+    bool crossed_10 = (m_lines_cleared / 10) > (previous_lines / 10);
+
+    DEBUG_PRINT("INFO: lines cleared: " << m_lines_cleared);
+
+    if (crossed_10)
+    {
+        ChangeSpeed(DOWN);
+    }
+}
+
+void GameCore::HardDrop()
+{
+    Coordinate drop = MOVEMENT_DOWN;
+    drop *= DropDistance(m_falling_piece);
+
+    m_falling_piece.Move(drop);
+    LockPiece();
+}
+
+int GameCore::DropDistance(const Piece& piece) const
+{
+    return m_board.DropDistance(m_rotation_system->Get(piece.m_type, piece.m_rotation_index), piece.m_origin);
+}
+
+static const uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+static const uint64_t FNV_PRIME = 0x100000001B3ULL;
+
+static void HashValue(uint64_t& hash, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+    {
+        hash ^= (uint8_t)(value >> (8 * i));
+        hash *= FNV_PRIME;
+    }
+}
+
+/*FNV-1a over everything that decides how the game continues, used to compare replays against live play*/
+uint64_t GameCore::Checksum() const
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    for (int y = 0; y < COORD_LIMIT_Y; y++)
+    {
+        HashValue(hash, m_board.m_rows[y], sizeof(RowMask));
+
+        // colors left behind in empty cells are stale, only hash the occupied ones
+        for (int x = 0; x < COORD_LIMIT_X; x++)
+        {
+            if (m_board.IsOccupied({x, y}))
+            {
+                HashValue(hash, m_board.m_colors[y][x], 1);
+            }
+        }
+    }
+
+    HashValue(hash, m_falling_piece.m_type, 1);
+    HashValue(hash, m_falling_piece.m_rotation_index, 1);
+    HashValue(hash, (uint32_t)m_falling_piece.m_origin.x, 4);
+    HashValue(hash, (uint32_t)m_falling_piece.m_origin.y, 4);
+    HashValue(hash, m_tick, 4);
+    HashValue(hash, m_fall_ticks, 4);
+    HashValue(hash, m_lines_cleared, 8);
+    HashValue(hash, m_pieces_placed, 8);
+    HashValue(hash, m_game_running, 1);
+
+    return hash;
+}
+
+void GameCore::SaveSnapshot(GameSnapshot& out_snapshot) const
+{
+    out_snapshot = {};
+    out_snapshot.seed = m_seed;
+    out_snapshot.rng_state = m_randomizer.m_rng.m_state;
+    out_snapshot.lines_cleared = m_lines_cleared;
+    out_snapshot.pieces_placed = m_pieces_placed;
+    out_snapshot.tick = m_tick;
+    out_snapshot.ticks_since_down_move = m_ticks_since_down_move;
+    out_snapshot.fall_ticks = m_fall_ticks;
+    out_snapshot.ticks_since_LR_move = m_ticks_since_LR_move;
+    out_snapshot.rows = m_board.m_rows;
+    out_snapshot.column_tops = m_board.m_column_tops;
+    out_snapshot.colors = m_board.m_colors;
+
+    for (size_t i = 0; i < m_randomizer.m_bag.size(); i++)
+    {
+        out_snapshot.bag[i] = (uint8_t)m_randomizer.m_bag[i];
+    }
+
+    out_snapshot.bag_index = (uint8_t)m_randomizer.m_bag_index;
+    out_snapshot.randomizer = m_randomizer.m_type;
+    out_snapshot.piece_type = (uint8_t)m_falling_piece.m_type;
+    out_snapshot.piece_rotation = (uint8_t)m_falling_piece.m_rotation_index;
+    out_snapshot.piece_x = (int8_t)m_falling_piece.m_origin.x;
+    out_snapshot.piece_y = (int8_t)m_falling_piece.m_origin.y;
+    out_snapshot.LR_key_state = (uint8_t)m_LR_key_state;
+    out_snapshot.down_key_state = m_down_key_state;
+    out_snapshot.game_running = m_game_running;
+}
+
+/*Whether snapshot is a state the game could have reached. Replays and saves come from disk, so
+everything used as an index or to bound a loop is checked before any of it is loaded*/
+bool SnapshotValid(const GameSnapshot& snapshot, const RotationSystem& rotation_system)
+{
+    if (snapshot.randomizer > RANDOMIZER_BAG7 || snapshot.bag_index > PIECE_TYPE::LENGTH ||
+        snapshot.piece_type >= PIECE_TYPE::LENGTH || snapshot.LR_key_state > GameCore::KEY_RIGHT ||
+        snapshot.down_key_state > 1 || snapshot.game_running > 1)
+    {
+        return false;
+    }
+
+    // slower than anyone plays, and a piece that never falls would keep a replay stepping for billions of ticks
+    if (snapshot.fall_ticks <= 0 || snapshot.fall_ticks > MAX_FALL_TICKS)
+    {
+        return false;
+    }
+
+    // only the pieces still to be dealt from a 7 bag are ever read
+    for (size_t i = snapshot.bag_index; i < snapshot.bag.size() && snapshot.randomizer == RANDOMIZER_BAG7; i++)
+    {
+        if (snapshot.bag[i] >= PIECE_TYPE::LENGTH)
+        {
+            return false;
+        }
+    }
+
+    Board board;
+    board.m_rows = snapshot.rows;
+
+    for (int y = 0; y < COORD_LIMIT_Y; y++)
+    {
+        if ((snapshot.rows[y] & ~FULL_ROW_MASK) != 0)
+        {
+            return false;
+        }
+
+        for (int x = 0; x < COORD_LIMIT_X; x++)
+        {
+            if (snapshot.colors[y][x] >= BLOCK_COLOR_LENGTH)
+            {
+                return false;
+            }
+
+            // column tops have to be the highest filled cell, DropDistance trusts them
+            if ((snapshot.rows[y] & (1 << x)) != 0 && board.m_column_tops[x] == COORD_LIMIT_Y)
+            {
+                board.m_column_tops[x] = (int8_t)y;
+            }
+        }
+    }
+
+    if (board.m_column_tops != snapshot.column_tops)
+    {
+        return false;
+    }
+
+    PIECE_TYPE type = (PIECE_TYPE)snapshot.piece_type;
+
+    if (snapshot.piece_rotation >= rotation_system.num_rotations[type])
+    {
+        return false;
+    }
+
+    // inside the board and clear of the stack while the game runs. AddGarbage can push the piece
+    // of a finished game up past the top
+    const PieceRotation& rotation = rotation_system.Get(type, snapshot.piece_rotation);
+    Coordinate origin = {snapshot.piece_x, snapshot.piece_y};
+
+    if (origin.x + rotation.min.x < 0 || origin.x + rotation.max.x >= COORD_LIMIT_X ||
+        origin.y + rotation.max.y >= COORD_LIMIT_Y)
+    {
+        return false;
+    }
+
+    return snapshot.game_running == 0 || !board.Collides(rotation, origin);
+}
+
+/*Replaces the whole game state, pending events are dropped. A snapshot that fails SnapshotValid
+is refused and leaves the game as it was*/
+bool GameCore::LoadSnapshot(const GameSnapshot& snapshot)
+{
+    if (!SnapshotValid(snapshot, *m_rotation_system))
+    {
+        ERROR_PRINT("ERROR: snapshot is corrupt, not loaded");
+        return false;
+    }
+
+    m_seed = snapshot.seed;
+    m_randomizer.m_type = (RANDOMIZER_TYPE)snapshot.randomizer;
+    m_randomizer.m_rng.m_state = snapshot.rng_state;
+
+    for (size_t i = 0; i < m_randomizer.m_bag.size(); i++)
+    {
+        m_randomizer.m_bag[i] = (PIECE_TYPE)snapshot.bag[i];
+    }
+
+    m_randomizer.m_bag_index = snapshot.bag_index;
+    m_lines_cleared = (size_t)snapshot.lines_cleared;
+    m_pieces_placed = (size_t)snapshot.pieces_placed;
+    m_tick = snapshot.tick;
+    m_ticks_since_down_move = snapshot.ticks_since_down_move;
+    m_fall_ticks = snapshot.fall_ticks;
+    m_ticks_since_LR_move = snapshot.ticks_since_LR_move;
+    m_board.m_rows = snapshot.rows;
+    m_board.m_column_tops = snapshot.column_tops;
+    m_board.m_colors = snapshot.colors;
+    m_falling_piece = Piece((PIECE_TYPE)snapshot.piece_type, snapshot.piece_rotation,
+        {snapshot.piece_x, snapshot.piece_y}, *m_rotation_system);
+    m_LR_key_state = (LR_Key_State)snapshot.LR_key_state;
+    m_down_key_state = snapshot.down_key_state != 0;
+    m_game_running = snapshot.game_running != 0;
+
+    m_event_count = 0;
+    m_event_read = 0;
+    return true;
+}
+
+/*Raises the stack by rows of garbage with a hole at hole_x. The falling piece is pushed up with
+it, the game is over when there is no room left for it*/
+void GameCore::AddGarbage(int rows, int hole_x)
+{
+    if (!m_game_running || rows <= 0)
+    {
+        return;
+    }
+
+    bool fits = m_board.AddGarbage(rows, hole_x, GARBAGE_COLOR);
+
+    for (int i = 0; i < rows && !CanMove(MOVEMENT_NULL, m_falling_piece); i++)
+    {
+        m_falling_piece.Move(MOVEMENT_UP);
+    }
+
+    if (!fits || !CanMove(MOVEMENT_NULL, m_falling_piece))
+    {
+        m_game_running = false;
+        PushEvent(EVENT_TOP_OUT, 0);
+    }
+}
+
+/*Pops the oldest pending event, in the same spirit as SDL_PollEvent*/
+bool GameCore::PollEvent(GameEvent& out_event)
+{
+    if (m_event_read >= m_event_count)
+    {
+        m_event_read = 0;
+        m_event_count = 0;
+        return false;
+    }
+
+    out_event = m_events[m_event_read];
+    m_event_read++;
+    return true;
+}
+
+void GameCore::PushEvent(GAME_EVENT_TYPE type, int value, uint32_t rows)
+{
+    if (m_event_count >= m_events.size())
+    {
+        DEBUG_PRINT("WARN: GameCore event queue full, dropping event " << type);
+        return;
+    }
+
+    m_events[m_event_count] = {type, value, rows};
+    m_event_count++;
+}
+
+void GameCore::ChangeSpeed(SpeedChange dir)
+{
+    if (dir == UP)
+    {
+        m_fall_ticks += m_fall_ticks_step;
+        DEBUG_PRINT("DEBUG: increased fall ticks to " << m_fall_ticks);
+    }
+    else if (dir == DOWN)
+    {
+        m_fall_ticks -= m_fall_ticks_step;
+
+        if (m_fall_ticks <= m_fall_ticks_minimum)
+        {
+            m_fall_ticks = m_fall_ticks_minimum;
+        }
+        DEBUG_PRINT("DEBUG: decreased fall ticks to " << m_fall_ticks);
+    }
+}
+
+void GameCore::CheckCompletedRow()
+{
+    uint32_t cleared_rows;
+    int rows_lowered = m_board.ClearCompletedRows(&cleared_rows);
+
+    m_lines_cleared += rows_lowered;
+
+    if (rows_lowered > 0)
+    {
+        PushEvent(EVENT_LINES_CLEARED, rows_lowered, cleared_rows);
+    }
+}
+
+bool GameCore::Move(const Coordinate& movement)
+{
+    if (CanMove(movement, m_falling_piece))
+    {
+        m_falling_piece.Move(movement);
+        return true;
+    }
+    return false;
+}
+
+bool GameCore::CanMove(const Coordinate& movement, const Piece& piece) const
+{
+    Coordinate origin = piece.m_origin;
+    origin += movement;
+
+    return !m_board.Collides(m_rotation_system->Get(piece.m_type, piece.m_rotation_index), origin);
+}
+
+void GameCore::Rotate()
+{
+    Piece new_piece = m_falling_piece;
+    new_piece.Rotate(m_coord_limits, *m_rotation_system);
+
+    for (size_t i = 0; i < m_rotation_system->num_kicks; i++)
+    {
+        const Coordinate& kick = m_rotation_system->kicks[i];
+
+        if (CanMove(kick, new_piece))
+        {
+            new_piece.Move(kick);
+            m_falling_piece = new_piece;
+            return;
+        }
+    }
+}
+
+bool GameCore::PlacePiece()
+{
+    for (const Square& sq : m_falling_piece.GetSquares())
+    {
+        m_board.Place(sq);
+    }
+
+    m_pieces_placed++;
+    PushEvent(EVENT_PIECE_LOCKED, 0);
+
+    return NewPiece();
+}
+
+bool GameCore::NewPiece()
+{
+    PIECE_TYPE new_piece = m_randomizer.Next();
+
+    m_falling_piece = Piece(new_piece, COORD_LIMIT_X, *m_rotation_system);
+
+    // test if the player is blocked out
+    return CanMove(MOVEMENT_NULL, m_falling_piece);
+}
+
+/*One step of one game for bots, the way BatchEnvironment and the engine library step every game:
+the action (a move checked with CanMove, INPUT_ROTATE or INPUT_HARD_DROP), then unless it was a
+hard drop one row down, or INPUT_HARD_DROP where the piece can go no further*/
+void StepGameCore(GameCore& core, uint8_t action)
+{
+    Piece& piece = core.m_falling_piece;
+
+    if (action == ACTION_LEFT || action == ACTION_RIGHT)
+    {
+        const Coordinate& movement = action == ACTION_LEFT ? MOVEMENT_LEFT : MOVEMENT_RIGHT;
+
+        if (core.CanMove(movement, piece))
+        {
+            piece.Move(movement);
+        }
+    }
+    else if (action == ACTION_ROTATE)
+    {
+        core.ApplyInput(INPUT_ROTATE);
+    }
+
+    if (action == ACTION_HARD_DROP || !core.CanMove(MOVEMENT_DOWN, piece))
+    {
+        core.ApplyInput(INPUT_HARD_DROP);
+    }
+    else
+    {
+        piece.Move(MOVEMENT_DOWN);
+    }
+}
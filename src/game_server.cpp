@@ -0,0 +1,384 @@
+#include "game_server.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "replay.hpp"
+#include "debug.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static double MillisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+GameServer::GameServer(size_t max_sessions, size_t thread_count)
+    : m_sessions(max_sessions), m_pool(thread_count)
+{
+    m_free_sessions.reserve(max_sessions);
+
+    for (size_t i = max_sessions; i > 0; i--)
+    {
+        m_free_sessions.push_back((uint32_t)(i - 1));
+    }
+}
+
+bool GameServer::Listen(uint16_t port)
+{
+    return m_listener.Listen(port);
+}
+
+uint16_t GameServer::Port() const
+{
+    return m_listener.LocalPort();
+}
+
+/*Takes in every message that arrived, steps every session one tick and sends what happened*/
+void GameServer::Tick(ServerTickTiming& out_timing)
+{
+    Clock::time_point start = Clock::now();
+
+    AcceptConnections();
+    ReceiveMessages();
+
+    Clock::time_point step_start = Clock::now();
+    out_timing.receive_ms = std::chrono::duration<double, std::milli>(step_start - start).count();
+
+    m_step_nanoseconds = 0;
+
+    for (size_t first = 0; first < m_session_end; first += SERVER_BATCH_SIZE)
+    {
+        size_t last = std::min(first + SERVER_BATCH_SIZE, m_session_end);
+        m_pool.Submit([this, first, last] { StepBatch(first, last); });
+    }
+
+    m_pool.Wait();
+
+    Clock::time_point send_start = Clock::now();
+    out_timing.step_ms = std::chrono::duration<double, std::milli>(send_start - step_start).count();
+    out_timing.step_cpu_ms = m_step_nanoseconds.load() / 1e6;
+
+    SendEvents();
+
+    out_timing.send_ms = MillisecondsSince(send_start);
+    out_timing.total_ms = MillisecondsSince(start);
+}
+
+size_t GameServer::SessionCount() const
+{
+    return m_session_count;
+}
+
+size_t GameServer::ThreadCount() const
+{
+    return m_pool.ThreadCount();
+}
+
+/*Bytes held for sessions and connections, not counting the thread stacks*/
+size_t GameServer::MemoryUsage() const
+{
+    size_t bytes = m_sessions.capacity() * sizeof(ServerSession) + m_free_sessions.capacity() * sizeof(uint32_t) +
+        m_connections.capacity() * sizeof(Connection);
+
+    for (const Connection& connection : m_connections)
+    {
+        bytes += connection.receive_buffer.capacity() + connection.send_buffer.capacity() +
+            connection.send_queue.Capacity();
+    }
+
+    return bytes;
+}
+
+/*Takes every client waiting to connect and greets it with the header*/
+void GameServer::AcceptConnections()
+{
+    NetSocket socket;
+
+    while (m_listener.Accept(socket, false))
+    {
+        uint8_t header[SERVER_HEADER_SIZE];
+        memcpy(header, SERVER_MAGIC, sizeof(SERVER_MAGIC));
+        header[4] = (uint8_t)(SERVER_PROTOCOL_VERSION & 0xFF);
+        header[5] = (uint8_t)(SERVER_PROTOCOL_VERSION >> 8);
+
+        auto free_slot = std::find_if(m_connections.begin(), m_connections.end(),
+            [](const Connection& connection) { return !connection.socket.IsOpen(); });
+
+        if (free_slot == m_connections.end())
+        {
+            m_connections.emplace_back();
+            free_slot = m_connections.end() - 1;
+        }
+
+        free_slot->socket = std::move(socket);
+        free_slot->receive_buffer.clear();
+        free_slot->send_buffer.clear();
+        free_slot->send_queue.Clear();
+
+        if (!free_slot->send_queue.Send(free_slot->socket, header, sizeof(header)))
+        {
+            continue;
+        }
+
+        DEBUG_PRINT("INFO: server client connected as " << free_slot - m_connections.begin());
+    }
+}
+
+void GameServer::ReceiveMessages()
+{
+    uint8_t buffer[4096];
+
+    for (uint32_t i = 0; i < m_connections.size(); i++)
+    {
+        Connection& connection = m_connections[i];
+
+        if (!connection.socket.IsOpen())
+        {
+            continue;
+        }
+
+        int bytes = 0;
+
+        while (connection.receive_buffer.size() <= SERVER_RECEIVE_LIMIT &&
+            (bytes = connection.socket.Receive(buffer, sizeof(buffer))) > 0)
+        {
+            connection.receive_buffer.insert(connection.receive_buffer.end(), buffer, buffer + bytes);
+        }
+
+        if (connection.receive_buffer.size() > SERVER_RECEIVE_LIMIT)
+        {
+            ERROR_PRINT("ERROR: server client " << i << " sent over " << SERVER_RECEIVE_LIMIT << " bytes in one tick");
+            CloseConnection(i);
+            continue;
+        }
+
+        if (bytes < 0 || !HandleMessages(i))
+        {
+            CloseConnection(i);
+        }
+    }
+}
+
+/*Applies every complete message from the connection, false if it sent something invalid*/
+bool GameServer::HandleMessages(uint32_t connection_index)
+{
+    std::vector<uint8_t>& messages = m_connections[connection_index].receive_buffer;
+    size_t position = 0;
+
+    while (position < messages.size())
+    {
+        const uint8_t* message = messages.data() + position;
+        size_t available = messages.size() - position;
+        size_t size;
+
+        switch (message[0])
+        {
+        case SERVER_OPEN:
+            size = SERVER_OPEN_SIZE;
+            break;
+        case SERVER_INPUT:
+            size = SERVER_INPUT_SIZE;
+            break;
+        case SERVER_CLOSE:
+            size = SERVER_CLOSE_SIZE;
+            break;
+        default:
+            ERROR_PRINT("ERROR: server got unknown message " << (int)message[0]);
+            return false;
+        }
+
+        if (available < size)
+        {
+            break;
+        }
+
+        position += size;
+
+        if (message[0] == SERVER_OPEN)
+        {
+            uint32_t session = OpenSession(connection_index, GetU64(message + 5));
+
+            std::vector<uint8_t>& reply = m_connections[connection_index].send_buffer;
+            reply.push_back(SERVER_OPENED);
+            reply.insert(reply.end(), message + 1, message + 5);
+            PutU32(reply, session);
+            continue;
+        }
+
+        uint32_t session = GetU32(message + 1);
+
+        if (session >= m_sessions.size() || !m_sessions[session].active ||
+            m_sessions[session].connection != connection_index)
+        {
+            ERROR_PRINT("ERROR: server client " << connection_index << " does not own session " << session);
+            return false;
+        }
+
+        if (message[0] == SERVER_CLOSE)
+        {
+            CloseSession(session);
+            continue;
+        }
+
+        TickInputs& inputs = m_sessions[session].inputs;
+
+        if (message[5] >= INPUT_LENGTH)
+        {
+            return false;
+        }
+
+        // a client pressing faster than MAX_INPUTS_PER_TICK loses the extra inputs
+        if (inputs.count < inputs.inputs.size())
+        {
+            inputs.inputs[inputs.count] = message[5];
+            inputs.count++;
+        }
+    }
+
+    messages.erase(messages.begin(), messages.begin() + position);
+    return true;
+}
+
+/*Starts a new game in the lowest free slot, SERVER_NO_SESSION when every slot is taken*/
+uint32_t GameServer::OpenSession(uint32_t connection_index, uint64_t seed)
+{
+    if (m_free_sessions.empty())
+    {
+        ERROR_PRINT("ERROR: server is full, " << m_sessions.size() << " sessions");
+        return SERVER_NO_SESSION;
+    }
+
+    uint32_t index = m_free_sessions.back();
+    m_free_sessions.pop_back();
+
+    GameSettings settings;
+    settings.seed = seed;
+
+    ServerSession& session = m_sessions[index];
+    session.core.Reset(settings);
+    session.inputs.count = 0;
+    session.event_count = 0;
+    session.connection = connection_index;
+    session.active = true;
+
+    m_session_end = std::max(m_session_end, (size_t)index + 1);
+    m_session_count++;
+    return index;
+}
+
+void GameServer::CloseSession(uint32_t session_index)
+{
+    m_sessions[session_index].active = false;
+    m_session_count--;
+
+    // kept sorted so the lowest free slot is reused first
+    auto position = std::lower_bound(m_free_sessions.begin(), m_free_sessions.end(), session_index,
+        [](uint32_t a, uint32_t b) { return a > b; });
+    m_free_sessions.insert(position, session_index);
+
+    while (m_session_end > 0 && !m_sessions[m_session_end - 1].active)
+    {
+        m_session_end--;
+    }
+}
+
+/*Ends every session the connection had open*/
+void GameServer::CloseConnection(uint32_t connection_index)
+{
+    DEBUG_PRINT("INFO: server client " << connection_index << " left");
+
+    for (size_t i = 0; i < m_session_end; i++)
+    {
+        if (m_sessions[i].active && m_sessions[i].connection == connection_index)
+        {
+            CloseSession((uint32_t)i);
+        }
+    }
+
+    m_connections[connection_index].socket.Close();
+}
+
+/*Runs on a pool thread, touches nothing outside its own sessions*/
+void GameServer::StepBatch(size_t first, size_t last)
+{
+    Clock::time_point start = Clock::now();
+
+    for (size_t i = first; i < last; i++)
+    {
+        ServerSession& session = m_sessions[i];
+
+        if (!session.active)
+        {
+            continue;
+        }
+
+        for (uint8_t j = 0; j < session.inputs.count; j++)
+        {
+            session.core.ApplyInput((GAME_INPUT)session.inputs.inputs[j]);
+        }
+
+        session.inputs.count = 0;
+        session.core.Step();
+
+        GameEvent event;
+        session.event_count = 0;
+
+        while (session.core.PollEvent(event))
+        {
+            if (session.event_count < session.events.size())
+            {
+                session.events[session.event_count] = event;
+                session.event_count++;
+            }
+        }
+    }
+
+    m_step_nanoseconds.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - start).count());
+}
+
+/*Queues each session's events on its connection, then sends each connection what its socket
+takes without waiting. The rest goes out on later ticks*/
+void GameServer::SendEvents()
+{
+    for (size_t i = 0; i < m_session_end; i++)
+    {
+        ServerSession& session = m_sessions[i];
+
+        if (!session.active)
+        {
+            continue;
+        }
+
+        std::vector<uint8_t>& out = m_connections[session.connection].send_buffer;
+
+        for (uint8_t j = 0; j < session.event_count; j++)
+        {
+            out.push_back(SERVER_EVENT);
+            PutU32(out, (uint32_t)i);
+            PutU32(out, session.core.m_tick);
+            out.push_back((uint8_t)session.events[j].type);
+            out.push_back((uint8_t)session.events[j].value);
+        }
+    }
+
+    for (uint32_t i = 0; i < m_connections.size(); i++)
+    {
+        Connection& connection = m_connections[i];
+
+        if (!connection.socket.IsOpen())
+        {
+            continue;
+        }
+
+        bool sent = connection.send_buffer.empty() ? connection.send_queue.Flush(connection.socket) :
+            connection.send_queue.Send(connection.socket, connection.send_buffer.data(), connection.send_buffer.size());
+
+        connection.send_buffer.clear();
+
+        if (!sent)
+        {
+            CloseConnection(i);
+        }
+    }
+}
@@ -1,18 +1,100 @@
 #include "game_state.hpp"
 #include "debug.hpp"
-#include "utility.hpp"
 #include "audio.hpp"
 #include <format>
 
 static const char* TEXTURE_PATH = "texture/game";
+static const Uint8 GHOST_ALPHA = 0x50;
 
-InGameState::InGameState(SDL_Window* window, SDL_Renderer* renderer)
+// texture file stem for each BLOCK_COLOR
+static const char* BLOCK_TEXTURE_NAMES[BLOCK_COLOR_LENGTH] =
+{
+    "yellow",
+    "cyan",
+    "orange",
+    "blue",
+    "purple",
+    "green",
+    "red"
+};
+
+/*Loads the game textures and picks out one per BLOCK_COLOR, exits if any is missing*/
+void LoadBlockTextures(SDL_Renderer* renderer, std::unordered_map<std::string, SDL_Texture*>& texture_data,
+    BlockTextures& out_textures)
+{
+    LoadTextures(renderer, TEXTURE_PATH, texture_data);
+
+    for (size_t i = 0; i < BLOCK_COLOR_LENGTH; i++)
+    {
+        auto texture = texture_data.find(BLOCK_TEXTURE_NAMES[i]);
+
+        if (texture == texture_data.end())
+        {
+            ERROR_PRINT("ERROR: missing block texture " << BLOCK_TEXTURE_NAMES[i]);
+            exit(-1);
+        }
+
+        out_textures[i] = texture->second;
+        SDL_SetTextureBlendMode(out_textures[i], SDL_BLENDMODE_BLEND);
+    }
+}
+
+/*Draws the ghost, the falling piece shifted by offset and the stack into the current viewport*/
+void RenderBoard(SDL_Renderer* renderer, const GameCore& core, const BlockTextures& textures, int cube_size,
+    int offset_x, int offset_y)
+{
+    SDL_Rect cube = {0,0,cube_size,cube_size};
+    const Piece& piece = core.m_falling_piece;
+
+    // ghost piece where a hard drop would land
+    int ghost_offset = core.DropDistance(piece) * cube_size;
+
+    for (const Square& sq : piece.GetSquares())
+    {
+        cube.x = sq.coord.x * cube_size;
+        cube.y = sq.coord.y * cube_size + ghost_offset;
+
+        SDL_SetTextureAlphaMod(textures[sq.color], GHOST_ALPHA);
+        SDL_RenderCopy(renderer, textures[sq.color], NULL, &cube);
+        SDL_SetTextureAlphaMod(textures[sq.color], 0xFF);
+    }
+
+    for (const Square& sq : piece.GetSquares())
+    {
+        cube.x = sq.coord.x * cube_size + offset_x;
+        cube.y = sq.coord.y * cube_size + offset_y;
+
+        SDL_RenderCopy(renderer, textures[sq.color], NULL, &cube);
+    }
+
+    for (int y = 0; y < COORD_LIMIT_Y; y++)
+    {
+        RowMask row = core.m_board.m_rows[y];
+
+        for (int x = 0; row != 0; x++, row >>= 1)
+        {
+            if ((row & 1) == 0)
+            {
+                continue;
+            }
+
+            cube.x = x * cube_size;
+            cube.y = y * cube_size;
+
+            SDL_RenderCopy(renderer, textures[core.m_board.m_colors[y][x]], NULL, &cube);
+        }
+    }
+}
+
+InGameState::InGameState(SDL_Window* window, SDL_Renderer* renderer, const GameSnapshot* resume)
+    : m_game(REPLAY_ARCHIVE_PATH, SAVE_PATH, GameSettings(), resume)
 {
     DEBUG_PRINT("InGameState created");
 
     m_window = window;
     m_renderer = renderer;
-    LoadTextures(m_renderer, TEXTURE_PATH, m_texture_data);
+
+    LoadBlockTextures(m_renderer, m_texture_data, m_block_textures);
     m_sound_effects = LoadSoundEffects();
 
     m_font = TTF_OpenFont(FONT_PATH, 50);
@@ -28,16 +110,16 @@ InGameState::InGameState(SDL_Window* window, SDL_Renderer* renderer)
 
     m_game_view.w = (int)(screen_width * 0.65);
     m_game_view.y = (int)(screen_height * .10);
-    m_cube_size = (int)(m_game_view.w / m_coord_limits.x);
-    m_game_view.w = m_cube_size * m_coord_limits.x;
-    m_game_view.h = m_cube_size * m_coord_limits.y;
+    m_cube_size = (int)(m_game_view.w / m_game.m_core.m_coord_limits.x);
+    m_game_view.w = m_cube_size * m_game.m_core.m_coord_limits.x;
+    m_game_view.h = m_cube_size * m_game.m_core.m_coord_limits.y;
 
     if ((m_game_view.y + m_game_view.h) > (screen_height - 5))
     {
         m_game_view.h = screen_height - m_game_view.y - 5;
-        m_cube_size = (int)(m_game_view.h / m_coord_limits.y);
-        m_game_view.h = m_cube_size * m_coord_limits.y; 
-        m_game_view.w = m_cube_size * m_coord_limits.x;
+        m_cube_size = (int)(m_game_view.h / m_game.m_core.m_coord_limits.y);
+        m_game_view.h = m_cube_size * m_game.m_core.m_coord_limits.y; 
+        m_game_view.w = m_cube_size * m_game.m_core.m_coord_limits.x;
     }
 
     m_game_view.x = (int)(screen_width / 2) - (int)(m_game_view.w / 2);
@@ -50,13 +132,20 @@ InGameState::InGameState(SDL_Window* window, SDL_Renderer* renderer)
         m_game_border[i].h = m_game_view.h + 2 * i + 2;
     }
     
-    m_score = Label(m_renderer, m_font, "Lines: 0", COLOR_WHITE);
+    m_score = Label(m_renderer, m_font, std::format("Lines: {}", m_game.m_core.m_lines_cleared), COLOR_WHITE);
     m_score.Reposition(5, 5, false);
 
-    NewPiece();
+    m_previous_piece = m_game.m_core.m_falling_piece;
+    m_allocation_free_frames = true;
 }
 
-STATE InGameState::HandleEvent(const SDL_Event& event)
+bool InGameState::WantsEvent(Uint32 event_type)
+{
+    return event_type == SDL_KEYDOWN || event_type == SDL_KEYUP;
+}
+
+/*Maps the movement keys to GAME_INPUTs, false for any other key and for key repeats*/
+bool TranslateKey(const SDL_Event& event, GAME_INPUT& out_input)
 {
     if (event.type == SDL_KEYDOWN && !event.key.repeat)
     {
@@ -64,31 +153,35 @@ STATE InGameState::HandleEvent(const SDL_Event& event)
         {
         case SDLK_w:
         case SDLK_UP:
-            Rotate();
-            break;
+            out_input = INPUT_ROTATE;
+            return true;
 
         case SDLK_a:
         case SDLK_LEFT:
-            m_LR_key_state = KEY_LEFT;
-            break;
+            out_input = INPUT_LEFT_PRESS;
+            return true;
 
         case SDLK_d:
         case SDLK_RIGHT:
-            m_LR_key_state = KEY_RIGHT;
-            break;
+            out_input = INPUT_RIGHT_PRESS;
+            return true;
 
         case SDLK_s:
         case SDLK_DOWN:
-            m_down_key_state = true;
-            break;
+            out_input = INPUT_DOWN_PRESS;
+            return true;
+
+        case SDLK_SPACE:
+            out_input = INPUT_HARD_DROP;
+            return true;
 
         case SDLK_F1:
-            ChangeSpeed(SpeedChange::UP);
-            break;
+            out_input = INPUT_SPEED_UP;
+            return true;
 
         case SDLK_F2:
-            ChangeSpeed(SpeedChange::DOWN);
-            break;
+            out_input = INPUT_SPEED_DOWN;
+            return true;
         }
     }
 
@@ -98,278 +191,147 @@ STATE InGameState::HandleEvent(const SDL_Event& event)
         {
         case SDLK_a:
         case SDLK_LEFT:
-            if (m_LR_key_state == KEY_LEFT)
-                m_LR_key_state = KEY_NONE;
-            break;
+            out_input = INPUT_LEFT_RELEASE;
+            return true;
 
         case SDLK_d:
         case SDLK_RIGHT:
-            if (m_LR_key_state == KEY_RIGHT)
-                m_LR_key_state = KEY_NONE;
-            break;
+            out_input = INPUT_RIGHT_RELEASE;
+            return true;
 
         case SDLK_s:
         case SDLK_DOWN:
-            m_down_key_state = false;
-            break;
+            out_input = INPUT_DOWN_RELEASE;
+            return true;
         }
     }
 
-    return STATE_UNCHANGED;
+    return false;
 }
 
-STATE InGameState::Step(double delta_time_sec)
+STATE InGameState::HandleEvent(const SDL_Event& event)
 {
-    if (!m_game_running)
-    {
-        return STATE_UNCHANGED;
-    }
-
-    m_time_since_down_move += delta_time_sec;
-    m_time_since_LR_move += delta_time_sec;
+    GAME_INPUT input;
 
-    if (m_LR_key_state != KEY_NONE && m_time_since_LR_move > m_hold_key_move_speed)
+    if (event.type == SDL_KEYDOWN && !event.key.repeat &&
+        (event.key.keysym.sym == SDLK_ESCAPE || event.key.keysym.sym == SDLK_p))
     {
-        m_time_since_LR_move = 0;
-
-        switch (m_LR_key_state)
-        {
-        case KEY_LEFT:
-            Move(MOVEMENT_LEFT);
-            break;
-        case KEY_RIGHT:
-            Move(MOVEMENT_RIGHT);
-            break;
-        }
+        SaveGame();
+        return STATE_PAUSED;
     }
 
-    bool should_auto_fall = (m_time_since_down_move > m_fall_speed);
-    bool should_hold_down_fall = (m_down_key_state && m_time_since_down_move > m_hold_key_move_speed);
-
-    if (should_auto_fall || should_hold_down_fall)
+    if (TranslateKey(event, input))
     {
-        bool moved_down = Move(MOVEMENT_DOWN);
-
-        if (moved_down)
-        {
-            DEBUG_PRINT("DEBUG: move down time since move: " << m_time_since_down_move);
-            m_time_since_down_move = 0;
-        }
-        else if (m_time_since_down_move > m_fall_speed * 1.5)
-        {
-            DEBUG_PRINT("DEBUG: place piece time since move: " << m_time_since_down_move);
-            m_time_since_down_move = 0;
-
-            if (!PlacePiece())
-            {
-                m_game_running = false;
-            }
-
-            size_t previous_lines = m_lines_cleared;
-            CheckCompletedRow();
-
-            bool crossed_10 = (m_lines_cleared / 10) > (previous_lines / 10);
-
-            DEBUG_PRINT("INFO: lines cleared: " << m_lines_cleared);
-
-            if (crossed_10)
-            {
-                ChangeSpeed(DOWN);
-            }
-        }
+        m_game.ApplyInput(input);
     }
 
     return STATE_UNCHANGED;
 }
 
-void InGameState::ChangeSpeed(SpeedChange dir)
+void InGameState::UpdateScore()
 {
-    if (dir == UP)
-    {
-        m_fall_speed += m_fall_speed_step;
-        DEBUG_PRINT("DEBUG: increased fall speed to " << m_fall_speed);
-    }
-    else if (dir == DOWN)
-    {
-        m_fall_speed -= m_fall_speed_step;
+    char text[32];
+    auto result = std::format_to_n(text, sizeof(text) - 1, "Lines: {}", m_game.m_core.m_lines_cleared);
+    *result.out = '\0';
 
-        if (m_fall_speed <= m_fall_speed_minimum)
-        {
-            m_fall_speed = m_fall_speed_minimum;
-        }
-        DEBUG_PRINT("DEBUG: decreased fall speed to " << m_fall_speed);
-    }
+    m_score.UpdateText(m_renderer, m_font, text);
 }
 
-void InGameState::CheckCompletedRow()
+STATE InGameState::Step(double delta_time_sec)
 {
-    std::array<int, COORD_LIMIT_Y> row_counts = {0};
-    
-    for (const Square& sq : m_placed_squares)
-    {
-        row_counts[sq.coord.y]++;
-    }
+    m_previous_piece = m_game.m_core.m_falling_piece;
+    m_game.Step();
 
-    std::vector<Square> remaining_squares;
+    GameEvent event;
 
-    for (const Square& sq : m_placed_squares)
+    while (m_game.m_core.PollEvent(event))
     {
-        if (row_counts[sq.coord.y] < COORD_LIMIT_X)
-        {
-            remaining_squares.push_back(sq);
-        }
+        HandleCoreEvent(event);
     }
 
-    int rows_lowered = 0;
-
-    for (int i = (int)row_counts.size() - 1; i >= 0; i--)
+    if (m_spectator != NULL)
     {
-        if (row_counts[i] >= COORD_LIMIT_X)
-        {
-            for (Square& sq : remaining_squares)
-            {
-                if (sq.coord.y < i + rows_lowered)
-                {
-                    sq.coord += MOVEMENT_DOWN;
-                }
-            }
-            rows_lowered++;
-        }
+        m_spectator->Publish(m_game.m_core, m_cleared_rows, m_spectator_resync);
     }
 
-    m_lines_cleared += rows_lowered;
-    m_placed_squares = remaining_squares;
+    m_cleared_rows = 0;
+    m_spectator_resync = false;
 
-    if (rows_lowered > 0)
-    {
-        m_score.UpdateText(m_renderer, m_font, std::format("Lines: {}", m_lines_cleared));
-    }
-
-    if (rows_lowered == 1)
-    {
-        Mix_PlayChannel(-1, m_sound_effects["smash1"], 0);
-    }
-    else if (rows_lowered > 1)
-    {
-        Mix_PlayChannel(-1, m_sound_effects["smash2"], 0);
-    }
+    return STATE_UNCHANGED;
 }
 
-bool InGameState::Move(const Coordinate& movement)
+/*Appends the current state to the save file, see RecordedGame::SaveGame*/
+void InGameState::SaveGame()
 {
-    return Move(movement, m_falling_piece);
+    m_game.SaveGame();
 }
 
-bool InGameState::Move(const Coordinate& movement, const Piece& piece)
+/*The save file is removed when this state is deleted, Continue on the title screen goes away*/
+void InGameState::DiscardSave()
 {
-    if (CanMove(movement, piece))
-    {
-        m_falling_piece.Move(movement);
-        return true;
-    }
-    return false;
+    m_game.DiscardSave();
 }
 
-bool InGameState::CanMove(const Coordinate& movement, const Piece& piece)
+void InGameState::HandleCoreEvent(const GameEvent& event)
 {
-    for (const Coordinate& coord : piece.m_coords)
+    switch (event.type)
     {
-        Coordinate new_pos = coord;
-        new_pos += movement;
-
-        if (new_pos.x < 0 || new_pos.x >= m_coord_limits.x ||
-            new_pos.y < 0 || new_pos.y >= m_coord_limits.y)
+    case EVENT_PIECE_LOCKED:
+        if (Mix_PlayChannel(-1, m_sound_effects["drop1"], 0) == -1)
         {
-            return false;
+            DEBUG_PRINT("ERROR: could not play sound 'drop1'. Mix_Error: " << Mix_GetError());
         }
+        break;
+
+    case EVENT_LINES_CLEARED:
+        UpdateScore();
+
+        // a second clear in one tick cannot be sent as one row mask
+        m_spectator_resync |= m_cleared_rows != 0;
+        m_cleared_rows = event.rows;
 
-        for (const Square& placed : m_placed_squares)
+        if (event.value == 1)
         {
-            if (placed.coord == new_pos)
-            {
-                return false;
-            }
+            Mix_PlayChannel(-1, m_sound_effects["smash1"], 0);
+        }
+        else if (event.value > 1)
+        {
+            Mix_PlayChannel(-1, m_sound_effects["smash2"], 0);
         }
+        break;
+
+    case EVENT_TOP_OUT:
+        DEBUG_PRINT("INFO: game over, lines cleared: " << m_game.m_core.m_lines_cleared);
+        break;
     }
-    return true;
 }
 
-void InGameState::Rotate()
+void InGameState::Render(double interpolation)
 {
-    Piece new_piece = m_falling_piece;
-    new_piece.Rotate(m_coord_limits);   
+    const Piece& piece = m_game.m_core.m_falling_piece;
 
-    if (CanMove(MOVEMENT_NULL, new_piece))
-    {
-        m_falling_piece = new_piece;
-    }
-    else if (CanMove(MOVEMENT_LEFT, new_piece))
-    {
-        new_piece.Move(MOVEMENT_LEFT);
-        m_falling_piece = new_piece;
-    }
-    else if (CanMove(MOVEMENT_RIGHT, new_piece))
-    {
-        new_piece.Move(MOVEMENT_RIGHT);
-        m_falling_piece = new_piece;
-    }
-    else if (CanMove(MOVEMENT_UP, new_piece))
-    {
-        new_piece.Move(MOVEMENT_UP);
-        m_falling_piece = new_piece;
-    }
-}
+    // slide the falling piece from where it was last tick, unless it was respawned or rotated
+    int offset_x = 0;
+    int offset_y = 0;
 
-bool InGameState::PlacePiece()
-{
-    for (Square sq : m_falling_piece.GetSquares())
+    if (m_previous_piece.m_type == piece.m_type && m_previous_piece.m_rotation_index == piece.m_rotation_index)
     {
-        m_placed_squares.push_back(sq);
-    }
+        int dx = m_previous_piece.m_origin.x - piece.m_origin.x;
+        int dy = m_previous_piece.m_origin.y - piece.m_origin.y;
 
-    if (Mix_PlayChannel(-1, m_sound_effects["drop1"], 0) == -1)
-    {
-        DEBUG_PRINT("ERROR: could not play sound 'drop1'. Mix_Error: " << Mix_GetError());
+        if (dx * dx + dy * dy <= 1)
+        {
+            offset_x = (int)(dx * m_cube_size * (1.0 - interpolation));
+            offset_y = (int)(dy * m_cube_size * (1.0 - interpolation));
+        }
     }
 
-    return NewPiece();
-}
-
-bool InGameState::NewPiece()
-{
-    PIECE_TYPE new_piece = (PIECE_TYPE)Random(0, PIECE_TYPE::LENGTH - 1);
-
-    m_falling_piece = Piece(new_piece, COORD_LIMIT_X);
-
-    // test if the player is blocked out
-    return CanMove(MOVEMENT_NULL, m_falling_piece);
-}
-
-void InGameState::Render()
-{
-    SDL_Rect cube = {0,0,m_cube_size,m_cube_size};
-
     SDL_RenderSetViewport(m_renderer, NULL);
     SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 0xFF);
     SDL_RenderClear(m_renderer);
 
     SDL_RenderSetViewport(m_renderer, &m_game_view);
-
-    for (const Square& sq : m_falling_piece.GetSquares())
-    {
-        cube.x = sq.coord.x * m_cube_size;
-        cube.y = sq.coord.y * m_cube_size;
-
-        SDL_RenderCopy(m_renderer, m_texture_data[sq.color], NULL, &cube);
-    }
-
-    for (const Square& sq : m_placed_squares)
-    {
-        cube.x = sq.coord.x * m_cube_size;
-        cube.y = sq.coord.y * m_cube_size;
-
-        SDL_RenderCopy(m_renderer, m_texture_data[sq.color], NULL, &cube);
-    }
+    RenderBoard(m_renderer, m_game.m_core, m_block_textures, m_cube_size, offset_x, offset_y);
 
     SDL_SetRenderDrawColor(m_renderer, 0, 33, 120, 0xFF);
     SDL_RenderSetViewport(m_renderer, NULL);
@@ -380,8 +342,6 @@ void InGameState::Render()
     }
 
     m_score.Render(m_renderer);
-
-    SDL_RenderPresent(m_renderer);
 }
 
 InGameState::~InGameState()
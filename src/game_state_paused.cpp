@@ -0,0 +1,167 @@
+#include "game_state.hpp"
+#include "debug.hpp"
+
+static const Uint8 OVERLAY_ALPHA = 0xA0;
+
+PausedState::PausedState(SDL_Window* window, SDL_Renderer* renderer, InGameState* game)
+{
+    DEBUG_PRINT("PausedState created");
+
+    m_window = window;
+    m_renderer = renderer;
+    m_game = game;
+
+    m_font = TTF_OpenFont(FONT_PATH, 50);
+
+    if (m_font == NULL)
+    {
+        std::cerr << "Could not load font from " << FONT_PATH << std::endl;
+        exit(-1);
+    }
+
+    int screen_width, screen_height;
+
+    SDL_GetRendererOutputSize(m_renderer, &screen_width, &screen_height);
+
+    m_labels["paused"] = Label(m_renderer, m_font, "Paused", COLOR_WHITE);
+    m_labels["paused"].Reposition((int)(screen_width / 2), (int)(screen_height / 4), true);
+
+    // buttons stacked below the title, in this order
+    const char* buttons[][2] =
+    {
+        {"resume", "Resume"},
+        {"save", "Save and quit"},
+        {"quit", "Quit"}
+    };
+
+    int y = (int)(screen_height / 2);
+
+    for (const auto& [name, text] : buttons)
+    {
+        m_labels[name] = Label(m_renderer, m_font, text, COLOR_WHITE, COLOR_BLACK);
+        m_labels[name].Reposition((int)(screen_width / 2), y, true);
+        m_labels[name].SetHoverColor(COLOR_BLACK, COLOR_WHITE);
+
+        y += m_labels[name].m_position.h * 2;
+    }
+}
+
+bool PausedState::WantsEvent(Uint32 event_type)
+{
+    return event_type == SDL_KEYDOWN || event_type == SDL_MOUSEMOTION || event_type == SDL_MOUSEBUTTONUP;
+}
+
+STATE PausedState::HandleEvent(const SDL_Event& event)
+{
+    SDL_Point point = {-1, -1};
+
+    if (event.type == SDL_KEYDOWN && !event.key.repeat)
+    {
+        switch (event.key.keysym.sym)
+        {
+        case SDLK_ESCAPE:
+        case SDLK_p:
+        case SDLK_RETURN:
+            return Choose("resume");
+
+        case SDLK_s:
+            return Choose("save");
+
+        case SDLK_q:
+            return Choose("quit");
+        }
+    }
+
+    else if (event.type == SDL_MOUSEMOTION)
+    {
+        point.x = event.motion.x;
+        point.y = event.motion.y;
+
+        for (auto& [name, label] : m_labels)
+        {
+            if (name == "paused")
+            {
+                continue;
+            }
+
+            if (SDL_PointInRect(&point, &label.m_position))
+            {
+                label.Hover(m_renderer, m_font);
+            }
+            else
+            {
+                label.Revert(m_renderer, m_font);
+            }
+        }
+    }
+
+    else if (event.type == SDL_MOUSEBUTTONUP && event.button.button == SDL_BUTTON_LEFT)
+    {
+        point.x = event.button.x;
+        point.y = event.button.y;
+
+        for (auto& [name, label] : m_labels)
+        {
+            if (SDL_PointInRect(&point, &label.m_position))
+            {
+                return Choose(name);
+            }
+        }
+    }
+    return STATE_UNCHANGED;
+}
+
+/*Save and quit leaves the save file for Continue on the title screen, Quit throws the game away*/
+STATE PausedState::Choose(const std::string& name)
+{
+    if (name == "resume")
+    {
+        return STATE_RESUME_GAME;
+    }
+    else if (name == "save")
+    {
+        return STATE_TITLE;
+    }
+    else if (name == "quit")
+    {
+        m_game->DiscardSave();
+        return STATE_TITLE;
+    }
+    return STATE_UNCHANGED;
+}
+
+STATE PausedState::Step(double delta_time_sec)
+{
+    return STATE_UNCHANGED;
+}
+
+void PausedState::Render(double interpolation)
+{
+    // the game is frozen, so it is drawn exactly where it stopped
+    m_game->Render(1.0);
+
+    int screen_width, screen_height;
+    SDL_GetRendererOutputSize(m_renderer, &screen_width, &screen_height);
+    SDL_Rect overlay = {0, 0, screen_width, screen_height};
+
+    SDL_RenderSetViewport(m_renderer, NULL);
+    SDL_SetRenderDrawBlendMode(m_renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(m_renderer, COLOR_BLACK.r, COLOR_BLACK.g, COLOR_BLACK.b, OVERLAY_ALPHA);
+    SDL_RenderFillRect(m_renderer, &overlay);
+    SDL_SetRenderDrawBlendMode(m_renderer, SDL_BLENDMODE_NONE);
+
+    for (auto& [name, label] : m_labels)
+    {
+        label.Render(m_renderer);
+    }
+}
+
+PausedState::~PausedState()
+{
+    for (auto& [name, label] : m_labels)
+    {
+        label.DestroyTexture();
+    }
+
+    TTF_CloseFont(m_font);
+}
@@ -38,15 +38,36 @@ TitleState::TitleState(SDL_Window* window, SDL_Renderer* renderer)
     m_labels["start"].Reposition((int)(screen_width / 2), (int)(screen_height / 2), true);
     m_labels["start"].SetHoverColor(COLOR_BLACK, COLOR_WHITE);
 
+    const char* below = "start";
+    GameSnapshot snapshot;
+
+    // a game that was saved, or never finished because the program died
+    if (LoadSaveGame(SAVE_PATH, snapshot))
+    {
+        m_labels["continue"] = Label(m_renderer, m_font, "Continue", COLOR_WHITE, COLOR_BLACK);
+        m_labels["continue"].Reposition(
+            (int)(screen_width / 2),
+            m_labels["start"].m_position.y + m_labels["start"].m_position.h * 2,
+            true
+        );
+        m_labels["continue"].SetHoverColor(COLOR_BLACK, COLOR_WHITE);
+        below = "continue";
+    }
+
     m_labels["quit"] = Label(m_renderer, m_font, "Quit", COLOR_WHITE, COLOR_BLACK);
     m_labels["quit"].Reposition(
         (int)(screen_width / 2),
-        m_labels["start"].m_position.y + m_labels["start"].m_position.h * 2,
+        m_labels[below].m_position.y + m_labels[below].m_position.h * 2,
         true
     );
     m_labels["quit"].SetHoverColor(COLOR_BLACK, COLOR_WHITE);
 }
 
+bool TitleState::WantsEvent(Uint32 event_type)
+{
+    return event_type == SDL_MOUSEMOTION || event_type == SDL_MOUSEBUTTONUP;
+}
+
 STATE TitleState::HandleEvent(const SDL_Event& event)
 {
     SDL_Point point = {-1, -1};
@@ -82,6 +103,10 @@ STATE TitleState::HandleEvent(const SDL_Event& event)
                 {
                     return STATE_NEW_GAME;
                 }
+                else if (name == "continue")
+                {
+                    return STATE_RESUME_GAME;
+                }
                 else if (name == "quit")
                 {
                     return STATE_QUIT;
@@ -101,7 +126,7 @@ STATE TitleState::Step(double delta_time_sec)
     return next_state;
 }
 
-void TitleState::Render()
+void TitleState::Render(double interpolation)
 {
     SDL_SetRenderDrawColor(m_renderer, COLOR_BLACK.r, COLOR_BLACK.g, COLOR_BLACK.b, COLOR_BLACK.a);
     SDL_RenderClear(m_renderer);
@@ -112,8 +137,6 @@ void TitleState::Render()
     {
         texture.Render(m_renderer);
     }
-
-    SDL_RenderPresent(m_renderer);
 }
 
 TitleState::~TitleState()
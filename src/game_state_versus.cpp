@@ -0,0 +1,192 @@
+#include "game_state.hpp"
+#include "debug.hpp"
+#include "audio.hpp"
+
+VersusState::VersusState(SDL_Window* window, SDL_Renderer* renderer, NetSocket&& socket,
+    const GameSettings& settings, int local_player)
+    : m_socket(std::move(socket)), m_session(settings, local_player)
+{
+    DEBUG_PRINT("VersusState created, player " << local_player);
+
+    m_window = window;
+    m_renderer = renderer;
+    LoadBlockTextures(m_renderer, m_texture_data, m_block_textures);
+    m_sound_effects = LoadSoundEffects();
+
+    m_font = TTF_OpenFont(FONT_PATH, 40);
+
+    if (m_font == NULL)
+    {
+        std::cerr << "Could not load font from " << FONT_PATH << std::endl;
+        exit(-1);
+    }
+
+    int screen_width, screen_height;
+    SDL_GetRendererOutputSize(m_renderer, &screen_width, &screen_height);
+
+    m_cube_size = (int)(screen_width * 0.45 / COORD_LIMIT_X);
+
+    if ((int)(screen_height * .10) + m_cube_size * COORD_LIMIT_Y > screen_height - 5)
+    {
+        m_cube_size = (int)(screen_height * .85 / COORD_LIMIT_Y);
+    }
+
+    for (size_t i = 0; i < m_views.size(); i++)
+    {
+        m_views[i].w = m_cube_size * COORD_LIMIT_X;
+        m_views[i].h = m_cube_size * COORD_LIMIT_Y;
+        m_views[i].x = (int)(screen_width * (2 * i + 1) / 4) - m_views[i].w / 2;
+        m_views[i].y = (int)(screen_height * .10);
+    }
+
+    m_labels["you"] = Label(m_renderer, m_font, "You", COLOR_WHITE);
+    m_labels["you"].Reposition(m_views[0].x + m_views[0].w / 2, m_views[0].y / 2, true);
+
+    m_labels["opponent"] = Label(m_renderer, m_font, "Opponent", COLOR_WHITE);
+    m_labels["opponent"].Reposition(m_views[1].x + m_views[1].w / 2, m_views[1].y / 2, true);
+
+    m_packet.reserve(VERSUS_INPUT_HEADER_SIZE + MAX_INPUTS_PER_TICK);
+}
+
+bool VersusState::WantsEvent(Uint32 event_type)
+{
+    return event_type == SDL_KEYDOWN || event_type == SDL_KEYUP;
+}
+
+STATE VersusState::HandleEvent(const SDL_Event& event)
+{
+    GAME_INPUT input;
+
+    if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE)
+    {
+        return STATE_TITLE;
+    }
+
+    if (!m_finished && TranslateKey(event, input))
+    {
+        m_session.AddLocalInput(input);
+    }
+
+    return STATE_UNCHANGED;
+}
+
+/*Feeds in whatever the opponent sent, runs one tick (rolling back first if a guess was wrong)
+and queues this tick's inputs. The result is only announced once it no longer depends on a guess,
+after that nothing is simulated and only inputs still queued go out*/
+STATE VersusState::Step(double delta_time_sec)
+{
+    // a peer that stops reading is dropped by the queue rather than waited on
+    m_send_queue.Flush(m_socket);
+
+    if (m_finished)
+    {
+        return STATE_UNCHANGED;
+    }
+
+    uint8_t buffer[1024];
+    int bytes;
+
+    while ((bytes = m_socket.Receive(buffer, sizeof(buffer))) > 0)
+    {
+        if (!m_session.Receive(buffer, (size_t)bytes))
+        {
+            m_socket.Close();
+        }
+    }
+
+    if (!m_socket.IsOpen())
+    {
+        ShowResult("Opponent left");
+        return STATE_UNCHANGED;
+    }
+
+    VersusTickEvents events;
+    m_packet.clear();
+
+    if (m_session.AdvanceFrame(m_packet, events))
+    {
+        m_send_queue.Send(m_socket, m_packet.data(), m_packet.size());
+
+        int local = m_session.m_local_player;
+
+        if (events.lines_cleared[local] > 1)
+        {
+            Mix_PlayChannel(-1, m_sound_effects["smash2"], 0);
+        }
+        else if (events.lines_cleared[local] == 1)
+        {
+            Mix_PlayChannel(-1, m_sound_effects["smash1"], 0);
+        }
+        else if (events.pieces_locked[local] > 0)
+        {
+            Mix_PlayChannel(-1, m_sound_effects["drop1"], 0);
+        }
+    }
+
+    if (m_session.IsConfirmed() && m_session.m_core.IsOver())
+    {
+        int winner = m_session.m_core.Winner();
+        ShowResult(winner < 0 ? "Draw" : (winner == m_session.m_local_player ? "You win" : "You lose"));
+    }
+
+    return STATE_UNCHANGED;
+}
+
+void VersusState::ShowResult(const char* text)
+{
+    if (m_finished)
+    {
+        return;
+    }
+
+    DEBUG_PRINT("INFO: versus over at tick " << m_session.Tick() << ": " << text);
+    m_finished = true;
+
+    int screen_width, screen_height;
+    SDL_GetRendererOutputSize(m_renderer, &screen_width, &screen_height);
+
+    m_labels["result"] = Label(m_renderer, m_font, text, COLOR_WHITE, COLOR_BLACK);
+    m_labels["result"].Reposition((int)(screen_width / 2), (int)(screen_height / 2), true);
+}
+
+void VersusState::Render(double interpolation)
+{
+    SDL_RenderSetViewport(m_renderer, NULL);
+    SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 0xFF);
+    SDL_RenderClear(m_renderer);
+
+    int local = m_session.m_local_player;
+
+    for (size_t i = 0; i < m_views.size(); i++)
+    {
+        const GameCore& core = m_session.m_core.m_players[i == 0 ? local : 1 - local];
+
+        SDL_RenderSetViewport(m_renderer, &m_views[i]);
+        RenderBoard(m_renderer, core, m_block_textures, m_cube_size, 0, 0);
+    }
+
+    SDL_RenderSetViewport(m_renderer, NULL);
+    SDL_SetRenderDrawColor(m_renderer, 0, 33, 120, 0xFF);
+
+    for (const SDL_Rect& view : m_views)
+    {
+        SDL_Rect border = {view.x - 1, view.y - 1, view.w + 2, view.h + 2};
+        SDL_RenderDrawRect(m_renderer, &border);
+    }
+
+    for (auto& [name, label] : m_labels)
+    {
+        label.Render(m_renderer);
+    }
+}
+
+VersusState::~VersusState()
+{
+    for (auto& [name, label] : m_labels)
+    {
+        label.DestroyTexture();
+    }
+
+    DestroyTextures(m_texture_data);
+    TTF_CloseFont(m_font);
+}
@@ -0,0 +1,105 @@
+#include "latency_probe.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <string>
+#include "utility.hpp"
+
+static const char* STAGE_NAMES[LATENCY_STAGE_LENGTH] =
+{
+    "injected",
+    "received",
+    "applied",
+    "render submitted",
+    "presented"
+};
+
+LatencyProbe::LatencyProbe(size_t sample_target, uint64_t counter_frequency)
+{
+    m_sample_target = sample_target;
+    m_counter_frequency = counter_frequency;
+    m_samples.reserve(sample_target);
+}
+
+bool LatencyProbe::InFlight() const
+{
+    return m_next_stage < LATENCY_STAGE_LENGTH;
+}
+
+bool LatencyProbe::Done() const
+{
+    return m_samples.size() >= m_sample_target;
+}
+
+void LatencyProbe::Begin(uint64_t counter)
+{
+    m_current = {};
+    m_current[LATENCY_INJECTED] = counter;
+    m_next_stage = LATENCY_RECEIVED;
+}
+
+/*Stages have to arrive in order, a mark for any other stage is ignored*/
+void LatencyProbe::Mark(LATENCY_STAGE stage, uint64_t counter)
+{
+    if (stage != m_next_stage)
+    {
+        return;
+    }
+
+    m_current[stage] = counter;
+    m_next_stage++;
+
+    if (m_next_stage == LATENCY_STAGE_LENGTH)
+    {
+        m_samples.push_back(m_current);
+    }
+}
+
+void LatencyProbe::PrintReport(std::ostream& out) const
+{
+    if (m_samples.empty())
+    {
+        out << "no latency samples recorded" << std::endl;
+        return;
+    }
+
+    std::vector<double> ms(m_samples.size());
+
+    out << "latency from injection, " << m_samples.size() << " samples (ms)" << std::endl;
+    out << std::left << std::setw(20) << "stage" << std::right
+        << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+    out << std::fixed << std::setprecision(3);
+
+    for (int stage = LATENCY_RECEIVED; stage < LATENCY_STAGE_LENGTH; stage++)
+    {
+        for (size_t i = 0; i < m_samples.size(); i++)
+        {
+            ms[i] = (double)(m_samples[i][stage] - m_samples[i][LATENCY_INJECTED]) * 1000 / m_counter_frequency;
+        }
+
+        double p50 = Percentile(ms, 0.50);
+        double p99 = Percentile(ms, 0.99);
+        std::sort(ms.begin(), ms.end());
+
+        out << std::left << std::setw(20) << STAGE_NAMES[stage] << std::right
+            << std::setw(10) << p50 << std::setw(10) << p99 << std::setw(10) << ms.back() << std::endl;
+    }
+
+    // ms still holds the sorted end to end latencies
+    const int bucket_count = 10;
+    double bucket_width = (ms.back() > 0 ? ms.back() : 1) / bucket_count;
+    std::array<size_t, bucket_count> buckets = {0};
+
+    for (double value : ms)
+    {
+        int bucket = std::min(bucket_count - 1, (int)(value / bucket_width));
+        buckets[bucket]++;
+    }
+
+    out << "end to end histogram" << std::endl;
+
+    for (int i = 0; i < bucket_count; i++)
+    {
+        out << std::setw(8) << bucket_width * i << " - " << std::setw(8) << bucket_width * (i + 1) << " | "
+            << std::string(buckets[i] * 50 / ms.size(), '#') << " " << buckets[i] << std::endl;
+    }
+}
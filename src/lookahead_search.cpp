@@ -0,0 +1,437 @@
+#include "lookahead_search.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+// 16 bytes a slot, 16 MB
+static const size_t TABLE_SIZE_LOG2 = 20;
+
+/*splitmix64's finaliser, spreads every input bit over the whole word*/
+static uint64_t Mix(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t RowHash(int y, RowMask row)
+{
+    return Mix(((uint64_t)(y + 1) << 16 | row) * 0x9E3779B97F4A7C15ULL);
+}
+
+/*XOR of every row's hash, so changing one row only changes its own term*/
+static uint64_t BoardHash(const Board& board)
+{
+    uint64_t hash = 0;
+
+    for (int y = 0; y < COORD_LIMIT_Y; y++)
+    {
+        hash ^= RowHash(y, board.m_rows[y]);
+    }
+
+    return hash;
+}
+
+/*Locks the piece into the board and clears lines, updating the hash for the rows it filled. Rows
+only move when lines clear and then the whole board is hashed again*/
+static void PlacePiece(Board& board, uint64_t& hash, const Piece& piece)
+{
+    for (const Square& square : piece.GetSquares())
+    {
+        int y = square.coord.y;
+        hash ^= RowHash(y, board.m_rows[y]);
+        board.Place(square);
+        hash ^= RowHash(y, board.m_rows[y]);
+    }
+
+    if (board.ClearCompletedRows() > 0)
+    {
+        hash = BoardHash(board);
+    }
+}
+
+TranspositionTable::TranspositionTable(size_t size_log2)
+{
+    m_slots = std::make_unique<Slot[]>((size_t)1 << size_log2);
+    m_mask = ((size_t)1 << size_log2) - 1;
+}
+
+bool TranspositionTable::Probe(uint64_t key, float& out_value) const
+{
+    const Slot& slot = m_slots[key & m_mask];
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+
+    if ((slot.check.load(std::memory_order_relaxed) ^ data) != key)
+    {
+        return false;
+    }
+
+    uint32_t bits = (uint32_t)data;
+    std::memcpy(&out_value, &bits, sizeof(out_value));
+    return true;
+}
+
+void TranspositionTable::Store(uint64_t key, float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    // the high half is never read, it only has to differ between values that share a key
+    uint64_t data = (uint64_t)bits | (key & 0xFFFFFFFF00000000ULL);
+
+    Slot& slot = m_slots[key & m_mask];
+    slot.data.store(data, std::memory_order_relaxed);
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::Clear()
+{
+    for (size_t i = 0; i <= m_mask; i++)
+    {
+        m_slots[i].check.store(0, std::memory_order_relaxed);
+        m_slots[i].data.store(0, std::memory_order_relaxed);
+    }
+}
+
+LookaheadSearch::Scratch::Scratch(const RotationSystem* rotation_system)
+    : generator(rotation_system)
+{
+}
+
+LookaheadSearch::LookaheadSearch(size_t thread_count, const RotationSystem* rotation_system)
+    : m_rotation_system(rotation_system), m_pool(thread_count), m_table(TABLE_SIZE_LOG2)
+{
+    m_kernel = BestEvaluatorKernel();
+    m_weights = EVALUATOR_BALANCED;
+}
+
+void LookaheadSearch::ClearTable()
+{
+    m_table.Clear();
+}
+
+size_t LookaheadSearch::ThreadCount() const
+{
+    return m_pool.ThreadCount();
+}
+
+/*Searches one more piece deep each time until max_depth or the budget runs out, false when the
+falling piece has nowhere to go. The first depth is always finished so there is an answer*/
+bool LookaheadSearch::Search(const Board& board, const Piece& falling_piece, const PieceOutlook& outlook,
+    const SearchOptions& options, SearchResult& out_result)
+{
+    Clock::time_point start = Clock::now();
+    out_result = SearchResult();
+
+    m_outlook = outlook;
+    m_outlook.bag = outlook.bag != 0 ? outlook.bag : ALL_PIECES_MASK;
+    m_has_deadline = options.budget_ms > 0;
+    m_deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(options.budget_ms));
+    m_stop.store(false);
+
+    // values under other weights are no use
+    if (std::memcmp(&m_weights, &options.weights, sizeof(m_weights)) != 0)
+    {
+        m_weights = options.weights;
+        m_table.Clear();
+    }
+
+    // held until the search is done, list lives in it
+    Scratch* root = TakeScratch();
+    PlacementList& list = root->lists[0];
+    root->generator.Generate(board, falling_piece, list);
+
+    if (list.count == 0)
+    {
+        ReturnScratch(root);
+        return false;
+    }
+
+    uint64_t hash = BoardHash(board);
+    m_children.assign(list.count, board);
+    m_child_hashes.assign(list.count, hash);
+    m_child_values.assign(list.count, 0.0f);
+
+    for (size_t i = 0; i < list.count; i++)
+    {
+        const Placement& placement = list.placements[i];
+        PlacePiece(m_children[i], m_child_hashes[i],
+            Piece(falling_piece.m_type, placement.rotation, {placement.x, placement.y}, *m_rotation_system));
+
+        BoardFeatures features;
+        EvaluateBoard(m_children[i].m_rows, features);
+        m_child_values[i] = ScoreFeatures(features, m_weights);
+    }
+
+    size_t best = (size_t)(std::max_element(m_child_values.begin(), m_child_values.end()) - m_child_values.begin());
+    out_result.placement = list.placements[best];
+    out_result.value = m_child_values[best];
+    out_result.depth = 1;
+    out_result.nodes = list.count;
+
+    size_t depth_nodes = list.count;
+    size_t last_depth_nodes = 0;
+    double depth_seconds = 0;
+
+    for (size_t depth = 2; depth <= std::min(options.max_depth, MAX_SEARCH_DEPTH) && !OutOfTime(); depth++)
+    {
+        // a depth left unfinished at the deadline is wasted, so do not start one that will not finish.
+        // each piece deeper costs about what the last one did over the one before, times every piece
+        // it could be once past the known ones
+        if (m_has_deadline && last_depth_nodes > 0)
+        {
+            double growth = (double)depth_nodes / last_depth_nodes;
+            growth *= depth - 1 > m_outlook.known_count ? PIECE_TYPE::LENGTH : 1;
+            Clock::time_point finish = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(depth_seconds * growth));
+
+            if (finish > m_deadline)
+            {
+                break;
+            }
+        }
+
+        Clock::time_point depth_start = Clock::now();
+
+        for (size_t i = 0; i < list.count; i++)
+        {
+            m_pool.Submit([this, i, depth]
+            {
+                Scratch* scratch = TakeScratch();
+                m_child_values[i] = Value(*scratch, m_children[i], m_child_hashes[i], 1, depth - 1, m_outlook.bag);
+                ReturnScratch(scratch);
+            });
+        }
+
+        m_pool.Wait();
+
+        {
+            std::lock_guard<std::mutex> lock(m_scratch_mutex);
+            last_depth_nodes = depth_nodes;
+            depth_nodes = m_nodes;
+            out_result.nodes += m_nodes;
+            out_result.table_hits += m_table_hits;
+            m_nodes = 0;
+            m_table_hits = 0;
+        }
+
+        depth_seconds = std::chrono::duration<double>(Clock::now() - depth_start).count();
+
+        if (m_stop.load())
+        {
+            break;
+        }
+
+        best = (size_t)(std::max_element(m_child_values.begin(), m_child_values.end()) - m_child_values.begin());
+        out_result.placement = list.placements[best];
+        out_result.value = m_child_values[best];
+        out_result.depth = depth;
+    }
+
+    ReturnScratch(root);
+    out_result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return true;
+}
+
+/*What the board is worth with remaining pieces still to place, the next one being piece ply of
+the search. bag is what is left in the bag for the first piece not in the outlook*/
+float LookaheadSearch::Value(Scratch& scratch, const Board& board, uint64_t hash, size_t ply, size_t remaining, uint8_t bag)
+{
+    if (OutOfTime())
+    {
+        return 0;
+    }
+
+    uint64_t key = PositionKey(hash, ply, remaining, bag);
+    float value;
+
+    if (m_table.Probe(key, value))
+    {
+        scratch.table_hits++;
+        return value;
+    }
+
+    if (ply <= m_outlook.known_count)
+    {
+        value = BestPlacement(scratch, board, hash, m_outlook.known[ply - 1], ply, remaining, bag);
+    }
+    else
+    {
+        // every piece left in the bag is as likely, a uniform randomizer never takes any out
+        value = 0;
+
+        for (int type = 0; type < PIECE_TYPE::LENGTH; type++)
+        {
+            if ((bag & (1 << type)) == 0)
+            {
+                continue;
+            }
+
+            uint8_t next_bag = bag;
+
+            if (m_outlook.randomizer == RANDOMIZER_BAG7)
+            {
+                next_bag = (uint8_t)(bag & ~(1 << type));
+                next_bag = next_bag != 0 ? next_bag : ALL_PIECES_MASK;
+            }
+
+            value += BestPlacement(scratch, board, hash, (PIECE_TYPE)type, ply, remaining, next_bag);
+        }
+
+        value /= (float)std::popcount(bag);
+    }
+
+    // a value cut short by the deadline is not the board's value
+    if (!m_stop.load(std::memory_order_relaxed))
+    {
+        m_table.Store(key, value);
+    }
+
+    return value;
+}
+
+/*The best the board is worth after placing a piece of this type, scoring the boards a batch at a
+time on the last piece*/
+float LookaheadSearch::BestPlacement(Scratch& scratch, const Board& board, uint64_t hash, PIECE_TYPE type,
+    size_t ply, size_t remaining, uint8_t bag)
+{
+    Piece piece(type, COORD_LIMIT_X, *m_rotation_system);
+    PlacementList& list = scratch.lists[ply];
+
+    // no placements means it could not even spawn
+    if (scratch.generator.Generate(board, piece, list) == 0)
+    {
+        return TOP_OUT_VALUE;
+    }
+
+    scratch.nodes += list.count;
+    float best = TOP_OUT_VALUE;
+
+    if (remaining > 1)
+    {
+        for (size_t i = 0; i < list.count; i++)
+        {
+            const Placement& placement = list.placements[i];
+            Board child = board;
+            uint64_t child_hash = hash;
+            PlacePiece(child, child_hash, Piece(type, placement.rotation, {placement.x, placement.y}, *m_rotation_system));
+            best = std::max(best, Value(scratch, child, child_hash, ply + 1, remaining - 1, bag));
+        }
+
+        return best;
+    }
+
+    BoardBatch& batch = scratch.batch;
+    std::array<float, EVALUATOR_BATCH_SIZE> scores;
+    batch.Clear();
+
+    for (size_t i = 0; i < list.count; i++)
+    {
+        const Placement& placement = list.placements[i];
+        Board child = board;
+        uint64_t child_hash = hash;
+        PlacePiece(child, child_hash, Piece(type, placement.rotation, {placement.x, placement.y}, *m_rotation_system));
+        batch.Add(child.m_rows);
+
+        if (batch.count == EVALUATOR_BATCH_SIZE || i + 1 == list.count)
+        {
+            ScoreBatch(batch, m_kernel, m_weights, scores);
+            best = std::max(best, *std::max_element(scores.begin(), scores.begin() + batch.count));
+            batch.Clear();
+        }
+    }
+
+    return best;
+}
+
+/*The board's hash combined with everything else its value depends on: the pieces still to come
+as far as the search goes and, once past the known ones, the bag. Nothing in it depends on where
+the search started, so a board met again on a later move finds its value*/
+uint64_t LookaheadSearch::PositionKey(uint64_t hash, size_t ply, size_t remaining, uint8_t bag) const
+{
+    size_t last = ply + remaining - 1;
+    size_t known = ply <= m_outlook.known_count ? std::min(last, m_outlook.known_count) - ply + 1 : 0;
+    uint64_t pieces = remaining << 3 | known;
+
+    for (size_t k = ply; k <= std::min(last, m_outlook.known_count); k++)
+    {
+        pieces = pieces << 3 | (uint64_t)(m_outlook.known[k - 1] + 1);
+    }
+
+    if (last > m_outlook.known_count)
+    {
+        pieces = (pieces << 8 | bag) << 1 | (m_outlook.randomizer == RANDOMIZER_BAG7);
+    }
+
+    return hash ^ Mix(pieces * 0xD6E8FEB86659FD93ULL);
+}
+
+/*Stops every task once the deadline passes, checked once per board searched*/
+bool LookaheadSearch::OutOfTime()
+{
+    if (m_stop.load(std::memory_order_relaxed))
+    {
+        return true;
+    }
+
+    if (m_has_deadline && Clock::now() >= m_deadline)
+    {
+        m_stop.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    return false;
+}
+
+LookaheadSearch::Scratch* LookaheadSearch::TakeScratch()
+{
+    std::lock_guard<std::mutex> lock(m_scratch_mutex);
+
+    if (m_free_scratch.empty())
+    {
+        m_scratch.push_back(std::make_unique<Scratch>(m_rotation_system));
+        return m_scratch.back().get();
+    }
+
+    Scratch* scratch = m_free_scratch.back();
+    m_free_scratch.pop_back();
+    return scratch;
+}
+
+/*Hands the scratch back, adding up what it counted*/
+void LookaheadSearch::ReturnScratch(Scratch* scratch)
+{
+    std::lock_guard<std::mutex> lock(m_scratch_mutex);
+    m_nodes += scratch->nodes;
+    m_table_hits += scratch->table_hits;
+    scratch->nodes = 0;
+    scratch->table_hits = 0;
+    m_free_scratch.push_back(scratch);
+}
+
+/*The next preview pieces NewPiece will deal, found on a copy of the randomizer, and for a bag
+what is left in it after them. Anything past the preview is only known as a chance*/
+PieceOutlook PeekOutlook(const PieceRandomizer& randomizer, size_t preview)
+{
+    PieceRandomizer copy = randomizer;
+    PieceOutlook outlook;
+    outlook.randomizer = randomizer.m_type;
+    outlook.known_count = std::min(preview, MAX_SEARCH_DEPTH);
+
+    for (size_t i = 0; i < outlook.known_count; i++)
+    {
+        outlook.known[i] = copy.Next();
+    }
+
+    if (copy.m_type == RANDOMIZER_BAG7 && copy.m_bag_index < copy.m_bag.size())
+    {
+        outlook.bag = 0;
+
+        for (size_t i = copy.m_bag_index; i < copy.m_bag.size(); i++)
+        {
+            outlook.bag |= (uint8_t)(1 << copy.m_bag[i]);
+        }
+    }
+
+    return outlook;
+}
@@ -3,7 +3,8 @@
 #define VC_EXTRALEAN
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
-void main(void);
+#include <stdlib.h>
+int main(int argc, char* argv[]);
 int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPTSTR lpCmdLine, int nCmdShow)
 {
     //avoid "unreferenced param" warnings
@@ -11,14 +12,342 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPTSTR lpCmdL
     (void)hPrevInstance;
     (void)lpCmdLine;
     (void)nCmdShow;
-    main();
+    return main(__argc, __argv);
 }
 #endif
 
 #define SDL_MAIN_HANDLED
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "alloc_bench.hpp"
 #include "application.hpp"
+#include "batch_bench.hpp"
+#include "board_bench.hpp"
+#include "commands.hpp"
+#include "evaluator_bench.hpp"
+#include "game_server.hpp"
+#include "placement_bench.hpp"
+#include "replay_archive.hpp"
+#include "replay_index.hpp"
+#include "rollback.hpp"
+#include "rollback_bench.hpp"
+#include "search_bench.hpp"
+#include "server_bench.hpp"
 
-void main(void)
+// every value the flags below can set
+struct CommandLine
 {
-    Application app;
+    LaunchOptions launch;
+    std::vector<std::string> replays;
+    std::vector<std::string> rebuild_archives;
+    std::vector<std::string> verify_paths;
+    size_t thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    std::string index_path = ReplayIndexPath(REPLAY_ARCHIVE_PATH);
+    int seek_seconds = -1;
+    int top_count = 0;
+    int longer_than_minutes = -1;
+    bool host_versus = false;
+    uint16_t versus_port = VERSUS_DEFAULT_PORT;
+    std::string join_address;
+    std::string watch_address;
+    uint16_t server_port = SERVER_DEFAULT_PORT;
+    RollbackBenchOptions rollback_bench;
+    ServerBenchOptions server_bench;
+    PlacementBenchOptions placement_bench;
+    EvaluatorBenchOptions evaluator_bench;
+    SearchBenchOptions search_bench;
+    BatchBenchOptions batch_bench;
+    AllocBenchOptions alloc_bench;
+    BoardBenchOptions board_bench;
+};
+
+// the arguments main() was given and the one being parsed
+struct ArgumentCursor
+{
+    int argc;
+    char** argv;
+    int i;
+};
+
+// One flag. parse reads the values after it, moving the cursor past them, and is false if one
+// it needs is missing. run is the command the flag asks for, NULL if it only sets an option
+struct CommandLineFlag
+{
+    const char* name;
+    bool (*parse)(ArgumentCursor& in, CommandLine& out);
+    int (*run)(CommandLine& args);
+};
+
+/*The argument after the cursor, NULL at the end*/
+static const char* NextArgument(const ArgumentCursor& in)
+{
+    return in.i + 1 < in.argc ? in.argv[in.i + 1] : NULL;
+}
+
+/*Takes the next argument if it is a number above zero, leaving it for the next flag otherwise*/
+template <typename T>
+static bool OptionalPositive(ArgumentCursor& in, T& out_value)
+{
+    const char* next = NextArgument(in);
+
+    if (next == NULL)
+    {
+        return true;
+    }
+
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        if (atof(next) > 0)
+        {
+            out_value = (T)atof(next);
+            in.i++;
+        }
+    }
+    else if (atoi(next) > 0)
+    {
+        out_value = (T)atoi(next);
+        in.i++;
+    }
+
+    return true;
+}
+
+static bool RequiredValue(ArgumentCursor& in, std::string& out_value)
+{
+    const char* next = NextArgument(in);
+
+    if (next == NULL)
+    {
+        return false;
+    }
+
+    out_value = next;
+    in.i++;
+    return true;
+}
+
+static bool RequiredInt(ArgumentCursor& in, int& out_value)
+{
+    const char* next = NextArgument(in);
+
+    if (next == NULL)
+    {
+        return false;
+    }
+
+    out_value = atoi(next);
+    in.i++;
+    return true;
+}
+
+/*Takes every following argument up to the next flag, or fallback if there are none*/
+static bool Paths(ArgumentCursor& in, std::vector<std::string>& out_paths, const char* fallback = NULL)
+{
+    while (NextArgument(in) != NULL && strncmp(NextArgument(in), "--", 2) != 0)
+    {
+        out_paths.push_back(NextArgument(in));
+        in.i++;
+    }
+
+    if (out_paths.empty() && fallback != NULL)
+    {
+        out_paths.push_back(fallback);
+    }
+
+    return !out_paths.empty();
+}
+
+// When several commands are given the first one here runs
+static const CommandLineFlag FLAGS[] =
+{
+    {"--replay",
+        [](ArgumentCursor& in, CommandLine& out) { return Paths(in, out.replays); },
+        [](CommandLine& args) { return RunReplays(args.replays, args.seek_seconds); }},
+    {"--verify",
+        [](ArgumentCursor& in, CommandLine& out) { return Paths(in, out.verify_paths, REPLAY_DIRECTORY); },
+        [](CommandLine& args) { return VerifyAll(args.verify_paths, args.thread_count); }},
+    {"--rebuild-index",
+        [](ArgumentCursor& in, CommandLine& out) { return Paths(in, out.rebuild_archives, REPLAY_ARCHIVE_PATH); },
+        [](CommandLine& args) { return RebuildIndexes(args.rebuild_archives, args.thread_count); }},
+    {"--top",
+        [](ArgumentCursor& in, CommandLine& out) { return RequiredInt(in, out.top_count) && out.top_count > 0; },
+        [](CommandLine& args) { return QueryIndex(args.index_path, args.top_count, args.longer_than_minutes); }},
+    {"--longer-than",
+        [](ArgumentCursor& in, CommandLine& out) { return RequiredInt(in, out.longer_than_minutes) && out.longer_than_minutes >= 0; },
+        [](CommandLine& args) { return QueryIndex(args.index_path, args.top_count, args.longer_than_minutes); }},
+    {"--rollback-bench",
+        [](ArgumentCursor& in, CommandLine& out) { return OptionalPositive(in, out.rollback_bench.seconds); },
+        [](CommandLine& args) { return MeasureRollback(args.rollback_bench); }},
+    {"--server",
+        [](ArgumentCursor& in, CommandLine& out) { return OptionalPositive(in, out.server_port); },
+        [](CommandLine& args) { return RunServer(args.server_port, args.thread_count); }},
+    {"--server-bench",
+        [](ArgumentCursor& in, CommandLine& out)
+        {
+            return OptionalPositive(in, out.server_bench.clients) && OptionalPositive(in, out.server_bench.seconds);
+        },
+        [](CommandLine& args)
+        {
+            args.server_bench.thread_count = args.thread_count;
+            return MeasureServer(args.server_bench);
+        }},
+    {"--placement-bench",
+        [](ArgumentCursor& in, CommandLine& out) { return OptionalPositive(in, out.placement_bench.games); },
+        [](CommandLine& args) { return MeasurePlacements(args.placement_bench); }},
+    {"--eval-bench",
+        [](ArgumentCursor& in, CommandLine& out) { return OptionalPositive(in, out.evaluator_bench.games); },
+        [](CommandLine& args) { return MeasureEvaluator(args.evaluator_bench); }},
+    {"--search-bench",
+        [](ArgumentCursor& in, CommandLine& out) { return OptionalPositive(in, out.search_bench.games); },
+        [](CommandLine& args)
+        {
+            args.search_bench.max_threads = args.thread_count;
+            return MeasureSearch(args.search_bench);
+        }},
+    {"--batch-bench",
+        [](ArgumentCursor& in, CommandLine& out) { return OptionalPositive(in, out.batch_bench.games); },
+        [](CommandLine& args)
+        {
+            args.batch_bench.max_threads = args.thread_count;
+            return MeasureBatch(args.batch_bench);
+        }},
+    {"--alloc-bench",
+        [](ArgumentCursor& in, CommandLine& out) { return OptionalPositive(in, out.alloc_bench.ticks); },
+        [](CommandLine& args) { return MeasureAllocations(args.alloc_bench); }},
+    {"--board-bench",
+        [](ArgumentCursor& in, CommandLine& out) { return OptionalPositive(in, out.board_bench.boards); },
+        [](CommandLine& args) { return MeasureBoard(args.board_bench); }},
+    {"--watch",
+        [](ArgumentCursor& in, CommandLine& out) { return RequiredValue(in, out.watch_address); },
+        [](CommandLine& args) { return WatchGame(args.watch_address); }},
+
+    // options for the commands above or the game
+    {"--seek",
+        [](ArgumentCursor& in, CommandLine& out) { return RequiredInt(in, out.seek_seconds); },
+        NULL},
+    {"--threads",
+        [](ArgumentCursor& in, CommandLine& out)
+        {
+            int threads = 0;
+
+            if (!RequiredInt(in, threads) || threads <= 0)
+            {
+                return false;
+            }
+
+            out.thread_count = (size_t)threads;
+            return true;
+        },
+        NULL},
+    {"--index",
+        [](ArgumentCursor& in, CommandLine& out) { return RequiredValue(in, out.index_path); },
+        NULL},
+    {"--delay",
+        [](ArgumentCursor& in, CommandLine& out) { return RequiredInt(in, out.rollback_bench.delay_ms); },
+        NULL},
+    {"--jitter",
+        [](ArgumentCursor& in, CommandLine& out) { return RequiredInt(in, out.rollback_bench.jitter_ms); },
+        NULL},
+    {"--latency",
+        [](ArgumentCursor& in, CommandLine& out)
+        {
+            out.launch.measure_latency = true;
+            return OptionalPositive(in, out.launch.latency_samples);
+        },
+        NULL},
+    {"--spectate",
+        [](ArgumentCursor& in, CommandLine& out)
+        {
+            out.launch.spectate = true;
+            return OptionalPositive(in, out.launch.spectate_port);
+        },
+        NULL},
+    {"--host",
+        [](ArgumentCursor& in, CommandLine& out)
+        {
+            out.host_versus = true;
+            return OptionalPositive(in, out.versus_port);
+        },
+        NULL},
+    {"--join",
+        [](ArgumentCursor& in, CommandLine& out) { return RequiredValue(in, out.join_address); },
+        NULL},
+};
+
+static const size_t FLAG_COUNT = std::size(FLAGS);
+
+int main(int argc, char* argv[])
+{
+    CommandLine command_line;
+    std::array<bool, FLAG_COUNT> given = {};
+
+    for (ArgumentCursor cursor = {argc, argv, 1}; cursor.i < argc; cursor.i++)
+    {
+        size_t flag = 0;
+
+        while (flag < FLAG_COUNT && strcmp(argv[cursor.i], FLAGS[flag].name) != 0)
+        {
+            flag++;
+        }
+
+        if (flag == FLAG_COUNT)
+        {
+            std::cerr << "unknown argument " << argv[cursor.i] << std::endl;
+            return 1;
+        }
+
+        if (!FLAGS[flag].parse(cursor, command_line))
+        {
+            std::cerr << FLAGS[flag].name << " is missing its value" << std::endl;
+            return 1;
+        }
+
+        given[flag] = true;
+    }
+
+    for (size_t flag = 0; flag < FLAG_COUNT; flag++)
+    {
+        if (given[flag] && FLAGS[flag].run != NULL)
+        {
+            return FLAGS[flag].run(command_line);
+        }
+    }
+
+    LaunchOptions& options = command_line.launch;
+    NetSocket versus_socket;
+
+    if (command_line.host_versus)
+    {
+        if (!HostVersus(command_line.versus_port, GameSettings(), versus_socket, options.versus_settings))
+        {
+            return 1;
+        }
+
+        options.versus_socket = &versus_socket;
+        options.versus_player = 0;
+    }
+    else if (!command_line.join_address.empty())
+    {
+        std::string host;
+        uint16_t port;
+        SplitAddress(command_line.join_address, VERSUS_DEFAULT_PORT, host, port);
+
+        if (!JoinVersus(host, port, versus_socket, options.versus_settings))
+        {
+            return 1;
+        }
+
+        options.versus_socket = &versus_socket;
+        options.versus_player = 1;
+    }
+
+    Application app(options);
+    return 0;
 }
@@ -0,0 +1,165 @@
+#include "mapped_file.hpp"
+#include "debug.hpp"
+
+#ifdef _WINDOWS
+#define VC_EXTRALEAN
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WINDOWS
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        ERROR_PRINT("ERROR: could not open " << path);
+        return false;
+    }
+
+    m_file = file;
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(file, &size))
+    {
+        ERROR_PRINT("ERROR: could not read the size of " << path);
+        Close();
+        return false;
+    }
+
+    m_size = (size_t)size.QuadPart;
+
+    // an empty file cannot be mapped, it simply has no data
+    if (m_size == 0)
+    {
+        return true;
+    }
+
+    m_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (m_mapping != NULL)
+    {
+        m_data = (const uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+
+    if (m_data == NULL)
+    {
+        ERROR_PRINT("ERROR: could not map " << path);
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data != NULL)
+    {
+        UnmapViewOfFile(m_data);
+    }
+
+    if (m_mapping != NULL)
+    {
+        CloseHandle(m_mapping);
+    }
+
+    if (m_file != NULL)
+    {
+        CloseHandle(m_file);
+    }
+
+    m_data = NULL;
+    m_size = 0;
+    m_mapping = NULL;
+    m_file = NULL;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    m_fd = open(path.c_str(), O_RDONLY);
+
+    if (m_fd < 0)
+    {
+        ERROR_PRINT("ERROR: could not open " << path);
+        return false;
+    }
+
+    struct stat info;
+
+    if (fstat(m_fd, &info) != 0)
+    {
+        ERROR_PRINT("ERROR: could not read the size of " << path);
+        Close();
+        return false;
+    }
+
+    m_size = (size_t)info.st_size;
+
+    // an empty file cannot be mapped, it simply has no data
+    if (m_size == 0)
+    {
+        return true;
+    }
+
+    void* data = mmap(NULL, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+
+    if (data == MAP_FAILED)
+    {
+        ERROR_PRINT("ERROR: could not map " << path);
+        Close();
+        return false;
+    }
+
+    m_data = (const uint8_t*)data;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data != NULL)
+    {
+        munmap((void*)m_data, m_size);
+    }
+
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+
+    m_data = NULL;
+    m_size = 0;
+    m_fd = -1;
+}
+
+#endif
+
+const uint8_t* MappedFile::Data() const
+{
+    return m_data;
+}
+
+size_t MappedFile::Size() const
+{
+    return m_size;
+}
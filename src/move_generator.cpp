@@ -0,0 +1,437 @@
+#include "move_generator.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+
+static const uint16_t NO_STEP = UINT16_MAX;
+static const int8_t STEP_DOWN = -1;
+static const int8_t STEP_START = -2;
+
+/*Everything a row of shifts left and right from columns reaches without leaving fits. Doubling the
+distance each round covers the nine columns in four*/
+static RowMask Spread(RowMask columns, RowMask fits)
+{
+    // mostly columns dropped from a row that was already spread
+    if (((columns << 1 | columns >> 1) & fits & ~columns) == 0)
+    {
+        return columns & fits;
+    }
+
+    RowMask left = columns & fits;
+    RowMask right = left;
+    RowMask open_left = fits;
+    RowMask open_right = fits;
+
+    for (int distance = 1; distance < COORD_LIMIT_X; distance *= 2)
+    {
+        left |= open_left & (RowMask)(left << distance);
+        right |= open_right & (RowMask)(right >> distance);
+        open_left &= (RowMask)(open_left << distance);
+        open_right &= (RowMask)(open_right >> distance);
+    }
+
+    return left | right;
+}
+
+/*Columns that Piece::Rotate's clamp puts on column, every one past the wall goes on the nearest one inside*/
+static RowMask ClampedOnto(const PieceRotation& rotation, int column)
+{
+    int lowest = -rotation.min.x;
+    int highest = COORD_LIMIT_X - 1 - rotation.max.x;
+    RowMask columns = (RowMask)(1 << column);
+
+    if (column == lowest)
+    {
+        columns |= (RowMask)((1 << lowest) - 1);
+    }
+
+    if (column == highest)
+    {
+        columns |= (RowMask)(FULL_ROW_MASK & ~((1 << (highest + 1)) - 1));
+    }
+
+    return columns;
+}
+
+static RowMask ShiftColumns(RowMask columns, int shift)
+{
+    return shift >= 0 ? (RowMask)(columns << shift) : (RowMask)(columns >> -shift);
+}
+
+MoveGenerator::MoveGenerator(const RotationSystem* rotation_system)
+    : m_rotation_system(rotation_system)
+{
+}
+
+/*Writes every resting position reachable from piece to out_placements and returns how many there
+are, none when the piece does not fit where it is*/
+size_t MoveGenerator::Generate(const Board& board, const Piece& piece, PlacementList& out_placements)
+{
+    out_placements.count = 0;
+
+    m_type = piece.m_type;
+    m_num_rotations = (int)m_rotation_system->num_rotations[m_type];
+    BuildFitMasks(board);
+
+    int start_rotation = (int)piece.m_rotation_index;
+    int start_x = piece.m_origin.x;
+    int start_y = piece.m_origin.y;
+
+    if (!Fits(start_rotation, start_x, start_y))
+    {
+        return 0;
+    }
+
+    Flood(start_rotation, start_x, start_y);
+    FindDrops(start_rotation, start_x, start_y);
+
+    // resting means the row below does not fit, m_fits has an empty row past the bottom for this
+    for (int rotation = 0; rotation < m_num_rotations; rotation++)
+    {
+        for (int y = 0; y < COORD_LIMIT_Y; y++)
+        {
+            RowMask resting = m_reachable[rotation][y] & (RowMask)~m_fits[rotation][y + 1];
+
+            while (resting != 0)
+            {
+                int x = std::countr_zero(resting);
+                resting &= (RowMask)(resting - 1);
+
+                Placement& placement = out_placements.placements[out_placements.count];
+                placement.x = (int8_t)x;
+                placement.y = (int8_t)y;
+                placement.rotation = (uint8_t)rotation;
+
+                if (((m_dropped[rotation][y] >> x) & 1) == 0)
+                {
+                    // a tuck or a spin, only a board built to be a maze needs more moves than fit
+                    if (TracePath(rotation, x, y, placement))
+                    {
+                        out_placements.count++;
+                    }
+
+                    continue;
+                }
+
+                int shift = x - m_drop_x[rotation];
+                uint8_t length = 0;
+
+                for (int i = 0; i < m_drop_rotations[rotation]; i++)
+                {
+                    placement.path[length++] = MOVE_ROTATE;
+                }
+
+                for (int i = 0; i < std::abs(shift); i++)
+                {
+                    placement.path[length++] = shift < 0 ? MOVE_LEFT : MOVE_RIGHT;
+                }
+
+                placement.path_length = length;
+                out_placements.count++;
+            }
+        }
+    }
+
+    return out_placements.count;
+}
+
+/*For each rotation and origin row, the columns where no cell of the piece is off the board or on a
+filled cell. One shifted copy of the board row under each cell, instead of a Collides call per position.
+Also where rotating from each rotation goes, so the flood does not look it up every step*/
+void MoveGenerator::BuildFitMasks(const Board& board)
+{
+    // nothing above the highest filled row can block anything
+    int stack_top = 0;
+
+    while (stack_top < COORD_LIMIT_Y && board.m_rows[stack_top] == 0)
+    {
+        stack_top++;
+    }
+
+    for (int r = 0; r < m_num_rotations; r++)
+    {
+        const PieceRotation& rotation = m_rotation_system->Get(m_type, (size_t)r);
+        int top = -rotation.min.y;
+        int bottom = COORD_LIMIT_Y - 1 - rotation.max.y;
+
+        std::array<RowMask, COORD_LIMIT_Y> blocked = {};
+
+        for (const Coordinate& cell : rotation.cells)
+        {
+            for (int y = std::max(top, stack_top - rotation.max.y); y <= bottom; y++)
+            {
+                blocked[y] |= ShiftColumns(board.m_rows[y + cell.y], -cell.x);
+            }
+        }
+
+        // origins that keep every cell inside the walls, the origin is always one of the cells
+        RowMask in_bounds = (RowMask)(((1 << (COORD_LIMIT_X - rotation.max.x)) - 1) & ~((1 << -rotation.min.x) - 1));
+
+        for (int y = 0; y <= COORD_LIMIT_Y; y++)
+        {
+            m_fits[r][y] = y >= top && y <= bottom ? (RowMask)(in_bounds & ~blocked[y]) : 0;
+        }
+
+        // where Piece::Rotate's clamp keeps the origin on the way out of this rotation
+        RotateBounds& bounds = m_rotate_bounds[r];
+        bounds.next = (int)m_rotation_system->Next(m_type, (size_t)r);
+        const PieceRotation& next_rotation = m_rotation_system->Get(m_type, (size_t)bounds.next);
+        bounds.lowest = -next_rotation.min.x;
+        bounds.highest = COORD_LIMIT_X - 1 - next_rotation.max.x;
+        bounds.top = -next_rotation.min.y;
+        bounds.bottom = COORD_LIMIT_Y - 1 - next_rotation.max.y;
+    }
+}
+
+/*Fills m_reachable with every position the piece can get to. Each step spreads the columns it
+reached sideways, then drops the new ones a row and rotates them all at once*/
+void MoveGenerator::Flood(int rotation, int x, int y)
+{
+    for (int r = 0; r < m_num_rotations; r++)
+    {
+        m_reachable[r].fill(0);
+        m_first_step[r].fill(NO_STEP);
+    }
+
+    m_step_count = 0;
+    AddStep(rotation, y, (RowMask)(1 << x), NO_STEP, STEP_START);
+
+    for (size_t i = 0; i < m_step_count; i++)
+    {
+        FloodStep& step = m_steps[i];
+        int r = step.rotation;
+        int row = step.y;
+
+        step.added = Spread(step.seeds, m_fits[r][row]) & (RowMask)~m_reachable[r][row];
+
+        if (step.added == 0)
+        {
+            continue;
+        }
+
+        m_reachable[r][row] |= step.added;
+        step.next = m_first_step[r][row];
+        m_first_step[r][row] = (uint16_t)i;
+
+        AddStep(r, row + 1, step.added & m_fits[r][row + 1], (uint16_t)i, STEP_DOWN);
+
+        if (m_num_rotations == 1)
+        {
+            continue;
+        }
+
+        const RotateBounds& bounds = m_rotate_bounds[r];
+
+        // Piece::Rotate's clamp, every column past a wall goes on the nearest one inside
+        RowMask below = step.added & (RowMask)((1 << bounds.lowest) - 1);
+        RowMask above = step.added & (RowMask)~((1 << (bounds.highest + 1)) - 1);
+        RowMask columns = step.added & (RowMask)~(below | above);
+
+        if (below != 0)
+        {
+            columns |= (RowMask)(1 << bounds.lowest);
+        }
+
+        if (above != 0)
+        {
+            columns |= (RowMask)(1 << bounds.highest);
+        }
+
+        int rotated_y = std::clamp(row, bounds.top, bounds.bottom);
+
+        // each column takes the first kick that fits, as in GameCore::Rotate
+        for (size_t k = 0; k < m_rotation_system->num_kicks && columns != 0; k++)
+        {
+            const Coordinate& kick = m_rotation_system->kicks[k];
+            int kicked_y = rotated_y + kick.y;
+
+            if (kicked_y < 0 || kicked_y >= COORD_LIMIT_Y)
+            {
+                continue;
+            }
+
+            RowMask fitting = columns & ShiftColumns(m_fits[bounds.next][kicked_y], -kick.x);
+            AddStep(bounds.next, kicked_y, ShiftColumns(fitting, kick.x), (uint16_t)i, (int8_t)k);
+            columns &= (RowMask)~fitting;
+        }
+    }
+}
+
+/*Queues the columns not reached yet as a step of the flood*/
+void MoveGenerator::AddStep(int rotation, int y, RowMask columns, uint16_t parent, int8_t kick)
+{
+    if (columns == 0)
+    {
+        return;
+    }
+
+    columns &= (RowMask)~m_reachable[rotation][y];
+
+    if (columns == 0)
+    {
+        return;
+    }
+
+    FloodStep& step = m_steps[m_step_count];
+    m_step_count++;
+
+    step.seeds = columns;
+    step.added = 0;
+    step.parent = parent;
+    step.next = NO_STEP;
+    step.rotation = (uint8_t)rotation;
+    step.y = (uint8_t)y;
+    step.kick = kick;
+}
+
+/*Fills m_dropped with the resting places reached by rotating where the piece starts, shifting
+across and dropping straight down, with how many rotations and from which column*/
+void MoveGenerator::FindDrops(int rotation, int x, int y)
+{
+    for (int r = 0; r < m_num_rotations; r++)
+    {
+        m_dropped[r].fill(0);
+    }
+
+    for (int rotations = 0; rotations < m_num_rotations; rotations++)
+    {
+        if (rotations > 0 && !Rotate(rotation, x, y))
+        {
+            break;
+        }
+
+        m_drop_rotations[rotation] = (uint8_t)rotations;
+        m_drop_x[rotation] = (int8_t)x;
+
+        RowMask columns = Spread((RowMask)(1 << x), m_fits[rotation][y]);
+
+        for (int row = y; row < COORD_LIMIT_Y && columns != 0; row++)
+        {
+            columns &= m_fits[rotation][row];
+            m_dropped[rotation][row] = columns;
+        }
+    }
+}
+
+/*Follows the flood back from a position to the start, shifting to the nearest column each step was
+reached at. False when the moves do not fit in Placement::path*/
+bool MoveGenerator::TracePath(int rotation, int x, int y, Placement& out_placement) const
+{
+    uint16_t index = m_first_step[rotation][y];
+
+    while (((m_steps[index].added >> x) & 1) == 0)
+    {
+        index = m_steps[index].next;
+    }
+
+    // moves come out last first, any downs at the very end are left to the hard drop
+    std::array<uint8_t, MAX_PLACEMENT_PATH> moves;
+    size_t length = 0;
+    int column = x;
+
+    while (true)
+    {
+        const FloodStep& step = m_steps[index];
+        RowMask seeds = step.seeds & Spread((RowMask)(1 << column), m_fits[step.rotation][step.y]);
+        RowMask left = seeds & (RowMask)((2 << column) - 1);
+        RowMask right = seeds & (RowMask)~((1 << column) - 1);
+        int seed = right != 0 ? std::countr_zero(right) : -1;
+
+        if (left != 0 && (seed < 0 || column - (std::bit_width(left) - 1) < seed - column))
+        {
+            seed = std::bit_width(left) - 1;
+        }
+
+        if (length + (size_t)std::abs(column - seed) + 1 > MAX_PLACEMENT_PATH)
+        {
+            return false;
+        }
+
+        for (; column != seed; column += column > seed ? -1 : 1)
+        {
+            moves[length++] = column > seed ? MOVE_RIGHT : MOVE_LEFT;
+        }
+
+        if (step.kick == STEP_START)
+        {
+            break;
+        }
+
+        const FloodStep& parent = m_steps[step.parent];
+
+        if (step.kick == STEP_DOWN)
+        {
+            if (length > 0)
+            {
+                moves[length++] = MOVE_DOWN;
+            }
+        }
+        else
+        {
+            // any column the clamp puts on the same one took the same kick
+            int clamped = seed - m_rotation_system->kicks[(size_t)step.kick].x;
+            const PieceRotation& rotated = m_rotation_system->Get(m_type, step.rotation);
+            column = std::countr_zero((RowMask)(parent.added & ClampedOnto(rotated, clamped)));
+            moves[length++] = MOVE_ROTATE;
+        }
+
+        index = step.parent;
+    }
+
+    out_placement.path_length = (uint8_t)length;
+    std::reverse_copy(moves.begin(), moves.begin() + length, out_placement.path.begin());
+    return true;
+}
+
+/*One position through GameCore::Rotate, Piece::Rotate's clamp back inside the board and then the
+first kick that fits. False and unchanged when none does*/
+bool MoveGenerator::Rotate(int& rotation, int& x, int& y) const
+{
+    int next = (int)m_rotation_system->Next(m_type, (size_t)rotation);
+    const PieceRotation& next_rotation = m_rotation_system->Get(m_type, (size_t)next);
+    int rotated_x = x;
+    int rotated_y = y;
+
+    if (x + next_rotation.min.x < 0)
+    {
+        rotated_x = -next_rotation.min.x;
+    }
+    else if (x + next_rotation.max.x >= COORD_LIMIT_X)
+    {
+        rotated_x = COORD_LIMIT_X - 1 - next_rotation.max.x;
+    }
+
+    if (y + next_rotation.min.y < 0)
+    {
+        rotated_y = -next_rotation.min.y;
+    }
+    else if (y + next_rotation.max.y >= COORD_LIMIT_Y)
+    {
+        rotated_y = COORD_LIMIT_Y - 1 - next_rotation.max.y;
+    }
+
+    for (size_t i = 0; i < m_rotation_system->num_kicks; i++)
+    {
+        const Coordinate& kick = m_rotation_system->kicks[i];
+
+        if (Fits(next, rotated_x + kick.x, rotated_y + kick.y))
+        {
+            rotation = next;
+            x = rotated_x + kick.x;
+            y = rotated_y + kick.y;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool MoveGenerator::Fits(int rotation, int x, int y) const
+{
+    if (x < 0 || x >= COORD_LIMIT_X || y < 0 || y >= COORD_LIMIT_Y)
+    {
+        return false;
+    }
+
+    return (m_fits[rotation][y] >> x) & 1;
+}
@@ -0,0 +1,442 @@
+#include "net_socket.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "debug.hpp"
+
+#ifdef _WINDOWS
+#define VC_EXTRALEAN
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+
+typedef SOCKET NativeSocket;
+static const uintptr_t NO_SOCKET = (uintptr_t)INVALID_SOCKET;
+
+/*Winsock has to be started once per process before the first socket is made*/
+static bool StartNetwork()
+{
+    static bool started = []
+    {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+
+    return started;
+}
+
+static bool WouldBlock()
+{
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+static void CloseSocket(NativeSocket socket)
+{
+    closesocket(socket);
+}
+
+static bool SetNonBlocking(NativeSocket socket)
+{
+    u_long enable = 1;
+    return ioctlsocket(socket, FIONBIO, &enable) == 0;
+}
+
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef int NativeSocket;
+static const int NO_SOCKET = -1;
+
+static bool StartNetwork()
+{
+    return true;
+}
+
+static bool WouldBlock()
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+static void CloseSocket(NativeSocket socket)
+{
+    close(socket);
+}
+
+static bool SetNonBlocking(NativeSocket socket)
+{
+    int flags = fcntl(socket, F_GETFL, 0);
+    return flags >= 0 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+#endif
+
+// a peer that went away fails the send instead of raising SIGPIPE
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+NetSocket::NetSocket(NetSocket&& other)
+{
+    m_socket = other.m_socket;
+    other.m_socket = NO_SOCKET;
+}
+
+NetSocket& NetSocket::operator=(NetSocket&& other)
+{
+    if (this != &other)
+    {
+        Close();
+        m_socket = other.m_socket;
+        other.m_socket = NO_SOCKET;
+    }
+    return *this;
+}
+
+NetSocket::~NetSocket()
+{
+    Close();
+}
+
+/*Waits for connections on every interface, port 0 lets the system pick a free one (see LocalPort)*/
+bool NetSocket::Listen(uint16_t port)
+{
+    Close();
+
+    if (!StartNetwork())
+    {
+        ERROR_PRINT("ERROR: could not start networking");
+        return false;
+    }
+
+    NativeSocket listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    if (listener == (NativeSocket)NO_SOCKET)
+    {
+        ERROR_PRINT("ERROR: could not create a socket");
+        return false;
+    }
+
+    m_socket = listener;
+
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+
+    if (bind(listener, (const sockaddr*)&address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+    {
+        ERROR_PRINT("ERROR: could not listen on port " << port);
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+/*Blocks until a peer connects. Without wait it only takes a peer already waiting and is false
+when there is none*/
+bool NetSocket::Accept(NetSocket& out_socket, bool wait)
+{
+    if (!wait && !SetNonBlocking((NativeSocket)m_socket))
+    {
+        ERROR_PRINT("ERROR: could not configure socket");
+        return false;
+    }
+
+    NativeSocket peer = accept((NativeSocket)m_socket, NULL, NULL);
+
+    if (peer == (NativeSocket)NO_SOCKET)
+    {
+        if (wait || !WouldBlock())
+        {
+            ERROR_PRINT("ERROR: accept failed");
+        }
+        return false;
+    }
+
+    out_socket.Close();
+    out_socket.m_socket = peer;
+    return out_socket.Configure();
+}
+
+bool NetSocket::Connect(const std::string& host, uint16_t port)
+{
+    Close();
+
+    if (!StartNetwork())
+    {
+        ERROR_PRINT("ERROR: could not start networking");
+        return false;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    addrinfo* addresses = NULL;
+
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+    {
+        ERROR_PRINT("ERROR: could not resolve " << host);
+        return false;
+    }
+
+    for (addrinfo* address = addresses; address != NULL; address = address->ai_next)
+    {
+        NativeSocket peer = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+
+        if (peer == (NativeSocket)NO_SOCKET)
+        {
+            continue;
+        }
+
+        if (connect(peer, address->ai_addr, (int)address->ai_addrlen) == 0)
+        {
+            m_socket = peer;
+            break;
+        }
+
+        CloseSocket(peer);
+    }
+
+    freeaddrinfo(addresses);
+
+    if (!IsOpen())
+    {
+        ERROR_PRINT("ERROR: could not connect to " << host << ":" << port);
+        return false;
+    }
+
+    return Configure();
+}
+
+bool NetSocket::Configure()
+{
+    int no_delay = 1;
+
+    if (setsockopt((NativeSocket)m_socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay)) != 0 ||
+        !SetNonBlocking((NativeSocket)m_socket))
+    {
+        ERROR_PRINT("ERROR: could not configure socket");
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+/*Sends all of data. Packets are small, so a full send buffer is only waited out, not queued*/
+bool NetSocket::Send(const uint8_t* data, size_t size)
+{
+    while (size > 0 && IsOpen())
+    {
+        int sent = send((NativeSocket)m_socket, (const char*)data, (int)size, MSG_NOSIGNAL);
+
+        if (sent > 0)
+        {
+            data += sent;
+            size -= (size_t)sent;
+        }
+        else if (sent < 0 && WouldBlock())
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            DEBUG_PRINT("INFO: connection lost while sending");
+            Close();
+        }
+    }
+
+    return size == 0;
+}
+
+/*Sends what the kernel takes right now without waiting. Bytes sent, 0 when the send buffer is
+full and -1 once the connection is gone*/
+int NetSocket::SendSome(const uint8_t* data, size_t size)
+{
+    if (!IsOpen())
+    {
+        return -1;
+    }
+
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    int sent = send((NativeSocket)m_socket, (const char*)data, (int)size, MSG_NOSIGNAL);
+
+    if (sent >= 0)
+    {
+        return sent;
+    }
+
+    if (WouldBlock())
+    {
+        return 0;
+    }
+
+    DEBUG_PRINT("INFO: connection lost while sending");
+    Close();
+    return -1;
+}
+
+/*Bytes read, 0 when nothing is waiting and -1 once the connection is gone*/
+int NetSocket::Receive(uint8_t* buffer, size_t size)
+{
+    if (!IsOpen())
+    {
+        return -1;
+    }
+
+    int received = recv((NativeSocket)m_socket, (char*)buffer, (int)size, 0);
+
+    if (received > 0)
+    {
+        return received;
+    }
+
+    if (received < 0 && WouldBlock())
+    {
+        return 0;
+    }
+
+    DEBUG_PRINT("INFO: connection closed by peer");
+    Close();
+    return -1;
+}
+
+uint16_t NetSocket::LocalPort() const
+{
+    sockaddr_in address = {};
+    socklen_t length = sizeof(address);
+
+    if (getsockname((NativeSocket)m_socket, (sockaddr*)&address, &length) != 0)
+    {
+        return 0;
+    }
+
+    return ntohs(address.sin_port);
+}
+
+bool NetSocket::IsOpen() const
+{
+    return m_socket != NO_SOCKET;
+}
+
+void NetSocket::Close()
+{
+    if (IsOpen())
+    {
+        CloseSocket((NativeSocket)m_socket);
+        m_socket = NO_SOCKET;
+    }
+}
+
+SendQueue::SendQueue(size_t limit)
+{
+    m_limit = limit;
+}
+
+/*Queues data behind anything still pending and sends as much as the socket takes. False, with
+the socket closed, once the connection is gone or more than the limit is waiting*/
+bool SendQueue::Send(NetSocket& socket, const uint8_t* data, size_t size)
+{
+    if (Pending() + size > m_limit)
+    {
+        DEBUG_PRINT("INFO: peer stopped reading, " << Pending() << " bytes waiting, disconnecting");
+        socket.Close();
+        Clear();
+        return false;
+    }
+
+    // straight out when nothing is queued ahead of it, the usual case
+    if (Pending() == 0)
+    {
+        int sent = socket.SendSome(data, size);
+
+        if (sent < 0)
+        {
+            Clear();
+            return false;
+        }
+
+        data += sent;
+        size -= (size_t)sent;
+        Clear();
+    }
+
+    m_bytes.insert(m_bytes.end(), data, data + size);
+    return Flush(socket);
+}
+
+/*Sends as much of the queue as the socket takes, false once the connection is gone*/
+bool SendQueue::Flush(NetSocket& socket)
+{
+    while (Pending() > 0)
+    {
+        int sent = socket.SendSome(m_bytes.data() + m_sent, Pending());
+
+        if (sent < 0)
+        {
+            Clear();
+            return false;
+        }
+
+        if (sent == 0)
+        {
+            break;
+        }
+
+        m_sent += (size_t)sent;
+    }
+
+    if (Pending() == 0)
+    {
+        Clear();
+    }
+    else if (m_sent >= m_bytes.size() / 2)
+    {
+        // drop what went out once it is most of the buffer, so the queue does not creep forward for ever
+        m_bytes.erase(m_bytes.begin(), m_bytes.begin() + m_sent);
+        m_sent = 0;
+    }
+
+    return true;
+}
+
+size_t SendQueue::Pending() const
+{
+    return m_bytes.size() - m_sent;
+}
+
+size_t SendQueue::Capacity() const
+{
+    return m_bytes.capacity();
+}
+
+void SendQueue::Clear()
+{
+    m_bytes.clear();
+    m_sent = 0;
+}
+
+/*host[:port], the port defaults to default_port*/
+void SplitAddress(const std::string& address, uint16_t default_port, std::string& out_host, uint16_t& out_port)
+{
+    size_t colon = address.rfind(':');
+    out_host = address.substr(0, colon);
+    out_port = colon == std::string::npos ? default_port : (uint16_t)atoi(address.c_str() + colon + 1);
+}
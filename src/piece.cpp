@@ -1,252 +1,87 @@
 #include "piece.hpp"
+#include "rotation.hpp"
 
-static const size_t NUM_ROT_SQUARE = 1;
-static const size_t NUM_ROT_LINE = 2;
-static const size_t NUM_ROT_L_RIGHT = 4;
-static const size_t NUM_ROT_L_LEFT = 4;
-static const size_t NUM_ROT_T = 4;
-static const size_t NUM_ROT_Z_RIGHT = 2;
-static const size_t NUM_ROT_Z_LEFT = 2;
-
-static const std::array<std::array<Coordinate, SQUARES_PER_PIECE>, NUM_ROT_SQUARE> ROTATIONS_SQUARE =
-{{{
-    { {0,0}, {1,0}, {0,1}, {1,1} }
-}}};
-
-static const std::array<std::array<Coordinate, SQUARES_PER_PIECE>, NUM_ROT_LINE> ROTATIONS_LINE =
-{{
-    {{ {-1,0}, {0,0}, {1,0}, {2,0} }},
-    {{ {0,-1}, {0,0}, {0,1}, {0,2} }}
-}};
-
-static const std::array<std::array<Coordinate, SQUARES_PER_PIECE>, NUM_ROT_L_RIGHT> ROTATIONS_L_RIGHT = 
-{{
-    {{ {0,0}, {1,0}, {2,0}, {0,1} }},
-    {{ {0,0}, {0,1}, {0,2}, {-1,0} }},
-    {{ {0,0}, {-1,0}, {-2,0}, {0,-1} }},
-    {{ {0,0}, {0,-1}, {0,-2}, {1,0} }}
-}};
-
-static const std::array<std::array<Coordinate, SQUARES_PER_PIECE>, NUM_ROT_L_LEFT> ROTATIONS_L_LEFT =
-{{
-    {{ {0,0}, {-1,0}, {-2,0}, {0,1} }},
-    {{ {0,0}, {0,-1}, {0,-2}, {-1,0} }},
-    {{ {0,0}, {1,0}, {2,0}, {0,-1} }},
-    {{ {0,0}, {0,1}, {0,2}, {1,0} }}
-}};
-
-static const std::array<std::array<Coordinate, SQUARES_PER_PIECE>, NUM_ROT_T> ROTATIONS_T =
-{{
-    {{ {-1,0}, {0,0}, {1,0}, {0,1} }},
-    {{ {0,-1}, {0,0}, {0,1}, {-1,0} }},
-    {{ {1,0}, {0,0}, {-1,0}, {0,-1} }},
-    {{ {0,1}, {0,0}, {0,-1}, {1,0} }}
-}};
-
-static const std::array<std::array<Coordinate, SQUARES_PER_PIECE>, NUM_ROT_Z_RIGHT> ROTATIONS_Z_RIGHT =
-{{
-    {{ {-1,0}, {0,0}, {0,1}, {1,1} }},
-    {{ {0,-1}, {0,0}, {-1,0}, {-1,1} }}
-}};
-
-static const std::array<std::array<Coordinate, SQUARES_PER_PIECE>, NUM_ROT_Z_LEFT> ROTATIONS_Z_LEFT =
-{{
-    {{ {-1,1}, {0,1}, {0,0}, {1,0} }},
-    {{ {-1,-1}, {-1,0}, {0,0}, {0,1} }}
-}};
-
-Piece::Piece(PIECE_TYPE t, int game_width)
+Piece::Piece(PIECE_TYPE t, int game_width, const RotationSystem& rotation_system)
 {
     m_type = t;
     m_rotation_index = 0;
+    m_origin = {game_width / 2, 0};
 
-    switch (m_type)
-    {
-    case SQUARE:
-        m_coords = ROTATIONS_SQUARE[m_rotation_index];
-        m_color = "yellow";
-        break;
-
-    case LINE:
-        m_coords = ROTATIONS_LINE[m_rotation_index];
-        m_color = "cyan";
-        break;
-        
-    case L_RIGHT:
-        m_coords = ROTATIONS_L_RIGHT[m_rotation_index];
-        m_color = "orange";
-        break;
-
-    case L_LEFT:
-        m_coords = ROTATIONS_L_LEFT[m_rotation_index];
-        m_color = "blue";
-        break;
-
-    case T:
-        m_coords = ROTATIONS_T[m_rotation_index];
-        m_color = "purple";
-        break;
-
-    case Z_RIGHT:
-        m_coords = ROTATIONS_Z_RIGHT[m_rotation_index];
-        m_color = "green";
-        break;
-
-    case Z_LEFT:
-        m_coords = ROTATIONS_Z_LEFT[m_rotation_index];
-        m_color = "red";
-        break;
-    }
+    m_color = PIECE_COLORS[m_type];
+
+    UpdateCoords(rotation_system);
+}
+
+/*Rebuilds a piece from its type, rotation and origin, used when loading snapshots*/
+Piece::Piece(PIECE_TYPE t, size_t rotation_index, const Coordinate& origin, const RotationSystem& rotation_system)
+{
+    m_type = t;
+    m_rotation_index = rotation_index;
+    m_origin = origin;
 
-    Coordinate movement = MOVEMENT_RIGHT;
-    movement *= (game_width / 2);
+    m_color = PIECE_COLORS[m_type];
 
-    Move(movement);
+    UpdateCoords(rotation_system);
 }
 
 void Piece::Move(const Coordinate& movement)
 {
+    m_origin += movement;
+
     for (Coordinate& coord : m_coords)
     {
         coord += movement;
     }
 }
 
-void Piece::Rotate(const Coordinate& coord_limits)
+/*Advances to the next rotation around the same origin, then shifts the piece back inside coord_limits*/
+void Piece::Rotate(const Coordinate& coord_limits, const RotationSystem& rotation_system)
 {
-    std::array<Coordinate, SQUARES_PER_PIECE> current_rot;
-    std::array<Coordinate, SQUARES_PER_PIECE> next_rot;
+    m_rotation_index = rotation_system.Next(m_type, m_rotation_index);
 
-    size_t current_rot_index = m_rotation_index;
-    m_rotation_index++;
-    
-    switch (m_type)
+    const PieceRotation& rotation = rotation_system.Get(m_type, m_rotation_index);
+
+    if (m_origin.x + rotation.min.x < 0)
+    {
+        m_origin.x = -rotation.min.x;
+    }
+    else if (m_origin.x + rotation.max.x >= coord_limits.x)
     {
-    case SQUARE:
-        if (m_rotation_index >= ROTATIONS_SQUARE.size())
-        {
-            m_rotation_index = 0;
-        }
-        current_rot = ROTATIONS_SQUARE[current_rot_index];
-        next_rot = ROTATIONS_SQUARE[m_rotation_index];
-        break;
-    case LINE:
-        if (m_rotation_index >= ROTATIONS_LINE.size())
-        {
-            m_rotation_index = 0;
-        }
-        current_rot = ROTATIONS_LINE[current_rot_index];
-        next_rot = ROTATIONS_LINE[m_rotation_index];
-        break;
-
-    case L_RIGHT:
-        if (m_rotation_index >= ROTATIONS_L_RIGHT.size())
-        {
-            m_rotation_index = 0;
-        }
-        current_rot = ROTATIONS_L_RIGHT[current_rot_index];
-        next_rot = ROTATIONS_L_RIGHT[m_rotation_index];
-        break;
-
-    case L_LEFT:
-        if (m_rotation_index >= ROTATIONS_L_LEFT.size())
-        {
-            m_rotation_index = 0;
-        }
-        current_rot = ROTATIONS_L_LEFT[current_rot_index];
-        next_rot = ROTATIONS_L_LEFT[m_rotation_index];
-        break;
-
-    case T:
-        if (m_rotation_index >= ROTATIONS_T.size())
-        {
-            m_rotation_index = 0;
-        }
-        current_rot = ROTATIONS_T[current_rot_index];
-        next_rot = ROTATIONS_T[m_rotation_index];
-        break;
-
-    case Z_RIGHT:
-        if (m_rotation_index >= ROTATIONS_Z_RIGHT.size())
-        {
-            m_rotation_index = 0;
-        }
-        current_rot = ROTATIONS_Z_RIGHT[current_rot_index];
-        next_rot = ROTATIONS_Z_RIGHT[m_rotation_index];
-        break;
-
-    case Z_LEFT:
-        if (m_rotation_index >= ROTATIONS_Z_LEFT.size())
-        {
-            m_rotation_index = 0;
-        }
-        current_rot = ROTATIONS_Z_LEFT[current_rot_index];
-        next_rot = ROTATIONS_Z_LEFT[m_rotation_index];
-        break;
+        m_origin.x = coord_limits.x - 1 - rotation.max.x;
     }
 
-    for (size_t i = 0; i < SQUARES_PER_PIECE; i++)
+    if (m_origin.y + rotation.min.y < 0)
     {
-        Coordinate offset
-        {
-            .x = m_coords[i].x - current_rot[i].x,
-            .y = m_coords[i].y - current_rot[i].y
-        };
-
-        m_coords[i].x = next_rot[i].x + offset.x;
-        m_coords[i].y = next_rot[i].y + offset.y;
+        m_origin.y = -rotation.min.y;
     }
+    else if (m_origin.y + rotation.max.y >= coord_limits.y)
+    {
+        m_origin.y = coord_limits.y - 1 - rotation.max.y;
+    }
+
+    UpdateCoords(rotation_system);
+}
 
-    bool in_bounds = false;
+void Piece::UpdateCoords(const RotationSystem& rotation_system)
+{
+    const PieceCells& cells = rotation_system.Get(m_type, m_rotation_index).cells;
 
-    while (!in_bounds)
+    for (size_t i = 0; i < SQUARES_PER_PIECE; i++)
     {
-        in_bounds = true;
-
-        for (Coordinate& c : m_coords)
-        {
-            if (c.x < 0)
-            {
-                Move(MOVEMENT_RIGHT);
-                in_bounds = false;
-                break;
-            }
-
-            if (c.x >= coord_limits.x)
-            {
-                Move(MOVEMENT_LEFT);
-                in_bounds = false;
-                break;
-            }
-
-            if (c.y < 0)
-            {
-                Move(MOVEMENT_DOWN);
-                in_bounds = false;
-                break;
-            }
-
-            if (c.y >= coord_limits.y)
-            {
-                Move(MOVEMENT_UP);
-                in_bounds = false;
-                break;
-            }
-        }
+        m_coords[i] = cells[i];
+        m_coords[i] += m_origin;
     }
 }
 
-std::vector<Square> Piece::GetSquares()
+std::array<Square, SQUARES_PER_PIECE> Piece::GetSquares() const
 {
-    std::vector<Square> squares;
+    std::array<Square, SQUARES_PER_PIECE> squares;
 
-    for (const Coordinate& coord : m_coords)
+    for (size_t i = 0; i < SQUARES_PER_PIECE; i++)
     {
-        Square sq;
-        sq.color = m_color;
-        sq.coord = coord;
-        squares.push_back(sq);
+        squares[i].coord = m_coords[i];
+        squares[i].color = m_color;
     }
 
     return squares;
-}
\ No newline at end of file
+}
@@ -0,0 +1,220 @@
+#include "placement_bench.hpp"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <vector>
+#include "debug.hpp"
+#include "game_core.hpp"
+#include "move_generator.hpp"
+#include "utility.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static size_t StateIndex(const Piece& piece)
+{
+    return (piece.m_rotation_index * COORD_LIMIT_Y + (size_t)piece.m_origin.y) * COORD_LIMIT_X + (size_t)piece.m_origin.x;
+}
+
+/*Marks every resting place of the falling piece in out_resting, found one position at a time with
+GameCore's own rules*/
+static void FindRestingPlaces(const GameCore& core, std::vector<bool>& out_resting)
+{
+    out_resting.assign(MAX_PIECE_STATES, false);
+
+    if (!core.CanMove(MOVEMENT_NULL, core.m_falling_piece))
+    {
+        return;
+    }
+
+    std::vector<bool> seen(MAX_PIECE_STATES, false);
+    std::vector<Piece> queue(1, core.m_falling_piece);
+    seen[StateIndex(core.m_falling_piece)] = true;
+    GameCore rotating(core);
+    GameEvent event;
+
+    for (size_t head = 0; head < queue.size(); head++)
+    {
+        Piece piece = queue[head];
+
+        if (!core.CanMove(MOVEMENT_DOWN, piece))
+        {
+            out_resting[StateIndex(piece)] = true;
+        }
+
+        std::array<Piece, 4> next;
+        size_t count = 0;
+
+        for (const Coordinate& movement : { MOVEMENT_LEFT, MOVEMENT_RIGHT, MOVEMENT_DOWN })
+        {
+            if (core.CanMove(movement, piece))
+            {
+                next[count] = piece;
+                next[count].Move(movement);
+                count++;
+            }
+        }
+
+        rotating.m_falling_piece = piece;
+        rotating.ApplyInput(INPUT_ROTATE);
+        next[count] = rotating.m_falling_piece;
+        count++;
+
+        while (rotating.PollEvent(event))
+        {
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!seen[StateIndex(next[i])])
+            {
+                seen[StateIndex(next[i])] = true;
+                queue.push_back(next[i]);
+            }
+        }
+    }
+}
+
+/*Plays the path on a copy of the game and hard drops, true if the piece ends on the placement*/
+static bool PlayPath(const GameCore& core, const Placement& placement)
+{
+    GameCore game(core);
+    Piece& piece = game.m_falling_piece;
+
+    for (size_t i = 0; i < placement.path_length; i++)
+    {
+        if (placement.path[i] == MOVE_ROTATE)
+        {
+            size_t rotation_index = piece.m_rotation_index;
+            game.ApplyInput(INPUT_ROTATE);
+
+            if (piece.m_rotation_index == rotation_index)
+            {
+                return false;
+            }
+
+            continue;
+        }
+
+        const Coordinate& movement = placement.path[i] == MOVE_LEFT ? MOVEMENT_LEFT :
+            (placement.path[i] == MOVE_RIGHT ? MOVEMENT_RIGHT : MOVEMENT_DOWN);
+
+        if (!game.CanMove(movement, piece))
+        {
+            return false;
+        }
+
+        piece.Move(movement);
+    }
+
+    piece.Move({0, game.DropDistance(piece)});
+
+    return piece.m_rotation_index == placement.rotation && piece.m_origin.x == placement.x &&
+        piece.m_origin.y == placement.y;
+}
+
+/*A straight drop's path is rotations then shifts, anything else went under something*/
+static bool IsTuck(const Placement& placement)
+{
+    bool shifted = false;
+
+    for (size_t i = 0; i < placement.path_length; i++)
+    {
+        if (placement.path[i] == MOVE_DOWN || (placement.path[i] == MOVE_ROTATE && shifted))
+        {
+            return true;
+        }
+
+        shifted = shifted || placement.path[i] != MOVE_ROTATE;
+    }
+
+    return false;
+}
+
+bool RunPlacementBench(const PlacementBenchOptions& options, PlacementBenchReport& out_report)
+{
+    Rng rng(options.seed != 0 ? options.seed : RandomSeed());
+    MoveGenerator generator;
+    std::vector<PlacementList> lists(1);   // too big for the stack
+    PlacementList& list = lists[0];
+    std::vector<bool> resting;
+    std::vector<double> piece_ns;
+    size_t repeats = std::max(options.repeats, (size_t)1);
+
+    for (size_t game = 0; game < options.games; game++)
+    {
+        GameSettings settings;
+        settings.seed = rng.Next() | 1;
+        GameCore core(settings);
+        GameEvent event;
+
+        while (core.m_game_running && core.m_pieces_placed < options.pieces_per_game)
+        {
+            Clock::time_point start = Clock::now();
+
+            for (size_t i = 0; i < repeats; i++)
+            {
+                generator.Generate(core.m_board, core.m_falling_piece, list);
+            }
+
+            piece_ns.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / repeats);
+
+            FindRestingPlaces(core, resting);
+            size_t expected = (size_t)std::count(resting.begin(), resting.end(), true);
+            bool same = list.count == expected;
+
+            for (size_t i = 0; i < list.count; i++)
+            {
+                const Placement& placement = list.placements[i];
+                Piece piece(core.m_falling_piece.m_type, placement.rotation, {placement.x, placement.y}, *core.m_rotation_system);
+                same = same && resting[StateIndex(piece)];
+
+                if (!PlayPath(core, placement))
+                {
+                    out_report.wrong_paths++;
+                }
+
+                if (IsTuck(placement))
+                {
+                    out_report.tucks++;
+                }
+            }
+
+            if (!same)
+            {
+                out_report.wrong_pieces++;
+            }
+
+            out_report.pieces++;
+            out_report.placements += list.count;
+
+            if (list.count == 0)
+            {
+                break;
+            }
+
+            // lower of two random picks, low enough to last and untidy enough to leave overhangs
+            const Placement& first = list.placements[rng.Range(0, list.count - 1)];
+            const Placement& second = list.placements[rng.Range(0, list.count - 1)];
+            const Placement& pick = second.y > first.y ? second : first;
+
+            core.m_falling_piece = Piece(core.m_falling_piece.m_type, pick.rotation, {pick.x, pick.y}, *core.m_rotation_system);
+            core.ApplyInput(INPUT_HARD_DROP);
+
+            while (core.PollEvent(event))
+            {
+            }
+        }
+    }
+
+    if (piece_ns.empty())
+    {
+        ERROR_PRINT("ERROR: placement bench played no pieces");
+        return false;
+    }
+
+    out_report.ns_per_piece = std::accumulate(piece_ns.begin(), piece_ns.end(), 0.0) / piece_ns.size();
+    out_report.ns_p50 = Percentile(piece_ns, 0.50);
+    out_report.ns_p99 = Percentile(piece_ns, 0.99);
+
+    return true;
+}
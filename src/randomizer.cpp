@@ -0,0 +1,44 @@
+#include "randomizer.hpp"
+
+PieceRandomizer::PieceRandomizer(RANDOMIZER_TYPE type, uint64_t seed)
+{
+    m_type = type;
+    m_rng.Seed(seed);
+    m_bag_index = PIECE_TYPE::LENGTH;
+}
+
+PIECE_TYPE PieceRandomizer::Next()
+{
+    if (m_type == RANDOMIZER_UNIFORM)
+    {
+        return (PIECE_TYPE)m_rng.Range(0, PIECE_TYPE::LENGTH - 1);
+    }
+
+    if (m_bag_index >= m_bag.size())
+    {
+        RefillBag();
+    }
+
+    PIECE_TYPE next = m_bag[m_bag_index];
+    m_bag_index++;
+    return next;
+}
+
+/*Fisher-Yates shuffle of one of each piece*/
+void PieceRandomizer::RefillBag()
+{
+    for (size_t i = 0; i < m_bag.size(); i++)
+    {
+        m_bag[i] = (PIECE_TYPE)i;
+    }
+
+    for (size_t i = m_bag.size() - 1; i > 0; i--)
+    {
+        size_t j = (size_t)m_rng.Range(0, i);
+        PIECE_TYPE temp = m_bag[i];
+        m_bag[i] = m_bag[j];
+        m_bag[j] = temp;
+    }
+
+    m_bag_index = 0;
+}
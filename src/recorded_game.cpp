@@ -0,0 +1,98 @@
+#include "recorded_game.hpp"
+#include <filesystem>
+#include "debug.hpp"
+
+RecordedGame::RecordedGame(const std::string& archive_path, const std::string& save_path,
+    const GameSettings& settings, const GameSnapshot* resume)
+    : m_core(settings), m_save_path(save_path)
+{
+    // a save that fails the snapshot checks starts a new game instead
+    bool resumed = resume != NULL && m_core.LoadSnapshot(*resume);
+
+    if (resume != NULL && !resumed)
+    {
+        ERROR_PRINT("ERROR: saved game is corrupt, starting a new one");
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(archive_path).parent_path(), error);
+    std::filesystem::create_directories(std::filesystem::path(save_path).parent_path(), error);
+
+    ReplayHeader header;
+    header.seed = m_core.m_seed;
+    header.randomizer = m_core.m_randomizer.m_type;
+
+    m_replay_archive = new ReplayArchiveWriter(archive_path);
+    m_replay = new ReplayWriter(*m_replay_archive, header);
+
+    // the resumed state opens the replay so it can be played back without the earlier session
+    if (resumed)
+    {
+        m_replay->WriteKeyframe(m_core);
+    }
+
+    m_save = new SaveGameWriter(save_path);
+    SaveGame();
+}
+
+/*A game left before it ended has no END, its replay is dropped from the archive. A kept save
+continues it later in a replay of its own that opens with the resumed keyframe*/
+RecordedGame::~RecordedGame()
+{
+    delete m_replay;
+    delete m_replay_archive;
+
+    // the writer has to finish with the file before it can go
+    delete m_save;
+
+    if (!m_keep_save)
+    {
+        std::error_code error;
+        std::filesystem::remove(m_save_path, error);
+    }
+}
+
+/*Every input goes through here so the replay sees exactly what GameCore saw*/
+void RecordedGame::ApplyInput(GAME_INPUT input)
+{
+    m_replay->RecordInput(m_core.m_tick, input);
+    m_core.ApplyInput(input);
+}
+
+/*One tick of the game, the replay finishes and the save goes away on the tick it ends*/
+void RecordedGame::Step()
+{
+    m_core.Step();
+    m_replay->Update(m_core);
+
+    if (!m_core.m_game_running)
+    {
+        m_replay->Finish(m_core);
+        DiscardSave();
+    }
+    else if (m_core.m_tick >= m_next_autosave_tick)
+    {
+        SaveGame();
+    }
+}
+
+/*Appends the current state to the save file, also done every AUTOSAVE_TICKS so a crash loses little*/
+void RecordedGame::SaveGame()
+{
+    if (!m_keep_save)
+    {
+        return;
+    }
+
+    GameSnapshot snapshot;
+    m_core.SaveSnapshot(snapshot);
+    m_save->Write(snapshot);
+
+    m_next_autosave_tick = m_core.m_tick + AUTOSAVE_TICKS;
+}
+
+/*The save file is removed when the game is deleted, Continue on the title screen goes away*/
+void RecordedGame::DiscardSave()
+{
+    m_keep_save = false;
+}
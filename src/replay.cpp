@@ -0,0 +1,588 @@
+#include "replay.hpp"
+#include <algorithm>
+#include <cstring>
+#include "debug.hpp"
+#include "replay_archive.hpp"
+
+void PutU16(std::vector<uint8_t>& out, uint16_t value)
+{
+    out.push_back((uint8_t)value);
+    out.push_back((uint8_t)(value >> 8));
+}
+
+void PutU32(std::vector<uint8_t>& out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        out.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+void PutU64(std::vector<uint8_t>& out, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        out.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+/*LEB128, 7 bits per byte with the high bit set on every byte but the last*/
+void PutVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+uint16_t GetU16(const uint8_t* bytes)
+{
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+uint32_t GetU32(const uint8_t* bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+uint64_t GetU64(const uint8_t* bytes)
+{
+    uint64_t value = 0;
+
+    for (int i = 0; i < 8; i++)
+    {
+        value |= (uint64_t)bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+/*Reads one LEB128 value and advances the cursor, false if the stream is truncated or overlong*/
+bool GetVarint(const uint8_t*& cursor, const uint8_t* end, uint64_t& out_value)
+{
+    out_value = 0;
+
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (cursor >= end)
+        {
+            return false;
+        }
+
+        uint8_t byte = *cursor;
+        cursor++;
+        out_value |= (uint64_t)(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+ReplayWriter::ReplayWriter(const std::string& path, const ReplayHeader& header)
+{
+    m_file = new AsyncFileWriter(path);
+    m_file->Reserve(REPLAY_FLUSH_BUFFERS, REPLAY_BUFFER_SIZE);
+    m_buffer.reserve(REPLAY_BUFFER_SIZE);
+    m_index.reserve(REPLAY_INDEX_RESERVE);
+    WriteHeader(header);
+}
+
+/*Hands the stream to the archive chunk by chunk, it becomes one block at Finish*/
+ReplayWriter::ReplayWriter(ReplayArchiveWriter& archive, const ReplayHeader& header)
+{
+    m_archive = &archive;
+    m_archive->Reserve(REPLAY_FLUSH_BUFFERS, REPLAY_BUFFER_SIZE);
+    m_buffer.reserve(REPLAY_BUFFER_SIZE);
+    m_index.reserve(REPLAY_INDEX_RESERVE);
+    WriteHeader(header);
+}
+
+void ReplayWriter::WriteHeader(const ReplayHeader& header)
+{
+    m_metadata.seed = header.seed;
+    m_metadata.randomizer = header.randomizer;
+
+    m_buffer.insert(m_buffer.end(), REPLAY_MAGIC, REPLAY_MAGIC + sizeof(REPLAY_MAGIC));
+    PutU16(m_buffer, header.version);
+    PutU64(m_buffer, header.seed);
+    m_buffer.push_back(header.randomizer);
+    m_buffer.push_back(header.board_width);
+    m_buffer.push_back(header.board_height);
+    PutU16(m_buffer, header.tick_rate);
+}
+
+ReplayWriter::~ReplayWriter()
+{
+    if (m_archive != NULL)
+    {
+        // archive blocks are written whole, an unfinished replay is dropped rather than torn
+        if (!m_finished)
+        {
+            m_archive->DropReplay();
+        }
+        return;
+    }
+
+    Flush();
+    delete m_file;
+}
+
+void ReplayWriter::RecordInput(uint32_t tick, GAME_INPUT input)
+{
+    if (m_finished)
+    {
+        return;
+    }
+
+    PutVarint(m_buffer, tick - m_last_tick);
+    m_buffer.push_back((uint8_t)input);
+    m_last_tick = tick;
+
+    if (m_buffer.size() >= REPLAY_FLUSH_SIZE)
+    {
+        Flush();
+    }
+}
+
+/*Writes a keyframe every REPLAY_KEYFRAME_PIECES locked pieces, call once per tick after the core stepped*/
+void ReplayWriter::Update(const GameCore& core)
+{
+    if (core.m_pieces_placed >= m_next_keyframe_pieces)
+    {
+        WriteKeyframe(core);
+    }
+}
+
+/*A keyframe before any input is where the replay starts, see SimulateReplay*/
+void ReplayWriter::WriteKeyframe(const GameCore& core)
+{
+    if (m_finished)
+    {
+        return;
+    }
+
+    GameSnapshot snapshot;
+    core.SaveSnapshot(snapshot);
+
+    PutVarint(m_buffer, core.m_tick - m_last_tick);
+    m_index.push_back({core.m_tick, m_bytes_flushed + m_buffer.size()});
+    m_buffer.push_back(REPLAY_KEYFRAME);
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&snapshot);
+    m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(snapshot));
+
+    m_last_tick = core.m_tick;
+    m_next_keyframe_pieces = (core.m_pieces_placed / REPLAY_KEYFRAME_PIECES + 1) * REPLAY_KEYFRAME_PIECES;
+
+    if (m_buffer.size() >= REPLAY_FLUSH_SIZE)
+    {
+        Flush();
+    }
+}
+
+void ReplayWriter::Finish(const GameCore& core)
+{
+    if (m_finished)
+    {
+        return;
+    }
+
+    PutVarint(m_buffer, core.m_tick - m_last_tick);
+    m_buffer.push_back(REPLAY_END);
+    PutVarint(m_buffer, core.m_lines_cleared);
+    PutVarint(m_buffer, core.m_pieces_placed);
+    m_last_tick = core.m_tick;
+    m_finished = true;
+
+    m_metadata.lines_cleared = (uint32_t)core.m_lines_cleared;
+    m_metadata.pieces_placed = (uint32_t)core.m_pieces_placed;
+    m_metadata.ticks = core.m_tick;
+    m_metadata.fall_ticks = (uint16_t)core.m_fall_ticks;
+
+    uint64_t index_offset = m_bytes_flushed + m_buffer.size();
+    PutVarint(m_buffer, m_index.size());
+
+    // flushed as it goes so a long index never outgrows the buffer
+    for (const ReplayIndexEntry& entry : m_index)
+    {
+        PutU32(m_buffer, entry.tick);
+        PutU64(m_buffer, entry.offset);
+
+        if (m_buffer.size() >= REPLAY_FLUSH_SIZE)
+        {
+            Flush();
+        }
+    }
+
+    PutU64(m_buffer, index_offset);
+    m_buffer.insert(m_buffer.end(), REPLAY_INDEX_MAGIC, REPLAY_INDEX_MAGIC + sizeof(REPLAY_INDEX_MAGIC));
+
+    Flush();
+
+    if (m_archive != NULL)
+    {
+        m_archive->EndReplay(m_metadata);
+    }
+}
+
+/*Hands the buffer to the writer thread and takes back one it already wrote out,
+nothing here touches the disk and unless the disk is behind nothing allocates*/
+void ReplayWriter::Flush()
+{
+    if (m_buffer.empty())
+    {
+        return;
+    }
+
+    m_bytes_flushed += m_buffer.size();
+
+    if (m_archive != NULL)
+    {
+        m_archive->Write(std::move(m_buffer));
+        m_archive->TakeBuffer(m_buffer, REPLAY_BUFFER_SIZE);
+        return;
+    }
+
+    m_file->Write(std::move(m_buffer));
+    m_file->TakeBuffer(m_buffer, REPLAY_BUFFER_SIZE);
+}
+
+bool ReplayReader::Open(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (file == NULL)
+    {
+        ERROR_PRINT("ERROR: could not open replay " << path);
+        return false;
+    }
+
+    std::vector<uint8_t> bytes;
+    uint8_t block[4096];
+    size_t count;
+
+    while ((count = fread(block, 1, sizeof(block), file)) > 0)
+    {
+        bytes.insert(bytes.end(), block, block + count);
+    }
+    fclose(file);
+
+    return Load(std::move(bytes));
+}
+
+/*Takes ownership of a whole replay stream and parses its header*/
+bool ReplayReader::Load(std::vector<uint8_t>&& bytes)
+{
+    static const size_t HEADER_SIZE = 4 + 2 + 8 + 1 + 1 + 1 + 2;
+
+    m_bytes = std::move(bytes);
+    m_header_size = HEADER_SIZE;
+    m_records_end = m_bytes.size();
+    m_position = HEADER_SIZE;
+    m_last_tick = 0;
+    m_has_end = false;
+    m_starts_with_keyframe = false;
+    m_index.clear();
+
+    if (m_bytes.size() < HEADER_SIZE || memcmp(m_bytes.data(), REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0)
+    {
+        ERROR_PRINT("ERROR: not a replay stream");
+        return false;
+    }
+
+    const uint8_t* bytes_in = m_bytes.data() + sizeof(REPLAY_MAGIC);
+    m_header.version = GetU16(bytes_in);
+    m_header.seed = GetU64(bytes_in + 2);
+    m_header.randomizer = (RANDOMIZER_TYPE)bytes_in[10];
+    m_header.board_width = bytes_in[11];
+    m_header.board_height = bytes_in[12];
+    m_header.tick_rate = GetU16(bytes_in + 13);
+
+    if (m_header.version != 1 && m_header.version != REPLAY_VERSION)
+    {
+        ERROR_PRINT("ERROR: unsupported replay version " << m_header.version);
+        return false;
+    }
+
+    if (m_header.board_width != COORD_LIMIT_X || m_header.board_height != COORD_LIMIT_Y ||
+        m_header.tick_rate != TICKS_PER_SECOND)
+    {
+        ERROR_PRINT("ERROR: replay was recorded with different board size or tick rate");
+        return false;
+    }
+
+    if (m_header.version >= 2)
+    {
+        LoadIndex();
+    }
+
+    // a game resumed from a save opens with a keyframe instead of starting from the seed
+    const uint8_t* cursor = m_bytes.data() + m_header_size;
+    uint64_t delta;
+    m_starts_with_keyframe = GetVarint(cursor, m_bytes.data() + m_records_end, delta) &&
+        cursor < m_bytes.data() + m_records_end && *cursor == REPLAY_KEYFRAME;
+
+    return true;
+}
+
+/*Reads the keyframe index through the footer. A stream without one (the game was cut off
+before Finish) is still playable, Seek just has to simulate from the start*/
+void ReplayReader::LoadIndex()
+{
+    if (m_bytes.size() < m_header_size + REPLAY_FOOTER_SIZE)
+    {
+        return;
+    }
+
+    const uint8_t* footer = m_bytes.data() + m_bytes.size() - REPLAY_FOOTER_SIZE;
+
+    if (memcmp(footer + 8, REPLAY_INDEX_MAGIC, sizeof(REPLAY_INDEX_MAGIC)) != 0)
+    {
+        DEBUG_PRINT("WARN: replay has no keyframe index");
+        return;
+    }
+
+    uint64_t index_offset = GetU64(footer);
+
+    if (index_offset < m_header_size || index_offset > (uint64_t)(footer - m_bytes.data()))
+    {
+        ERROR_PRINT("ERROR: replay index offset out of range");
+        return;
+    }
+
+    const uint8_t* cursor = m_bytes.data() + index_offset;
+    uint64_t count;
+
+    if (!GetVarint(cursor, footer, count) || count > (uint64_t)(footer - cursor) / 12)
+    {
+        ERROR_PRINT("ERROR: replay index is corrupt");
+        return;
+    }
+
+    m_index.resize((size_t)count);
+
+    for (ReplayIndexEntry& entry : m_index)
+    {
+        entry.tick = GetU32(cursor);
+        entry.offset = GetU64(cursor + 4);
+        cursor += 12;
+    }
+
+    m_records_end = (size_t)index_offset;
+}
+
+/*Decodes the next record, false once the END record or the end of the stream is reached*/
+bool ReplayReader::NextRecord(ReplayRecord& out_record)
+{
+    if (m_has_end)
+    {
+        return false;
+    }
+
+    const uint8_t* cursor = m_bytes.data() + m_position;
+    const uint8_t* end = m_bytes.data() + m_records_end;
+    uint64_t delta;
+
+    if (!GetVarint(cursor, end, delta) || cursor >= end)
+    {
+        return false;
+    }
+
+    out_record.tick = m_last_tick + (uint32_t)delta;
+    out_record.input = *cursor;
+    cursor++;
+
+    if (out_record.input == REPLAY_END)
+    {
+        uint64_t lines, pieces;
+
+        if (!GetVarint(cursor, end, lines) || !GetVarint(cursor, end, pieces))
+        {
+            return false;
+        }
+
+        m_has_end = true;
+        m_end_lines = (size_t)lines;
+        m_end_pieces = (size_t)pieces;
+    }
+    else if (out_record.input == REPLAY_KEYFRAME)
+    {
+        if ((size_t)(end - cursor) < sizeof(GameSnapshot))
+        {
+            return false;
+        }
+
+        memcpy(&m_keyframe, cursor, sizeof(GameSnapshot));
+        cursor += sizeof(GameSnapshot);
+
+        // written on the tick it holds, anything else would have the replay step to a tick it never reached
+        if (m_keyframe.tick != out_record.tick)
+        {
+            ERROR_PRINT("ERROR: replay keyframe is for tick " << m_keyframe.tick << ", recorded at " << out_record.tick);
+            return false;
+        }
+    }
+    else if (out_record.input >= INPUT_LENGTH)
+    {
+        ERROR_PRINT("ERROR: bad replay input " << (int)out_record.input);
+        return false;
+    }
+
+    m_last_tick = out_record.tick;
+    m_position = cursor - m_bytes.data();
+    return true;
+}
+
+/*Puts core in the state it had once every record up to and including tick was applied. Starts
+from the last keyframe at or before tick so only the remainder is simulated*/
+bool ReplayReader::Seek(uint32_t tick, GameCore& core)
+{
+    auto after = std::upper_bound(m_index.begin(), m_index.end(), tick,
+        [](uint32_t t, const ReplayIndexEntry& entry) { return t < entry.tick; });
+
+    m_has_end = false;
+
+    // nothing before the resume point was recorded, the closest state is the first keyframe
+    if (after == m_index.begin() && m_starts_with_keyframe && !m_index.empty())
+    {
+        after++;
+    }
+
+    if (after != m_index.begin())
+    {
+        const ReplayIndexEntry& entry = *(after - 1);
+
+        if (entry.offset + 1 + sizeof(GameSnapshot) > m_records_end || m_bytes[entry.offset] != REPLAY_KEYFRAME)
+        {
+            ERROR_PRINT("ERROR: replay index points at a bad keyframe");
+            return false;
+        }
+
+        memcpy(&m_keyframe, &m_bytes[entry.offset + 1], sizeof(GameSnapshot));
+
+        if (m_keyframe.tick != entry.tick || !core.LoadSnapshot(m_keyframe))
+        {
+            ERROR_PRINT("ERROR: replay keyframe at tick " << entry.tick << " is corrupt");
+            return false;
+        }
+
+        m_position = (size_t)entry.offset + 1 + sizeof(GameSnapshot);
+        m_last_tick = entry.tick;
+    }
+    else
+    {
+        GameSnapshot start;
+        GameCore(Settings()).SaveSnapshot(start);
+        core.LoadSnapshot(start);
+
+        m_position = m_header_size;
+        m_last_tick = 0;
+    }
+
+    GameEvent event;
+    ReplayRecord record;
+
+    while (true)
+    {
+        size_t position = m_position;
+        uint32_t last_tick = m_last_tick;
+
+        if (!NextRecord(record))
+        {
+            break;
+        }
+
+        if (record.tick > tick)
+        {
+            // leave the record for the caller to read next
+            m_position = position;
+            m_last_tick = last_tick;
+            m_has_end = false;
+            break;
+        }
+
+        while (core.m_game_running && core.m_tick < record.tick)
+        {
+            core.Step();
+            while (core.PollEvent(event));
+        }
+
+        if (record.input < INPUT_LENGTH)
+        {
+            core.ApplyInput((GAME_INPUT)record.input);
+        }
+    }
+
+    while (core.m_game_running && core.m_tick < tick)
+    {
+        core.Step();
+        while (core.PollEvent(event));
+    }
+
+    while (core.PollEvent(event));
+    return true;
+}
+
+GameSettings ReplayReader::Settings() const
+{
+    GameSettings settings;
+    settings.seed = m_header.seed;
+    settings.randomizer = m_header.randomizer;
+    return settings;
+}
+
+/*Runs a replay through GameCore as fast as possible. Inputs are applied before the tick they
+were recorded on, the same order InGameState::ApplyInput and InGameState::Step use live*/
+bool SimulateReplay(ReplayReader& reader, ReplayResult& out_result)
+{
+    GameCore core(reader.Settings());
+    GameEvent event;
+    ReplayRecord record;
+    bool first_record = true;
+
+    out_result.resumed = false;
+
+    while (reader.NextRecord(record))
+    {
+        // a game resumed from a save starts from the state it was saved in
+        if (first_record && record.input == REPLAY_KEYFRAME)
+        {
+            out_result.resumed = true;
+
+            if (!core.LoadSnapshot(reader.m_keyframe))
+            {
+                out_result.corrupt = true;
+                return false;
+            }
+        }
+
+        first_record = false;
+
+        while (core.m_game_running && core.m_tick < record.tick)
+        {
+            core.Step();
+            while (core.PollEvent(event));
+        }
+
+        if (record.input < INPUT_LENGTH)
+        {
+            core.ApplyInput((GAME_INPUT)record.input);
+            while (core.PollEvent(event));
+        }
+    }
+
+    out_result.ticks = core.m_tick;
+    out_result.lines_cleared = core.m_lines_cleared;
+    out_result.pieces_placed = core.m_pieces_placed;
+    out_result.fall_ticks = core.m_fall_ticks;
+    out_result.checksum = core.Checksum();
+    out_result.has_end = reader.m_has_end;
+    out_result.recorded_lines = reader.m_end_lines;
+    out_result.recorded_pieces = reader.m_end_pieces;
+
+    return reader.m_has_end;
+}
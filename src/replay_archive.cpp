@@ -0,0 +1,550 @@
+#include "replay_archive.hpp"
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include "debug.hpp"
+
+// binary probabilities are 11 bit fixed point and adapt by 1/32 of the error per bit
+static const int PROB_BITS = 11;
+static const uint16_t PROB_ONE = 1 << PROB_BITS;
+static const int PROB_ADAPT_SHIFT = 5;
+static const uint32_t RANGE_TOP = 1 << 24;
+
+// one probability per node of a 256 leaf bit tree, node 0 is unused
+typedef std::array<uint16_t, 256> ByteModel;
+
+class RangeEncoder
+{
+public:
+    RangeEncoder(std::vector<uint8_t>& out) : m_out(out) {}
+
+    void EncodeBit(uint16_t& prob, int bit)
+    {
+        uint32_t bound = (m_range >> PROB_BITS) * prob;
+
+        if (bit == 0)
+        {
+            m_range = bound;
+            prob += (PROB_ONE - prob) >> PROB_ADAPT_SHIFT;
+        }
+        else
+        {
+            m_low += bound;
+            m_range -= bound;
+            prob -= prob >> PROB_ADAPT_SHIFT;
+        }
+
+        while (m_range < RANGE_TOP)
+        {
+            m_range <<= 8;
+            ShiftLow();
+        }
+    }
+
+    void EncodeByte(ByteModel& model, uint8_t value)
+    {
+        size_t node = 1;
+
+        for (int i = 7; i >= 0; i--)
+        {
+            int bit = (value >> i) & 1;
+            EncodeBit(model[node], bit);
+            node = (node << 1) | bit;
+        }
+    }
+
+    void Finish()
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            ShiftLow();
+        }
+    }
+
+private:
+    /*Emits the top byte of low. Bytes are held back while they are 0xFF in case a carry still has to ripple into them*/
+    void ShiftLow()
+    {
+        if ((uint32_t)m_low < 0xFF000000 || (m_low >> 32) != 0)
+        {
+            uint8_t carry = (uint8_t)(m_low >> 32);
+            uint8_t pending = m_cache;
+
+            do
+            {
+                m_out.push_back((uint8_t)(pending + carry));
+                pending = 0xFF;
+            } while (--m_cache_size != 0);
+
+            m_cache = (uint8_t)(m_low >> 24);
+        }
+
+        m_cache_size++;
+        m_low = (m_low & 0x00FFFFFF) << 8;
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+    uint64_t m_low = 0;
+    uint32_t m_range = 0xFFFFFFFF;
+    uint8_t m_cache = 0;
+    uint64_t m_cache_size = 1;
+};
+
+class RangeDecoder
+{
+public:
+    RangeDecoder(const uint8_t* bytes, size_t size) : m_cursor(bytes), m_end(bytes + size)
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            m_code = (m_code << 8) | NextByte();
+        }
+    }
+
+    int DecodeBit(uint16_t& prob)
+    {
+        uint32_t bound = (m_range >> PROB_BITS) * prob;
+        int bit;
+
+        if (m_code < bound)
+        {
+            m_range = bound;
+            prob += (PROB_ONE - prob) >> PROB_ADAPT_SHIFT;
+            bit = 0;
+        }
+        else
+        {
+            m_code -= bound;
+            m_range -= bound;
+            prob -= prob >> PROB_ADAPT_SHIFT;
+            bit = 1;
+        }
+
+        while (m_range < RANGE_TOP)
+        {
+            m_range <<= 8;
+            m_code = (m_code << 8) | NextByte();
+        }
+        return bit;
+    }
+
+    uint8_t DecodeByte(ByteModel& model)
+    {
+        size_t node = 1;
+
+        for (int i = 0; i < 8; i++)
+        {
+            node = (node << 1) | DecodeBit(model[node]);
+        }
+        return (uint8_t)node;
+    }
+
+    bool Overrun() const
+    {
+        return m_overrun;
+    }
+
+private:
+    uint8_t NextByte()
+    {
+        if (m_cursor >= m_end)
+        {
+            m_overrun = true;
+            return 0;
+        }
+
+        uint8_t byte = *m_cursor;
+        m_cursor++;
+        return byte;
+    }
+
+private:
+    const uint8_t* m_cursor;
+    const uint8_t* m_end;
+    uint32_t m_range = 0xFFFFFFFF;
+    uint32_t m_code = 0;
+    bool m_overrun = false;
+};
+
+/*Reflected CRC-32 (the zlib one), table built on first use*/
+uint32_t Crc32(const uint8_t* bytes, size_t size)
+{
+    static const std::array<uint32_t, 256> table = []
+    {
+        std::array<uint32_t, 256> result;
+
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t value = i;
+
+            for (int bit = 0; bit < 8; bit++)
+            {
+                value = (value & 1) ? (value >> 1) ^ 0xEDB88320 : value >> 1;
+            }
+            result[i] = value;
+        }
+        return result;
+    }();
+
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+void PackBytes(const std::vector<uint8_t>& raw, std::vector<uint8_t>& out_packed)
+{
+    ByteModel model;
+    model.fill(PROB_ONE / 2);
+
+    out_packed.clear();
+    out_packed.reserve(raw.size() / 2 + 16);
+
+    RangeEncoder encoder(out_packed);
+
+    for (uint8_t byte : raw)
+    {
+        encoder.EncodeByte(model, byte);
+    }
+    encoder.Finish();
+}
+
+/*False if the packed bytes run out before raw_size bytes were decoded*/
+bool UnpackBytes(const uint8_t* packed, size_t packed_size, size_t raw_size, std::vector<uint8_t>& out_raw)
+{
+    ByteModel model;
+    model.fill(PROB_ONE / 2);
+
+    out_raw.resize(raw_size);
+
+    RangeDecoder decoder(packed, packed_size);
+
+    for (size_t i = 0; i < raw_size; i++)
+    {
+        out_raw[i] = decoder.DecodeByte(model);
+    }
+    return !decoder.Overrun();
+}
+
+bool IsReplayArchive(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    char magic[sizeof(REPLAY_ARCHIVE_MAGIC)];
+    bool is_archive = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+        memcmp(magic, REPLAY_ARCHIVE_MAGIC, sizeof(magic)) == 0;
+
+    fclose(file);
+    return is_archive;
+}
+
+// tags of the chunks ReplayArchiveWriter queues on its file
+static const uint8_t ARCHIVE_CHUNK_STREAM = 1;  // more of the replay being recorded
+static const uint8_t ARCHIVE_CHUNK_END = 2;     // the replay is complete, the chunk holds its ReplayMetadata
+static const uint8_t ARCHIVE_CHUNK_DROP = 3;    // forget the replay, no bytes
+
+ReplayArchiveWriter::ReplayArchiveWriter(const std::string& path)
+{
+    std::error_code error;
+    uintmax_t existing_size = std::filesystem::file_size(path, error);
+    bool is_new = error || existing_size == 0;
+
+    if (!is_new && !IsReplayArchive(path))
+    {
+        ERROR_PRINT("ERROR: " << path << " is not a replay archive, not recording replays into it");
+        return;
+    }
+
+    if (!m_file.Open(path, true, this))
+    {
+        return;
+    }
+
+    m_index.Open(ReplayIndexPath(path));
+
+    if (is_new)
+    {
+        std::vector<uint8_t> header;
+        header.insert(header.end(), REPLAY_ARCHIVE_MAGIC, REPLAY_ARCHIVE_MAGIC + sizeof(REPLAY_ARCHIVE_MAGIC));
+        PutU16(header, REPLAY_ARCHIVE_VERSION);
+        m_size = header.size();
+        m_file.Write(std::move(header));
+    }
+    else
+    {
+        m_size = existing_size;
+    }
+}
+
+/*Sets count empty chunks of capacity bytes aside for TakeBuffer, plus one for EndReplay*/
+void ReplayArchiveWriter::Reserve(size_t count, size_t capacity)
+{
+    m_file.Reserve(count + 1, capacity);
+}
+
+/*Adds chunk to the end of the replay being written*/
+void ReplayArchiveWriter::Write(std::vector<uint8_t>&& chunk)
+{
+    if (!chunk.empty())
+    {
+        m_file.Write(std::move(chunk), ARCHIVE_CHUNK_STREAM);
+    }
+}
+
+/*Leaves out_buffer empty with room for capacity bytes, see AsyncFileWriter::TakeBuffer*/
+void ReplayArchiveWriter::TakeBuffer(std::vector<uint8_t>& out_buffer, size_t capacity)
+{
+    m_file.TakeBuffer(out_buffer, capacity);
+}
+
+/*The chunks written so far are one complete replay, compress it and append it as a block*/
+void ReplayArchiveWriter::EndReplay(const ReplayMetadata& metadata)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&metadata);
+
+    std::vector<uint8_t> chunk;
+    m_file.TakeBuffer(chunk, sizeof(metadata));
+    chunk.insert(chunk.end(), bytes, bytes + sizeof(metadata));
+    m_file.Write(std::move(chunk), ARCHIVE_CHUNK_END);
+}
+
+/*Forgets the chunks written so far, the next Write starts a new replay*/
+void ReplayArchiveWriter::DropReplay()
+{
+    m_file.Write(std::vector<uint8_t>(), ARCHIVE_CHUNK_DROP);
+}
+
+/*Runs on m_file's thread, out_bytes is what goes into the archive*/
+void ReplayArchiveWriter::HandleChunk(const std::vector<uint8_t>& chunk, uint8_t tag, std::vector<uint8_t>& out_bytes)
+{
+    switch (tag)
+    {
+    case ARCHIVE_CHUNK_STREAM:
+        m_stream.insert(m_stream.end(), chunk.begin(), chunk.end());
+        break;
+
+    case ARCHIVE_CHUNK_END:
+    {
+        ReplayMetadata metadata;
+
+        if (chunk.size() == sizeof(metadata))
+        {
+            memcpy(&metadata, chunk.data(), sizeof(metadata));
+            Append(metadata, out_bytes);
+        }
+        m_stream.clear();
+        break;
+    }
+
+    case ARCHIVE_CHUNK_DROP:
+        m_stream.clear();
+        break;
+    }
+}
+
+/*Compresses the finished replay in m_stream into one block and records it in the index*/
+void ReplayArchiveWriter::Append(const ReplayMetadata& metadata, std::vector<uint8_t>& out_block)
+{
+    if (m_stream.size() > REPLAY_BLOCK_MAX_SIZE)
+    {
+        ERROR_PRINT("ERROR: replay of " << m_stream.size() << " bytes is too large for the archive");
+        return;
+    }
+
+    PackBytes(m_stream, m_packed);
+
+    REPLAY_CODEC codec = m_packed.size() < m_stream.size() ? CODEC_RANGE : CODEC_STORED;
+    const std::vector<uint8_t>& payload = codec == CODEC_RANGE ? m_packed : m_stream;
+
+    out_block.insert(out_block.end(), REPLAY_BLOCK_MAGIC, REPLAY_BLOCK_MAGIC + sizeof(REPLAY_BLOCK_MAGIC));
+    out_block.push_back(codec);
+    PutU32(out_block, (uint32_t)m_stream.size());
+    PutU32(out_block, (uint32_t)payload.size());
+    PutU32(out_block, Crc32(m_stream.data(), m_stream.size()));
+    out_block.insert(out_block.end(), payload.begin(), payload.end());
+
+    ReplayMetadata indexed = metadata;
+    indexed.archive_offset = m_size;
+    m_size += out_block.size();
+    m_index.Append(indexed);
+}
+
+ReplayArchiveReader::~ReplayArchiveReader()
+{
+    if (m_file != NULL)
+    {
+        fclose(m_file);
+    }
+}
+
+bool ReplayArchiveReader::Open(const std::string& path)
+{
+    m_file = fopen(path.c_str(), "rb");
+
+    if (m_file == NULL)
+    {
+        ERROR_PRINT("ERROR: could not open replay archive " << path);
+        return false;
+    }
+
+    uint8_t header[REPLAY_ARCHIVE_HEADER_SIZE];
+
+    if (fread(header, 1, sizeof(header), m_file) != sizeof(header) ||
+        memcmp(header, REPLAY_ARCHIVE_MAGIC, sizeof(REPLAY_ARCHIVE_MAGIC)) != 0)
+    {
+        ERROR_PRINT("ERROR: " << path << " is not a replay archive");
+        return false;
+    }
+
+    if (GetU16(header + 4) != REPLAY_ARCHIVE_VERSION)
+    {
+        ERROR_PRINT("ERROR: unsupported replay archive version " << GetU16(header + 4));
+        return false;
+    }
+
+    m_offset = REPLAY_ARCHIVE_HEADER_SIZE;
+    return true;
+}
+
+/*Reads up to and including the next block magic. Garbage in between, such as a block torn by a
+crash that was later appended after, is skipped and counted as one corrupt block*/
+bool ReplayArchiveReader::FindBlockMagic()
+{
+    uint8_t window[sizeof(REPLAY_BLOCK_MAGIC)];
+
+    if (fread(window, 1, sizeof(window), m_file) != sizeof(window))
+    {
+        return false;
+    }
+
+    m_offset += sizeof(window);
+    uint64_t skipped = 0;
+
+    while (memcmp(window, REPLAY_BLOCK_MAGIC, sizeof(window)) != 0)
+    {
+        int byte = fgetc(m_file);
+
+        if (byte == EOF)
+        {
+            m_corrupt_blocks++;
+            return false;
+        }
+
+        memmove(window, window + 1, sizeof(window) - 1);
+        window[sizeof(window) - 1] = (uint8_t)byte;
+        m_offset++;
+        skipped++;
+    }
+
+    if (skipped > 0)
+    {
+        ERROR_PRINT("ERROR: skipped " << skipped << " bytes of damaged replay archive");
+        m_corrupt_blocks++;
+    }
+
+    m_block_offset = m_offset - sizeof(window);
+    return true;
+}
+
+/*Reads the next block without decoding it, false at the end of the archive. Blocks with a
+damaged header are skipped here, damaged payloads are only found by DecodeReplayBlock*/
+bool ReplayArchiveReader::NextBlock(ReplayBlock& out_block)
+{
+    if (m_file == NULL)
+    {
+        return false;
+    }
+
+    while (FindBlockMagic())
+    {
+        uint8_t header[REPLAY_BLOCK_HEADER_SIZE - sizeof(REPLAY_BLOCK_MAGIC)];
+
+        if (fread(header, 1, sizeof(header), m_file) != sizeof(header))
+        {
+            ERROR_PRINT("ERROR: replay archive ends inside a block header");
+            m_corrupt_blocks++;
+            return false;
+        }
+
+        m_offset += sizeof(header);
+
+        out_block.offset = m_block_offset;
+        out_block.codec = header[0];
+        out_block.raw_size = GetU32(header + 1);
+        out_block.crc = GetU32(header + 9);
+        uint32_t packed_size = GetU32(header + 5);
+
+        if (out_block.raw_size > REPLAY_BLOCK_MAX_SIZE || packed_size > REPLAY_BLOCK_MAX_SIZE ||
+            (out_block.codec != CODEC_STORED && out_block.codec != CODEC_RANGE))
+        {
+            ERROR_PRINT("ERROR: bad replay archive block header at " << m_block_offset);
+            m_corrupt_blocks++;
+            continue;
+        }
+
+        out_block.packed.resize(packed_size);
+
+        if (fread(out_block.packed.data(), 1, packed_size, m_file) != packed_size)
+        {
+            ERROR_PRINT("ERROR: replay archive ends inside a block");
+            m_corrupt_blocks++;
+            return false;
+        }
+
+        m_offset += packed_size;
+        return true;
+    }
+
+    return false;
+}
+
+/*Loads the next intact game into out_replay, false at the end of the archive*/
+bool ReplayArchiveReader::Next(ReplayReader& out_replay)
+{
+    while (NextBlock(m_block))
+    {
+        if (DecodeReplayBlock(m_block, out_replay))
+        {
+            return true;
+        }
+
+        m_corrupt_blocks++;
+    }
+
+    return false;
+}
+
+/*Unpacks and checks one block. Safe to call from any thread, so callers that want to
+spread decoding over workers can read blocks with NextBlock and decode them elsewhere*/
+bool DecodeReplayBlock(const ReplayBlock& block, ReplayReader& out_replay)
+{
+    std::vector<uint8_t> raw;
+    bool unpacked;
+
+    if (block.codec == CODEC_STORED)
+    {
+        raw.assign(block.packed.begin(), block.packed.end());
+        unpacked = raw.size() == block.raw_size;
+    }
+    else
+    {
+        unpacked = UnpackBytes(block.packed.data(), block.packed.size(), block.raw_size, raw);
+    }
+
+    if (!unpacked || Crc32(raw.data(), raw.size()) != block.crc)
+    {
+        ERROR_PRINT("ERROR: checksum mismatch in replay archive block at " << block.offset);
+        return false;
+    }
+
+    return out_replay.Load(std::move(raw));
+}
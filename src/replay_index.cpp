@@ -0,0 +1,248 @@
+#include "replay_index.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include "debug.hpp"
+#include "replay_archive.hpp"
+#include "work_stealing_pool.hpp"
+
+static void PutIndexHeader(std::vector<uint8_t>& out)
+{
+    out.insert(out.end(), REPLAY_INDEX_FILE_MAGIC, REPLAY_INDEX_FILE_MAGIC + sizeof(REPLAY_INDEX_FILE_MAGIC));
+    PutU16(out, REPLAY_INDEX_FILE_VERSION);
+    PutU16(out, (uint16_t)sizeof(ReplayMetadata));
+}
+
+/*replays/replays.fba -> replays/replays.fbx*/
+std::string ReplayIndexPath(const std::string& archive_path)
+{
+    return std::filesystem::path(archive_path).replace_extension(".fbx").string();
+}
+
+ReplayIndexWriter::ReplayIndexWriter(const std::string& path)
+{
+    Open(path);
+}
+
+bool ReplayIndexWriter::Open(const std::string& path)
+{
+    if (!m_file.Open(path, true))
+    {
+        return false;
+    }
+
+    m_file.Reserve(1, sizeof(ReplayMetadata));
+    m_buffer.reserve(sizeof(ReplayMetadata));
+
+    std::error_code error;
+    uintmax_t existing_size = std::filesystem::file_size(path, error);
+
+    if (error || existing_size == 0)
+    {
+        std::vector<uint8_t> header;
+        PutIndexHeader(header);
+        m_file.Write(std::move(header));
+    }
+
+    return true;
+}
+
+void ReplayIndexWriter::Append(const ReplayMetadata& metadata)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&metadata);
+    m_file.TakeBuffer(m_buffer, sizeof(metadata));
+    m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(metadata));
+    m_file.Write(std::move(m_buffer));
+}
+
+bool ReplayIndexView::Open(const std::string& path)
+{
+    m_count = 0;
+
+    if (!m_file.Open(path))
+    {
+        return false;
+    }
+
+    const uint8_t* header = m_file.Data();
+
+    if (m_file.Size() < REPLAY_INDEX_FILE_HEADER_SIZE ||
+        memcmp(header, REPLAY_INDEX_FILE_MAGIC, sizeof(REPLAY_INDEX_FILE_MAGIC)) != 0)
+    {
+        ERROR_PRINT("ERROR: " << path << " is not a replay index");
+        m_file.Close();
+        return false;
+    }
+
+    if (GetU16(header + 4) != REPLAY_INDEX_FILE_VERSION || GetU16(header + 6) != sizeof(ReplayMetadata))
+    {
+        ERROR_PRINT("ERROR: unsupported replay index version " << GetU16(header + 4) << ", rebuild it");
+        m_file.Close();
+        return false;
+    }
+
+    // a record torn by a crash mid-append is left out
+    m_count = (m_file.Size() - REPLAY_INDEX_FILE_HEADER_SIZE) / sizeof(ReplayMetadata);
+    return true;
+}
+
+size_t ReplayIndexView::Count() const
+{
+    return m_count;
+}
+
+const ReplayMetadata* ReplayIndexView::Records() const
+{
+    if (m_count == 0)
+    {
+        return NULL;
+    }
+
+    return reinterpret_cast<const ReplayMetadata*>(m_file.Data() + REPLAY_INDEX_FILE_HEADER_SIZE);
+}
+
+/*Re-simulates every game in the archive on thread_count workers and replaces the index beside
+it. Blocks are read here a few at a time ahead of the workers, so memory stays bounded*/
+bool RebuildReplayIndex(const std::string& archive_path, size_t thread_count)
+{
+    ReplayArchiveReader archive;
+
+    if (!archive.Open(archive_path))
+    {
+        return false;
+    }
+
+    std::mutex mutex;
+    std::vector<ReplayMetadata> records;
+    WorkStealingPool pool(thread_count);
+    ReplayBlock block;
+
+    while (archive.NextBlock(block))
+    {
+        pool.Submit([&mutex, &records, block = std::move(block)]
+        {
+            ReplayReader reader;
+
+            if (!DecodeReplayBlock(block, reader))
+            {
+                return;
+            }
+
+            ReplayResult result;
+            bool complete = SimulateReplay(reader, result);
+            bool matches = complete && !result.resumed && result.lines_cleared == result.recorded_lines &&
+                result.pieces_placed == result.recorded_pieces;
+
+            ReplayMetadata metadata = {};
+            metadata.seed = reader.m_header.seed;
+            metadata.archive_offset = block.offset;
+            metadata.lines_cleared = (uint32_t)result.lines_cleared;
+            metadata.pieces_placed = (uint32_t)result.pieces_placed;
+            metadata.ticks = result.ticks;
+            metadata.fall_ticks = (uint16_t)result.fall_ticks;
+            metadata.randomizer = reader.m_header.randomizer;
+            metadata.flags = matches ? REPLAY_META_VERIFIED : 0;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            records.push_back(metadata);
+        });
+
+        pool.Wait(pool.ThreadCount() * 2);
+    }
+
+    pool.Wait();
+
+    std::sort(records.begin(), records.end(),
+        [](const ReplayMetadata& a, const ReplayMetadata& b) { return a.archive_offset < b.archive_offset; });
+
+    // written beside the old index and swapped in, readers never see a half built file
+    std::string index_path = ReplayIndexPath(archive_path);
+    std::string temp_path = index_path + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "wb");
+
+    if (file == NULL)
+    {
+        ERROR_PRINT("ERROR: could not open " << temp_path << " for writing");
+        return false;
+    }
+
+    std::vector<uint8_t> header;
+    PutIndexHeader(header);
+
+    bool written = fwrite(header.data(), 1, header.size(), file) == header.size() &&
+        fwrite(records.data(), sizeof(ReplayMetadata), records.size(), file) == records.size();
+    written = fclose(file) == 0 && written;
+
+    std::error_code error;
+
+    if (written)
+    {
+        std::filesystem::rename(temp_path, index_path, error);
+    }
+
+    if (!written || error)
+    {
+        ERROR_PRINT("ERROR: could not write replay index " << index_path);
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+
+    return true;
+}
+
+static bool MoreLines(const ReplayMetadata* a, const ReplayMetadata* b)
+{
+    if (a->lines_cleared != b->lines_cleared)
+    {
+        return a->lines_cleared > b->lines_cleared;
+    }
+    return a->ticks < b->ticks;
+}
+
+/*Most lines first, ties go to the shorter game. Keeps a heap of count entries while scanning*/
+void TopByLines(const ReplayIndexView& index, size_t count, std::vector<const ReplayMetadata*>& out_records)
+{
+    out_records.clear();
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    out_records.reserve(std::min(count, index.Count()));
+    const ReplayMetadata* records = index.Records();
+
+    // the heap front is the weakest entry kept so far
+    for (size_t i = 0; i < index.Count(); i++)
+    {
+        if (out_records.size() < count)
+        {
+            out_records.push_back(&records[i]);
+            std::push_heap(out_records.begin(), out_records.end(), MoreLines);
+        }
+        else if (MoreLines(&records[i], out_records.front()))
+        {
+            std::pop_heap(out_records.begin(), out_records.end(), MoreLines);
+            out_records.back() = &records[i];
+            std::push_heap(out_records.begin(), out_records.end(), MoreLines);
+        }
+    }
+
+    std::sort_heap(out_records.begin(), out_records.end(), MoreLines);
+}
+
+/*Every game that ran for more than ticks, in archive order*/
+void LongerThan(const ReplayIndexView& index, uint32_t ticks, std::vector<const ReplayMetadata*>& out_records)
+{
+    out_records.clear();
+    const ReplayMetadata* records = index.Records();
+
+    for (size_t i = 0; i < index.Count(); i++)
+    {
+        if (records[i].ticks > ticks)
+        {
+            out_records.push_back(&records[i]);
+        }
+    }
+}
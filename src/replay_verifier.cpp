@@ -0,0 +1,169 @@
+#include "replay_verifier.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include "replay_archive.hpp"
+#include "work_stealing_pool.hpp"
+
+// games read ahead of the workers per thread, bounds memory on large archives
+static const size_t VERIFY_QUEUE_PER_THREAD = 4;
+
+static void CheckReplay(ReplayReader& reader, VerifyResult& out_result)
+{
+    // the saved state it starts from was never checked against the seed, and submissions are untrusted,
+    // so nothing from it is simulated
+    if (reader.m_starts_with_keyframe)
+    {
+        out_result.reason = "starts from a save";
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    ReplayResult result;
+    bool complete = SimulateReplay(reader, result);
+
+    out_result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    out_result.lines_cleared = result.lines_cleared;
+    out_result.claimed_lines = result.recorded_lines;
+    out_result.pieces_placed = result.pieces_placed;
+    out_result.claimed_pieces = result.recorded_pieces;
+    out_result.ticks = result.ticks;
+    out_result.checksum = result.checksum;
+
+    if (!complete)
+    {
+        out_result.reason = "no END record";
+    }
+    else if (result.lines_cleared != result.recorded_lines)
+    {
+        out_result.reason = "lines mismatch";
+    }
+    else if (result.pieces_placed != result.recorded_pieces)
+    {
+        out_result.reason = "pieces mismatch";
+    }
+    else
+    {
+        out_result.passed = true;
+    }
+}
+
+/*Directories are searched recursively for .fbr replays and .fba archives*/
+static void CollectFiles(const std::vector<std::string>& paths, std::vector<std::string>& out_files)
+{
+    for (const std::string& path : paths)
+    {
+        std::error_code error;
+
+        if (!std::filesystem::is_directory(path, error))
+        {
+            out_files.push_back(path);
+            continue;
+        }
+
+        std::vector<std::string> found;
+
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(path, error))
+        {
+            std::string extension = entry.path().extension().string();
+
+            if (entry.is_regular_file() && (extension == ".fbr" || extension == ".fba"))
+            {
+                found.push_back(entry.path().string());
+            }
+        }
+
+        std::sort(found.begin(), found.end());
+        out_files.insert(out_files.end(), found.begin(), found.end());
+    }
+}
+
+/*Every game becomes one task on a work stealing pool. This thread only does the sequential
+part, reading archive blocks, and the workers do everything else*/
+void VerifyReplays(const std::vector<std::string>& paths, size_t thread_count, VerifyReport& out_report)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::string> files;
+    CollectFiles(paths, files);
+
+    // deque elements never move, so workers can fill in their slot while more are added
+    std::deque<VerifyResult> results;
+    WorkStealingPool pool(thread_count);
+    const size_t max_pending = pool.ThreadCount() * VERIFY_QUEUE_PER_THREAD;
+
+    for (const std::string& file : files)
+    {
+        if (!IsReplayArchive(file))
+        {
+            VerifyResult& slot = results.emplace_back();
+            slot.name = file;
+
+            pool.Submit([&slot]
+            {
+                ReplayReader reader;
+
+                if (!reader.Open(slot.name))
+                {
+                    slot.reason = "unreadable";
+                    return;
+                }
+                CheckReplay(reader, slot);
+            });
+
+            pool.Wait(max_pending);
+            continue;
+        }
+
+        ReplayArchiveReader archive;
+
+        if (!archive.Open(file))
+        {
+            VerifyResult& slot = results.emplace_back();
+            slot.name = file;
+            slot.reason = "unreadable";
+            continue;
+        }
+
+        ReplayBlock block;
+
+        while (archive.NextBlock(block))
+        {
+            VerifyResult& slot = results.emplace_back();
+            slot.name = file + "@" + std::to_string(block.offset);
+
+            // decoding is as costly as a short game, so it happens on the worker too
+            pool.Submit([&slot, block = std::move(block)]
+            {
+                ReplayReader reader;
+
+                if (!DecodeReplayBlock(block, reader))
+                {
+                    slot.reason = "damaged block";
+                    return;
+                }
+                CheckReplay(reader, slot);
+            });
+
+            pool.Wait(max_pending);
+        }
+
+        if (archive.m_corrupt_blocks > 0)
+        {
+            VerifyResult& slot = results.emplace_back();
+            slot.name = file;
+            slot.reason = "damaged archive blocks";
+        }
+    }
+
+    pool.Wait();
+
+    out_report.results.assign(results.begin(), results.end());
+    out_report.failures = (size_t)std::count_if(out_report.results.begin(), out_report.results.end(),
+        [](const VerifyResult& result) { return !result.passed; });
+    out_report.thread_count = pool.ThreadCount();
+    out_report.steals = pool.StealCount();
+    out_report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,238 @@
+#include "rollback.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include "debug.hpp"
+#include "replay.hpp"
+
+RollbackSession::RollbackSession(const GameSettings& settings, int local_player)
+    : m_core(settings)
+{
+    m_local_player = local_player;
+    m_receive_buffer.reserve(1024);
+}
+
+void RollbackSession::AddLocalInput(GAME_INPUT input)
+{
+    if (m_pending_local.count >= MAX_INPUTS_PER_TICK)
+    {
+        DEBUG_PRINT("WARN: too many inputs in one tick, dropping " << input);
+        return;
+    }
+
+    m_pending_local.inputs[m_pending_local.count] = (uint8_t)input;
+    m_pending_local.count++;
+}
+
+/*Takes bytes as they came off the socket, packets may be split or several may arrive at once.
+False if the stream is not a valid input stream*/
+bool RollbackSession::Receive(const uint8_t* data, size_t size)
+{
+    m_receive_buffer.insert(m_receive_buffer.end(), data, data + size);
+    size_t position = 0;
+
+    while (m_receive_buffer.size() - position >= VERSUS_INPUT_HEADER_SIZE)
+    {
+        const uint8_t* packet = m_receive_buffer.data() + position;
+        uint8_t count = packet[0];
+        uint32_t tick = GetU32(packet + 1);
+
+        if (m_receive_buffer.size() - position < VERSUS_INPUT_HEADER_SIZE + count)
+        {
+            break;
+        }
+
+        if (count > MAX_INPUTS_PER_TICK || tick != m_remote_ticks || tick >= m_core.m_tick + ROLLBACK_WINDOW)
+        {
+            ERROR_PRINT("ERROR: bad input packet for tick " << tick << ", expected " << m_remote_ticks);
+            return false;
+        }
+
+        TickInputs& inputs = m_remote_inputs[tick % m_remote_inputs.size()];
+        inputs.count = count;
+        memcpy(inputs.inputs.data(), packet + VERSUS_INPUT_HEADER_SIZE, count);
+
+        // the tick already ran on the guess that nothing was pressed
+        if (tick < m_core.m_tick && count > 0)
+        {
+            m_rollback_tick = std::min(m_rollback_tick, tick);
+        }
+
+        m_remote_ticks++;
+        position += VERSUS_INPUT_HEADER_SIZE + count;
+    }
+
+    m_receive_buffer.erase(m_receive_buffer.begin(), m_receive_buffer.begin() + position);
+    return true;
+}
+
+/*Fixes up any misprediction, then runs one tick with the local inputs gathered since the last
+one and appends the packet to send for it. False when it has to wait for the remote side, the
+local inputs stay queued for the next frame*/
+bool RollbackSession::AdvanceFrame(std::vector<uint8_t>& out_packet, VersusTickEvents& out_events)
+{
+    Rollback();
+
+    out_events = {};
+
+    // the snapshot about to be written is the one the oldest unconfirmed tick needs
+    if (m_core.m_tick >= m_remote_ticks + ROLLBACK_WINDOW)
+    {
+        m_stalled_frames++;
+        return false;
+    }
+
+    uint32_t tick = m_core.m_tick;
+    m_local_inputs[tick % ROLLBACK_WINDOW] = m_pending_local;
+    m_pending_local.count = 0;
+
+    SimulateTick(out_events);
+
+    const TickInputs& sent = m_local_inputs[tick % ROLLBACK_WINDOW];
+    out_packet.push_back(sent.count);
+    PutU32(out_packet, tick);
+    out_packet.insert(out_packet.end(), sent.inputs.begin(), sent.inputs.begin() + sent.count);
+
+    return true;
+}
+
+/*True when nothing on screen is a guess, every tick run so far used the real remote inputs*/
+bool RollbackSession::IsConfirmed() const
+{
+    return m_remote_ticks >= m_core.m_tick && m_rollback_tick == NO_ROLLBACK;
+}
+
+uint32_t RollbackSession::Tick() const
+{
+    return m_core.m_tick;
+}
+
+void RollbackSession::SimulateTick(VersusTickEvents& out_events)
+{
+    uint32_t tick = m_core.m_tick;
+    VersusInputs inputs = {};
+
+    inputs[m_local_player] = m_local_inputs[tick % ROLLBACK_WINDOW];
+
+    if (tick < m_remote_ticks)
+    {
+        inputs[1 - m_local_player] = m_remote_inputs[tick % m_remote_inputs.size()];
+    }
+
+    m_core.SaveSnapshot(m_snapshots[tick % ROLLBACK_WINDOW]);
+    m_core.Step(inputs, out_events);
+}
+
+/*Restores the state from before the earliest mispredicted tick and simulates back up to the
+current tick. AdvanceFrame does this first, on its own it corrects the state without moving on*/
+void RollbackSession::Rollback()
+{
+    if (m_rollback_tick == NO_ROLLBACK)
+    {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t current_tick = m_core.m_tick;
+    uint32_t depth = current_tick - m_rollback_tick;
+
+    m_core.LoadSnapshot(m_snapshots[m_rollback_tick % ROLLBACK_WINDOW]);
+
+    // sounds for these ticks already played when they were predicted
+    VersusTickEvents events;
+
+    while (m_core.m_tick < current_tick)
+    {
+        SimulateTick(events);
+    }
+
+    m_rollbacks++;
+    m_resimulated_ticks += depth;
+    m_max_rollback_ticks = std::max(m_max_rollback_ticks, depth);
+    m_rollback_tick = NO_ROLLBACK;
+    m_rollback_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*Waits for one opponent on port, then sends it the settings both sides play with*/
+bool HostVersus(uint16_t port, const GameSettings& settings, NetSocket& out_socket, GameSettings& out_settings)
+{
+    NetSocket listener;
+
+    if (!listener.Listen(port))
+    {
+        return false;
+    }
+
+    std::cout << "waiting for an opponent on port " << listener.LocalPort() << std::endl;
+
+    if (!listener.Accept(out_socket))
+    {
+        return false;
+    }
+
+    out_settings = settings;
+
+    if (out_settings.seed == 0)
+    {
+        out_settings.seed = RandomSeed();
+    }
+
+    std::vector<uint8_t> hello(VERSUS_MAGIC, VERSUS_MAGIC + sizeof(VERSUS_MAGIC));
+    PutU16(hello, VERSUS_PROTOCOL_VERSION);
+    PutU64(hello, out_settings.seed);
+    hello.push_back(out_settings.randomizer);
+
+    return out_socket.Send(hello.data(), hello.size());
+}
+
+/*Connects to a host and reads the settings it picked*/
+bool JoinVersus(const std::string& host, uint16_t port, NetSocket& out_socket, GameSettings& out_settings)
+{
+    if (!out_socket.Connect(host, port))
+    {
+        return false;
+    }
+
+    uint8_t hello[VERSUS_HELLO_SIZE];
+    size_t received = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(VERSUS_CONNECT_TIMEOUT_MS);
+
+    while (received < sizeof(hello) && std::chrono::steady_clock::now() < deadline)
+    {
+        int bytes = out_socket.Receive(hello + received, sizeof(hello) - received);
+
+        if (bytes < 0)
+        {
+            break;
+        }
+
+        received += (size_t)bytes;
+
+        if (bytes == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    if (received < sizeof(hello) || memcmp(hello, VERSUS_MAGIC, sizeof(VERSUS_MAGIC)) != 0)
+    {
+        ERROR_PRINT("ERROR: " << host << ":" << port << " is not hosting a versus game");
+        out_socket.Close();
+        return false;
+    }
+
+    if (GetU16(hello + 4) != VERSUS_PROTOCOL_VERSION)
+    {
+        ERROR_PRINT("ERROR: host runs versus protocol " << GetU16(hello + 4) << ", this build "
+            << VERSUS_PROTOCOL_VERSION);
+        out_socket.Close();
+        return false;
+    }
+
+    out_settings = GameSettings();
+    out_settings.seed = GetU64(hello + 6);
+    out_settings.randomizer = (RANDOMIZER_TYPE)hello[14];
+    return true;
+}
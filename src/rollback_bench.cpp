@@ -0,0 +1,215 @@
+#include "rollback_bench.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <vector>
+#include "bench_input.hpp"
+#include "debug.hpp"
+#include "rollback.hpp"
+#include "utility.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static const double BENCH_DRAIN_SECONDS = 2.0;
+
+/*One direction of the connection. Packets wait here until their delay is up, never overtaking
+an earlier one since TCP would not either*/
+class LaggedLink
+{
+public:
+    LaggedLink(NetSocket& socket, const RollbackBenchOptions& options, uint64_t seed)
+        : m_socket(socket), m_rng(seed)
+    {
+        m_delay = std::chrono::milliseconds(options.delay_ms);
+        m_jitter_ms = options.jitter_ms;
+    }
+
+    void Send(const std::vector<uint8_t>& packet, Clock::time_point now)
+    {
+        Clock::time_point release = now + m_delay;
+
+        if (m_jitter_ms > 0)
+        {
+            release += std::chrono::microseconds(m_rng.Range(0, (uint64_t)m_jitter_ms * 1000));
+        }
+
+        release = std::max(release, m_last_release);
+        m_last_release = release;
+        m_queue.push_back({release, packet});
+    }
+
+    bool Flush(Clock::time_point now)
+    {
+        while (!m_queue.empty() && m_queue.front().first <= now)
+        {
+            const std::vector<uint8_t>& bytes = m_queue.front().second;
+
+            if (!m_socket.Send(bytes.data(), bytes.size()))
+            {
+                return false;
+            }
+            m_queue.pop_front();
+        }
+        return true;
+    }
+
+private:
+    NetSocket& m_socket;
+    Rng m_rng;
+    std::chrono::nanoseconds m_delay;
+    int m_jitter_ms = 0;
+    Clock::time_point m_last_release;
+    std::deque<std::pair<Clock::time_point, std::vector<uint8_t>>> m_queue;
+};
+
+/*Reads everything waiting on the socket into the session*/
+static bool Pump(NetSocket& socket, RollbackSession& session)
+{
+    uint8_t buffer[4096];
+    int bytes;
+
+    while ((bytes = socket.Receive(buffer, sizeof(buffer))) > 0)
+    {
+        if (!session.Receive(buffer, (size_t)bytes))
+        {
+            return false;
+        }
+    }
+
+    return bytes == 0;
+}
+
+/*Runs the match in real time at TICKS_PER_SECOND for options.seconds, then stops the bots and
+lets both sides catch up on every input so their final states can be compared*/
+bool RunRollbackBench(const RollbackBenchOptions& options, RollbackBenchReport& out_report)
+{
+    NetSocket listener;
+    std::array<NetSocket, 2> sockets;
+
+    // connect completes against the listen backlog, so one thread can do both ends
+    if (!listener.Listen(0) || !sockets[1].Connect("127.0.0.1", listener.LocalPort()) ||
+        !listener.Accept(sockets[0]))
+    {
+        return false;
+    }
+
+    GameSettings settings;
+    settings.seed = (options.seed != 0) ? options.seed : RandomSeed();
+
+    RollbackSession host(settings, 0);
+    RollbackSession client(settings, 1);
+    std::array<RollbackSession*, 2> sessions = {&host, &client};
+    std::array<LaggedLink, 2> links = {
+        LaggedLink(sockets[0], options, settings.seed + 1),
+        LaggedLink(sockets[1], options, settings.seed + 2)};
+    std::array<Rng, 2> bots = {Rng(settings.seed + 3), Rng(settings.seed + 4)};
+
+    std::vector<double> frame_ms;
+    frame_ms.reserve((size_t)(options.seconds * TICKS_PER_SECOND * 2) + 16);
+
+    std::vector<uint8_t> packet;
+    VersusTickEvents events;
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.seconds));
+    Clock::time_point next_frame = start;
+
+    while (Clock::now() < end)
+    {
+        for (size_t side = 0; side < 2; side++)
+        {
+            RollbackSession& session = *sessions[side];
+
+            if (!Pump(sockets[side], session))
+            {
+                ERROR_PRINT("ERROR: rollback bench lost its connection");
+                return false;
+            }
+
+            GAME_INPUT input;
+
+            if (RandomBotInput(bots[side], input))
+            {
+                session.AddLocalInput(input);
+            }
+
+            packet.clear();
+            Clock::time_point frame_start = Clock::now();
+            bool advanced = session.AdvanceFrame(packet, events);
+            Clock::time_point now = Clock::now();
+            frame_ms.push_back(std::chrono::duration<double, std::milli>(now - frame_start).count());
+
+            if (advanced)
+            {
+                links[side].Send(packet, now);
+            }
+
+            if (!links[side].Flush(now))
+            {
+                ERROR_PRINT("ERROR: rollback bench lost its connection");
+                return false;
+            }
+
+            if (out_report.match_over_tick == 0 && session.IsConfirmed() && session.m_core.IsOver())
+            {
+                out_report.match_over_tick = session.Tick();
+            }
+        }
+
+        next_frame += BENCH_TICK;
+        std::this_thread::sleep_until(next_frame);
+    }
+
+    out_report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // no more delay and no more inputs, both sides run up to the same tick on real inputs only
+    uint32_t final_tick = std::max(host.Tick(), client.Tick());
+    Clock::time_point drain_end = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(BENCH_DRAIN_SECONDS));
+
+    while (!(host.Tick() == final_tick && client.Tick() == final_tick && host.IsConfirmed() && client.IsConfirmed()))
+    {
+        if (Clock::now() > drain_end)
+        {
+            ERROR_PRINT("ERROR: rollback bench sessions never caught up with each other");
+            break;
+        }
+
+        for (size_t side = 0; side < 2; side++)
+        {
+            RollbackSession& session = *sessions[side];
+
+            if (!links[side].Flush(Clock::time_point::max()) || !Pump(sockets[side], session))
+            {
+                return false;
+            }
+
+            packet.clear();
+
+            if (session.Tick() >= final_tick)
+            {
+                session.Rollback();
+            }
+            else if (session.AdvanceFrame(packet, events))
+            {
+                links[side].Send(packet, Clock::now());
+            }
+        }
+
+        std::this_thread::yield();
+    }
+
+    out_report.ticks = final_tick;
+    out_report.rollbacks = host.m_rollbacks + client.m_rollbacks;
+    out_report.resimulated_ticks = host.m_resimulated_ticks + client.m_resimulated_ticks;
+    out_report.max_rollback_ticks = std::max(host.m_max_rollback_ticks, client.m_max_rollback_ticks);
+    out_report.stalled_frames = host.m_stalled_frames + client.m_stalled_frames;
+    out_report.rollback_seconds = host.m_rollback_seconds + client.m_rollback_seconds;
+    out_report.frame_ms_p50 = Percentile(frame_ms, 0.50);
+    out_report.frame_ms_p99 = Percentile(frame_ms, 0.99);
+    out_report.frame_ms_max = frame_ms.empty() ? 0 : *std::max_element(frame_ms.begin(), frame_ms.end());
+    out_report.checksums = {host.m_core.Checksum(), client.m_core.Checksum()};
+    out_report.in_sync = host.Tick() == client.Tick() && out_report.checksums[0] == out_report.checksums[1];
+
+    return true;
+}
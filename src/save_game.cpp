@@ -0,0 +1,74 @@
+#include "save_game.hpp"
+#include <cstring>
+#include <filesystem>
+#include "mapped_file.hpp"
+#include "replay_archive.hpp"
+
+SaveGameWriter::SaveGameWriter(const std::string& path)
+    : m_file(path)
+{
+    m_file.Reserve(1, sizeof(SaveRecord));
+    m_buffer.reserve(sizeof(SaveRecord));
+}
+
+void SaveGameWriter::Write(const GameSnapshot& snapshot)
+{
+    SaveRecord record = {};
+    memcpy(record.magic, SAVE_MAGIC, sizeof(SAVE_MAGIC));
+    record.version = SAVE_VERSION;
+    record.snapshot_size = (uint16_t)sizeof(GameSnapshot);
+    record.crc = Crc32(reinterpret_cast<const uint8_t*>(&snapshot), sizeof(snapshot));
+    record.sequence = m_sequence;
+    record.snapshot = snapshot;
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record);
+    m_file.TakeBuffer(m_buffer, sizeof(SaveRecord));
+    m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(record));
+    m_file.WriteAt((uint64_t)(m_sequence % SAVE_SLOTS) * sizeof(SaveRecord), std::move(m_buffer));
+
+    m_sequence++;
+}
+
+/*Finds the newest intact record of a game still in progress, false if there is none*/
+bool LoadSaveGame(const std::string& path, GameSnapshot& out_snapshot)
+{
+    MappedFile file;
+    std::error_code error;
+
+    if (!std::filesystem::exists(path, error) || !file.Open(path))
+    {
+        return false;
+    }
+
+    size_t count = file.Size() / sizeof(SaveRecord);
+    bool found = false;
+    SaveRecord newest;
+
+    // a later slot wins a tie, files from before the slots have every sequence at 0
+    for (size_t i = 0; i < count; i++)
+    {
+        SaveRecord record;
+        memcpy(&record, file.Data() + i * sizeof(SaveRecord), sizeof(SaveRecord));
+
+        if (memcmp(record.magic, SAVE_MAGIC, sizeof(SAVE_MAGIC)) != 0 || record.version != SAVE_VERSION ||
+            record.snapshot_size != sizeof(GameSnapshot) ||
+            record.crc != Crc32(reinterpret_cast<const uint8_t*>(&record.snapshot), sizeof(GameSnapshot)))
+        {
+            continue;
+        }
+
+        if (!found || record.sequence >= newest.sequence)
+        {
+            newest = record;
+            found = true;
+        }
+    }
+
+    if (!found || newest.snapshot.game_running == 0)
+    {
+        return false;
+    }
+
+    out_snapshot = newest.snapshot;
+    return true;
+}
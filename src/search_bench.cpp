@@ -0,0 +1,174 @@
+#include "search_bench.hpp"
+#include <algorithm>
+#include <chrono>
+#include "debug.hpp"
+#include "game_core.hpp"
+#include "lookahead_search.hpp"
+#include "utility.hpp"
+
+// a move the lookahead bot made, searched again for the scaling runs
+struct SearchPosition
+{
+    Board board;
+    Piece piece;
+    PieceOutlook outlook;
+};
+
+/*Plays one game per seed with the search deciding every move. Positions and move times are only
+kept when asked for*/
+static void PlayGames(const SearchBenchOptions& options, const std::vector<uint64_t>& seeds, LookaheadSearch& search,
+    const SearchOptions& search_options, SearchBotResult& out_result, std::vector<SearchPosition>* out_positions,
+    std::vector<double>* out_move_ms, size_t* out_depths)
+{
+    SearchResult result;
+    BoardFeatures features;
+    size_t height_sum = 0;
+
+    for (uint64_t seed : seeds)
+    {
+        GameSettings settings;
+        settings.seed = seed;
+        GameCore core(settings);
+        GameEvent event;
+        search.ClearTable();
+
+        while (core.m_game_running && core.m_pieces_placed < options.pieces_per_game)
+        {
+            PieceOutlook outlook = PeekOutlook(core.m_randomizer, options.preview);
+
+            if (!search.Search(core.m_board, core.m_falling_piece, outlook, search_options, result))
+            {
+                break;
+            }
+
+            if (out_positions != NULL)
+            {
+                out_positions->push_back({core.m_board, core.m_falling_piece, outlook});
+                out_move_ms->push_back(result.seconds * 1000.0);
+                *out_depths += result.depth;
+            }
+
+            const Placement& pick = result.placement;
+            core.m_falling_piece = Piece(core.m_falling_piece.m_type, pick.rotation, {pick.x, pick.y}, *core.m_rotation_system);
+            core.ApplyInput(INPUT_HARD_DROP);
+
+            while (core.PollEvent(event))
+            {
+                out_result.lines += event.type == EVENT_LINES_CLEARED ? (size_t)event.value : 0;
+            }
+
+            EvaluateBoard(core.m_board.m_rows, features);
+            height_sum += (size_t)features.max_height;
+        }
+
+        out_result.pieces += core.m_pieces_placed;
+        out_result.top_outs += core.m_game_running ? 0 : 1;
+    }
+
+    out_result.mean_height = out_result.pieces > 0 ? (double)height_sum / out_result.pieces : 0;
+}
+
+/*Searches every position to the same depth with no budget, fresh table first*/
+static void TimeSearches(const std::vector<SearchPosition>& positions, size_t depth, size_t thread_count,
+    SearchScaling& out_scaling, std::vector<Placement>& out_moves)
+{
+    LookaheadSearch search(thread_count);
+    SearchOptions search_options;
+    search_options.max_depth = depth;
+    SearchResult result;
+
+    out_scaling.threads = search.ThreadCount();
+    out_moves.clear();
+
+    for (const SearchPosition& position : positions)
+    {
+        search.Search(position.board, position.piece, position.outlook, search_options, result);
+        out_scaling.nodes += result.nodes;
+        out_scaling.table_hits += result.table_hits;
+        out_scaling.seconds += result.seconds;
+        out_moves.push_back(result.placement);
+    }
+
+    out_scaling.nodes_per_second = out_scaling.seconds > 0 ? out_scaling.nodes / out_scaling.seconds : 0;
+}
+
+static bool SamePlacement(const Placement& a, const Placement& b)
+{
+    return a.x == b.x && a.y == b.y && a.rotation == b.rotation;
+}
+
+bool RunSearchBench(const SearchBenchOptions& options, SearchBenchReport& out_report)
+{
+    Rng rng(options.seed != 0 ? options.seed : RandomSeed());
+    std::vector<uint64_t> seeds;
+
+    for (size_t game = 0; game < options.games; game++)
+    {
+        seeds.push_back(rng.Next() | 1);
+    }
+
+    size_t max_threads = std::max(options.max_threads, (size_t)1);
+    LookaheadSearch search(max_threads);
+    SearchOptions search_options;
+
+    // one piece deep is the greedy bot, scored the same way
+    search_options.max_depth = 1;
+    PlayGames(options, seeds, search, search_options, out_report.greedy, NULL, NULL, NULL);
+
+    std::vector<SearchPosition> played;
+    std::vector<double> move_ms;
+    size_t depths = 0;
+    search_options.max_depth = MAX_SEARCH_DEPTH;
+    search_options.budget_ms = options.budget_ms;
+    PlayGames(options, seeds, search, search_options, out_report.lookahead, &played, &move_ms, &depths);
+
+    if (played.empty())
+    {
+        ERROR_PRINT("ERROR: search bench played no moves");
+        return false;
+    }
+
+    out_report.games = seeds.size();
+    out_report.mean_depth = (double)depths / played.size();
+    out_report.move_ms_p50 = Percentile(move_ms, 0.50);
+    out_report.move_ms_p99 = Percentile(move_ms, 0.99);
+
+    // spread over the games rather than the empty boards at the start of one
+    std::vector<SearchPosition> positions;
+    size_t count = std::min(std::max(options.positions, (size_t)1), played.size());
+
+    for (size_t i = 0; i < count; i++)
+    {
+        positions.push_back(played[i * played.size() / count]);
+    }
+
+    out_report.positions = positions.size();
+
+    std::vector<Placement> first_moves;
+    std::vector<Placement> moves;
+
+    for (size_t threads = 1; ; threads = std::min(threads * 2, max_threads))
+    {
+        SearchScaling scaling;
+        TimeSearches(positions, options.depth, threads, scaling, threads == 1 ? first_moves : moves);
+
+        if (threads > 1)
+        {
+            for (size_t i = 0; i < positions.size(); i++)
+            {
+                scaling.differing_moves += SamePlacement(first_moves[i], moves[i]) ? 0 : 1;
+            }
+        }
+
+        const SearchScaling* one = out_report.scaling.empty() ? &scaling : &out_report.scaling[0];
+        scaling.speedup = one->nodes_per_second > 0 ? scaling.nodes_per_second / one->nodes_per_second : 0;
+        out_report.scaling.push_back(scaling);
+
+        if (threads == max_threads)
+        {
+            break;
+        }
+    }
+
+    return true;
+}
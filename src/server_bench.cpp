@@ -0,0 +1,312 @@
+#include "server_bench.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <numeric>
+#include <thread>
+#include <vector>
+#include "bench_input.hpp"
+#include "debug.hpp"
+#include "game_server.hpp"
+#include "replay.hpp"
+#include "utility.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static const double BENCH_CONNECT_SECONDS = 10.0;
+static const size_t SESSIONS_PER_CONNECTION = 64;
+
+struct ClientCounters
+{
+    std::atomic<size_t> sessions {0};
+    std::atomic<size_t> inputs_sent {0};
+    std::atomic<size_t> events_received {0};
+    std::atomic<size_t> games_over {0};
+    std::atomic<bool> failed {false};
+};
+
+// a group of simulated players sharing one connection
+struct ClientConnection
+{
+    NetSocket socket;
+    std::vector<uint32_t> sessions;     // by request id, SERVER_NO_SESSION until opened
+    std::vector<uint8_t> receive_buffer;
+    std::vector<uint8_t> send_buffer;   // this tick's messages
+    SendQueue send_queue;               // earlier ticks' the socket has not taken yet
+    bool header_read = false;
+};
+
+static void PutOpen(std::vector<uint8_t>& out, uint32_t request, uint64_t seed)
+{
+    out.push_back(SERVER_OPEN);
+    PutU32(out, request);
+    PutU64(out, seed);
+}
+
+/*Handles everything the server sent, a game that topped out is closed and opened again*/
+static bool ReadServer(ClientConnection& connection, Rng& rng, ClientCounters& counters)
+{
+    uint8_t buffer[4096];
+    int bytes;
+
+    while ((bytes = connection.socket.Receive(buffer, sizeof(buffer))) > 0)
+    {
+        connection.receive_buffer.insert(connection.receive_buffer.end(), buffer, buffer + bytes);
+    }
+
+    if (bytes < 0)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t>& messages = connection.receive_buffer;
+    size_t position = 0;
+
+    if (!connection.header_read)
+    {
+        if (messages.size() < SERVER_HEADER_SIZE)
+        {
+            return true;
+        }
+
+        if (memcmp(messages.data(), SERVER_MAGIC, sizeof(SERVER_MAGIC)) != 0)
+        {
+            ERROR_PRINT("ERROR: server bench connected to something that is not a game server");
+            return false;
+        }
+
+        connection.header_read = true;
+        position = SERVER_HEADER_SIZE;
+    }
+
+    while (position < messages.size())
+    {
+        const uint8_t* message = messages.data() + position;
+        size_t size = message[0] == SERVER_OPENED ? SERVER_OPENED_SIZE : SERVER_EVENT_SIZE;
+
+        if (message[0] != SERVER_OPENED && message[0] != SERVER_EVENT)
+        {
+            return false;
+        }
+
+        if (messages.size() - position < size)
+        {
+            break;
+        }
+
+        position += size;
+
+        if (message[0] == SERVER_OPENED)
+        {
+            uint32_t request = GetU32(message + 1);
+            uint32_t session = GetU32(message + 5);
+
+            if (request >= connection.sessions.size() || session == SERVER_NO_SESSION)
+            {
+                return false;
+            }
+
+            connection.sessions[request] = session;
+            counters.sessions.fetch_add(1);
+            continue;
+        }
+
+        counters.events_received.fetch_add(1);
+
+        if (message[9] != EVENT_TOP_OUT)
+        {
+            continue;
+        }
+
+        uint32_t session = GetU32(message + 1);
+        auto request = std::find(connection.sessions.begin(), connection.sessions.end(), session);
+
+        if (request == connection.sessions.end())
+        {
+            continue;
+        }
+
+        counters.games_over.fetch_add(1);
+        counters.sessions.fetch_sub(1);
+
+        connection.send_buffer.push_back(SERVER_CLOSE);
+        PutU32(connection.send_buffer, session);
+        PutOpen(connection.send_buffer, (uint32_t)(request - connection.sessions.begin()), rng.Next() | 1);
+        *request = SERVER_NO_SESSION;
+    }
+
+    messages.erase(messages.begin(), messages.begin() + position);
+    return true;
+}
+
+/*Every simulated player, run on its own thread until stop is set*/
+static void RunClients(uint16_t port, size_t clients, uint64_t seed, std::atomic<bool>& stop, ClientCounters& counters)
+{
+    Rng rng(seed);
+    std::vector<ClientConnection> connections((clients + SESSIONS_PER_CONNECTION - 1) / SESSIONS_PER_CONNECTION);
+
+    for (size_t i = 0; i < connections.size(); i++)
+    {
+        ClientConnection& connection = connections[i];
+        size_t count = std::min(SESSIONS_PER_CONNECTION, clients - i * SESSIONS_PER_CONNECTION);
+
+        if (!connection.socket.Connect("127.0.0.1", port))
+        {
+            counters.failed = true;
+            return;
+        }
+
+        connection.sessions.assign(count, SERVER_NO_SESSION);
+
+        for (uint32_t request = 0; request < count; request++)
+        {
+            PutOpen(connection.send_buffer, request, rng.Next() | 1);
+        }
+    }
+
+    Clock::time_point next_tick = Clock::now();
+
+    while (!stop)
+    {
+        for (ClientConnection& connection : connections)
+        {
+            if (!ReadServer(connection, rng, counters))
+            {
+                ERROR_PRINT("ERROR: server bench client lost its connection");
+                counters.failed = true;
+                return;
+            }
+
+            for (uint32_t session : connection.sessions)
+            {
+                GAME_INPUT input;
+
+                if (session == SERVER_NO_SESSION || !RandomBotInput(rng, input))
+                {
+                    continue;
+                }
+
+                connection.send_buffer.push_back(SERVER_INPUT);
+                PutU32(connection.send_buffer, session);
+                connection.send_buffer.push_back(input);
+                counters.inputs_sent.fetch_add(1);
+            }
+
+            // the clients share a thread, one server that stops reading must not stall the rest
+            bool sent = connection.send_buffer.empty() ?
+                connection.send_queue.Flush(connection.socket) :
+                connection.send_queue.Send(connection.socket, connection.send_buffer.data(), connection.send_buffer.size());
+            connection.send_buffer.clear();
+
+            if (!sent)
+            {
+                ERROR_PRINT("ERROR: server bench client could not send");
+                counters.failed = true;
+                return;
+            }
+        }
+
+        next_tick += BENCH_TICK;
+        std::this_thread::sleep_until(next_tick);
+    }
+}
+
+/*Fills the server with options.clients sessions, then runs it in real time for options.seconds*/
+bool RunServerBench(const ServerBenchOptions& options, ServerBenchReport& out_report)
+{
+    GameServer server(options.clients, options.thread_count);
+
+    if (!server.Listen(0))
+    {
+        return false;
+    }
+
+    std::atomic<bool> stop {false};
+    ClientCounters counters;
+    std::thread clients(RunClients, server.Port(), options.clients, RandomSeed(), std::ref(stop), std::ref(counters));
+
+    ServerTickTiming timing;
+    Clock::time_point next_tick = Clock::now();
+    Clock::time_point connect_end = next_tick + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(BENCH_CONNECT_SECONDS));
+
+    // connecting is not part of the measurement
+    while (server.SessionCount() < options.clients && !counters.failed && Clock::now() < connect_end)
+    {
+        server.Tick(timing);
+        next_tick += BENCH_TICK;
+        std::this_thread::sleep_until(next_tick);
+    }
+
+    if (server.SessionCount() < options.clients)
+    {
+        ERROR_PRINT("ERROR: server bench only opened " << server.SessionCount() << " of " << options.clients << " sessions");
+        stop = true;
+        clients.join();
+        return false;
+    }
+
+    size_t expected_ticks = (size_t)(options.seconds * TICKS_PER_SECOND) + 1;
+    std::vector<double> tick_ms;
+    std::vector<double> step_ms;
+    std::vector<double> cpu_ms;
+    tick_ms.reserve(expected_ticks);
+    step_ms.reserve(expected_ticks);
+    cpu_ms.reserve(expected_ticks);
+
+    size_t inputs_before = counters.inputs_sent;
+    size_t events_before = counters.events_received;
+    size_t games_before = counters.games_over;
+    double tick_budget_ms = 1000.0 / TICKS_PER_SECOND;
+
+    Clock::time_point start = Clock::now();
+    next_tick = start;
+
+    for (size_t tick = 0; tick < expected_ticks && !counters.failed; tick++)
+    {
+        server.Tick(timing);
+
+        tick_ms.push_back(timing.total_ms);
+        step_ms.push_back(timing.step_ms);
+        cpu_ms.push_back(timing.receive_ms + timing.step_cpu_ms + timing.send_ms);
+
+        if (timing.total_ms > tick_budget_ms)
+        {
+            out_report.late_ticks++;
+        }
+
+        next_tick += BENCH_TICK;
+        std::this_thread::sleep_until(next_tick);
+    }
+
+    out_report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    stop = true;
+    clients.join();
+
+    if (counters.failed)
+    {
+        return false;
+    }
+
+    out_report.sessions = options.clients;
+    out_report.thread_count = server.ThreadCount();
+    out_report.ticks = (uint32_t)tick_ms.size();
+    out_report.cpu_ms_per_tick = std::accumulate(cpu_ms.begin(), cpu_ms.end(), 0.0) / cpu_ms.size();
+    out_report.sessions_per_core = out_report.cpu_ms_per_tick > 0 ?
+        options.clients * tick_budget_ms / out_report.cpu_ms_per_tick : 0;
+    out_report.tick_ms_max = *std::max_element(tick_ms.begin(), tick_ms.end());
+    out_report.tick_ms_p50 = Percentile(tick_ms, 0.50);
+    out_report.tick_ms_p99 = Percentile(tick_ms, 0.99);
+    out_report.tick_ms_p999 = Percentile(tick_ms, 0.999);
+    out_report.step_ms_p50 = Percentile(step_ms, 0.50);
+    out_report.step_ms_p99 = Percentile(step_ms, 0.99);
+    out_report.session_bytes = sizeof(ServerSession);
+    out_report.bytes_per_session = server.MemoryUsage() / options.clients;
+    out_report.inputs_sent = counters.inputs_sent - inputs_before;
+    out_report.events_received = counters.events_received - events_before;
+    out_report.games_over = counters.games_over - games_before;
+
+    return true;
+}
@@ -0,0 +1,548 @@
+#include "spectator.hpp"
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include "replay.hpp"
+#include "debug.hpp"
+
+static const int FEED_IDLE_SLEEP_MS = 1;
+static const size_t ROW_RECORD_HEADER_SIZE = 1 + 1 + 2;
+static const size_t PIECE_RECORD_SIZE = 1 + 3;
+static const size_t KEYFRAME_RECORD_SIZE = 1 + 1 + sizeof(GameSnapshot);
+
+/*Removes the rows in mask and drops the ones above, the way Board::ClearCompletedRows does*/
+static void CollapseRows(GameSnapshot& state, uint32_t mask)
+{
+    int write_row = COORD_LIMIT_Y - 1;
+
+    for (int read_row = COORD_LIMIT_Y - 1; read_row >= 0; read_row--)
+    {
+        if (mask & (1u << read_row))
+        {
+            continue;
+        }
+
+        state.rows[write_row] = state.rows[read_row];
+        state.colors[write_row] = state.colors[read_row];
+        write_row--;
+    }
+
+    for (; write_row >= 0; write_row--)
+    {
+        state.rows[write_row] = 0;
+    }
+
+    state.lines_cleared += (uint64_t)std::popcount(mask);
+}
+
+/*Same cells filled with the same colors, the color of an empty cell does not matter*/
+static bool RowEquals(const GameSnapshot& a, const GameSnapshot& b, int y)
+{
+    if (a.rows[y] != b.rows[y])
+    {
+        return false;
+    }
+
+    for (int x = 0; x < COORD_LIMIT_X; x++)
+    {
+        if ((a.rows[y] & (1 << x)) && a.colors[y][x] != b.colors[y][x])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool PieceEquals(const GameSnapshot& a, const GameSnapshot& b)
+{
+    return a.piece_type == b.piece_type && a.piece_rotation == b.piece_rotation &&
+        a.piece_x == b.piece_x && a.piece_y == b.piece_y;
+}
+
+/*Everything a spectator draws*/
+static bool ViewEquals(const GameSnapshot& a, const GameSnapshot& b)
+{
+    for (int y = 0; y < COORD_LIMIT_Y; y++)
+    {
+        if (!RowEquals(a, b, y))
+        {
+            return false;
+        }
+    }
+
+    return PieceEquals(a, b) && a.lines_cleared == b.lines_cleared && a.game_running == b.game_running;
+}
+
+/*Appends the records taking the spectators from the last frame to this one, nothing for a tick
+where nothing they can see changed*/
+void SpectatorEncoder::Encode(const SpectatorFrame& frame, std::vector<uint8_t>& out)
+{
+    const GameSnapshot& next = frame.snapshot;
+
+    bool new_game = !m_has_state || next.seed != m_state.seed || next.tick < m_state.tick;
+
+    if (new_game || frame.resync)
+    {
+        WriteKeyframe(next, 0, out);
+        return;
+    }
+
+    if (frame.cleared_rows != 0)
+    {
+        WriteTick(next.tick, out);
+        out.push_back(SPECTATOR_CLEAR);
+        PutVarint(out, frame.cleared_rows);
+        CollapseRows(m_state, frame.cleared_rows);
+    }
+
+    for (int y = 0; y < COORD_LIMIT_Y; y++)
+    {
+        if (RowEquals(m_state, next, y))
+        {
+            continue;
+        }
+
+        WriteTick(next.tick, out);
+        out.push_back(SPECTATOR_ROW);
+        out.push_back((uint8_t)y);
+        PutU16(out, next.rows[y]);
+
+        // two colors to a byte, low nibble first
+        int packed = 0;
+
+        for (int x = 0; x < COORD_LIMIT_X; x++)
+        {
+            if ((next.rows[y] & (1 << x)) == 0)
+            {
+                continue;
+            }
+
+            if (packed % 2 == 0)
+            {
+                out.push_back(next.colors[y][x]);
+            }
+            else
+            {
+                out.back() |= (uint8_t)(next.colors[y][x] << 4);
+            }
+            packed++;
+        }
+
+        m_state.rows[y] = next.rows[y];
+        m_state.colors[y] = next.colors[y];
+    }
+
+    if (!PieceEquals(m_state, next))
+    {
+        WriteTick(next.tick, out);
+        out.push_back(SPECTATOR_PIECE);
+        out.push_back((uint8_t)(next.piece_type << 4 | next.piece_rotation));
+        out.push_back((uint8_t)next.piece_x);
+        out.push_back((uint8_t)next.piece_y);
+
+        m_state.piece_type = next.piece_type;
+        m_state.piece_rotation = next.piece_rotation;
+        m_state.piece_x = next.piece_x;
+        m_state.piece_y = next.piece_y;
+    }
+
+    if (m_state.game_running && !next.game_running)
+    {
+        WriteTick(next.tick, out);
+        out.push_back(SPECTATOR_END);
+        PutVarint(out, next.lines_cleared);
+        m_state.game_running = 0;
+    }
+
+    // follows the changes so a spectator in sync can check it holds the same state
+    if (m_force_keyframe || next.tick - m_keyframe_tick >= SPECTATOR_KEYFRAME_TICKS)
+    {
+        WriteKeyframe(next, SPECTATOR_KEYFRAME_CONTINUES, out);
+    }
+}
+
+/*The next frame goes out whole, so a spectator that joins after it can start from there*/
+void SpectatorEncoder::ForceKeyframe()
+{
+    m_force_keyframe = true;
+}
+
+void SpectatorEncoder::WriteKeyframe(const GameSnapshot& snapshot, uint8_t flags, std::vector<uint8_t>& out)
+{
+    out.push_back(SPECTATOR_KEYFRAME);
+    out.push_back(flags);
+
+    size_t offset = out.size();
+    out.resize(offset + sizeof(GameSnapshot));
+    memcpy(out.data() + offset, &snapshot, sizeof(GameSnapshot));
+
+    m_state = snapshot;
+    m_has_state = true;
+    m_force_keyframe = false;
+    m_keyframe_tick = snapshot.tick;
+    m_keyframes++;
+}
+
+/*Opens a tick before its first change, m_state.tick is the last tick the spectators were sent*/
+void SpectatorEncoder::WriteTick(uint32_t tick, std::vector<uint8_t>& out)
+{
+    if (m_state.tick == tick)
+    {
+        return;
+    }
+
+    out.push_back(SPECTATOR_TICK);
+    PutVarint(out, tick - m_state.tick);
+    m_state.tick = tick;
+}
+
+/*Applies every complete record in data, keeps a partial one for the next call. False if the
+stream is not a spectator stream or is corrupt*/
+bool SpectatorDecoder::Receive(const uint8_t* data, size_t size)
+{
+    m_receive_buffer.insert(m_receive_buffer.end(), data, data + size);
+    size_t position = 0;
+
+    if (!m_header_read)
+    {
+        if (m_receive_buffer.size() < SPECTATOR_HEADER_SIZE)
+        {
+            return true;
+        }
+
+        if (memcmp(m_receive_buffer.data(), SPECTATOR_MAGIC, sizeof(SPECTATOR_MAGIC)) != 0 ||
+            GetU16(m_receive_buffer.data() + sizeof(SPECTATOR_MAGIC)) != SPECTATOR_PROTOCOL_VERSION)
+        {
+            ERROR_PRINT("ERROR: not a spectator stream, or another version of one");
+            return false;
+        }
+
+        m_header_read = true;
+        position = SPECTATOR_HEADER_SIZE;
+    }
+
+    while (position < m_receive_buffer.size())
+    {
+        int used = ParseRecord(m_receive_buffer.data() + position, m_receive_buffer.size() - position);
+
+        if (used < 0)
+        {
+            ERROR_PRINT("ERROR: bad spectator record " << (int)m_receive_buffer[position]);
+            return false;
+        }
+
+        if (used == 0)
+        {
+            break;
+        }
+
+        position += (size_t)used;
+    }
+
+    m_receive_buffer.erase(m_receive_buffer.begin(), m_receive_buffer.begin() + position);
+    return true;
+}
+
+/*Bytes used by the record at data, 0 if it is not all there yet and -1 if it is not valid.
+Records before the first keyframe are skipped*/
+int SpectatorDecoder::ParseRecord(const uint8_t* data, size_t size)
+{
+    const uint8_t* cursor = data + 1;
+    const uint8_t* end = data + size;
+    uint64_t value;
+
+    switch (data[0])
+    {
+    case SPECTATOR_KEYFRAME:
+    {
+        if (size < KEYFRAME_RECORD_SIZE)
+        {
+            return 0;
+        }
+
+        GameSnapshot keyframe;
+        memcpy(&keyframe, data + 2, sizeof(keyframe));
+        ApplyKeyframe(keyframe, data[1]);
+        return (int)KEYFRAME_RECORD_SIZE;
+    }
+
+    case SPECTATOR_TICK:
+        if (!GetVarint(cursor, end, value))
+        {
+            return 0;
+        }
+
+        m_state.tick += (uint32_t)value;
+        m_ticks++;
+        break;
+
+    case SPECTATOR_CLEAR:
+        if (!GetVarint(cursor, end, value))
+        {
+            return 0;
+        }
+
+        if (value >> COORD_LIMIT_Y)
+        {
+            return -1;
+        }
+
+        if (m_synced)
+        {
+            CollapseRows(m_state, (uint32_t)value);
+        }
+        break;
+
+    case SPECTATOR_ROW:
+    {
+        if (size < ROW_RECORD_HEADER_SIZE)
+        {
+            return 0;
+        }
+
+        int y = data[1];
+        RowMask mask = GetU16(data + 2);
+        size_t color_bytes = ((size_t)std::popcount(mask) + 1) / 2;
+
+        if (y >= COORD_LIMIT_Y || (mask & ~FULL_ROW_MASK) != 0)
+        {
+            return -1;
+        }
+
+        if (size < ROW_RECORD_HEADER_SIZE + color_bytes)
+        {
+            return 0;
+        }
+
+        cursor = data + ROW_RECORD_HEADER_SIZE + color_bytes;
+
+        if (!m_synced)
+        {
+            break;
+        }
+
+        const uint8_t* colors = data + ROW_RECORD_HEADER_SIZE;
+        int packed = 0;
+
+        for (int x = 0; x < COORD_LIMIT_X; x++)
+        {
+            if ((mask & (1 << x)) == 0)
+            {
+                continue;
+            }
+
+            uint8_t color = (colors[packed / 2] >> (packed % 2 * 4)) & 0x0F;
+
+            if (color >= BLOCK_COLOR_LENGTH)
+            {
+                return -1;
+            }
+
+            m_state.colors[y][x] = (BLOCK_COLOR)color;
+            packed++;
+        }
+
+        m_state.rows[y] = mask;
+        break;
+    }
+
+    case SPECTATOR_PIECE:
+        if (size < PIECE_RECORD_SIZE)
+        {
+            return 0;
+        }
+
+        m_state.piece_type = data[1] >> 4;
+        m_state.piece_rotation = data[1] & 0x0F;
+        m_state.piece_x = (int8_t)data[2];
+        m_state.piece_y = (int8_t)data[3];
+        cursor = data + PIECE_RECORD_SIZE;
+        break;
+
+    case SPECTATOR_END:
+        if (!GetVarint(cursor, end, value))
+        {
+            return 0;
+        }
+
+        if (m_synced)
+        {
+            m_state.game_running = 0;
+            m_state.lines_cleared = value;
+            m_games_finished++;
+        }
+        break;
+
+    default:
+        return -1;
+    }
+
+    return (int)(cursor - data);
+}
+
+/*A keyframe that continues the game should hold exactly what the records before it built up,
+anything else means a delta was encoded or applied wrong. One that is not a valid state at all is
+dropped and the view waits for the next*/
+void SpectatorDecoder::ApplyKeyframe(const GameSnapshot& keyframe, uint8_t flags)
+{
+    if (!SnapshotValid(keyframe, DEFAULT_ROTATION_SYSTEM))
+    {
+        ERROR_PRINT("ERROR: corrupt spectator keyframe at tick " << keyframe.tick << ", waiting for the next one");
+        m_bad_keyframes++;
+        m_synced = false;
+        return;
+    }
+
+    if (m_synced && (flags & SPECTATOR_KEYFRAME_CONTINUES) && !ViewEquals(m_state, keyframe))
+    {
+        ERROR_PRINT("ERROR: spectator state differs from the keyframe at tick " << keyframe.tick);
+        m_mismatches++;
+    }
+
+    m_state = keyframe;
+    m_synced = true;
+    m_keyframes++;
+}
+
+SpectatorFeed::~SpectatorFeed()
+{
+    m_running = false;
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+/*Listens for spectators on port and starts the feed thread*/
+bool SpectatorFeed::Start(uint16_t port)
+{
+    if (!m_listener.Listen(port))
+    {
+        return false;
+    }
+
+    DEBUG_PRINT("INFO: spectators can connect on port " << m_listener.LocalPort());
+
+    m_running = true;
+    m_thread = std::thread(&SpectatorFeed::Run, this);
+    return true;
+}
+
+/*Called by the game thread after each tick. Copies the state into the ring and returns, when the
+feed thread is a whole ring behind the frame is dropped and the next one goes out as a keyframe*/
+void SpectatorFeed::Publish(const GameCore& core, uint32_t cleared_rows, bool resync)
+{
+    size_t write_index = m_write_index.load(std::memory_order_relaxed);
+
+    if (write_index - m_read_index.load(std::memory_order_acquire) >= m_ring.size())
+    {
+        m_resync.store(true, std::memory_order_relaxed);
+        m_dropped_frames.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    SpectatorFrame& frame = m_ring[write_index % m_ring.size()];
+    core.SaveSnapshot(frame.snapshot);
+    frame.cleared_rows = cleared_rows;
+    frame.resync = m_resync.exchange(false, std::memory_order_relaxed) || resync;
+
+    m_write_index.store(write_index + 1, std::memory_order_release);
+}
+
+void SpectatorFeed::Run()
+{
+    while (m_running)
+    {
+        AcceptSpectators();
+        FlushSpectators();
+
+        size_t read_index = m_read_index.load(std::memory_order_relaxed);
+        size_t write_index = m_write_index.load(std::memory_order_acquire);
+
+        if (read_index == write_index)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(FEED_IDLE_SLEEP_MS));
+            continue;
+        }
+
+        m_chunk.clear();
+
+        for (; read_index != write_index; read_index++)
+        {
+            m_encoder.Encode(m_ring[read_index % m_ring.size()], m_chunk);
+            m_read_index.store(read_index + 1, std::memory_order_release);
+        }
+
+        Broadcast(m_chunk);
+    }
+}
+
+/*Takes every spectator waiting to connect. They get the header now and join the broadcast from
+the next chunk, which holds a keyframe after its first frame's changes*/
+void SpectatorFeed::AcceptSpectators()
+{
+    NetSocket socket;
+
+    while (m_listener.Accept(socket, false))
+    {
+        Spectator spectator;
+        spectator.socket = std::move(socket);
+
+        uint8_t header[SPECTATOR_HEADER_SIZE];
+        memcpy(header, SPECTATOR_MAGIC, sizeof(SPECTATOR_MAGIC));
+        header[4] = (uint8_t)(SPECTATOR_PROTOCOL_VERSION & 0xFF);
+        header[5] = (uint8_t)(SPECTATOR_PROTOCOL_VERSION >> 8);
+
+        if (spectator.queue.Send(spectator.socket, header, sizeof(header)))
+        {
+            DEBUG_PRINT("INFO: spectator connected, " << m_spectators.size() + 1 << " watching");
+            m_spectators.push_back(std::move(spectator));
+            m_encoder.ForceKeyframe();
+        }
+    }
+}
+
+/*Queues data for every spectator and sends what each socket takes. A spectator that stops reading
+only fills its own queue and is dropped once that is full, so it holds up neither the others nor
+the feed thread*/
+void SpectatorFeed::Broadcast(const std::vector<uint8_t>& data)
+{
+    if (data.empty())
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < m_spectators.size();)
+    {
+        Spectator& spectator = m_spectators[i];
+
+        if (spectator.queue.Send(spectator.socket, data.data(), data.size()))
+        {
+            i++;
+            continue;
+        }
+
+        DEBUG_PRINT("INFO: spectator left");
+        m_spectators.erase(m_spectators.begin() + i);
+    }
+}
+
+/*Sends what is still queued for spectators whose sockets were full last time*/
+void SpectatorFeed::FlushSpectators()
+{
+    for (size_t i = 0; i < m_spectators.size();)
+    {
+        Spectator& spectator = m_spectators[i];
+
+        if (spectator.queue.Flush(spectator.socket))
+        {
+            i++;
+            continue;
+        }
+
+        DEBUG_PRINT("INFO: spectator left");
+        m_spectators.erase(m_spectators.begin() + i);
+    }
+}
@@ -1,27 +1,107 @@
 #include "utility.hpp"
+#include <algorithm>
 #include <random>
-#include <iostream>
+#include <limits>
 
 static bool g_srand_called = false;
-static std::random_device rand_device;
-static std::mt19937_64 rand_engine;
-static std::uniform_int_distribution<Uint64> rand_distribution;
+static Rng g_rng;
+
+static uint64_t RotateLeft(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+Rng::Rng(uint64_t seed)
+{
+    Seed(seed);
+}
+
+/*Expands the seed with splitmix64 so nearby seeds give unrelated streams*/
+void Rng::Seed(uint64_t seed)
+{
+    for (uint64_t& word : m_state)
+    {
+        seed += 0x9E3779B97F4A7C15ULL;
+        uint64_t z = seed;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        word = z ^ (z >> 31);
+    }
+}
+
+uint64_t Rng::Next()
+{
+    uint64_t result = RotateLeft(m_state[1] * 5, 7) * 9;
+    uint64_t t = m_state[1] << 17;
+
+    m_state[2] ^= m_state[0];
+    m_state[3] ^= m_state[1];
+    m_state[1] ^= m_state[2];
+    m_state[0] ^= m_state[3];
+    m_state[2] ^= t;
+    m_state[3] = RotateLeft(m_state[3], 45);
+
+    return result;
+}
+
+/*Uniform in [min, max], rejection sampled so small ranges are not biased*/
+uint64_t Rng::Range(uint64_t min, uint64_t max)
+{
+    uint64_t span = max - min + 1;
+
+    if (span == 0)
+    {
+        return Next();
+    }
+
+    uint64_t limit = std::numeric_limits<uint64_t>::max() - std::numeric_limits<uint64_t>::max() % span;
+    uint64_t value = Next();
+
+    while (value >= limit)
+    {
+        value = Next();
+    }
+
+    return min + value % span;
+}
+
+uint64_t RandomSeed()
+{
+    std::random_device rand_device;
+    return ((uint64_t)rand_device() << 32) | rand_device();
+}
 
 uint64_t Random()
 {
     if (!g_srand_called)
     {
-        rand_engine = std::mt19937_64(rand_device());
-        rand_distribution = std::uniform_int_distribution<uint64_t>(0, (uint64_t)std::pow(2,63));
+        g_rng.Seed(RandomSeed());
         g_srand_called = true;
     }
 
-    return rand_distribution(rand_engine);
+    return g_rng.Next() >> 1;
 }
 
 uint64_t Random(uint64_t min, uint64_t max)
 {
-    auto rand = std::mt19937_64(rand_device());
-    auto dist = std::uniform_int_distribution<uint64_t>(0, max);
-    return dist(rand);
-}
\ No newline at end of file
+    if (!g_srand_called)
+    {
+        g_rng.Seed(RandomSeed());
+        g_srand_called = true;
+    }
+
+    return g_rng.Range(min, max);
+}
+
+/*Value below which fraction of values fall, reorders values*/
+double Percentile(std::vector<double>& values, double fraction)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+
+    size_t index = std::min((size_t)(fraction * values.size()), values.size() - 1);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
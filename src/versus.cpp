@@ -0,0 +1,157 @@
+#include "versus.hpp"
+#include <algorithm>
+
+// garbage rows sent for clearing 0, 1, 2, 3 or 4 lines at once
+static const uint8_t GARBAGE_FOR_LINES[5] = {0, 0, 1, 2, 4};
+
+static const uint64_t GARBAGE_SEED_SALT = 0x9E3779B97F4A7C15ULL;
+
+VersusCore::VersusCore(const GameSettings& settings)
+    : VersusCore(settings, settings.seed != 0 ? settings.seed : RandomSeed())
+{
+}
+
+static GameSettings WithSeed(GameSettings settings, uint64_t seed)
+{
+    settings.seed = seed;
+    return settings;
+}
+
+VersusCore::VersusCore(const GameSettings& settings, uint64_t seed)
+    : m_players{GameCore(WithSeed(settings, seed)), GameCore(WithSeed(settings, seed))},
+    m_garbage_rng(seed ^ GARBAGE_SEED_SALT)
+{
+}
+
+/*Applies each player's inputs and runs one tick for both, then trades garbage. Lines cleared
+first cancel the player's own pending garbage, what is left over goes to the other player and
+lands the next time they lock a piece without clearing anything*/
+void VersusCore::Step(const VersusInputs& inputs, VersusTickEvents& out_events)
+{
+    out_events = {};
+    m_tick++;
+
+    for (size_t p = 0; p < VERSUS_PLAYERS; p++)
+    {
+        GameCore& core = m_players[p];
+
+        for (uint8_t i = 0; i < inputs[p].count; i++)
+        {
+            core.ApplyInput((GAME_INPUT)inputs[p].inputs[i]);
+        }
+
+        core.Step();
+
+        GameEvent event;
+
+        while (core.PollEvent(event))
+        {
+            if (event.type == EVENT_PIECE_LOCKED)
+            {
+                out_events.pieces_locked[p]++;
+            }
+            else if (event.type == EVENT_LINES_CLEARED)
+            {
+                out_events.lines_cleared[p] += (uint8_t)event.value;
+            }
+        }
+    }
+
+    for (size_t p = 0; p < VERSUS_PLAYERS; p++)
+    {
+        uint8_t attack = GARBAGE_FOR_LINES[std::min<uint8_t>(out_events.lines_cleared[p], 4)];
+        uint8_t cancelled = std::min(attack, m_pending_garbage[p]);
+        uint8_t& target = m_pending_garbage[(p + 1) % VERSUS_PLAYERS];
+
+        m_pending_garbage[p] -= cancelled;
+        target = (uint8_t)std::min(target + attack - cancelled, (int)MAX_PENDING_GARBAGE);
+    }
+
+    for (size_t p = 0; p < VERSUS_PLAYERS; p++)
+    {
+        if (out_events.pieces_locked[p] == 0 || out_events.lines_cleared[p] != 0 || m_pending_garbage[p] == 0)
+        {
+            continue;
+        }
+
+        GameCore& core = m_players[p];
+        int hole_x = (int)m_garbage_rng.Range(0, COORD_LIMIT_X - 1);
+        core.AddGarbage(m_pending_garbage[p], hole_x);
+        m_pending_garbage[p] = 0;
+
+        // a top out from the garbage shows up in IsOver, nothing else listens here
+        GameEvent event;
+        while (core.PollEvent(event));
+    }
+}
+
+void VersusCore::SaveSnapshot(VersusSnapshot& out_snapshot) const
+{
+    for (size_t p = 0; p < VERSUS_PLAYERS; p++)
+    {
+        m_players[p].SaveSnapshot(out_snapshot.players[p]);
+    }
+
+    out_snapshot.garbage_rng_state = m_garbage_rng.m_state;
+    out_snapshot.tick = m_tick;
+    out_snapshot.pending_garbage = m_pending_garbage;
+    out_snapshot.reserved[0] = 0;
+    out_snapshot.reserved[1] = 0;
+}
+
+void VersusCore::LoadSnapshot(const VersusSnapshot& snapshot)
+{
+    for (size_t p = 0; p < VERSUS_PLAYERS; p++)
+    {
+        m_players[p].LoadSnapshot(snapshot.players[p]);
+    }
+
+    m_garbage_rng.m_state = snapshot.garbage_rng_state;
+    m_tick = snapshot.tick;
+    m_pending_garbage = snapshot.pending_garbage;
+}
+
+bool VersusCore::IsOver() const
+{
+    for (const GameCore& core : m_players)
+    {
+        if (!core.m_game_running)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*Index of the player still standing, -1 while both are playing or when both topped out on the
+same tick*/
+int VersusCore::Winner() const
+{
+    int winner = -1;
+    size_t running = 0;
+
+    for (size_t p = 0; p < VERSUS_PLAYERS; p++)
+    {
+        if (m_players[p].m_game_running)
+        {
+            winner = (int)p;
+            running++;
+        }
+    }
+
+    return running == 1 ? winner : -1;
+}
+
+/*Both games plus the garbage still in flight, equal on two machines only if they agree*/
+uint64_t VersusCore::Checksum() const
+{
+    uint64_t hash = m_tick;
+
+    for (size_t p = 0; p < VERSUS_PLAYERS; p++)
+    {
+        hash = hash * GARBAGE_SEED_SALT ^ m_players[p].Checksum();
+        hash = hash * GARBAGE_SEED_SALT ^ m_pending_garbage[p];
+    }
+
+    return hash ^ m_garbage_rng.m_state[0];
+}
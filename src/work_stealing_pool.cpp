@@ -0,0 +1,142 @@
+#include "work_stealing_pool.hpp"
+#include <algorithm>
+
+// lets Submit find the calling worker's own deque
+static thread_local WorkStealingPool* t_pool = NULL;
+static thread_local size_t t_worker_index = 0;
+
+WorkStealingPool::WorkStealingPool(size_t thread_count)
+{
+    thread_count = std::max<size_t>(thread_count, 1);
+
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        m_threads.emplace_back(&WorkStealingPool::Run, this, i);
+    }
+}
+
+/*Finishes every queued task before the workers exit*/
+WorkStealingPool::~WorkStealingPool()
+{
+    Wait();
+
+    {
+        std::lock_guard<std::mutex> lock(m_idle_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::Submit(std::function<void()> task)
+{
+    size_t index = t_pool == this ? t_worker_index : m_next_worker.fetch_add(1) % m_workers.size();
+
+    // counted before the task is visible so a worker taking it never sees the counts go negative
+    m_pending.fetch_add(1);
+    m_queued.fetch_add(1);
+
+    {
+        std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+        m_workers[index]->tasks.push_back(std::move(task));
+    }
+
+    // taking the lock orders the increment against a worker checking it before sleeping
+    {
+        std::lock_guard<std::mutex> lock(m_idle_mutex);
+    }
+    m_wake.notify_one();
+}
+
+/*Blocks until no more than max_pending tasks are unfinished. A producer can pass a small
+limit to keep from queueing far ahead of the workers*/
+void WorkStealingPool::Wait(size_t max_pending)
+{
+    std::unique_lock<std::mutex> lock(m_idle_mutex);
+    m_wait_limit.store(max_pending);
+    m_done.wait(lock, [&] { return m_pending.load() <= max_pending; });
+}
+
+size_t WorkStealingPool::ThreadCount() const
+{
+    return m_threads.size();
+}
+
+size_t WorkStealingPool::StealCount() const
+{
+    return m_steals.load();
+}
+
+/*Own deque newest first, then the other deques oldest first*/
+bool WorkStealingPool::TakeTask(size_t index, std::function<void()>& out_task)
+{
+    {
+        Worker& own = *m_workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+
+        if (!own.tasks.empty())
+        {
+            out_task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t offset = 1; offset < m_workers.size(); offset++)
+    {
+        Worker& victim = *m_workers[(index + offset) % m_workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.tasks.empty())
+        {
+            out_task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_steals.fetch_add(1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingPool::Run(size_t index)
+{
+    t_pool = this;
+    t_worker_index = index;
+
+    std::function<void()> task;
+
+    while (true)
+    {
+        if (TakeTask(index, task))
+        {
+            m_queued.fetch_sub(1);
+            task();
+            task = nullptr;
+
+            if (m_pending.fetch_sub(1) - 1 <= m_wait_limit.load())
+            {
+                std::lock_guard<std::mutex> lock(m_idle_mutex);
+                m_done.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_idle_mutex);
+        m_wake.wait(lock, [&] { return m_stopping || m_queued.load() > 0; });
+
+        if (m_stopping && m_queued.load() == 0)
+        {
+            break;
+        }
+    }
+}